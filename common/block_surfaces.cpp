@@ -0,0 +1,50 @@
+#include "stdafx.h"
+#include "block_surfaces.h"
+
+
+// What surface, if any, should go between two blocks? Against air, a block always
+// shows. Stone and coal only show against dirt, and coal against stone, when the
+// transitions are being drawn.
+SurfaceType CalcSurfaceType(BlockType block_type, FaceType face, BlockType other, bool draw_transitions)
+{
+    SurfaceType result = SurfaceType::NOTHING;
+
+    switch (block_type) {
+    case BlockType::DIRT:
+        if (other == BlockType::AIR) {
+            result = SurfaceType::DIRT;
+        }
+        break;
+
+    case BlockType::STONE:
+        if (other == BlockType::AIR) {
+            result = SurfaceType::STONE;
+        }
+        else {
+            bool show = (other == BlockType::DIRT);
+            if (show && draw_transitions) {
+                result = SurfaceType::STONE;
+            }
+        }
+        break;
+
+    case BlockType::COAL:
+        if (other == BlockType::AIR) {
+            result = SurfaceType::COAL;
+        }
+        else {
+            bool show = ((other == BlockType::DIRT) || 
+                         (other == BlockType::STONE));
+            if (show && draw_transitions) {
+                result = SurfaceType::COAL;
+            }
+        }
+        break;
+
+    default:
+        PrintTheImpossible(__FILE__, __LINE__, static_cast<int>(block_type));
+        break;
+    }
+
+    return result;
+}
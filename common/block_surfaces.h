@@ -0,0 +1,102 @@
+#pragma once
+
+#include "stdafx.h"
+#include "common_util.h"
+
+/**
+ * Which faces of a block show, and what's drawn on them.
+ *
+ * The game turns these into its landscape's vertex lists, and the world editor's
+ * terrain preview draws them itself, but whether a face is there at all gets
+ * decided right here, for both of them, so the preview shows what the game would.
+ * Nothing in here knows about OpenGL or wxWidgets.
+ */
+
+
+// The faces of a block.
+enum class FaceType
+{
+    NONE   = 0,
+    SOUTH  = 1,
+    NORTH  = 2,
+    WEST   = 3,
+    EAST   = 4,
+    TOP    = 5,
+    BOTTOM = 6
+};
+
+
+// What gets drawn on a face.
+enum class SurfaceType : unsigned char
+{
+    GRASS_TOP = 0,
+    DIRT      = 1,
+    STONE     = 2,
+    COAL      = 3,
+
+    NOTHING   = 255
+};
+
+const int SURFACE_TYPE_COUNT = 4;
+
+
+SurfaceType CalcSurfaceType(BlockType block_type, FaceType face, BlockType other, bool draw_transitions);
+
+
+// The surfaces on all six faces of one block.
+struct BlockSurfaces
+{
+    BlockSurfaces() :
+        south(SurfaceType::NOTHING), north(SurfaceType::NOTHING),
+        west(SurfaceType::NOTHING), east(SurfaceType::NOTHING),
+        top(SurfaceType::NOTHING), bottom(SurfaceType::NOTHING) {}
+
+    bool hasAny() const {
+        return (
+            (south  != SurfaceType::NOTHING) ||
+            (north  != SurfaceType::NOTHING) ||
+            (west   != SurfaceType::NOTHING) ||
+            (east   != SurfaceType::NOTHING) ||
+            (top    != SurfaceType::NOTHING) ||
+            (bottom != SurfaceType::NOTHING));
+    }
+
+    SurfaceType south;
+    SurfaceType north;
+    SurfaceType west;
+    SurfaceType east;
+    SurfaceType top;
+    SurfaceType bottom;
+};
+
+
+// Figure out which faces of the block at (x, y, z) show, in a grid "width" across
+// each way and "height" tall. Anything past the edges counts as air. For the game,
+// the grid is one chunk, and for the preview, it's the whole window. The neighbors
+// come from "get_block_type", which gets called with (x, y, z) too. Air has no faces.
+template<typename GetBlockType>
+void CalcBlockSurfaces(
+    BlockType block_type, int x, int y, int z, int width, int height,
+    bool draw_transitions, const GetBlockType &get_block_type, BlockSurfaces *pOut)
+{
+    *pOut = BlockSurfaces();
+    if (block_type == BlockType::AIR) {
+        return;
+    }
+
+    // Get our six neighbors, with the edges as air.
+    BlockType west_block_type   = (x > 0)          ? get_block_type(x - 1, y, z) : BlockType::AIR;
+    BlockType east_block_type   = (x < width - 1)  ? get_block_type(x + 1, y, z) : BlockType::AIR;
+    BlockType south_block_type  = (z > 0)          ? get_block_type(x, y, z - 1) : BlockType::AIR;
+    BlockType north_block_type  = (z < width - 1)  ? get_block_type(x, y, z + 1) : BlockType::AIR;
+    BlockType bottom_block_type = (y > 0)          ? get_block_type(x, y - 1, z) : BlockType::AIR;
+    BlockType top_block_type    = (y < height - 1) ? get_block_type(x, y + 1, z) : BlockType::AIR;
+
+    // Check each of the faces.
+    pOut->west   = CalcSurfaceType(block_type, FaceType::WEST,   west_block_type,   draw_transitions);
+    pOut->east   = CalcSurfaceType(block_type, FaceType::EAST,   east_block_type,   draw_transitions);
+    pOut->south  = CalcSurfaceType(block_type, FaceType::SOUTH,  south_block_type,  draw_transitions);
+    pOut->north  = CalcSurfaceType(block_type, FaceType::NORTH,  north_block_type,  draw_transitions);
+    pOut->bottom = CalcSurfaceType(block_type, FaceType::BOTTOM, bottom_block_type, draw_transitions);
+    pOut->top    = CalcSurfaceType(block_type, FaceType::TOP,    top_block_type,    draw_transitions);
+}
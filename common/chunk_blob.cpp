@@ -0,0 +1,210 @@
+#include "stdafx.h"
+#include "chunk_blob.h"
+
+
+// Ctor. The version goes in first.
+ChunkBlobWriter::ChunkBlobWriter() :
+    m_column_count(0)
+{
+    m_data.reserve(CHUNK_BLOB_COLUMNS * 4);
+    m_data.push_back(CHUNK_BLOB_VERSION);
+}
+
+
+// A column with nothing in it.
+void ChunkBlobWriter::addEmptyColumn()
+{
+    assert(!isComplete());
+
+    addVarint(0);
+    m_column_count++;
+}
+
+
+// Add a column, run by run. Runs longer than a byte get split up.
+void ChunkBlobWriter::addColumn(const ColumnRuns &column)
+{
+    assert(!isComplete());
+
+    int split_count = 0;
+    for (int i = 0; i < column.run_count; i++) {
+        split_count += (column.runs[i].length + 254) / 255;
+    }
+
+    addVarint(split_count);
+
+    for (int i = 0; i < column.run_count; i++) {
+        const BlockRun &run = column.runs[i];
+        assert(run.length > 0);
+
+        int remaining = run.length;
+        while (remaining > 0) {
+            int length = (remaining > 255) ? 255 : remaining;
+            m_data.push_back(static_cast<unsigned char>(run.block_type));
+            m_data.push_back(static_cast<unsigned char>(length));
+            remaining -= length;
+        }
+    }
+
+    m_column_count++;
+}
+
+
+// Add a column the way the old world files described them. Dirt from the bottom up to
+// the dirt top, then stone over that up to the stone top, then the coal. The coal has to
+// be sorted bottom up. Either top can be -1, which means there's none of it.
+void ChunkBlobWriter::addColumnTops(int dirt_top, int stone_top, const int *coal_ys, int coal_count)
+{
+    ColumnRuns column;
+
+    int top = (dirt_top > stone_top) ? dirt_top : stone_top;
+    assert(top < CHUNK_BLOB_HEIGHT);
+
+    int coal_index = 0;
+    for (int y = 0; y <= top; y++) {
+        BlockType block_type = (y <= stone_top) ? BlockType::STONE : BlockType::DIRT;
+
+        if ((coal_index < coal_count) && (coal_ys[coal_index] == y)) {
+            block_type = BlockType::COAL;
+            coal_index++;
+        }
+
+        BlockRun *last_run = (column.run_count > 0) ? &column.runs[column.run_count - 1] : nullptr;
+        if ((last_run != nullptr) && (last_run->block_type == block_type)) {
+            last_run->length++;
+        }
+        else {
+            column.runs[column.run_count] = { block_type, y, 1 };
+            column.run_count++;
+        }
+    }
+
+    // Coal outside the column would have been dropped on the floor.
+    assert(coal_index == coal_count);
+
+    addColumn(column);
+}
+
+
+// Add a number, seven bits at a time, low bits first.
+void ChunkBlobWriter::addVarint(int val)
+{
+    assert(val >= 0);
+
+    while (val >= 0x80) {
+        m_data.push_back(static_cast<unsigned char>((val & 0x7F) | 0x80));
+        val >>= 7;
+    }
+
+    m_data.push_back(static_cast<unsigned char>(val));
+}
+
+
+// Ctor. Check the version up front.
+ChunkBlobReader::ChunkBlobReader(const unsigned char *data, int size) :
+    m_data(data),
+    m_size(size),
+    m_pos(1),
+    m_column_count(0),
+    m_valid((data != nullptr) && (size > 0) && (data[0] == CHUNK_BLOB_VERSION))
+{
+}
+
+
+// Read the next column. Return false if it's past the end, or it doesn't make sense.
+bool ChunkBlobReader::readColumn(ColumnRuns *pOut)
+{
+    int run_count;
+    if (!m_valid || (m_column_count >= CHUNK_BLOB_COLUMNS) || !readVarint(&run_count)) {
+        m_valid = false;
+        return false;
+    }
+
+    if ((run_count > CHUNK_BLOB_HEIGHT) || (m_pos + (run_count * 2) > m_size)) {
+        m_valid = false;
+        return false;
+    }
+
+    int y = 0;
+    for (int i = 0; i < run_count; i++) {
+        BlockType block_type = static_cast<BlockType>(m_data[m_pos]);
+        int length = m_data[m_pos + 1];
+        m_pos += 2;
+
+        if ((length == 0) || (block_type > BlockType::COAL) || (y + length > CHUNK_BLOB_HEIGHT)) {
+            m_valid = false;
+            return false;
+        }
+
+        pOut->runs[i] = { block_type, y, length };
+        y += length;
+    }
+
+    pOut->run_count = run_count;
+    m_column_count++;
+    return true;
+}
+
+
+// Skip over the next column, when we only want some of them.
+bool ChunkBlobReader::skipColumn()
+{
+    int run_count;
+    if (!m_valid || (m_column_count >= CHUNK_BLOB_COLUMNS) || !readVarint(&run_count)) {
+        m_valid = false;
+        return false;
+    }
+
+    if ((run_count > CHUNK_BLOB_HEIGHT) || (m_pos + (run_count * 2) > m_size)) {
+        m_valid = false;
+        return false;
+    }
+
+    m_pos += run_count * 2;
+    m_column_count++;
+    return true;
+}
+
+
+// Read a number, seven bits at a time. Nothing we write needs more than a few bytes.
+bool ChunkBlobReader::readVarint(int *pOut)
+{
+    int result = 0;
+
+    for (int shift = 0; shift < 28; shift += 7) {
+        if (m_pos >= m_size) {
+            return false;
+        }
+
+        unsigned char one_byte = m_data[m_pos];
+        m_pos++;
+
+        result |= (one_byte & 0x7F) << shift;
+        if ((one_byte & 0x80) == 0) {
+            *pOut = result;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+// Get the dirt and stone tops back out of a column.
+void CalcColumnTops(const ColumnRuns &column, int *pOut_dirt_top, int *pOut_stone_top)
+{
+    *pOut_dirt_top  = -1;
+    *pOut_stone_top = -1;
+
+    for (int i = 0; i < column.run_count; i++) {
+        const BlockRun &run = column.runs[i];
+        int run_top = run.first_y + run.length - 1;
+
+        if (run.block_type == BlockType::DIRT) {
+            *pOut_dirt_top = run_top;
+        }
+        else if (run.block_type == BlockType::STONE) {
+            *pOut_stone_top = run_top;
+        }
+    }
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "stdafx.h"
+#include "common_util.h"
+
+/**
+ * The chunk blob format, for world files and the chunk cache.
+ *
+ * The world editor writes these, and the game reads them (and writes them
+ * too, for generated worlds). Unlike common_util, there's just the one copy
+ * of this code, which both of them build, so they can't drift apart.
+ *
+ * A world file has one row per chunk, keyed by the chunk's origin, and the
+ * whole chunk goes in one blob. First a version byte, then every column,
+ * X-major, so column (x, z) is number "(x * CHUNK_BLOB_WIDTH) + z".
+ * Each column is a run count, as a varint, then that many runs from the
+ * bottom up. A run is a block type byte, then a length byte, from 1 to 255.
+ * Anything above the last run is air, so an empty column is just a zero.
+ *
+ * This version last updated on Mon, Oct 19th, 2026.
+ */
+
+
+const int CHUNK_BLOB_VERSION = 1;
+const int CHUNK_BLOB_WIDTH   = 32;
+const int CHUNK_BLOB_HEIGHT  = 256;
+const int CHUNK_BLOB_COLUMNS = CHUNK_BLOB_WIDTH * CHUNK_BLOB_WIDTH;
+
+
+// A run of blocks of the same type, stacked up in one column.
+struct BlockRun
+{
+    BlockType block_type;
+    int first_y;
+    int length;
+};
+
+
+// All the runs in one column. Every run is at least one block tall, so this is always enough.
+struct ColumnRuns
+{
+    ColumnRuns() : run_count(0) {}
+
+    int run_count;
+    std::array<BlockRun, CHUNK_BLOB_HEIGHT> runs;
+};
+
+
+// Builds up a chunk blob, one column at a time, in blob order.
+class ChunkBlobWriter
+{
+public:
+    ChunkBlobWriter();
+    ~ChunkBlobWriter() {}
+
+    void addEmptyColumn();
+    void addColumn(const ColumnRuns &column);
+    void addColumnTops(int dirt_top, int stone_top, const int *coal_ys, int coal_count);
+
+    bool isComplete() const { return m_column_count == CHUNK_BLOB_COLUMNS; }
+    const std::vector<unsigned char> &getData() const { return m_data; }
+
+private:
+    // Private methods.
+    void addVarint(int val);
+
+    // Private data.
+    std::vector<unsigned char> m_data;
+    int m_column_count;
+};
+
+
+// Reads a chunk blob back, one column at a time, in blob order.
+// Anything that doesn't look right makes it fail, rather than read garbage.
+class ChunkBlobReader
+{
+public:
+    ChunkBlobReader(const unsigned char *data, int size);
+    ~ChunkBlobReader() {}
+
+    bool isValid() const { return m_valid; }
+    bool readColumn(ColumnRuns *pOut);
+    bool skipColumn();
+
+private:
+    // Private methods.
+    bool readVarint(int *pOut);
+
+    // Private data.
+    const unsigned char *m_data;
+    int m_size;
+    int m_pos;
+    int m_column_count;
+    bool m_valid;
+};
+
+
+// Unpack a whole blob, handing every block that isn't air to "set_block", as
+// (x, y, z, block type), in chunk coords. Air gets skipped, so whatever it's going
+// into should start out empty. This is how the game fills in a chunk, and how the
+// editor's preview fills in its window, so they always agree on what's where.
+// Return false if the blob's no good, after setting whatever came before that.
+template<typename SetBlock>
+bool ReadChunkBlobBlocks(const unsigned char *data, int size, const SetBlock &set_block)
+{
+    ChunkBlobReader reader(data, size);
+    ColumnRuns column;
+
+    for     (int local_x = 0; local_x < CHUNK_BLOB_WIDTH; local_x++) {
+        for (int local_z = 0; local_z < CHUNK_BLOB_WIDTH; local_z++) {
+            if (!reader.readColumn(&column)) {
+                return false;
+            }
+
+            for (int i = 0; i < column.run_count; i++) {
+                const BlockRun &run = column.runs[i];
+                if (run.block_type == BlockType::AIR) {
+                    continue;
+                }
+
+                int last_y = run.first_y + run.length;
+                for (int y = run.first_y; y < last_y; y++) {
+                    set_block(local_x, y, local_z, run.block_type);
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+
+// The old world files only kept the dirt and stone tops. Get those back
+// from the runs. A top of -1 means there's none of that kind in the column.
+void CalcColumnTops(const ColumnRuns &column, int *pOut_dirt_top, int *pOut_stone_top);
@@ -0,0 +1,131 @@
+#include "stdafx.h"
+#include "column_recipe.h"
+
+#include "simplex_noise.h"
+
+
+// The noise that pushes the stone top up or down.
+double CalcStoneNoise(const ColumnRecipe &recipe, int world_x, int world_z)
+{
+    // Scale our noise outward.
+    double noise_x = (world_x / recipe.stone_noise_scale) + recipe.noise_offset_x;
+    double noise_z = (world_z / recipe.stone_noise_scale) + recipe.noise_offset_z;
+    return simplex_noise_2(noise_x, noise_z) - 0.5;
+}
+
+
+// Given our landscape top, and the noise for the column, calc where the stone top goes.
+int CalcStoneHeightFromNoise(const ColumnRecipe &recipe, int dirt_height, double noise_val)
+{
+    // First, scale the stone, then lower it.
+    int result = (dirt_height * (recipe.stone_percent / 100.0)) - recipe.stone_subtracted;
+
+    // Displace the result by our noise value.
+    result += (noise_val * recipe.stone_displacement);
+
+    // Return -1 to mean there's no stone at all. The settings can ask
+    // for silly amounts of stone, so keep it inside the chunk, too.
+    if (result < -1) {
+        result = -1;
+    }
+    if (result >= CHUNK_BLOB_HEIGHT) {
+        result = CHUNK_BLOB_HEIGHT - 1;
+    }
+
+    return result;
+}
+
+
+// Given our landscape top, calc where the stone top goes.
+int CalcStoneHeight(const ColumnRecipe &recipe, int world_x, int world_z, int dirt_height)
+{
+    return CalcStoneHeightFromNoise(recipe, dirt_height, CalcStoneNoise(recipe, world_x, world_z));
+}
+
+
+// The coal noise up a column. This is most of the build time, so it's one batch.
+// That changed the worlds. The batched noise is in floats, so some blocks right at
+// the coal density flip to or from coal, compared to worlds built a point at a time
+// before it came along. It's 14 of 12.4M blocks on a 1024x1024 heightmap. Whenever
+// worlds are said to come out byte-identical since then, like with the chunk blobs,
+// or the game's generator, it's compared to worlds built with the batched noise.
+void CalcCoalNoise(const ColumnRecipe &recipe, int world_x, int world_z, int top, float *pOut)
+{
+    assert(top < CHUNK_BLOB_HEIGHT);
+
+    float noise_x = static_cast<float>((world_x / recipe.stone_noise_scale) + recipe.noise_offset_x);
+    float noise_z = static_cast<float>((world_z / recipe.stone_noise_scale) + recipe.noise_offset_z);
+    float y_step  = static_cast<float>(1.0 / recipe.stone_noise_scale);
+
+    simplex_noise_3_column(noise_x, noise_z, 0.0f, y_step, top + 1, pOut);
+}
+
+
+// Calc the blocks for one column, then its rows. The rows go through the dirt and
+// stone tops, the same as the old blocks table did, so worlds come out exactly the
+// way they used to. Coal that's right on top of the stone never made it into the
+// old rows, so it doesn't make it in here either, though it's still in the blocks.
+void CalcColumn(const ColumnRecipe &recipe, int world_x, int world_z, int dirt_height, GeneratedColumn *pOut)
+{
+    pOut->block_count = 0;
+    pOut->dirt_top    = -1;
+    pOut->stone_top   = -1;
+    pOut->coal_count  = 0;
+
+    if (dirt_height < 0) {
+        return;
+    }
+
+    if (dirt_height >= CHUNK_BLOB_HEIGHT) {
+        dirt_height = CHUNK_BLOB_HEIGHT - 1;
+    }
+
+    // Given our dirt height, calc how tall the stone could be.
+    int stone_height = CalcStoneHeight(recipe, world_x, world_z, dirt_height);
+
+    // In rare cases, the stone could stick up *out* of the dirt.
+    int ceiling = (dirt_height > stone_height) ? dirt_height : stone_height;
+
+    // Dirt all the way up, then stone, then coal wherever the noise says so.
+    std::array<BlockType, CHUNK_BLOB_HEIGHT> &blocks = pOut->blocks;
+    for (int y = 0; y <= ceiling; y++) {
+        blocks[y] = BlockType::DIRT;
+    }
+
+    for (int y = 0; y <= stone_height; y++) {
+        blocks[y] = BlockType::STONE;
+    }
+
+    if (stone_height >= 0) {
+        double coal_density = recipe.coal_density / 100.0f;
+
+        float noise_vals[CHUNK_BLOB_HEIGHT];
+        CalcCoalNoise(recipe, world_x, world_z, stone_height, noise_vals);
+
+        for (int y = 0; y <= stone_height; y++) {
+            if (noise_vals[y] < coal_density) {
+                blocks[y] = BlockType::COAL;
+            }
+        }
+    }
+
+    pOut->block_count = ceiling + 1;
+
+    // Calc the real tops of the dirt and stone.
+    for (int y = 0; y <= ceiling; y++) {
+        if (blocks[y] == BlockType::DIRT) {
+            pOut->dirt_top = y;
+        }
+        else if (blocks[y] == BlockType::STONE) {
+            pOut->stone_top = y;
+        }
+    }
+
+    // Then, each individual coal block under the stone top, bottom up.
+    for (int y = 0; y < pOut->stone_top; y++) {
+        if (blocks[y] == BlockType::COAL) {
+            pOut->coal_ys[pOut->coal_count] = y;
+            pOut->coal_count++;
+        }
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "stdafx.h"
+#include "chunk_blob.h"
+#include "common_util.h"
+
+/**
+ * The recipe for one column of terrain, for the game and the world editor both.
+ *
+ * Dirt up to the heightmap, stone under that, pushed up and down by 2D noise,
+ * and coal wherever 3D noise dips under the coal density. The editor bakes
+ * worlds with this, and the game makes them up on the fly with it, so with the
+ * same heightmap and settings, and no seed, they build exactly the same blocks.
+ */
+
+
+// Everything that goes into a column, besides where it is and how high the dirt goes.
+// The coal density is a percent. The noise offsets are how the game's seed slides the
+// noise somewhere else, and zero leaves it alone, which is what the editor does.
+struct ColumnRecipe
+{
+    ColumnRecipe() :
+        stone_percent(50.0),
+        stone_subtracted(4.0),
+        stone_displacement(8.0),
+        stone_noise_scale(100.0),
+        coal_density(1.0),
+        noise_offset_x(0.0),
+        noise_offset_z(0.0) {}
+
+    double stone_percent;
+    double stone_subtracted;
+    double stone_displacement;
+    double stone_noise_scale;
+    double coal_density;
+
+    double noise_offset_x;
+    double noise_offset_z;
+};
+
+
+// One column's blocks, bottom up, where everything from "block_count" up is air,
+// and the rows a world file has for it. A top of -1 means there's none of that kind.
+struct GeneratedColumn
+{
+    GeneratedColumn() :
+        block_count(0),
+        dirt_top(-1),
+        stone_top(-1),
+        coal_count(0) {}
+
+    int block_count;
+    std::array<BlockType, CHUNK_BLOB_HEIGHT> blocks;
+
+    int dirt_top;
+    int stone_top;
+
+    int coal_count;
+    std::array<int, CHUNK_BLOB_HEIGHT> coal_ys;
+};
+
+
+// The stone top is in two parts, so a dry run can keep the noise, which is the slow
+// part, and only depends on where the column is and the noise scale.
+double CalcStoneNoise(const ColumnRecipe &recipe, int world_x, int world_z);
+int CalcStoneHeightFromNoise(const ColumnRecipe &recipe, int dirt_height, double noise_val);
+int CalcStoneHeight(const ColumnRecipe &recipe, int world_x, int world_z, int dirt_height);
+
+// The coal noise up a column, from the bottom to "top", inclusive.
+void CalcCoalNoise(const ColumnRecipe &recipe, int world_x, int world_z, int top, float *pOut);
+
+// The whole column. Negative dirt heights are nothing at all.
+void CalcColumn(const ColumnRecipe &recipe, int world_x, int world_z, int dirt_height, GeneratedColumn *pOut);
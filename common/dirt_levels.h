@@ -0,0 +1,56 @@
+#pragma once
+
+#include "stdafx.h"
+#include "chunk_blob.h"
+
+/**
+ * Turning heightmap levels into dirt heights, for the game and the world editor both.
+ *
+ * A level is a heightmap pixel as 16 bits, however deep the heightmap really is.
+ * An 8-bit pixel's level is its value times 257, and color pixels are the average
+ * of red, green and blue. The editor bakes heightmaps into worlds with these, and
+ * the game's generator builds from them on the fly, so a seed of zero matches.
+ */
+
+
+// The stone can stick up to a hundred blocks out of the dirt, so this is as tall
+// as the dirt can go and still leave room for it under the top of the world.
+const int MAX_STONE_ABOVE_DIRT = 100;
+const int MAX_DIRT_HEIGHT = CHUNK_BLOB_HEIGHT - 1 - MAX_STONE_ABOVE_DIRT;
+
+
+// Turn one 16-bit level into how high the dirt goes. The whole range of levels gets
+// spread out evenly over every height there is, from nothing at all at the bottom,
+// which is -1, up to "MAX_DIRT_HEIGHT". That's about 417 levels a block.
+constexpr int LevelToDirtHeight(int level)
+{
+    return ((level * (MAX_DIRT_HEIGHT + 2)) >> 16) - 1;
+}
+
+
+// The same for 8-bit heightmaps, which keep the heights they always had, so old
+// worlds come out the same. Every 512 levels is a block, so that's half the 8-bit
+// color. Subtract one so that we don't have a two-block falloff at the edges.
+constexpr int LegacyLevelToDirtHeight(int level)
+{
+    return (level >> 9) - 1;
+}
+
+
+// Whichever of those goes with a heightmap this many bits deep.
+constexpr int LevelToDirtHeight(int level, int bit_depth)
+{
+    return (bit_depth <= 8) ? LegacyLevelToDirtHeight(level) : LevelToDirtHeight(level);
+}
+
+
+// The level for an 8-bit pixel, so 0 and 255 turn into 0 and 65535.
+constexpr int EightBitToLevel(int red, int green, int blue)
+{
+    return ((red + green + blue) / 3) * 257;
+}
+
+static_assert(LevelToDirtHeight(0) == -1, "Level zero has to be nothing at all");
+static_assert(LevelToDirtHeight(65535) == MAX_DIRT_HEIGHT, "The top level has to be the top height");
+static_assert(LegacyLevelToDirtHeight(65535) <= MAX_DIRT_HEIGHT, "8-bit heights have to fit too");
+static_assert(LevelToDirtHeight(EightBitToLevel(255, 255, 255), 8) == (255 / 2) - 1, "8-bit heights are half the color");
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "stdafx.h"
+
+/**
+ * Rounding to a multiple, for the game and the world editor both.
+ *
+ * Chunk origins are world coords rounded down to the chunk width, and the
+ * editor writes the chunks that the game reads, so the two had better agree.
+ * That's why this is the one copy, rather than one in each common_util.
+ */
+
+
+// Better rounding.
+int RoundUpInt(int val, int mult);
+int RoundDownInt(int val, int mult);
@@ -2,6 +2,21 @@
 #include "stdafx.h"
 #include "simplex_noise.h"
 
+#include <math.h>
+
+// The batched versions use as many float lanes as the build allows. x64 always
+// has SSE2, and AVX2 needs to be turned on in the build. Anything else falls
+// back to calling the regular versions one point at a time.
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SIMPLEX_LANES 8
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define SIMPLEX_LANES 4
+#else
+#define SIMPLEX_LANES 1
+#endif
+
 
 // This code is copied from the classic paper, "Simplex noise demystified", by Stefan Gustavson.
 // Translated from Java to C++.
@@ -107,20 +122,6 @@ static int simplex[][4] = {
 };
 
 
-// Here is one of the few times I'll tolerate C++ function overloading.
-GLfloat simplex_noise_2(const MyVec2 &val) {
-    return static_cast<GLfloat>(simplex_noise_2(val.x(), val.y()));
-}
-
-GLfloat simplex_noise_3(const MyVec4 &val) {
-    return static_cast<GLfloat>(simplex_noise_3(val.x(), val.y(), val.z()));
-}
-
-GLfloat simplex_noise_4(const MyVec4 &val) {
-    return static_cast<GLfloat>(simplex_noise_4(val.x(), val.y(), val.z(), val.w()));
-}
-
-
 // This method is a *lot* faster than using (int)Math.floor(x)
 static int fastfloor(double x)
 {
@@ -511,3 +512,400 @@ double simplex_noise_4(double x, double y, double z, double w)
     // Sum up and scale the result to cover the range [-1,1]
     return 27.0 * (n0 + n1 + n2 + n3 + n4);
 }
+
+
+// ---- Batched versions ----
+// Same math as above, just in floats, and a whole register of points at a time.
+// All the skewing, corner picking and falloffs happen across the lanes.
+
+#if SIMPLEX_LANES > 1
+
+// The gradient for every spot in "perm", already turned into floats. The last
+// table lookup for a corner lands straight on its gradient, instead of doing
+// "% 12" and then "grad3". Padded out to four, so a row is one SSE register.
+struct PermGradients
+{
+    float grads[512][4];
+};
+
+static const PermGradients &GetPermGradients()
+{
+    static const PermGradients table = []() {
+        PermGradients result;
+        for (int i = 0; i < 512; i++) {
+            int gi = perm[i] % 12;
+            result.grads[i][0] = static_cast<float>(grad3[gi][0]);
+            result.grads[i][1] = static_cast<float>(grad3[gi][1]);
+            result.grads[i][2] = static_cast<float>(grad3[gi][2]);
+            result.grads[i][3] = 0.0f;
+        }
+        return result;
+    }();
+
+    return table;
+}
+
+#endif
+
+
+#if SIMPLEX_LANES == 8
+typedef __m256  Lanes;
+typedef __m256i LaneInts;
+
+static inline Lanes LaneSet(float val)              { return _mm256_set1_ps(val); }
+static inline Lanes LaneLoad(const float *pSrc)     { return _mm256_loadu_ps(pSrc); }
+static inline void  LaneStore(float *pDest, Lanes a) { _mm256_storeu_ps(pDest, a); }
+
+static inline Lanes LaneAdd(Lanes a, Lanes b) { return _mm256_add_ps(a, b); }
+static inline Lanes LaneSub(Lanes a, Lanes b) { return _mm256_sub_ps(a, b); }
+static inline Lanes LaneMul(Lanes a, Lanes b) { return _mm256_mul_ps(a, b); }
+static inline Lanes LaneMax(Lanes a, Lanes b) { return _mm256_max_ps(a, b); }
+
+// Comparisons give all ones or all zeros in each lane, for masking.
+static inline Lanes LaneGE(Lanes a, Lanes b)     { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+static inline Lanes LaneGT(Lanes a, Lanes b)     { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+static inline Lanes LaneAnd(Lanes a, Lanes b)    { return _mm256_and_ps(a, b); }
+static inline Lanes LaneOr(Lanes a, Lanes b)     { return _mm256_or_ps(a, b); }
+static inline Lanes LaneAndNot(Lanes a, Lanes b) { return _mm256_andnot_ps(a, b); }
+
+static inline Lanes    LaneTruncate(Lanes a) { return _mm256_cvtepi32_ps(_mm256_cvttps_epi32(a)); }
+static inline LaneInts LaneToInts(Lanes a)   { return _mm256_cvttps_epi32(a); }
+
+static inline LaneInts LaneIntsAdd(LaneInts a, LaneInts b) { return _mm256_add_epi32(a, b); }
+static inline LaneInts LaneIntsWrap(LaneInts a) { return _mm256_and_si256(a, _mm256_set1_epi32(255)); }
+
+// Look up "perm" for every lane at once.
+static inline LaneInts LanePerm(LaneInts index)
+{
+    return _mm256_i32gather_epi32(perm, index, 4);
+}
+
+// Look up the gradient for every lane at once.
+static inline void LaneGradients(LaneInts index, const PermGradients &table, Lanes *pOut_x, Lanes *pOut_y, Lanes *pOut_z)
+{
+    const float *base = &table.grads[0][0];
+    LaneInts offset = _mm256_slli_epi32(index, 2);
+
+    *pOut_x = _mm256_i32gather_ps(base,     offset, 4);
+    *pOut_y = _mm256_i32gather_ps(base + 1, offset, 4);
+    *pOut_z = _mm256_i32gather_ps(base + 2, offset, 4);
+}
+
+#elif SIMPLEX_LANES == 4
+typedef __m128  Lanes;
+typedef __m128i LaneInts;
+
+static inline Lanes LaneSet(float val)              { return _mm_set1_ps(val); }
+static inline Lanes LaneLoad(const float *pSrc)     { return _mm_loadu_ps(pSrc); }
+static inline void  LaneStore(float *pDest, Lanes a) { _mm_storeu_ps(pDest, a); }
+
+static inline Lanes LaneAdd(Lanes a, Lanes b) { return _mm_add_ps(a, b); }
+static inline Lanes LaneSub(Lanes a, Lanes b) { return _mm_sub_ps(a, b); }
+static inline Lanes LaneMul(Lanes a, Lanes b) { return _mm_mul_ps(a, b); }
+static inline Lanes LaneMax(Lanes a, Lanes b) { return _mm_max_ps(a, b); }
+
+// Comparisons give all ones or all zeros in each lane, for masking.
+static inline Lanes LaneGE(Lanes a, Lanes b)     { return _mm_cmpge_ps(a, b); }
+static inline Lanes LaneGT(Lanes a, Lanes b)     { return _mm_cmpgt_ps(a, b); }
+static inline Lanes LaneAnd(Lanes a, Lanes b)    { return _mm_and_ps(a, b); }
+static inline Lanes LaneOr(Lanes a, Lanes b)     { return _mm_or_ps(a, b); }
+static inline Lanes LaneAndNot(Lanes a, Lanes b) { return _mm_andnot_ps(a, b); }
+
+static inline Lanes    LaneTruncate(Lanes a) { return _mm_cvtepi32_ps(_mm_cvttps_epi32(a)); }
+static inline LaneInts LaneToInts(Lanes a)   { return _mm_cvttps_epi32(a); }
+
+static inline LaneInts LaneIntsAdd(LaneInts a, LaneInts b) { return _mm_add_epi32(a, b); }
+static inline LaneInts LaneIntsWrap(LaneInts a) { return _mm_and_si128(a, _mm_set1_epi32(255)); }
+
+// Look up "perm" for every lane. SSE2 has no gathers, so it's one at a time.
+static inline LaneInts LanePerm(LaneInts index)
+{
+    alignas(16) int idx[4];
+    _mm_store_si128(reinterpret_cast<__m128i *>(idx), index);
+    return _mm_setr_epi32(perm[idx[0]], perm[idx[1]], perm[idx[2]], perm[idx[3]]);
+}
+
+// Look up the gradient for every lane. Each gradient is one row of the
+// table, so grab the four rows and flip them around into x, y and z.
+static inline void LaneGradients(LaneInts index, const PermGradients &table, Lanes *pOut_x, Lanes *pOut_y, Lanes *pOut_z)
+{
+    alignas(16) int idx[4];
+    _mm_store_si128(reinterpret_cast<__m128i *>(idx), index);
+
+    Lanes row0 = _mm_loadu_ps(table.grads[idx[0]]);
+    Lanes row1 = _mm_loadu_ps(table.grads[idx[1]]);
+    Lanes row2 = _mm_loadu_ps(table.grads[idx[2]]);
+    Lanes row3 = _mm_loadu_ps(table.grads[idx[3]]);
+    _MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+
+    *pOut_x = row0;
+    *pOut_y = row1;
+    *pOut_z = row2;
+}
+#endif
+
+
+#if SIMPLEX_LANES > 1
+
+// The same floor as "fastfloor", quirks and all, so the batches agree with the regular versions.
+static inline Lanes LaneFastFloor(Lanes x)
+{
+    Lanes minus_one = LaneAndNot(LaneGT(x, LaneSet(0.0f)), LaneSet(1.0f));
+    return LaneSub(LaneTruncate(x), minus_one);
+}
+
+
+// One corner's share of the 2D noise. "index" is where its last "perm" lookup would go.
+static inline Lanes LaneCorner2(const PermGradients &table, LaneInts index, Lanes x, Lanes y)
+{
+    Lanes gx, gy, gz;
+    LaneGradients(index, table, &gx, &gy, &gz);
+
+    Lanes t = LaneSub(LaneSet(0.5f), LaneAdd(LaneMul(x, x), LaneMul(y, y)));
+    t = LaneMax(t, LaneSet(0.0f));
+    t = LaneMul(t, t);
+
+    Lanes dot = LaneAdd(LaneMul(gx, x), LaneMul(gy, y));
+    return LaneMul(LaneMul(t, t), dot);
+}
+
+
+// One corner's share of the 3D noise. "index" is where its last "perm" lookup would go.
+static inline Lanes LaneCorner3(const PermGradients &table, LaneInts index, Lanes x, Lanes y, Lanes z)
+{
+    Lanes gx, gy, gz;
+    LaneGradients(index, table, &gx, &gy, &gz);
+
+    Lanes t = LaneSub(LaneSet(0.6f), LaneAdd(LaneAdd(LaneMul(x, x), LaneMul(y, y)), LaneMul(z, z)));
+    t = LaneMax(t, LaneSet(0.0f));
+    t = LaneMul(t, t);
+
+    Lanes dot = LaneAdd(LaneAdd(LaneMul(gx, x), LaneMul(gy, y)), LaneMul(gz, z));
+    return LaneMul(LaneMul(t, t), dot);
+}
+
+
+// 2D simplex noise, for a register's worth of points.
+static Lanes LaneSimplexNoise2(const PermGradients &table, Lanes xin, Lanes yin)
+{
+    const float F2 = 0.5f * (sqrtf(3.0f) - 1.0f);
+    const float G2 = (3.0f - sqrtf(3.0f)) / 6.0f;
+
+    // Skew the input space to find our cell, then unskew back.
+    Lanes s = LaneMul(LaneAdd(xin, yin), LaneSet(F2));
+    Lanes i = LaneFastFloor(LaneAdd(xin, s));
+    Lanes j = LaneFastFloor(LaneAdd(yin, s));
+    Lanes t = LaneMul(LaneAdd(i, j), LaneSet(G2));
+
+    Lanes x0 = LaneSub(xin, LaneSub(i, t));
+    Lanes y0 = LaneSub(yin, LaneSub(j, t));
+
+    // Lower or upper triangle.
+    Lanes one = LaneSet(1.0f);
+    Lanes i1 = LaneAnd(LaneGT(x0, y0), one);
+    Lanes j1 = LaneSub(one, i1);
+
+    Lanes x1 = LaneAdd(LaneSub(x0, i1), LaneSet(G2));
+    Lanes y1 = LaneAdd(LaneSub(y0, j1), LaneSet(G2));
+    Lanes x2 = LaneAdd(LaneSub(x0, one), LaneSet(2.0f * G2));
+    Lanes y2 = LaneAdd(LaneSub(y0, one), LaneSet(2.0f * G2));
+
+    // Hash the corners.
+    LaneInts ii = LaneIntsWrap(LaneToInts(i));
+    LaneInts jj = LaneIntsWrap(LaneToInts(j));
+    LaneInts i1_ints = LaneToInts(i1);
+    LaneInts j1_ints = LaneToInts(j1);
+    LaneInts one_ints = LaneToInts(one);
+
+    LaneInts index0 = LaneIntsAdd(ii, LanePerm(jj));
+    LaneInts index1 = LaneIntsAdd(LaneIntsAdd(ii, i1_ints), LanePerm(LaneIntsAdd(jj, j1_ints)));
+    LaneInts index2 = LaneIntsAdd(LaneIntsAdd(ii, one_ints), LanePerm(LaneIntsAdd(jj, one_ints)));
+
+    Lanes n0 = LaneCorner2(table, index0, x0, y0);
+    Lanes n1 = LaneCorner2(table, index1, x1, y1);
+    Lanes n2 = LaneCorner2(table, index2, x2, y2);
+
+    return LaneMul(LaneSet(70.0f), LaneAdd(LaneAdd(n0, n1), n2));
+}
+
+
+// Where the last "perm" lookup goes for one corner of the 3D simplex.
+static inline LaneInts LaneHash3(LaneInts ii, LaneInts jj, LaneInts kk, LaneInts off_i, LaneInts off_j, LaneInts off_k)
+{
+    LaneInts hash = LanePerm(LaneIntsAdd(kk, off_k));
+    hash = LanePerm(LaneIntsAdd(LaneIntsAdd(jj, off_j), hash));
+    return LaneIntsAdd(LaneIntsAdd(ii, off_i), hash);
+}
+
+
+// 3D simplex noise, for a register's worth of points.
+static Lanes LaneSimplexNoise3(const PermGradients &table, Lanes xin, Lanes yin, Lanes zin)
+{
+    const float F3 = 1.0f / 3.0f;
+    const float G3 = 1.0f / 6.0f;
+
+    // Skew the input space to find our cell, then unskew back.
+    Lanes s = LaneMul(LaneAdd(LaneAdd(xin, yin), zin), LaneSet(F3));
+    Lanes i = LaneFastFloor(LaneAdd(xin, s));
+    Lanes j = LaneFastFloor(LaneAdd(yin, s));
+    Lanes k = LaneFastFloor(LaneAdd(zin, s));
+    Lanes t = LaneMul(LaneAdd(LaneAdd(i, j), k), LaneSet(G3));
+
+    Lanes x0 = LaneSub(xin, LaneSub(i, t));
+    Lanes y0 = LaneSub(yin, LaneSub(j, t));
+    Lanes z0 = LaneSub(zin, LaneSub(k, t));
+
+    // Which tetrahedron we're in. This is the big if-else in the regular
+    // version, boiled down to masks. The offsets come out as 0 or 1.
+    Lanes one  = LaneSet(1.0f);
+    Lanes zero = LaneSet(0.0f);
+    Lanes x_ge_y = LaneGE(x0, y0);
+    Lanes x_ge_z = LaneGE(x0, z0);
+    Lanes y_ge_z = LaneGE(y0, z0);
+
+    Lanes i1 = LaneAnd(LaneAnd(x_ge_y, x_ge_z), one);
+    Lanes j1 = LaneAnd(LaneAndNot(x_ge_y, y_ge_z), one);
+    Lanes k1 = LaneSub(LaneSub(one, i1), j1);
+
+    Lanes i2 = LaneAnd(LaneOr(x_ge_y, x_ge_z), one);
+    Lanes j2 = LaneOr(LaneAndNot(x_ge_y, one), LaneAnd(y_ge_z, one));
+    Lanes k2 = LaneSub(LaneSub(LaneSet(2.0f), i2), j2);
+
+    Lanes x1 = LaneAdd(LaneSub(x0, i1), LaneSet(G3));
+    Lanes y1 = LaneAdd(LaneSub(y0, j1), LaneSet(G3));
+    Lanes z1 = LaneAdd(LaneSub(z0, k1), LaneSet(G3));
+    Lanes x2 = LaneAdd(LaneSub(x0, i2), LaneSet(2.0f * G3));
+    Lanes y2 = LaneAdd(LaneSub(y0, j2), LaneSet(2.0f * G3));
+    Lanes z2 = LaneAdd(LaneSub(z0, k2), LaneSet(2.0f * G3));
+    Lanes x3 = LaneAdd(LaneSub(x0, one), LaneSet(3.0f * G3));
+    Lanes y3 = LaneAdd(LaneSub(y0, one), LaneSet(3.0f * G3));
+    Lanes z3 = LaneAdd(LaneSub(z0, one), LaneSet(3.0f * G3));
+
+    // Hash the corners.
+    LaneInts ii = LaneIntsWrap(LaneToInts(i));
+    LaneInts jj = LaneIntsWrap(LaneToInts(j));
+    LaneInts kk = LaneIntsWrap(LaneToInts(k));
+    LaneInts none = LaneToInts(zero);
+    LaneInts all  = LaneToInts(one);
+
+    LaneInts index0 = LaneHash3(ii, jj, kk, none, none, none);
+    LaneInts index1 = LaneHash3(ii, jj, kk, LaneToInts(i1), LaneToInts(j1), LaneToInts(k1));
+    LaneInts index2 = LaneHash3(ii, jj, kk, LaneToInts(i2), LaneToInts(j2), LaneToInts(k2));
+    LaneInts index3 = LaneHash3(ii, jj, kk, all, all, all);
+
+    Lanes n0 = LaneCorner3(table, index0, x0, y0, z0);
+    Lanes n1 = LaneCorner3(table, index1, x1, y1, z1);
+    Lanes n2 = LaneCorner3(table, index2, x2, y2, z2);
+    Lanes n3 = LaneCorner3(table, index3, x3, y3, z3);
+
+    return LaneMul(LaneSet(32.0f), LaneAdd(LaneAdd(n0, n1), LaneAdd(n2, n3)));
+}
+
+#endif
+
+
+// 2D simplex noise for a whole bunch of points. Any count works, but
+// a multiple of 8 never wastes a lane.
+void simplex_noise_2_batch(const float *xs, const float *ys, int count, float *pOut)
+{
+#if SIMPLEX_LANES > 1
+    const PermGradients &table = GetPermGradients();
+
+    int n = 0;
+    for (; n + SIMPLEX_LANES <= count; n += SIMPLEX_LANES) {
+        LaneStore(pOut + n, LaneSimplexNoise2(table, LaneLoad(xs + n), LaneLoad(ys + n)));
+    }
+
+    // Pad out whatever's left over, so it gets the same float math as the rest.
+    if (n < count) {
+        float x[SIMPLEX_LANES] = {};
+        float y[SIMPLEX_LANES] = {};
+        float result[SIMPLEX_LANES];
+
+        int left = count - n;
+        memcpy(x, xs + n, left * sizeof(float));
+        memcpy(y, ys + n, left * sizeof(float));
+
+        LaneStore(result, LaneSimplexNoise2(table, LaneLoad(x), LaneLoad(y)));
+        memcpy(pOut + n, result, left * sizeof(float));
+    }
+#else
+    for (int n = 0; n < count; n++) {
+        pOut[n] = static_cast<float>(simplex_noise_2(xs[n], ys[n]));
+    }
+#endif
+}
+
+
+// 3D simplex noise for a whole bunch of points. Any count works, but
+// a multiple of 8 never wastes a lane.
+void simplex_noise_3_batch(const float *xs, const float *ys, const float *zs, int count, float *pOut)
+{
+#if SIMPLEX_LANES > 1
+    const PermGradients &table = GetPermGradients();
+
+    int n = 0;
+    for (; n + SIMPLEX_LANES <= count; n += SIMPLEX_LANES) {
+        LaneStore(pOut + n, LaneSimplexNoise3(table, LaneLoad(xs + n), LaneLoad(ys + n), LaneLoad(zs + n)));
+    }
+
+    // Pad out whatever's left over, so it gets the same float math as the rest.
+    if (n < count) {
+        float x[SIMPLEX_LANES] = {};
+        float y[SIMPLEX_LANES] = {};
+        float z[SIMPLEX_LANES] = {};
+        float result[SIMPLEX_LANES];
+
+        int left = count - n;
+        memcpy(x, xs + n, left * sizeof(float));
+        memcpy(y, ys + n, left * sizeof(float));
+        memcpy(z, zs + n, left * sizeof(float));
+
+        LaneStore(result, LaneSimplexNoise3(table, LaneLoad(x), LaneLoad(y), LaneLoad(z)));
+        memcpy(pOut + n, result, left * sizeof(float));
+    }
+#else
+    for (int n = 0; n < count; n++) {
+        pOut[n] = static_cast<float>(simplex_noise_3(xs[n], ys[n], zs[n]));
+    }
+#endif
+}
+
+
+// 3D simplex noise straight up a column. X and Z stay put, and point "n" is
+// at "first_y + (n * y_step)". Saves building the arrays for the usual case.
+void simplex_noise_3_column(float x, float z, float first_y, float y_step, int count, float *pOut)
+{
+#if SIMPLEX_LANES > 1
+    const PermGradients &table = GetPermGradients();
+
+    float lane_index[SIMPLEX_LANES];
+    for (int lane = 0; lane < SIMPLEX_LANES; lane++) {
+        lane_index[lane] = static_cast<float>(lane);
+    }
+
+    Lanes lanes_x = LaneSet(x);
+    Lanes lanes_z = LaneSet(z);
+    Lanes lanes_step  = LaneSet(y_step);
+    Lanes lanes_index = LaneLoad(lane_index);
+
+    for (int n = 0; n < count; n += SIMPLEX_LANES) {
+        Lanes steps   = LaneAdd(LaneSet(static_cast<float>(n)), lanes_index);
+        Lanes lanes_y = LaneAdd(LaneSet(first_y), LaneMul(steps, lanes_step));
+        Lanes result  = LaneSimplexNoise3(table, lanes_x, lanes_y, lanes_z);
+
+        if (n + SIMPLEX_LANES <= count) {
+            LaneStore(pOut + n, result);
+        }
+        else {
+            float partial[SIMPLEX_LANES];
+            LaneStore(partial, result);
+            memcpy(pOut + n, partial, (count - n) * sizeof(float));
+        }
+    }
+#else
+    for (int n = 0; n < count; n++) {
+        pOut[n] = static_cast<float>(simplex_noise_3(x, first_y + (n * y_step), z));
+    }
+#endif
+}
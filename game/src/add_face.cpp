@@ -7,8 +7,8 @@
 #include "utils.h"
 
 
-std::array<Vertex_PNT, 6> GetLandscapePatch_PNT(
-    const Chunk &chunk, const LocalGrid &local_coord, FaceType face)
+void AddLandscapePatch_PNT(
+    const Chunk &chunk, const LocalGrid &local_coord, FaceType face, ScratchVector<Vertex_PNT> *pOut)
 {
     int x = local_coord.x();
     int y = local_coord.y();
@@ -82,18 +82,14 @@ std::array<Vertex_PNT, 6> GetLandscapePatch_PNT(
         break;
     }
 
-    // Position, normal, texuv.
-    std::array<Vertex_PNT, 6> triangles = {
-        Vertex_PNT(point_ll, dir_normal, MyVec2(0.0f, 0.0f)), // LL
-        Vertex_PNT(point_ur, dir_normal, MyVec2(1.0f, 1.0f)), // UR
-        Vertex_PNT(point_ul, dir_normal, MyVec2(0.0f, 1.0f)), // UL
-        Vertex_PNT(point_ur, dir_normal, MyVec2(1.0f, 1.0f)), // UR
-        Vertex_PNT(point_ll, dir_normal, MyVec2(0.0f, 0.0f)), // LL
-        Vertex_PNT(point_lr, dir_normal, MyVec2(1.0f, 0.0f)), // LR
-    };
-
-
-    return std::move(triangles);
+    // Position, normal, texuv. These go straight onto the end of the list,
+    // which should already have room for them.
+    pOut->emplace_back(point_ll, dir_normal, MyVec2(0.0f, 0.0f)); // LL
+    pOut->emplace_back(point_ur, dir_normal, MyVec2(1.0f, 1.0f)); // UR
+    pOut->emplace_back(point_ul, dir_normal, MyVec2(0.0f, 1.0f)); // UL
+    pOut->emplace_back(point_ur, dir_normal, MyVec2(1.0f, 1.0f)); // UR
+    pOut->emplace_back(point_ll, dir_normal, MyVec2(0.0f, 0.0f)); // LL
+    pOut->emplace_back(point_lr, dir_normal, MyVec2(1.0f, 0.0f)); // LR
 }
 
 
@@ -4,6 +4,7 @@
 
 #include "draw_state_pnt.h"
 #include "draw_state_pt.h"
+#include "scratch_arena.h"
 #include "utils.h"
 
 
@@ -11,7 +12,7 @@ class Chunk;
 class LocalGrid;
 
 
-std::array<Vertex_PNT, 6> GetLandscapePatch_PNT(
-    const Chunk &chunk, const LocalGrid &local_coord, FaceType face);
+void AddLandscapePatch_PNT(
+    const Chunk &chunk, const LocalGrid &local_coord, FaceType face, ScratchVector<Vertex_PNT> *pOut);
 std::array<Vertex_PT, 6> GetLandscapePatch_PT(
     const Chunk &chunk, const LocalGrid &local_coord, FaceType face);
\ No newline at end of file
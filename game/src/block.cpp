@@ -3,7 +3,6 @@
 #include "block.h"
 
 #include "common_util.h"
-#include "config.h"
 #include "utils.h"
 
 // Return true if a block type should generate ever landscape surfaces.
@@ -16,54 +15,6 @@ bool IsBlockTypeEmpty(BlockType block_type) {
 }
 
 
-// What surface, if any, should go between two blocks?
-SurfaceType CalcSurfaceType(BlockType block_type, FaceType face, BlockType other)
-{
-    bool draw_transitions = GetConfig().debug.draw_transitions;
-
-    SurfaceType result = SurfaceType::NOTHING;
-
-    switch (block_type) {
-    case BlockType::DIRT:
-        if (other == BlockType::AIR) {
-            result = SurfaceType::DIRT;
-        }
-        break;
-
-    case BlockType::STONE:
-        if (other == BlockType::AIR) {
-            result = SurfaceType::STONE;
-        }
-        else {
-            bool show = (other == BlockType::DIRT);
-            if (show && draw_transitions) {
-                result = SurfaceType::STONE;
-            }
-        }
-        break;
-
-    case BlockType::COAL:
-        if (other == BlockType::AIR) {
-            result = SurfaceType::COAL;
-        }
-        else {
-            bool show = ((other == BlockType::DIRT) || 
-                         (other == BlockType::STONE));
-            if (show && draw_transitions) {
-                result = SurfaceType::COAL;
-            }
-        }
-        break;
-
-    default:
-        PrintTheImpossible(__FILE__, __LINE__, static_cast<int>(block_type));
-        break;
-    }
-
-    return result;
-}
-
-
 // Default ctor. This is a plain struct, so it's all we need.
 Block::Block() :
     m_block_type(BlockType::AIR),
@@ -2,6 +2,7 @@
 
 #include "stdafx.h"
 
+#include "block_surfaces.h"
 #include "common_util.h"
 #include "draw_state_pt.h"
 #include "utils.h"
@@ -12,21 +13,6 @@ class Chunk;
 bool IsBlockTypeFilled(BlockType block_type);
 bool IsBlockTypeEmpty (BlockType block_type);
 
-enum class SurfaceType : unsigned char
-{
-    GRASS_TOP = 0,
-    DIRT      = 1,
-    STONE     = 2,
-    COAL      = 3,
-
-    NOTHING   = 255
-};
-
-const int SURFACE_TYPE_COUNT = 4;
-
-
-SurfaceType CalcSurfaceType(BlockType block_type, FaceType face, BlockType other);
-
 
 // The block data itself.
 class Block
@@ -24,6 +24,31 @@ ChunkOrigin WorldToChunkOrigin(const MyVec4 &pos)
 }
 
 
+// Wipe the chunk clean, and move it to a new origin, as if it were brand new.
+// The landscape should already be empty, but keeps its surface lists. This only
+// touches the chunk itself, so a loader thread can do it.
+void Chunk::recycle(const ChunkOrigin &origin)
+{
+    m_origin = origin;
+    m_last_touched_msecs = 0;
+
+    for (ChunkStripe &stripe : m_stripes) {
+        stripe.clear();
+    }
+
+    m_solid_bits.fill(0);
+    m_exposed_bits.fill(0);
+    m_exposed_list.clear();
+    m_exposed_list_valid = true;
+
+    for (SurfaceTotals &totals : m_section_totals) {
+        totals.clear();
+    }
+
+    m_wfinstance_list.clear();
+}
+
+
 // Return true if a grid coord is within this chunk.
 bool Chunk::IsGlobalGridWithin(const GlobalGrid &coord) const
 {
@@ -55,6 +80,45 @@ void Chunk::setBlockType(const LocalGrid &coord, BlockType block_type)
     const int index = offset(coord.x(), coord.y());
     ChunkStripe &stripe = m_stripes.at(index);
     stripe.setBlockType(coord.z(), block_type);
+
+    uint32_t bit = 1u << coord.z();
+    if (IsBlockTypeFilled(block_type)) {
+        m_solid_bits[index] |= bit;
+    }
+    else {
+        m_solid_bits[index] &= ~bit;
+    }
+}
+
+
+// Is anything solid in a range of local coords? Both ends are inclusive.
+// The Z range turns into a mask, so each stripe is one AND.
+bool Chunk::anySolidInRange(
+    int min_x, int min_y, int min_z,
+    int max_x, int max_y, int max_z) const
+{
+    assert((min_x >= 0) && (max_x < CHUNK_WIDTH));
+    assert((min_y >= 0) && (max_y < CHUNK_HEIGHT));
+    assert((min_z >= 0) && (max_z < CHUNK_WIDTH));
+
+    if ((min_x > max_x) || (min_y > max_y) || (min_z > max_z)) {
+        return false;
+    }
+
+    // All the bits from min_z up through max_z. Shift in 64 bits,
+    // so that a full-width range doesn't shift by 32, which is undefined.
+    uint32_t mask = static_cast<uint32_t>(
+        ((1ULL << (max_z + 1)) - 1) & ~((1ULL << min_z) - 1));
+
+    for     (int y = min_y; y <= max_y; y++) {
+        for (int x = min_x; x <= max_x; x++) {
+            if ((m_solid_bits[offset(x, y)] & mask) != 0) {
+                return true;
+            }
+        }
+    }
+
+    return false;
 }
 
 
@@ -153,20 +217,34 @@ const Chunk *Chunk::getNeighborWest() const
 // This resets our status back to the start.
 void Chunk::rebuildExposedBlockSet(SurfaceTotals *pOutTotals)
 {
-    m_exposed_block_set.clear();
+    m_exposed_list_valid = false;
 
-    for     (int x = 0; x < CHUNK_WIDTH;  x++) {
-        for (int y = 0; y < CHUNK_HEIGHT; y++) {
+    for (SurfaceTotals &totals : m_section_totals) {
+        totals.clear();
+    }
+
+    for (int y = 0; y < CHUNK_HEIGHT; y++) {
+        SurfaceTotals &section_totals = m_section_totals.at(LocalYToSection(y));
+
+        for (int x = 0; x < CHUNK_WIDTH; x++) {
             const int index = offset(x, y);
+
+            uint32_t bits = 0;
             for (int z = 0; z < CHUNK_WIDTH; z++) {
                 const LocalGrid coord(x, y, z);
-                const bool exposed = m_stripes.at(index).recalcExposuresForBlock(*this, coord, pOutTotals);
+                const bool exposed = m_stripes.at(index).recalcExposuresForBlock(*this, coord, &section_totals);
                 if (exposed) {
-                    m_exposed_block_set.insert(coord);
+                    bits |= (1u << z);
                 }
             }
+
+            m_exposed_bits[index] = bits;
         }
     }
+
+    for (const SurfaceTotals &totals : m_section_totals) {
+        pOutTotals->add(totals);
+    }
 }
 
 
@@ -177,24 +255,110 @@ void Chunk::rebuildLandscape()
 }
 
 
-// Get a vector of the exposed blocks.
-std::vector<LocalGrid> Chunk::getExposedBlockList()
+// Get the list of exposed blocks, in the same order they sit in memory.
+// We only rebuild this when the exposures have changed since last time.
+// This isn't safe to call from worker threads, since it might rebuild.
+const std::vector<LocalGrid> &Chunk::getExposedBlockList()
 {
-    const int count = m_exposed_block_set.size();
+    if (!m_exposed_list_valid) {
+        getExposedBlocksInRange(0, CHUNK_HEIGHT - 1, &m_exposed_list);
+        m_exposed_list_valid = true;
+    }
 
-    std::vector<LocalGrid> results(count);
-    results.insert(results.end(), m_exposed_block_set.begin(), m_exposed_block_set.end());
-    std::sort(results.begin(), results.end());
-    
-    return std::move(results);
+    return m_exposed_list;
 }
 
 
-// Add to surface lists.
-void Chunk::addToSurfaceLists(const LocalGrid &coord)
+// Get the exposed blocks with a local Y from "min_y" to "max_y", inclusive, in memory
+// order. A range of Y is a contiguous run of stripes, and we skip empty stripes a word
+// at a time. This only reads the exposure bits, so it's fine from worker threads.
+// Works with any kind of vector, so meshing can use scratch memory.
+template<typename T>
+static void CollectExposedBlocks(
+    const std::array<uint32_t, CHUNK_WIDTH * CHUNK_HEIGHT> &exposed_bits, int min_y, int max_y, T *pOut)
+{
+    assert((min_y >= 0) && (max_y < CHUNK_HEIGHT));
+
+    pOut->clear();
+
+    for     (int y = min_y; y <= max_y;      y++) {
+        for (int x = 0;     x < CHUNK_WIDTH; x++) {
+            uint32_t bits = exposed_bits[x + (CHUNK_WIDTH * y)];
+            for (int z = 0; bits != 0; z++, bits >>= 1) {
+                if ((bits & 1) != 0) {
+                    pOut->emplace_back(x, y, z);
+                }
+            }
+        }
+    }
+}
+
+
+// Get the exposed blocks in a range of Y, into a regular vector.
+void Chunk::getExposedBlocksInRange(int min_y, int max_y, std::vector<LocalGrid> *pOut) const
+{
+    CollectExposedBlocks(m_exposed_bits, min_y, max_y, pOut);
+}
+
+
+// Get the exposed blocks in a range of Y, into scratch memory.
+void Chunk::getExposedBlocksInRange(int min_y, int max_y, ScratchVector<LocalGrid> *pOut) const
+{
+    CollectExposedBlocks(m_exposed_bits, min_y, max_y, pOut);
+}
+
+
+// Add a block's faces to some section verts.
+void Chunk::addToSurfaceLists(const LocalGrid &coord, SectionVerts *pOut) const
 {
     const int index = offset(coord.x(), coord.y());
-    m_stripes.at(index).addToSurfaceLists(*this, coord);
+    m_stripes.at(index).addToSurfaceLists(*this, coord, pOut);
+}
+
+
+// Recalc the exposures for just one block, and keep the exposed bits up to date.
+// Return true if any of its surfaces changed, meaning its section needs remeshing.
+bool Chunk::recalcExposuresForBlock(const LocalGrid &coord)
+{
+    const FaceType faces[] = {
+        FaceType::SOUTH, FaceType::NORTH,
+        FaceType::WEST,  FaceType::EAST,
+        FaceType::TOP,   FaceType::BOTTOM
+    };
+
+    ChunkStripe &stripe = m_stripes.at(offset(coord.x(), coord.y()));
+
+    std::array<SurfaceType, 6> before;
+    for (int i = 0; i < 6; i++) {
+        before[i] = stripe.getSurface(coord.z(), faces[i]);
+    }
+
+    SurfaceTotals totals;
+    bool exposed = stripe.recalcExposuresForBlock(*this, coord, &totals);
+
+    uint32_t &bits = m_exposed_bits[offset(coord.x(), coord.y())];
+    uint32_t bit = 1u << coord.z();
+    bool was_exposed = (bits & bit) != 0;
+
+    if (exposed != was_exposed) {
+        bits ^= bit;
+        m_exposed_list_valid = false;
+    }
+
+    // Keep the section's face counts exact, so meshing can size its lists up front.
+    SurfaceTotals &section_totals = m_section_totals.at(LocalYToSection(coord.y()));
+    bool changed = false;
+
+    for (int i = 0; i < 6; i++) {
+        SurfaceType after = stripe.getSurface(coord.z(), faces[i]);
+        if (after != before[i]) {
+            section_totals.decrement(before[i]);
+            section_totals.increment(after);
+            changed = true;
+        }
+    }
+
+    return changed;
 }
 
 
@@ -6,6 +6,7 @@
 #include "chunk_stripe.h"
 #include "format.h"
 #include "landscape.h"
+#include "scratch_arena.h"
 #include "wavefront_object.h"
 
 
@@ -100,10 +101,16 @@ public:
         landscape(*this),
         m_world(world),
         m_origin(origin),
-        m_last_touched_msecs(0) {}
+        m_last_touched_msecs(0),
+        m_exposed_list_valid(true) {
+        m_solid_bits.fill(0);
+        m_exposed_bits.fill(0);
+    }
 
     ~Chunk() {}
 
+    void recycle(const ChunkOrigin &origin);
+
     // TODO: Hi Self! Happy day after Easter! Add these next.
     void joinMainThread();
     void departMainThread();
@@ -114,6 +121,15 @@ public:
     BlockType getBlockType(const LocalGrid &coord) const;
     void setBlockType(const LocalGrid &coord, BlockType block_type);
 
+    // Is a block solid? This is a lot cheaper than getting its type.
+    bool isBlockSolid(int local_x, int local_y, int local_z) const {
+        return ((m_solid_bits[offset(local_x, local_y)] >> local_z) & 1) != 0;
+    }
+
+    bool anySolidInRange(
+        int min_x, int min_y, int min_z,
+        int max_x, int max_y, int max_z) const;
+
     bool   IsGlobalGridWithin(const GlobalGrid &coord) const;
     MyVec4 localGridToWorldPos(int local_x, int local_y, int local_z) const;
 
@@ -140,8 +156,16 @@ public:
     void rebuildExposedBlockSet(SurfaceTotals *pOutTotals);
     void rebuildLandscape();
 
-    std::vector<LocalGrid> getExposedBlockList();
-    void addToSurfaceLists(const LocalGrid &coord);
+    const std::vector<LocalGrid> &getExposedBlockList();
+    void getExposedBlocksInRange(int min_y, int max_y, std::vector<LocalGrid> *pOut) const;
+    void getExposedBlocksInRange(int min_y, int max_y, ScratchVector<LocalGrid> *pOut) const;
+    void addToSurfaceLists(const LocalGrid &coord, SectionVerts *pOut) const;
+    bool recalcExposuresForBlock(const LocalGrid &coord);
+
+    // How many of each surface are showing in a section. Always exact.
+    const SurfaceTotals &getSectionTotals(int section) const {
+        return m_section_totals.at(section);
+    }
 
     // Specialty objects.
     Landscape landscape;
@@ -163,7 +187,57 @@ private:
 
     std::array<ChunkStripe, CHUNK_WIDTH * CHUNK_HEIGHT> m_stripes;
 
-    std::set<LocalGrid> m_exposed_block_set;
+    // One bit per block, saying whether it's solid. Each word is a stripe,
+    // and bit N is local Z = N. So for the whole chunk, that's 32 KB.
+    // This is kept up to date by "setBlockType", so always go through that.
+    std::array<uint32_t, CHUNK_WIDTH * CHUNK_HEIGHT> m_solid_bits;
+
+    // Same layout as the solid bits, but for which blocks have any surfaces showing.
+    // The list is built from these on demand, and thrown out whenever they change.
+    std::array<uint32_t, CHUNK_WIDTH * CHUNK_HEIGHT> m_exposed_bits;
+    std::vector<LocalGrid> m_exposed_list;
+    bool m_exposed_list_valid;
+
+    // Face counts for each landscape section, from the exposure pass.
+    std::array<SurfaceTotals, LANDSCAPE_SECTION_COUNT> m_section_totals;
 
     std::vector<std::unique_ptr<WFInstance>> m_wfinstance_list;
 };
+
+static_assert(CHUNK_WIDTH == 32, "The solid bits need one stripe to fit in a 32-bit word");
+
+
+// Is anything solid in a range of global grid coords? Both ends are inclusive.
+// The source is anything with a "getChunk", so the world, or a physics snapshot.
+// Chunks that aren't loaded don't have anything solid in them.
+template <typename T>
+bool AnySolidBlockInRange(const T &source, const GlobalGrid &lower, const GlobalGrid &upper)
+{
+    int min_y = max(lower.y(), 0);
+    int max_y = min(upper.y(), CHUNK_HEIGHT - 1);
+    if ((min_y > max_y) || (lower.x() > upper.x()) || (lower.z() > upper.z())) {
+        return false;
+    }
+
+    ChunkOrigin first = GlobalGridToChunkOrigin(GlobalGrid(lower.x(), 0, lower.z()));
+
+    for     (int chunk_x = first.x(); chunk_x <= upper.x(); chunk_x += CHUNK_WIDTH) {
+        for (int chunk_z = first.z(); chunk_z <= upper.z(); chunk_z += CHUNK_WIDTH) {
+            const Chunk *chunk = source.getChunk(ChunkOrigin(chunk_x, chunk_z));
+            if (chunk == nullptr) {
+                continue;
+            }
+
+            int min_x = max(lower.x() - chunk_x, 0);
+            int max_x = min(upper.x() - chunk_x, CHUNK_WIDTH - 1);
+            int min_z = max(lower.z() - chunk_z, 0);
+            int max_z = min(upper.z() - chunk_z, CHUNK_WIDTH - 1);
+
+            if (chunk->anySolidInRange(min_x, min_y, min_z, max_x, max_y, max_z)) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
@@ -5,8 +5,10 @@
 
 #include "block.h"
 #include "chunk.h"
+#include "chunk_blob.h"
 #include "game_world.h"
 #include "resource_pool.h"
+#include "scratch_arena.h"
 #include "wavefront_object.h"
 #include "utils.h"
 
@@ -16,6 +18,9 @@
 static const std::string DIRT_TOP("dirt_top");
 static const std::string STONE_TOP("stone_top");
 
+static_assert(CHUNK_BLOB_WIDTH  == CHUNK_WIDTH,  "Chunk blobs and chunks should be the same width.");
+static_assert(CHUNK_BLOB_HEIGHT == CHUNK_HEIGHT, "Chunk blobs and chunks should be the same height.");
+
 
 // TEMP: C++ is fucking impossible at times.
 std::unique_ptr<Chunk> FuckYou(const std::string &blah, GameWorld *world) {
@@ -53,13 +58,60 @@ MyVec4 GetPlayerStartPos(const std::string &db_fname)
         y = 0;
     }
 
-    // Add one, since we're on top of the block.
-    y++;
-
     // All done.
     SQL_finalize(db, stmt);
     SQL_close(db);
 
+    return StartHeightToWorldPos(y);
+}
+
+
+// Same again, for a world file with chunk blobs. Column (0, 0) is the first one in chunk (0, 0).
+MyVec4 GetPlayerStartPosFromBlobs(const std::string &db_fname)
+{
+    MyVec4 never_mind(0, 0, 0);
+
+    sqlite3 *db = SQL_open(db_fname);
+    if (db == nullptr) {
+        PrintDebug(fmt::format("Could not open DB '{}'", db_fname));
+        return never_mind;
+    }
+
+    sqlite3_stmt *stmt = SQL_prepare(db, "SELECT data FROM chunks WHERE x == 0 AND z == 0");
+    if (stmt == nullptr) {
+        assert(false);
+        return never_mind;
+    }
+
+    int top = -1;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        const void *data = sqlite3_column_blob(stmt, 0);
+        int size = sqlite3_column_bytes(stmt, 0);
+
+        ChunkBlobReader reader(static_cast<const unsigned char *>(data), size);
+        ColumnRuns column;
+        if (reader.readColumn(&column) && (column.run_count > 0)) {
+            const BlockRun &last_run = column.runs[column.run_count - 1];
+            top = last_run.first_y + last_run.length - 1;
+        }
+    }
+
+    SQL_finalize(db, stmt);
+    SQL_close(db);
+
+    return StartHeightToWorldPos(top);
+}
+
+
+// Start the player on top of the block at the given height, in the middle of the column.
+MyVec4 StartHeightToWorldPos(int top)
+{
+    // Add one, since we're on top of the block.
+    int y = top + 1;
+    if (y < 0) {
+        y = 0;
+    }
+
     GLfloat half_x   = BLOCK_SCALE / 2;
     GLfloat scaled_y = y * BLOCK_SCALE;
     GLfloat half_z   = BLOCK_SCALE / 2;
@@ -67,23 +119,36 @@ MyVec4 GetPlayerStartPos(const std::string &db_fname)
 }
 
 
-// Load a chunk from our SQLite file.
-// This just deals with the block data. The landscape is are dealt with later.
-// For the world, don't touch the reference, just save it.
-std::unique_ptr<Chunk> LoadChunk(const std::string &db_fname, GameWorld *world, const ChunkOrigin &origin)
+// See if a world file has the chunks table. If it doesn't, it's an older
+// world file, with a row for every dirt top, stone top and coal block.
+bool IsChunkBlobWorld(const std::string &db_fname)
 {
-    // Our result.
-    std::unique_ptr<Chunk> chunk = std::make_unique<Chunk>(*world, origin);
+    sqlite3 *db = SQL_open(db_fname);
+    if (db == nullptr) {
+        return false;
+    }
 
-    // TODO: A simple test of a Wavefront Object.
-    if (origin == ChunkOrigin(0, 0)) {
-        MyVec4 move(0, 0, 0);
+    sqlite3_stmt *stmt = SQL_prepare(db,
+        "SELECT 1 FROM sqlite_master WHERE type == 'table' AND name == 'chunks'");
+    if (stmt == nullptr) {
+        return false;
+    }
 
-        const auto &pool = GetResourcePool();
-        std::unique_ptr<WFInstance> capsule = pool.cloneWFObject("capsule", move);
-        chunk->addWFInstance(std::move(capsule));
+    bool found = (sqlite3_step(stmt) == SQLITE_ROW);
+
+    if (SQL_finalize(db, stmt)) {
+        SQL_close(db);
     }
 
+    return found;
+}
+
+
+// Load a chunk from our SQLite file.
+// This just deals with the block data. The landscape is are dealt with later.
+// For the world, don't touch the reference, just save it.
+std::unique_ptr<Chunk> LoadChunk(const std::string &db_fname, GameWorld *world, const ChunkOrigin &origin)
+{
     sqlite3 *db = SQL_open(db_fname);
     if (db == nullptr) {
         PrintDebug(fmt::format("Could not open DB '{}'", db_fname));
@@ -103,32 +168,38 @@ std::unique_ptr<Chunk> LoadChunk(const std::string &db_fname, GameWorld *world,
         return nullptr;
     }
 
-    // For all the data in this chunk, use maps to figure out where things start.
-    std::map<GlobalPillar, int> dirt_tops;
-    std::map<GlobalPillar, int> stone_tops;
-    std::map<GlobalPillar, std::vector<int>> coal_spots;
+    // Our result. This is likely a recycled chunk, which might have surface lists
+    // hanging off of it, so we grab it only once nothing else can fail. That way,
+    // it never gets deleted on this thread.
+    std::unique_ptr<Chunk> chunk = world->getChunkPool().acquire(*world, origin);
+
+    // Everything we collect along the way is scratch, and goes away when we leave.
+    ScratchScope scratch;
+
+    // For all the data in this chunk, figure out where things start.
+    // The rows come sorted by pillar, so if a pillar shows up twice, the later one wins.
+    ChunkRows rows;
 
-    int count = 0;
     int ret_code = sqlite3_step(stmt);
     while (ret_code == SQLITE_ROW) {
         int x = sqlite3_column_int(stmt, 0);
         int y = sqlite3_column_int(stmt, 1);
         int z = sqlite3_column_int(stmt, 2);
 
-        GlobalPillar pillar(x, z);
+        const LocalPillar &pillar = GlobalPillarToLocal(GlobalPillar(x, z), origin);
+        BlockSpot spot = { pillar.x(), y, pillar.z() };
 
         const unsigned char *raw_text = sqlite3_column_text(stmt, 3);
-        const char *clean = reinterpret_cast<const char*>(raw_text);
-        std::string text(clean);
+        const char *text = reinterpret_cast<const char*>(raw_text);
 
-        if (text == "dirt_top") {
-            dirt_tops[pillar] = y;
+        if (strcmp(text, "dirt_top") == 0) {
+            rows.dirt_tops.emplace_back(spot);
         }
-        else if (text == "stone_top") {
-            stone_tops[pillar] = y;
+        else if (strcmp(text, "stone_top") == 0) {
+            rows.stone_tops.emplace_back(spot);
         }
-        else if (text == "coal") {
-            coal_spots[pillar].emplace_back(y);
+        else if (strcmp(text, "coal") == 0) {
+            rows.coal_spots.emplace_back(spot);
         }
         else {
             PrintDebug(fmt::format("Impossible value for block: {}", text));
@@ -141,57 +212,138 @@ std::unique_ptr<Chunk> LoadChunk(const std::string &db_fname, GameWorld *world,
     SQL_finalize(db, stmt);
 
     // Now, build the chunk.
-    int dirt_top_count = 0;
+    BuildChunkFromRows(rows, chunk.get());
 
-    for (const auto &iter : dirt_tops) {
-        const GlobalPillar &global_pillar = iter.first;
-        int dirt_top = iter.second;
+    // All done.
+    PrintDebug(fmt::format(
+        "Loaded chunk [{0}, {1}] with {2} dirt tops.\n", 
+        origin.debugX(), origin.debugZ(), rows.dirt_tops.size()));
 
-        const LocalPillar &pillar = GlobalPillarToLocal(global_pillar, origin);
-        for (int y = 0; y <= dirt_top; y++) {
-            LocalGrid coord(pillar.x(), y, pillar.z());
-            chunk->setBlockType(coord, BlockType::DIRT);
-        }
+    SQL_close(db);
+
+    return chunk;
+}
 
-        dirt_top_count++;
+
+// Load a chunk from a world file with chunk blobs. It's just the one row.
+std::unique_ptr<Chunk> LoadChunkFromBlob(const std::string &db_fname, GameWorld *world, const ChunkOrigin &origin)
+{
+    sqlite3 *db = SQL_open(db_fname);
+    if (db == nullptr) {
+        PrintDebug(fmt::format("Could not open DB '{}'", db_fname));
+        return nullptr;
     }
 
-    for (const auto &iter : stone_tops) {
-        const GlobalPillar &global_pillar = iter.first;
-        int stone_top = iter.second;
+    std::string buffer = fmt::format(
+        "SELECT data FROM chunks WHERE x == {0} AND z == {1}",
+        origin.x(), origin.z());
+    sqlite3_stmt *stmt = SQL_prepare(db, buffer.c_str());
+    if (stmt == nullptr) {
+        assert(false);
+        return nullptr;
+    }
 
-        const LocalPillar &pillar = GlobalPillarToLocal(global_pillar, origin);
-        for (int y = 0; y <= stone_top; y++) {
-            LocalGrid coord(pillar.x(), y, pillar.z());
-            chunk->setBlockType(coord, BlockType::STONE);
+    int ret_code = sqlite3_step(stmt);
+    if ((ret_code != SQLITE_ROW) && (ret_code != SQLITE_DONE)) {
+        PrintDebug(fmt::format(
+            "Could not read chunk [{0}, {1}]: {2}\n",
+            origin.debugX(), origin.debugZ(), SQL_code_to_str(ret_code)));
+        SQL_finalize(db, stmt);
+        SQL_close(db);
+        return nullptr;
+    }
+
+    // Same as the rows, we grab the chunk only once nothing else can fail.
+    std::unique_ptr<Chunk> chunk = world->getChunkPool().acquire(*world, origin);
+
+    // No row means we're off the edge of the world. That's an empty chunk, not an error.
+    int size = 0;
+    if (ret_code == SQLITE_ROW) {
+        const void *data = sqlite3_column_blob(stmt, 0);
+        size = sqlite3_column_bytes(stmt, 0);
+
+        if (!BuildChunkFromBlob(static_cast<const unsigned char *>(data), size, chunk.get())) {
+            PrintDebug(fmt::format(
+                "Chunk [{0}, {1}] has a bad blob, so some of it is missing.\n",
+                origin.debugX(), origin.debugZ()));
         }
     }
+    else {
+        BuildChunkFromBlob(nullptr, 0, chunk.get());
+    }
 
-    for (const auto &iter : coal_spots) {
-        const GlobalPillar &global_pillar = iter.first;
-        const std::vector<int> spots_vec  = iter.second;
+    SQL_finalize(db, stmt);
+    SQL_close(db);
 
-        const LocalPillar &pillar = GlobalPillarToLocal(global_pillar, origin);
-        for (int y : spots_vec) {
-            LocalGrid coord(pillar.x(), y, pillar.z());
-            chunk->setBlockType(coord, BlockType::COAL);
+    PrintDebug(fmt::format(
+        "Loaded chunk [{0}, {1}] from a {2} byte blob.\n",
+        origin.debugX(), origin.debugZ(), size));
+
+    return chunk;
+}
+
+
+// TODO: A simple test of a Wavefront Object.
+static void AddTestObjects(Chunk *pOut_chunk)
+{
+    if (pOut_chunk->getOrigin() == ChunkOrigin(0, 0)) {
+        MyVec4 move(0, 0, 0);
+
+        const auto &pool = GetResourcePool();
+        std::unique_ptr<WFInstance> capsule = pool.cloneWFObject("capsule", move);
+        pOut_chunk->addWFInstance(std::move(capsule));
+    }
+}
+
+
+// Fill in a chunk from its rows, however we got them.
+void BuildChunkFromRows(const ChunkRows &rows, Chunk *pOut_chunk)
+{
+    AddTestObjects(pOut_chunk);
+
+    for (const BlockSpot &spot : rows.dirt_tops) {
+        for (int y = 0; y <= spot.y; y++) {
+            pOut_chunk->setBlockType(LocalGrid(spot.x, y, spot.z), BlockType::DIRT);
+        }
+    }
+
+    for (const BlockSpot &spot : rows.stone_tops) {
+        for (int y = 0; y <= spot.y; y++) {
+            pOut_chunk->setBlockType(LocalGrid(spot.x, y, spot.z), BlockType::STONE);
         }
     }
 
+    for (const BlockSpot &spot : rows.coal_spots) {
+        pOut_chunk->setBlockType(LocalGrid(spot.x, spot.y, spot.z), BlockType::COAL);
+    }
+
     // Just before we leave, recalc the exposures.
     // The actual landscape will be rebuilt back in the main thread,
     // since the OpenGL part can't be done in a sub-thread.
     SurfaceTotals ignored;
-    chunk->rebuildExposedBlockSet(&ignored);
+    pOut_chunk->rebuildExposedBlockSet(&ignored);
+}
 
-    // All done.
-    PrintDebug(fmt::format(
-        "Loaded chunk [{0}, {1}] with {2} dirt tops.\n", 
-        origin.debugX(), origin.debugZ(), dirt_top_count));
 
-    SQL_close(db);
+// Fill in a chunk from its blob, however we got it. With no blob at all, it's just empty.
+// Return false if the blob's no good, but the chunk is still usable, just missing columns.
+bool BuildChunkFromBlob(const unsigned char *data, int size, Chunk *pOut_chunk)
+{
+    AddTestObjects(pOut_chunk);
 
-    return chunk;
+    bool success = true;
+
+    if (data != nullptr) {
+        success = ReadChunkBlobBlocks(data, size, [pOut_chunk](int x, int y, int z, BlockType block_type) {
+            pOut_chunk->setBlockType(LocalGrid(x, y, z), block_type);
+        });
+    }
+
+    // Just before we leave, recalc the exposures, same as above.
+    SurfaceTotals ignored;
+    pOut_chunk->rebuildExposedBlockSet(&ignored);
+
+    return success;
 }
 
 
@@ -3,6 +3,7 @@
 #include "stdafx.h"
 
 #include "my_math.h"
+#include "scratch_arena.h"
 
 
 class Chunk;
@@ -10,11 +11,43 @@ class GameWorld;
 class ChunkOrigin;
 
 
+// Where one row from the blocks table lands, in local coords.
+struct BlockSpot
+{
+    int x;
+    int y;
+    int z;
+};
+
+
+// Every row for one chunk, sorted by kind. Dirt goes in first, then stone on top
+// of it, then coal, so we keep each kind in its own list. These are scratch,
+// so they have to be filled in and used inside the same ScratchScope.
+struct ChunkRows
+{
+    ScratchVector<BlockSpot> dirt_tops;
+    ScratchVector<BlockSpot> stone_tops;
+    ScratchVector<BlockSpot> coal_spots;
+};
+
+
+// Does this world file keep a blob per chunk, or the old blocks table?
+bool IsChunkBlobWorld(const std::string &db_fname);
+
 // Find the player's start pos.
 MyVec4 GetPlayerStartPos(const std::string &db_fname);
+MyVec4 GetPlayerStartPosFromBlobs(const std::string &db_fname);
 
 // Load a chunk.
 std::unique_ptr<Chunk> LoadChunk(const std::string &db_fname, GameWorld *world, const ChunkOrigin &origin);
+std::unique_ptr<Chunk> LoadChunkFromBlob(const std::string &db_fname, GameWorld *world, const ChunkOrigin &origin);
+
+// Fill in a freshly acquired chunk from its rows, or its blob.
+void BuildChunkFromRows(const ChunkRows &rows, Chunk *pOut_chunk);
+bool BuildChunkFromBlob(const unsigned char *data, int size, Chunk *pOut_chunk);
+
+// Turn a player start height into a position, right in the middle of the column.
+MyVec4 StartHeightToWorldPos(int top);
 
 // Save a chunk.
 void SaveChunk(GameWorld &world, std::unique_ptr<Chunk> chunk);
\ No newline at end of file
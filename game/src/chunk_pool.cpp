@@ -0,0 +1,86 @@
+#include "stdafx.h"
+#include "chunk_pool.h"
+
+#include "chunk.h"
+
+
+// Default ctor. The pool starts out empty, and fills up as chunks get evicted.
+ChunkPool::ChunkPool() :
+    m_created_count(0),
+    m_reused_count(0)
+{
+    m_free_chunks.reserve(MAX_FREE_CHUNKS);
+}
+
+
+// Destructor. Whatever's left gets deleted for real.
+ChunkPool::~ChunkPool()
+{
+}
+
+
+// Get a blank chunk for an origin. Recycle one if we can, or make a new one if we can't.
+// The wiping happens outside the lock, since it's a couple of megs of writes.
+std::unique_ptr<Chunk> ChunkPool::acquire(const GameWorld &world, const ChunkOrigin &origin)
+{
+    std::unique_ptr<Chunk> chunk;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_free_chunks.empty()) {
+            chunk = std::move(m_free_chunks.back());
+            m_free_chunks.pop_back();
+            m_reused_count++;
+        }
+        else {
+            m_created_count++;
+        }
+    }
+
+    if (chunk == nullptr) {
+        return std::make_unique<Chunk>(world, origin);
+    }
+
+    chunk->recycle(origin);
+    return chunk;
+}
+
+
+// Take back a chunk that's no longer in the world. Its surface lists get
+// emptied, but they keep their buffers. If we're full up, just let it go.
+void ChunkPool::release(std::unique_ptr<Chunk> chunk)
+{
+    if (chunk == nullptr) {
+        return;
+    }
+
+    chunk->landscape.freeSurfaceLists();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (static_cast<int>(m_free_chunks.size()) < MAX_FREE_CHUNKS) {
+        m_free_chunks.emplace_back(std::move(chunk));
+    }
+}
+
+
+// How many chunks are sitting around, waiting to be reused.
+int ChunkPool::getFreeCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_free_chunks.size();
+}
+
+
+// How many chunks we've had to make from scratch.
+int ChunkPool::getCreatedCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_created_count;
+}
+
+
+// How many loads got a recycled chunk.
+int ChunkPool::getReusedCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_reused_count;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include <mutex>
+
+class Chunk;
+class ChunkOrigin;
+class GameWorld;
+
+
+// Chunks are big, a couple of megs each, and their landscapes hang on to OpenGL
+// buffers. As the player walks around, chunks fall off one edge of the world as
+// fast as new ones load in on the other. So rather than deleting old chunks, we
+// keep them here, and the next load wipes one clean and fills it back up.
+// The surface lists, and their buffer names, come along for the ride.
+// Loader threads acquire, so that part's locked. Only the main thread
+// should ever release, since dropping a chunk can delete GL buffers.
+class ChunkPool
+{
+public:
+    ChunkPool();
+    ~ChunkPool();
+
+    std::unique_ptr<Chunk> acquire(const GameWorld &world, const ChunkOrigin &origin);
+    void release(std::unique_ptr<Chunk> chunk);
+
+    // Getters.
+    int getFreeCount()    const;
+    int getCreatedCount() const;
+    int getReusedCount()  const;
+
+private:
+    FORBID_COPYING(ChunkPool)
+    FORBID_MOVING(ChunkPool)
+
+    // Private data. We cap how many we keep, so a
+    // big jump across the world doesn't hog memory.
+    static const int MAX_FREE_CHUNKS = 64;
+
+    mutable std::mutex m_mutex;
+    std::vector<std::unique_ptr<Chunk>> m_free_chunks;
+
+    int m_created_count;
+    int m_reused_count;
+};
@@ -0,0 +1,353 @@
+#include "stdafx.h"
+#include "chunk_source.h"
+#include "common_util.h"
+
+#include "chunk.h"
+#include "chunk_blob.h"
+#include "chunk_io.h"
+#include "game_world.h"
+#include "utils.h"
+
+#include "sqlite3.h"
+
+
+// Database chunk source ctor. The file's already known to exist.
+// Check which kind of world file it is once, up front, rather than on every load.
+DatabaseChunkSource::DatabaseChunkSource(const std::string &db_fname) :
+    m_db_fname(db_fname),
+    m_chunk_blobs(IsChunkBlobWorld(db_fname))
+{
+    if (!m_chunk_blobs) {
+        PrintDebug(fmt::format("'{}' is an older world file, with a row per block.\n", db_fname));
+    }
+}
+
+
+// Load a chunk from the world file.
+std::unique_ptr<Chunk> DatabaseChunkSource::loadChunk(GameWorld *world, const ChunkOrigin &origin) const
+{
+    if (m_chunk_blobs) {
+        return LoadChunkFromBlob(m_db_fname, world, origin);
+    }
+
+    return LoadChunk(m_db_fname, world, origin);
+}
+
+
+// Load a far tile from the world file.
+std::unique_ptr<FarTile> DatabaseChunkSource::loadFarTile(const GlobalPillar &origin, int step) const
+{
+    if (m_chunk_blobs) {
+        return LoadFarTileFromBlobs(m_db_fname, origin, step);
+    }
+
+    return LoadFarTile(m_db_fname, origin, step);
+}
+
+
+// Where the world file says the player starts.
+MyVec4 DatabaseChunkSource::getPlayerStartPos() const
+{
+    if (m_chunk_blobs) {
+        return GetPlayerStartPosFromBlobs(m_db_fname);
+    }
+
+    return GetPlayerStartPos(m_db_fname);
+}
+
+
+// Procedural chunk source ctor. Nothing happens until "init".
+ProceduralChunkSource::ProceduralChunkSource(const ConfigWorld &config) :
+    m_cache_fname(RESOURCE_PATH + config.cache_name),
+    m_generator(config.generator),
+    m_generated_count(0),
+    m_cached_count(0),
+    m_over_budget_count(0),
+    m_generate_usecs(0)
+{
+}
+
+
+// Get the generator ready, and open up the cache, making it if we have to.
+// Return false if either one doesn't work out.
+bool ProceduralChunkSource::init()
+{
+    if (!m_generator.init()) {
+        return false;
+    }
+
+    sqlite3 *db = SQL_open(m_cache_fname);
+    if (db == nullptr) {
+        return false;
+    }
+
+    // On failure, the SQL helpers have already closed the database.
+    if (!initCache(db)) {
+        PrintDebug(fmt::format("Could not set up the chunk cache '{}'.\n", m_cache_fname));
+        return false;
+    }
+
+    SQL_close(db);
+
+    PrintDebug(fmt::format(
+        "Generating chunks with: {0}\n"
+        "Caching them in '{1}'.\n",
+        m_generator.getDescription(), m_cache_fname));
+    return true;
+}
+
+
+// Make the cache tables, if they aren't there already. The chunks table is the same
+// as the editor's, so the cache is a perfectly good world file, for what's in it.
+// If the generator settings changed since the cache was made, it's all wrong, so empty it.
+bool ProceduralChunkSource::initCache(sqlite3 *db)
+{
+    // The loader threads all write here, so let readers and the writer get along.
+    if (!SQL_exec(db, "PRAGMA journal_mode=WAL")) {
+        return false;
+    }
+
+    bool success = SQL_exec(db,
+        "CREATE TABLE IF NOT EXISTS chunks ("
+        "x INTEGER, "
+        "z INTEGER, "
+        "data BLOB NOT NULL, "
+        "PRIMARY KEY (x, z))");
+    if (!success) {
+        return false;
+    }
+
+    success = SQL_exec(db, "CREATE TABLE IF NOT EXISTS generator_settings (descr TEXT NOT NULL)");
+    if (!success) {
+        return false;
+    }
+
+    // See what made the chunks that are already in here.
+    sqlite3_stmt *stmt = SQL_prepare(db, "SELECT descr FROM generator_settings");
+    if (stmt == nullptr) {
+        return false;
+    }
+
+    std::string old_descr;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        const unsigned char *raw_text = sqlite3_column_text(stmt, 0);
+        old_descr = reinterpret_cast<const char*>(raw_text);
+    }
+
+    if (!SQL_finalize(db, stmt)) {
+        return false;
+    }
+
+    // The blob version goes in too, so caches from older builds get thrown out.
+    std::string new_descr = fmt::format(
+        "blob_version={0} {1}", CHUNK_BLOB_VERSION, m_generator.getDescription());
+    if (old_descr == new_descr) {
+        return true;
+    }
+
+    if (!old_descr.empty()) {
+        PrintDebug("The generator settings changed, so the chunk cache is being emptied.\n");
+    }
+
+    // Quotes in the heightmap name would break the SQL, so double them up.
+    std::string quoted_descr;
+    for (char one_char : new_descr) {
+        quoted_descr += one_char;
+        if (one_char == '\'') {
+            quoted_descr += one_char;
+        }
+    }
+
+    return SQL_exec(db, fmt::format(
+        "BEGIN;"
+        "DROP TABLE IF EXISTS blocks;"
+        "DROP TABLE IF EXISTS generated_chunks;"
+        "DELETE FROM chunks;"
+        "DELETE FROM generator_settings;"
+        "INSERT INTO generator_settings (descr) VALUES ('{}');"
+        "COMMIT;",
+        quoted_descr));
+}
+
+
+// Load a chunk. If we've been here before, it's in the cache. If not, make it up.
+std::unique_ptr<Chunk> ProceduralChunkSource::loadChunk(GameWorld *world, const ChunkOrigin &origin) const
+{
+    if (isChunkCached(origin)) {
+        std::unique_ptr<Chunk> chunk = LoadChunkFromBlob(m_cache_fname, world, origin);
+        if (chunk != nullptr) {
+            m_cached_count++;
+            return chunk;
+        }
+    }
+
+    return generateChunk(world, origin);
+}
+
+
+// Has this chunk been generated before?
+bool ProceduralChunkSource::isChunkCached(const ChunkOrigin &origin) const
+{
+    sqlite3 *db = SQL_open(m_cache_fname);
+    if (db == nullptr) {
+        return false;
+    }
+
+    sqlite3_busy_timeout(db, CACHE_BUSY_TIMEOUT_MSECS);
+
+    std::string buffer = fmt::format(
+        "SELECT 1 FROM chunks WHERE x == {0} AND z == {1}",
+        origin.x(), origin.z());
+    sqlite3_stmt *stmt = SQL_prepare(db, buffer.c_str());
+    if (stmt == nullptr) {
+        return false;
+    }
+
+    bool found = (sqlite3_step(stmt) == SQLITE_ROW);
+
+    if (SQL_finalize(db, stmt)) {
+        SQL_close(db);
+    }
+
+    return found;
+}
+
+
+// Generate a chunk from scratch, and save it in the cache for next time.
+// Same as loading, we grab the chunk only once nothing else can fail.
+std::unique_ptr<Chunk> ProceduralChunkSource::generateChunk(GameWorld *world, const ChunkOrigin &origin) const
+{
+    sf::Clock clock;
+
+    // Columns go in blob order, so build the blob first, then the chunk from that.
+    // The blob is exactly what goes in the cache.
+    ChunkBlobWriter writer;
+    GeneratedColumn column;
+
+    for     (int local_x = 0; local_x < CHUNK_WIDTH; local_x++) {
+        for (int local_z = 0; local_z < CHUNK_WIDTH; local_z++) {
+            m_generator.calcColumn(origin.x() + local_x, origin.z() + local_z, &column);
+            writer.addColumnTops(column.dirt_top, column.stone_top, column.coal_ys.data(), column.coal_count);
+        }
+    }
+
+    const std::vector<unsigned char> &data = writer.getData();
+
+    std::unique_ptr<Chunk> chunk = world->getChunkPool().acquire(*world, origin);
+    bool built = BuildChunkFromBlob(data.data(), static_cast<int>(data.size()), chunk.get());
+    assert(built);
+
+    // Only the generating counts against the budget. The cache write is extra.
+    long long usecs = clock.getElapsedTime().asMicroseconds();
+    m_generated_count++;
+    m_generate_usecs += usecs;
+
+    if (usecs > GENERATE_BUDGET_USECS) {
+        m_over_budget_count++;
+        PrintDebug(fmt::format(
+            "Generating chunk [{0}, {1}] took {2:.1f} msecs, which is over budget.\n",
+            origin.debugX(), origin.debugZ(), usecs / 1000.0));
+    }
+
+    // If this doesn't work, we've still got the chunk. It just gets generated again next time.
+    if (!saveToCache(origin, data)) {
+        PrintDebug(fmt::format(
+            "Could not cache chunk [{0}, {1}].\n", origin.debugX(), origin.debugZ()));
+    }
+
+    return chunk;
+}
+
+
+// Write a chunk's blob to the cache, keyed by its origin, same as a world file.
+// It's one row, so the chunk is either all cached, or not at all.
+bool ProceduralChunkSource::saveToCache(const ChunkOrigin &origin, const std::vector<unsigned char> &data) const
+{
+    sqlite3 *db = SQL_open(m_cache_fname);
+    if (db == nullptr) {
+        return false;
+    }
+
+    // Other loader threads might be writing too. Wait our turn.
+    sqlite3_busy_timeout(db, CACHE_BUSY_TIMEOUT_MSECS);
+
+    sqlite3_stmt *stmt = SQL_prepare(db,
+        "INSERT OR REPLACE INTO chunks (x, z, data) "
+        "VALUES (?, ?, ?)");
+    if (stmt == nullptr) {
+        return false;
+    }
+
+    sqlite3_bind_int(stmt, 1, origin.x());
+    sqlite3_bind_int(stmt, 2, origin.z());
+    sqlite3_bind_blob(stmt, 3, data.data(), static_cast<int>(data.size()), SQLITE_STATIC);
+
+    bool success = (sqlite3_step(stmt) == SQLITE_DONE);
+
+    if (!SQL_finalize(db, stmt)) {
+        return false;
+    }
+
+    SQL_close(db);
+    return success;
+}
+
+
+// Make up the column tops for a far tile. No need for the cache, or for coal,
+// since the far terrain only ever sees the tops, and the 2D noise is cheap.
+std::unique_ptr<FarTile> ProceduralChunkSource::loadFarTile(const GlobalPillar &origin, int step) const
+{
+    std::unique_ptr<FarTile> tile = std::make_unique<FarTile>(origin, step);
+
+    int samples = tile->getSamplesPerSide();
+
+    for     (int sample_x = 0; sample_x < samples; sample_x++) {
+        for (int sample_z = 0; sample_z < samples; sample_z++) {
+            int world_x = origin.x() + (sample_x * step);
+            int world_z = origin.z() + (sample_z * step);
+
+            int dirt_height = m_generator.calcDirtHeight(world_x, world_z);
+            if ((dirt_height < 0) || (dirt_height >= ColumnTops::NONE)) {
+                continue;
+            }
+
+            int stone_height = m_generator.calcStoneHeight(world_x, world_z, dirt_height);
+
+            // Stone that sticks out of the dirt leaves no dirt at all.
+            ColumnTops tops;
+            if (dirt_height > stone_height) {
+                tops.dirt_top = static_cast<unsigned char>(dirt_height);
+            }
+            if ((stone_height >= 0) && (stone_height < ColumnTops::NONE)) {
+                tops.stone_top = static_cast<unsigned char>(stone_height);
+            }
+
+            tile->setColumnTops(sample_x, sample_z, tops);
+        }
+    }
+
+    return tile;
+}
+
+
+// Start the player on top of whatever's at X=0, Z=0, same as a world file.
+MyVec4 ProceduralChunkSource::getPlayerStartPos() const
+{
+    GeneratedColumn column;
+    m_generator.calcColumn(0, 0, &column);
+
+    int top = (column.dirt_top > column.stone_top) ? column.dirt_top : column.stone_top;
+    return StartHeightToWorldPos(top);
+}
+
+
+// How generating is going, for the HUD.
+std::string ProceduralChunkSource::getStatsText() const
+{
+    int generated = m_generated_count;
+    double avg_msecs = (generated > 0) ? (m_generate_usecs / 1000.0) / generated : 0.0;
+
+    return fmt::format(
+        "Chunk Source: {0} generated ({1:.1f} msecs avg, {2} over budget), {3} from cache",
+        generated, avg_msecs, m_over_budget_count.load(), m_cached_count.load());
+}
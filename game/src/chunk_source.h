@@ -0,0 +1,101 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "chunk_io.h"
+#include "config.h"
+#include "far_terrain.h"
+#include "my_math.h"
+#include "terrain_generator.h"
+
+#include <atomic>
+
+class Chunk;
+class ChunkOrigin;
+class GameWorld;
+struct sqlite3;
+
+
+// Where the world's blocks come from. The game world and far terrain don't care
+// whether it's a world file the editor baked, or terrain made up on the spot.
+// Loads happen on the loader threads, so everything here has to be thread-safe.
+class ChunkSource
+{
+public:
+    ChunkSource() {}
+    virtual ~ChunkSource() {}
+
+    virtual std::unique_ptr<Chunk> loadChunk(GameWorld *world, const ChunkOrigin &origin) const = 0;
+    virtual std::unique_ptr<FarTile> loadFarTile(const GlobalPillar &origin, int step) const = 0;
+    virtual MyVec4 getPlayerStartPos() const = 0;
+
+    // A line for the HUD, if there's anything worth saying.
+    virtual std::string getStatsText() const { return ""; }
+
+private:
+    FORBID_COPYING(ChunkSource)
+    FORBID_MOVING(ChunkSource)
+};
+
+
+// The world file the editor baked. Every load just opens it and asks.
+class DatabaseChunkSource : public ChunkSource
+{
+public:
+    DatabaseChunkSource(const std::string &db_fname);
+    ~DatabaseChunkSource() {}
+
+    std::unique_ptr<Chunk> loadChunk(GameWorld *world, const ChunkOrigin &origin) const override;
+    std::unique_ptr<FarTile> loadFarTile(const GlobalPillar &origin, int step) const override;
+    MyVec4 getPlayerStartPos() const override;
+
+private:
+    FORBID_DEFAULT_CTOR(DatabaseChunkSource)
+
+    // Private data.
+    std::string m_db_fname;
+    bool m_chunk_blobs;
+};
+
+
+// A world with no edges. Chunks get generated the first time anyone visits them,
+// and then go in a cache file, so the next visit is just a load like any other.
+// The cache only ever grows, and it's thrown out if the generator settings change.
+// Far terrain never goes near the cache, since it only needs the tops, and
+// those are cheap enough to just calculate.
+class ProceduralChunkSource : public ChunkSource
+{
+public:
+    ProceduralChunkSource(const ConfigWorld &config);
+    ~ProceduralChunkSource() {}
+
+    bool init();
+
+    std::unique_ptr<Chunk> loadChunk(GameWorld *world, const ChunkOrigin &origin) const override;
+    std::unique_ptr<FarTile> loadFarTile(const GlobalPillar &origin, int step) const override;
+    MyVec4 getPlayerStartPos() const override;
+
+    std::string getStatsText() const override;
+
+private:
+    FORBID_DEFAULT_CTOR(ProceduralChunkSource)
+
+    // Private methods.
+    bool initCache(sqlite3 *db);
+    bool isChunkCached(const ChunkOrigin &origin) const;
+    std::unique_ptr<Chunk> generateChunk(GameWorld *world, const ChunkOrigin &origin) const;
+    bool saveToCache(const ChunkOrigin &origin, const std::vector<unsigned char> &data) const;
+
+    // Private data. Generating a chunk should fit comfortably in a streaming
+    // tick or two. Anything slower gets complained about.
+    static const int GENERATE_BUDGET_USECS = 50000;
+    static const int CACHE_BUSY_TIMEOUT_MSECS = 5000;
+
+    std::string m_cache_fname;
+    TerrainGenerator m_generator;
+
+    mutable std::atomic<int> m_generated_count;
+    mutable std::atomic<int> m_cached_count;
+    mutable std::atomic<int> m_over_budget_count;
+    mutable std::atomic<long long> m_generate_usecs;
+};
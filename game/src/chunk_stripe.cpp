@@ -6,6 +6,7 @@
 #include "block.h"
 #include "chunk.h"
 #include "common_util.h"
+#include "config.h"
 #include "landscape.h"
 
 
@@ -18,6 +19,13 @@ SurfaceTotals::SurfaceTotals()
 }
 
 
+// Back to nothing at all.
+void SurfaceTotals::clear()
+{
+    m_counts.fill(0);
+}
+
+
 // Increment our surface type.
 void SurfaceTotals::increment(SurfaceType surf)
 {
@@ -29,6 +37,26 @@ void SurfaceTotals::increment(SurfaceType surf)
 }
 
 
+// Decrement our surface type.
+void SurfaceTotals::decrement(SurfaceType surf)
+{
+    if (surf != SurfaceType::NOTHING) {
+        int index = static_cast<int>(surf);
+        assert((index < SURFACE_TYPE_COUNT) && (m_counts[index] > 0));
+        m_counts[index]--;
+    }
+}
+
+
+// Add in somebody else's counts.
+void SurfaceTotals::add(const SurfaceTotals &other)
+{
+    for (int i = 0; i < SURFACE_TYPE_COUNT; i++) {
+        m_counts[i] += other.m_counts[i];
+    }
+}
+
+
 // Get the count for one surface.
 int SurfaceTotals::get(SurfaceType surf) const
 {
@@ -58,6 +86,18 @@ BlockType ChunkStripe::getBlockType(int z) const
 }
 
 
+// Back to all air, with nothing showing.
+void ChunkStripe::clear()
+{
+    for (Block &block : m_blocks) {
+        block.setBlockType(BlockType::AIR);
+        block.clearSurfaces();
+    }
+
+    m_has_exposures = false;
+}
+
+
 // Set the type of a block
 void ChunkStripe::setBlockType(int z, BlockType block_type)
 {
@@ -66,7 +106,16 @@ void ChunkStripe::setBlockType(int z, BlockType block_type)
 }
 
 
-// Figure out which faces of a block are exposed.
+// Get one of a block's surfaces.
+SurfaceType ChunkStripe::getSurface(int z, FaceType face) const
+{
+    assert((z >= 0) && (z < CHUNK_WIDTH));
+    return m_blocks.at(z).getSurface(face);
+}
+
+
+// Figure out which faces of a block are exposed. That part's shared with the world
+// editor's preview, and the chunk's edges count as air, same as the preview's window.
 // Populate a surface totals object, showing what we added.
 // Return if this block has any exposures at all.
 bool ChunkStripe::recalcExposuresForBlock(
@@ -82,94 +131,34 @@ bool ChunkStripe::recalcExposuresForBlock(
         return false;
     }
 
-    // Check for edge cases.
-    const int x = local_coord.x();
-    const int y = local_coord.y();
-    const int z = local_coord.z();
-
-    const bool west_edge = (x == 0);
-    const bool east_edge = (x == (CHUNK_WIDTH - 1));
-
-    const bool south_edge = (z == 0);
-    const bool north_edge = (z == (CHUNK_WIDTH - 1));
-
-    const bool bottom_edge = (y == 0);
-    const bool top_edge    = (y == (CHUNK_HEIGHT - 1));
-
-    // Get our six neigbors, straddling across chunk boundaries if necessary.
-    BlockType west_block_type = BlockType::AIR;
-    if (!west_edge) {
-        const LocalGrid coord(x - 1, y, z);
-        west_block_type = chunk.getBlockType(coord);
-    }
-
-    BlockType east_block_type = BlockType::AIR;
-    if (!east_edge) {
-        const LocalGrid coord(x + 1, y, z);
-        east_block_type = chunk.getBlockType(coord);
-    }
-
-    BlockType south_block_type = BlockType::AIR;
-    if (!south_edge) {
-        const LocalGrid coord(x, y, z - 1);
-        south_block_type = chunk.getBlockType(coord);
-    }
-
-    BlockType north_block_type = BlockType::AIR;
-    if (!north_edge) {
-        const LocalGrid coord(x, y, z + 1);
-        north_block_type = chunk.getBlockType(coord);
-    }
-
-    BlockType top_block_type = BlockType::AIR;
-    if (!top_edge) {
-        const LocalGrid coord(x, y + 1, z);
-        top_block_type = chunk.getBlockType(coord);
-    }
-
-    BlockType bottom_block_type = BlockType::AIR;
-    if (!bottom_edge) {
-        const LocalGrid coord(x, y - 1, z);
-        bottom_block_type = chunk.getBlockType(coord);
-    }
-
-    // Check each of the faces.
-    const SurfaceType west_surf   = CalcSurfaceType(block_type, FaceType::WEST, west_block_type);
-    const SurfaceType east_surf   = CalcSurfaceType(block_type, FaceType::EAST, east_block_type);
-
-    const SurfaceType south_surf  = CalcSurfaceType(block_type, FaceType::SOUTH, south_block_type);
-    const SurfaceType north_surf  = CalcSurfaceType(block_type, FaceType::NORTH, north_block_type);
-
-    const SurfaceType top_surf    = CalcSurfaceType(block_type, FaceType::TOP,    top_block_type);
-    const SurfaceType bottom_surf = CalcSurfaceType(block_type, FaceType::BOTTOM, bottom_block_type);
+    BlockSurfaces surfs;
+    CalcBlockSurfaces(
+        block_type, local_coord.x(), local_coord.y(), local_coord.z(), CHUNK_WIDTH, CHUNK_HEIGHT,
+        GetConfig().debug.draw_transitions,
+        [&chunk](int x, int y, int z) { return chunk.getBlockType(LocalGrid(x, y, z)); },
+        &surfs);
 
-    current.setSurface(FaceType::SOUTH,  south_surf);
-    current.setSurface(FaceType::NORTH,  north_surf);
-    current.setSurface(FaceType::WEST,   west_surf);
-    current.setSurface(FaceType::EAST,   east_surf);
-    current.setSurface(FaceType::TOP,    top_surf);
-    current.setSurface(FaceType::BOTTOM, bottom_surf);
+    current.setSurface(FaceType::SOUTH,  surfs.south);
+    current.setSurface(FaceType::NORTH,  surfs.north);
+    current.setSurface(FaceType::WEST,   surfs.west);
+    current.setSurface(FaceType::EAST,   surfs.east);
+    current.setSurface(FaceType::TOP,    surfs.top);
+    current.setSurface(FaceType::BOTTOM, surfs.bottom);
 
-    pOut->increment(south_surf);
-    pOut->increment(north_surf);
-    pOut->increment(west_surf);
-    pOut->increment(east_surf);
-    pOut->increment(top_surf);
-    pOut->increment(bottom_surf);
+    pOut->increment(surfs.south);
+    pOut->increment(surfs.north);
+    pOut->increment(surfs.west);
+    pOut->increment(surfs.east);
+    pOut->increment(surfs.top);
+    pOut->increment(surfs.bottom);
 
     // Return true if anything we calculated has exposures.
-    return (
-        (south_surf  != SurfaceType::NOTHING) ||
-        (north_surf  != SurfaceType::NOTHING) ||
-        (west_surf   != SurfaceType::NOTHING) ||
-        (east_surf   != SurfaceType::NOTHING) ||
-        (top_surf    != SurfaceType::NOTHING) ||
-        (bottom_surf != SurfaceType::NOTHING));
+    return surfs.hasAny();
 }
 
 
-// Add the quads for a block.
-void ChunkStripe::addToSurfaceLists(Chunk &chunk, const LocalGrid &local_coord)
+// Add the quads for a block, to whichever section verts we were given.
+void ChunkStripe::addToSurfaceLists(const Chunk &chunk, const LocalGrid &local_coord, SectionVerts *pOut)
 {
     const Block &current = m_blocks.at(local_coord.z());
 
@@ -185,48 +174,36 @@ void ChunkStripe::addToSurfaceLists(Chunk &chunk, const LocalGrid &local_coord)
     // Top face.
     const SurfaceType top_surf = current.getSurface(FaceType::TOP);
     if (top_surf != SurfaceType::NOTHING) {
-        VertList_PNT &list = chunk.landscape.getSurfaceList_RW(top_surf);
-        auto tris = GetLandscapePatch_PNT(chunk, local_coord, FaceType::TOP);
-        list.add(tris.data(), tris.size());
+        AddLandscapePatch_PNT(chunk, local_coord, FaceType::TOP, &pOut->getList(top_surf));
     }
 
     // Bottom face.
     const SurfaceType bottom_surf = current.getSurface(FaceType::BOTTOM);
     if (bottom_surf != SurfaceType::NOTHING) {
-        VertList_PNT &list = chunk.landscape.getSurfaceList_RW(bottom_surf);
-        auto tris = GetLandscapePatch_PNT(chunk, local_coord, FaceType::BOTTOM);
-        list.add(tris.data(), tris.size());
+        AddLandscapePatch_PNT(chunk, local_coord, FaceType::BOTTOM, &pOut->getList(bottom_surf));
     }
 
     // Southern face.
     const SurfaceType south_surf = current.getSurface(FaceType::SOUTH);
     if (south_surf != SurfaceType::NOTHING) {
-        VertList_PNT &list = chunk.landscape.getSurfaceList_RW(south_surf);
-        auto tris = GetLandscapePatch_PNT(chunk, local_coord, FaceType::SOUTH);
-        list.add(tris.data(), tris.size());
+        AddLandscapePatch_PNT(chunk, local_coord, FaceType::SOUTH, &pOut->getList(south_surf));
     }
 
     // Northern face.
     const SurfaceType north_surf = current.getSurface(FaceType::NORTH);
     if (north_surf != SurfaceType::NOTHING) {
-        VertList_PNT &list = chunk.landscape.getSurfaceList_RW(north_surf);
-        auto tris = GetLandscapePatch_PNT(chunk, local_coord, FaceType::NORTH);
-        list.add(tris.data(), tris.size());
+        AddLandscapePatch_PNT(chunk, local_coord, FaceType::NORTH, &pOut->getList(north_surf));
     }
 
     // Eastern face.
     const SurfaceType east_surf = current.getSurface(FaceType::EAST);
     if (east_surf != SurfaceType::NOTHING) {
-        VertList_PNT &list = chunk.landscape.getSurfaceList_RW(east_surf);
-        auto tris = GetLandscapePatch_PNT(chunk, local_coord, FaceType::EAST);
-        list.add(tris.data(), tris.size());
+        AddLandscapePatch_PNT(chunk, local_coord, FaceType::EAST, &pOut->getList(east_surf));
     }
 
     // Western face.
     const SurfaceType west_surf = current.getSurface(FaceType::WEST);
     if (west_surf != SurfaceType::NOTHING) {
-        VertList_PNT &list = chunk.landscape.getSurfaceList_RW(west_surf);
-        auto tris = GetLandscapePatch_PNT(chunk, local_coord, FaceType::WEST);
-        list.add(tris.data(), tris.size());
+        AddLandscapePatch_PNT(chunk, local_coord, FaceType::WEST, &pOut->getList(west_surf));
     }
 }
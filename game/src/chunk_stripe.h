@@ -9,6 +9,7 @@
 class Chunk;
 class ChunkVertLists;
 class Landscape;
+struct SectionVerts;
 
 
 // As we recalc exposures, keep track of how many surfaces we discover.
@@ -16,7 +17,10 @@ class SurfaceTotals
 {
 public:
     SurfaceTotals();
+    void clear();
     void increment(SurfaceType surf_type);
+    void decrement(SurfaceType surf_type);
+    void add(const SurfaceTotals &other);
     int  get(SurfaceType surf) const;
     int  getGrandTotal() const;
 
@@ -38,11 +42,15 @@ public:
 
     ~ChunkStripe() {}
 
+    void clear();
+
     BlockType getBlockType(int local_z) const;
     void setBlockType(int local_z, BlockType block_type);
 
+    SurfaceType getSurface(int local_z, FaceType face) const;
+
     bool recalcExposuresForBlock(const Chunk &chunk, const LocalGrid &local_coord, SurfaceTotals *pOut);
-    void addToSurfaceLists(Chunk &chunk, const LocalGrid &local_coord);
+    void addToSurfaceLists(const Chunk &chunk, const LocalGrid &local_coord, SectionVerts *pOut);
 
 private:
     FORBID_COPYING(ChunkStripe)
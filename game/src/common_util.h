@@ -1,6 +1,7 @@
 #pragma once
 
 #include "stdafx.h"
+#include "rounding.h"
 
 /**
 * Common data structures and utility methods.
@@ -46,10 +47,6 @@ int GetMemoryUsage();
 void PrintDebug(const std::string &msg);
 void PrintTheImpossible(const std::string &fname, int line_num, int value);
 
-// Better rounding.
-int RoundUpInt(int val, int mult);
-int RoundDownInt(int val, int mult);
-
 // Including the SQLite header causes conflicts. Not worth it.
 struct sqlite3;
 struct sqlite3_stmt;
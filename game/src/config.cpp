@@ -90,7 +90,35 @@ bool Config::loadFromFile()
     // Read the "world" table.
     lua_getglobal(L, "world");
     if (lua_istable(L, -1)) {
-        world.file_name = getStringField(L, "file_name");
+        world.file_name  = getStringField(L, "file_name");
+        world.procedural = getBoolField(L, "procedural", false);
+        world.cache_name = getStringField(L, "cache_name");
+
+        // Read the "generator" settings. Anything missing keeps the editor's defaults.
+        lua_getfield(L, -1, "generator");
+        if (lua_istable(L, -1)) {
+            ConfigGenerator &generator = world.generator;
+
+            lua_getfield(L, -1, "seed");
+            if (lua_isinteger(L, -1)) {
+                generator.seed = static_cast<int>(lua_tointeger(L, -1));
+            }
+            lua_pop(L, 1);
+
+            generator.heightmap = getStringField(L, "heightmap");
+
+            generator.stone_percent      = getDoubleField(L, "stone_percent",      generator.stone_percent);
+            generator.stone_subtracted   = getDoubleField(L, "stone_subtracted",   generator.stone_subtracted);
+            generator.stone_displacement = getDoubleField(L, "stone_displacement", generator.stone_displacement);
+            generator.stone_noise_scale  = getDoubleField(L, "stone_noise_scale",  generator.stone_noise_scale);
+            generator.coal_density       = getDoubleField(L, "coal_density",       generator.coal_density);
+
+            // The noise scale gets divided by, so keep it away from zero.
+            if (generator.stone_noise_scale < 1.0) {
+                generator.stone_noise_scale = 1.0;
+            }
+        }
+        lua_pop(L, 1);
     }
     lua_pop(L, 1);
 
@@ -101,6 +129,8 @@ bool Config::loadFromFile()
         debug.noclip           = getBoolField(L, "noclip", false);
         debug.check_for_leaks  = getBoolField(L, "check_for_leaks",  false);
         debug.draw_transitions = getBoolField(L, "draw_transitions", false);
+        debug.physics_benchmark = getBoolField(L, "physics_benchmark", false);
+        debug.meshing_benchmark = getBoolField(L, "meshing_benchmark", false);
 
         debug.hud_framerate    = getBoolField(L, "hud_framerate",    false);
         debug.hud_game_clock   = getBoolField(L, "hud_game_clock",   false);
@@ -191,6 +221,14 @@ bool Config::loadFromFile()
         }
         lua_pop(L, 1);
 
+        // Clamp the streaming buffer from 1 meg to 256 megs, per region.
+        lua_getfield(L, -1, "streaming_buffer_megs");
+        if (lua_isnumber(L, -1)) {
+            int val = static_cast<int>(lua_tointeger(L, -1));
+            render.streaming_buffer_megs = clampInt(val, 1, 256);
+        }
+        lua_pop(L, 1);
+
         // Read the "wavefront" settings.
         lua_getfield(L, -1, "wavefront");
         if (lua_istable(L, -1)) {
@@ -236,6 +274,32 @@ bool Config::loadFromFile()
             render.hit_test.texture     = getStringField(L, "texture");
         }
         lua_pop(L, 1);
+
+        // Read the "far terrain" settings. Clamp the distance so it stays inside the far plane.
+        lua_getfield(L, -1, "far_terrain");
+        if (lua_istable(L, -1)) {
+            render.far_terrain.enabled = getBoolField(L, "enabled", false);
+
+            lua_getfield(L, -1, "distance");
+            if (lua_isnumber(L, -1)) {
+                GLfloat val = static_cast<GLfloat>(lua_tonumber(L, -1));
+                render.far_terrain.distance_meters = clampFloat(val, 10.0f, render.far_plane_meters);
+            }
+            lua_pop(L, 1);
+
+            render.far_terrain.vert_shader = getStringField(L, "vert_shader");
+            render.far_terrain.frag_shader = getStringField(L, "frag_shader");
+        }
+        lua_pop(L, 1);
+
+        // Read the "overdraw" settings.
+        lua_getfield(L, -1, "overdraw");
+        if (lua_istable(L, -1)) {
+            render.overdraw.enabled     = getBoolField(L, "enabled", false);
+            render.overdraw.vert_shader = getStringField(L, "vert_shader");
+            render.overdraw.frag_shader = getStringField(L, "frag_shader");
+        }
+        lua_pop(L, 1);
     }
     lua_pop(L, 1);
 
@@ -319,6 +383,19 @@ bool Config::getBoolField(lua_State *L, const std::string &field_name, bool defa
 }
 
 
+// Wrap some of the Lua stuff.
+double Config::getDoubleField(lua_State *L, const std::string &field_name, double default_val)
+{
+    double result = default_val;
+    lua_getfield(L, -1, field_name.c_str());
+    if (lua_isnumber(L, -1)) {
+        result = lua_tonumber(L, -1);
+    }
+    lua_pop(L, 1);
+    return result;
+}
+
+
 // Wrap some of the Lua stuff.
 std::string Config::getStringField(lua_State *L, const std::string &field_name)
 {
@@ -386,8 +463,20 @@ bool Config::validate() const
 {
     bool success = true;
 
-    // Big picture stuff. 
-    if (!validateResource("world.file_name", world.file_name)) { success = false; }
+    // Big picture stuff. A procedural world doesn't need a world file, but it does need
+    // somewhere to keep its cache. That file gets created, so it doesn't have to exist yet.
+    if (world.procedural) {
+        if (world.cache_name.empty()) {
+            PrintDebug("Config field 'world.cache_name' is not set.\n");
+            success = false;
+        }
+
+        const std::string &heightmap = world.generator.heightmap;
+        if (!heightmap.empty() && !validateResource("world.generator.heightmap", heightmap)) { success = false; }
+    }
+    else {
+        if (!validateResource("world.file_name", world.file_name)) { success = false; }
+    }
 
     // Fonts, textures and shaders.
     if (!validateResource("render.hud_font", render.hud_font)) { success = false; }
@@ -422,6 +511,18 @@ bool Config::validate() const
     if (!validateResource("render.hit_test.frag_shader", render.hit_test.frag_shader)) { success = false; }
     if (!validateResource("render.hit_test.texture",     render.hit_test.texture))     { success = false; }
 
+    // Far terrain resources, but only if we're using it.
+    if (render.far_terrain.enabled) {
+        if (!validateResource("render.far_terrain.vert_shader", render.far_terrain.vert_shader)) { success = false; }
+        if (!validateResource("render.far_terrain.frag_shader", render.far_terrain.frag_shader)) { success = false; }
+    }
+
+    // Overdraw resources, same deal.
+    if (render.overdraw.enabled) {
+        if (!validateResource("render.overdraw.vert_shader", render.overdraw.vert_shader)) { success = false; }
+        if (!validateResource("render.overdraw.frag_shader", render.overdraw.frag_shader)) { success = false; }
+    }
+
     if (!success) {
         PrintDebug(fmt::format("File '{}' has errors. Fix these and try again.\n", config_fname));
     }
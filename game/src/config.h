@@ -9,10 +9,41 @@ struct lua_State;
 
 // We'll have lots of config settings, so let's dispense with
 // the formalities, and just go for plain structs for now.
+// The knobs for making up a world as we go. The stone and coal settings
+// are the same ones as the world editor's build settings.
+struct ConfigGenerator
+{
+    ConfigGenerator() :
+        seed(0),
+        heightmap(""),
+        stone_percent(50.0),
+        stone_subtracted(4.0),
+        stone_displacement(8.0),
+        stone_noise_scale(100.0),
+        coal_density(1.0) {}
+
+    ~ConfigGenerator() {}
+
+    DEFAULT_COPYING(ConfigGenerator)
+    DEFAULT_MOVING(ConfigGenerator)
+
+    int seed;
+    std::string heightmap;
+
+    double stone_percent;
+    double stone_subtracted;
+    double stone_displacement;
+    double stone_noise_scale;
+    double coal_density;
+};
+
+
 struct ConfigWorld
 {
     ConfigWorld() :
-        file_name("") {}
+        file_name(""),
+        procedural(false),
+        cache_name("") {}
 
     ~ConfigWorld() {}
 
@@ -20,6 +51,11 @@ struct ConfigWorld
     DEFAULT_MOVING(ConfigWorld)
 
     std::string file_name;
+
+    // Procedural worlds ignore the world file, and keep what they generate in the cache file.
+    bool procedural;
+    std::string cache_name;
+    ConfigGenerator generator;
 };
 
 
@@ -31,6 +67,8 @@ struct ConfigDebug
 
         noclip(false),
         draw_transitions(false),
+        physics_benchmark(false),
+        meshing_benchmark(false),
 
         hud_framerate(false),
         hud_game_clock(false),
@@ -59,6 +97,8 @@ struct ConfigDebug
 
     bool check_for_leaks;
     bool draw_transitions;
+    bool physics_benchmark;
+    bool meshing_benchmark;
 
     bool hud_framerate;
     bool hud_game_clock;
@@ -171,6 +211,46 @@ struct ConfigHitTest
 };
 
 
+struct ConfigFarTerrain
+{
+    ConfigFarTerrain() :
+        enabled(false),
+        distance_meters(500.0f) {}
+
+    ~ConfigFarTerrain() {}
+
+    DEFAULT_COPYING(ConfigFarTerrain)
+    DEFAULT_MOVING(ConfigFarTerrain)
+
+    bool enabled;
+    GLfloat distance_meters;
+
+    std::string vert_shader;
+    std::string frag_shader;
+
+    GLfloat getDistanceCm() const { return distance_meters * 100.0f; }
+};
+
+
+// Overdraw measurement. This draws the landscape a couple more times a frame,
+// so leave it off unless you're actually measuring something.
+struct ConfigOverdraw
+{
+    ConfigOverdraw() :
+        enabled(false) {}
+
+    ~ConfigOverdraw() {}
+
+    DEFAULT_COPYING(ConfigOverdraw)
+    DEFAULT_MOVING(ConfigOverdraw)
+
+    bool enabled;
+
+    std::string vert_shader;
+    std::string frag_shader;
+};
+
+
 struct ConfigRender
 {
     ConfigRender() :
@@ -179,7 +259,8 @@ struct ConfigRender
         field_of_view(90.0f),
         near_plane_meters(0.1f),
         far_plane_meters(1000.0f),
-        fade_distance_meters(80.0f) {}
+        fade_distance_meters(80.0f),
+        streaming_buffer_megs(16) {}
 
     ~ConfigRender() {}
 
@@ -193,11 +274,14 @@ struct ConfigRender
     GLfloat near_plane_meters;
     GLfloat far_plane_meters;
     GLfloat fade_distance_meters;
+    int     streaming_buffer_megs;
 
     ConfigWavefront wavefront;
     ConfigLandscape landscape;
     ConfigSkybox    skybox;
     ConfigHitTest   hit_test;
+    ConfigFarTerrain far_terrain;
+    ConfigOverdraw   overdraw;
 
     GLfloat getNearPlaneCm()    const { return near_plane_meters    * 100.0f; }
     GLfloat getFarPlaneCm()     const { return far_plane_meters     * 100.0f; }
@@ -259,6 +343,7 @@ private:
     GLfloat clampFloat(GLfloat val, GLfloat min_val, GLfloat max_val);
 
     bool getBoolField(lua_State *L, const std::string &field_name, bool default_val);
+    double getDoubleField(lua_State *L, const std::string &field_name, double default_val);
     std::string getStringField(lua_State *L, const std::string &field_name);
 
     bool validateResource(const std::string &field, const std::string &val) const;
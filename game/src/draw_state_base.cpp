@@ -7,6 +7,7 @@
 #include "draw_texture.h"
 #include "config.h"
 #include "format.h"
+#include "gl_state_cache.h"
 #include "my_math.h"
 #include "utils.h"
 
@@ -256,7 +257,7 @@ bool DrawState_Base::create(
 bool DrawState_Base::updateUniformFloat(const std::string &name, GLfloat value) const
 {
     // Use our compiled program.
-    glUseProgram(m_program_ID);
+    GetGLStateCache().useProgram(m_program_ID);
 
     if (!IS_KEY_IN_MAP(m_uniform_float_map, name)) {
         PrintDebug(fmt::format("Could not find uniform float {}\n", name));
@@ -273,7 +274,7 @@ bool DrawState_Base::updateUniformFloat(const std::string &name, GLfloat value)
 bool DrawState_Base::updateUniformVec4(const std::string &name, const MyVec4 &val) const
 {
     // Use our compiled program.
-    glUseProgram(m_program_ID);
+    GetGLStateCache().useProgram(m_program_ID);
 
     if (!IS_KEY_IN_MAP(m_uniform_vec4_map, name)) {
         PrintDebug(fmt::format("Could not find uniform vec4 {}\n", name));
@@ -290,7 +291,7 @@ bool DrawState_Base::updateUniformVec4(const std::string &name, const MyVec4 &va
 bool DrawState_Base::updateUniformMatrix4by4(const std::string &name, const MyMatrix4by4 &val) const
 {
     // Use our compiled program.
-    glUseProgram(m_program_ID);
+    GetGLStateCache().useProgram(m_program_ID);
 
     if (!IS_KEY_IN_MAP(m_uniform_matrix4by4_map, name)) {
         PrintDebug(fmt::format("Could not find uniform matrix-4by4 {}\n", name));
@@ -309,13 +310,12 @@ bool DrawState_Base::updateUniformTexture(int index, const DrawTexture &texture)
     assert(index <= MAX_TEXTURES);
 
     // Use our compiled program.
-    glUseProgram(m_program_ID);
+    GetGLStateCache().useProgram(m_program_ID);
 
     GLuint texture_id = texture.getTextureId();
     assert(texture_id != 0);
 
-    glActiveTexture(GL_TEXTURE0 + index);
-    glBindTexture(GL_TEXTURE_2D, texture_id);
+    GetGLStateCache().bindTexture(index, GL_TEXTURE_2D, texture_id);
     glUniform1i(m_uniform_textures[index], index);
     return true;
 }
@@ -327,29 +327,31 @@ bool DrawState_Base::updateUniformCubemapTexture(int index, const DrawCubemapTex
     assert(index <= MAX_TEXTURES);
 
     // Use our compiled program.
-    glUseProgram(m_program_ID);
+    GetGLStateCache().useProgram(m_program_ID);
 
     GLuint texture_id = cubemap_texture.getTextureId();
     assert(texture_id != 0);
 
-    glActiveTexture(GL_TEXTURE0 + index);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, texture_id);
+    GetGLStateCache().bindTexture(index, GL_TEXTURE_CUBE_MAP, texture_id);
     glUniform1i(m_uniform_textures[index], index);
     return true;
 }
 
 
-// Stuff right before the render.
+// Stuff right before the render. The state cache skips
+// anything that's already set, which is most of it, most of the time.
 bool DrawState_Base::renderSetup() const
 {
+    GLStateCache &cache = GetGLStateCache();
+
     // Switch to our draw state settings.
-    (GetConfig().render.cull_backfaces ? glEnable : glDisable)(GL_CULL_FACE);
-    (m_settings.enable_depth_test ? glEnable : glDisable)(GL_DEPTH_TEST);
-    (m_settings.enable_blending   ? glEnable : glDisable)(GL_BLEND);
-    glDepthFunc(m_settings.depth_func);
+    cache.setCapability(GL_CULL_FACE,  GetConfig().render.cull_backfaces);
+    cache.setCapability(GL_DEPTH_TEST, m_settings.enable_depth_test);
+    cache.setCapability(GL_BLEND,      m_settings.enable_blending);
+    cache.setDepthFunc(m_settings.depth_func);
 
     // Use our compiled program.
-    glUseProgram(m_program_ID);
+    cache.useProgram(m_program_ID);
     return true;
 }
 
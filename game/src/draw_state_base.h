@@ -66,6 +66,8 @@ public:
     bool updateUniformTexture(int index, const DrawTexture &texture) const;
     bool updateUniformCubemapTexture(int index, const DrawCubemapTexture &cubemap_texture) const;
 
+    GLuint getProgramID() const { return m_program_ID; }
+
 protected:
     bool  renderSetup() const;
     bool  renderTeardown() const;
@@ -34,7 +34,7 @@ bool DrawState_P::render(const VertList_P &vert_list) const
         (void*)offsetof(Vertex_P, position));
 
     // And away we go.
-    glDrawArrays(m_settings.draw_mode, 0, vert_list.getByteCount());
+    glDrawArrays(m_settings.draw_mode, vert_list.getFirstItem(), vert_list.getItemCount());
 
     // Clean up after ourselves.
     if (!renderTeardown()) {
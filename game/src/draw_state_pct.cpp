@@ -46,7 +46,7 @@ bool DrawState_PCT::render(const VertList_PCT &vert_list)
         (void*) offsetof(Vertex_PCT, texuv));
 
     // And away we go.
-    glDrawArrays(m_settings.draw_mode, 0, vert_list.getByteCount());
+    glDrawArrays(m_settings.draw_mode, vert_list.getFirstItem(), vert_list.getItemCount());
 
     // Clean up after ourselves.
     if (!renderTeardown()) {
@@ -47,7 +47,7 @@ bool DrawState_PNT::render(const VertList_PNT &vert_list) const
         (void*) offsetof(Vertex_PNT, texuv));
 
     // And away we go.
-    glDrawArrays(m_settings.draw_mode, 0, vert_list.getByteCount());
+    glDrawArrays(m_settings.draw_mode, vert_list.getFirstItem(), vert_list.getItemCount());
 
     // Clean up after ourselves.
     if (!renderTeardown()) {
@@ -0,0 +1,86 @@
+#include "stdafx.h"
+#include "draw_state_pnt_instanced.h"
+
+#include "utils.h"
+
+
+// Create the draw state. Note our uniform attribute names are always the same.
+bool DrawState_PNT_Instanced::create(const DrawStateSettings &settings)
+{
+    std::vector<std::string> attribs = { "in_position", "in_normal", "in_texuv", "in_move" };
+    return DrawState_Base::create(attribs, settings);
+}
+
+
+// Draw the vert list once for each instance in the given range.
+// We point the "in_move" attribute right at the first instance we want,
+// rather than relying on base-instance support.
+bool DrawState_PNT_Instanced::render(
+    const VertList_PNT &vert_list,
+    const InstanceList_Move &instance_list,
+    int first_instance,
+    int instance_count) const
+{
+    // Make sure the lists are up to date.
+    assert(vert_list.isCurrent());
+    assert(instance_list.isCurrent());
+    assert((first_instance + instance_count) <= instance_list.getItemCount());
+
+    if (instance_count == 0) {
+        return true;
+    }
+
+    // Set up our textures.
+    if (!renderSetup()) {
+        return false;
+    }
+
+    // The per-vertex stuff.
+    glBindBuffer(GL_ARRAY_BUFFER, vert_list.getVertexBufferID());
+
+    GLint attrib_position = getAttribute("in_position");
+    GLint attrib_normal   = getAttribute("in_normal");
+    GLint attrib_texuv    = getAttribute("in_texuv");
+    GLint attrib_move     = getAttribute("in_move");
+
+    glEnableVertexAttribArray(attrib_position);
+    glVertexAttribPointer(
+        attrib_position, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex_PNT),
+        (void*) offsetof(Vertex_PNT, position));
+
+    glEnableVertexAttribArray(attrib_normal);
+    glVertexAttribPointer(
+        attrib_normal, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex_PNT),
+        (void*) offsetof(Vertex_PNT, normal));
+
+    glEnableVertexAttribArray(attrib_texuv);
+    glVertexAttribPointer(
+        attrib_texuv, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex_PNT),
+        (void*) offsetof(Vertex_PNT, texuv));
+
+    // The per-instance stuff.
+    glBindBuffer(GL_ARRAY_BUFFER, instance_list.getVertexBufferID());
+
+    std::size_t instance_offset =
+        (instance_list.getFirstItem() + first_instance) * sizeof(Instance_Move);
+
+    glEnableVertexAttribArray(attrib_move);
+    glVertexAttribPointer(
+        attrib_move, 4, GL_FLOAT, GL_FALSE, sizeof(Instance_Move),
+        (void*) (instance_offset + offsetof(Instance_Move, move)));
+    glVertexAttribDivisor(attrib_move, 1);
+
+    // And away we go.
+    glDrawArraysInstanced(
+        m_settings.draw_mode, vert_list.getFirstItem(), vert_list.getItemCount(), instance_count);
+
+    // Clean up after ourselves. The divisor sticks to the attribute index,
+    // and other draw states might end up using the same one.
+    glVertexAttribDivisor(attrib_move, 0);
+
+    if (!renderTeardown()) {
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "draw_state_base.h"
+#include "draw_state_pnt.h"
+#include "my_math.h"
+#include "vert_list_base.h"
+
+
+// A shader for drawing the same Position/Normal/TexUV data many times over,
+// with one Move per instance. The verts come from one list, and the moves
+// from another, so a thousand trees is still just one draw call.
+
+struct Instance_Move
+{
+    Instance_Move(const MyVec4 &arg_move) :
+        move(arg_move) {}
+
+    MyVec4 move;
+};
+
+static_assert(sizeof(Instance_Move) == 16, "Instance_Move should be 16 bytes.");
+
+
+typedef VertList_Base<Instance_Move> InstanceList_Move;
+
+
+class DrawState_PNT_Instanced : public DrawState_Base
+{
+public:
+    DrawState_PNT_Instanced(int uniform_texture_count) :
+        DrawState_Base(uniform_texture_count) {}
+
+    virtual ~DrawState_PNT_Instanced() {}
+
+    bool create(const DrawStateSettings &settings);
+    bool render(
+        const VertList_PNT &vert_list,
+        const InstanceList_Move &instance_list,
+        int first_instance,
+        int instance_count) const;
+
+private:
+    FORBID_DEFAULT_CTOR(DrawState_PNT_Instanced)
+    FORBID_COPYING(DrawState_PNT_Instanced)
+    FORBID_MOVING(DrawState_PNT_Instanced)
+};
@@ -40,7 +40,7 @@ bool DrawState_PT::render(const VertList_PT  &vert_list) const
         (void*)offsetof(Vertex_PT, texuv));
 
     // And away we go.
-    glDrawArrays(m_settings.draw_mode, 0, vert_list.getByteCount());
+    glDrawArrays(m_settings.draw_mode, vert_list.getFirstItem(), vert_list.getItemCount());
 
     // Clean up after ourselves.
     if (!renderTeardown()) {
@@ -0,0 +1,217 @@
+#include "stdafx.h"
+#include "entity_physics.h"
+
+#include "common_util.h"
+#include "config.h"
+#include "format.h"
+#include "game_world.h"
+#include "physics.h"
+#include "utils.h"
+
+
+// Default ctor. Nobody here yet.
+EntityPhysics::EntityPhysics() :
+    m_last_step_usecs(0)
+{
+}
+
+
+// Add an entity, and return its index. Note that removing
+// an entity can move another one into its old index.
+int EntityPhysics::addEntity(const MyVec4 &pos, const MyVec4 &velocity, GLfloat width, GLfloat height)
+{
+    m_pos_x.emplace_back(pos.x());
+    m_pos_y.emplace_back(pos.y());
+    m_pos_z.emplace_back(pos.z());
+
+    m_vel_x.emplace_back(velocity.x());
+    m_vel_y.emplace_back(velocity.y());
+    m_vel_z.emplace_back(velocity.z());
+
+    m_half_width.emplace_back(width / 2.0f);
+    m_height.emplace_back(height);
+    m_on_ground.emplace_back(0);
+
+    return m_pos_x.size() - 1;
+}
+
+
+// Remove an entity, by moving the last one into its spot. Cheap, but it means
+// indexes aren't stable. Whoever's keeping track of entities needs to know that.
+void EntityPhysics::removeEntity(int index)
+{
+    assert((index >= 0) && (index < getEntityCount()));
+
+    int last = getEntityCount() - 1;
+
+    m_pos_x[index] = m_pos_x[last];
+    m_pos_y[index] = m_pos_y[last];
+    m_pos_z[index] = m_pos_z[last];
+
+    m_vel_x[index] = m_vel_x[last];
+    m_vel_y[index] = m_vel_y[last];
+    m_vel_z[index] = m_vel_z[last];
+
+    m_half_width[index] = m_half_width[last];
+    m_height[index]     = m_height[last];
+    m_on_ground[index]  = m_on_ground[last];
+
+    m_pos_x.pop_back();
+    m_pos_y.pop_back();
+    m_pos_z.pop_back();
+
+    m_vel_x.pop_back();
+    m_vel_y.pop_back();
+    m_vel_z.pop_back();
+
+    m_half_width.pop_back();
+    m_height.pop_back();
+    m_on_ground.pop_back();
+}
+
+
+// Get rid of everybody.
+void EntityPhysics::clear()
+{
+    m_pos_x.clear();
+    m_pos_y.clear();
+    m_pos_z.clear();
+
+    m_vel_x.clear();
+    m_vel_y.clear();
+    m_vel_z.clear();
+
+    m_half_width.clear();
+    m_height.clear();
+    m_on_ground.clear();
+}
+
+
+// Get an entity's position.
+MyVec4 EntityPhysics::getEntityPos(int index) const
+{
+    return MyVec4(m_pos_x[index], m_pos_y[index], m_pos_z[index]);
+}
+
+
+// Get an entity's velocity, in cm/msec.
+MyVec4 EntityPhysics::getEntityVelocity(int index) const
+{
+    return MyVec4(m_vel_x[index], m_vel_y[index], m_vel_z[index]);
+}
+
+
+// Step everybody forward in time. We take a snapshot of the loaded chunks, then
+// hand out slices of entities to the world's worker pool. Every entity only ever writes to
+// its own slots in the arrays, so the workers never have to lock anything.
+// We wait for all of them before returning, which is what keeps the snapshot valid.
+void EntityPhysics::step(const GameWorld &world, int elapsed_msec)
+{
+    sf::Clock clock;
+
+    int entity_count = getEntityCount();
+    if (entity_count == 0) {
+        m_last_step_usecs = 0;
+        return;
+    }
+
+    ChunkSnapshot snapshot(world);
+
+    // Gravity, converted from m/sec2 to cm/msec2.
+    GLfloat gravity = GetConfig().logic.player_gravity;
+    GLfloat scaled_gravity = (gravity * BLOCK_SCALE) / (1000.0f * 1000.0f);
+    GLfloat elapsed_msec_f = static_cast<GLfloat>(elapsed_msec);
+
+    world.getWorkerPool().runSlices(entity_count, ENTITIES_PER_TASK,
+        [this, &snapshot, elapsed_msec_f, scaled_gravity](int first, int last) {
+            stepRange(snapshot, first, last, elapsed_msec_f, scaled_gravity);
+        });
+
+    m_last_step_usecs = static_cast<int>(clock.getElapsedTime().asMicroseconds());
+}
+
+
+// Step one slice of entities. This runs on a worker thread, so it
+// only reads from the snapshot, and only writes to its own slice.
+void EntityPhysics::stepRange(
+    const ChunkSnapshot &snapshot, int first, int last, GLfloat elapsed_msec, GLfloat gravity)
+{
+    for (int i = first; i < last; i++) {
+        m_vel_y[i] -= gravity * elapsed_msec;
+
+        MyVec4 motion(
+            m_vel_x[i] * elapsed_msec,
+            m_vel_y[i] * elapsed_msec,
+            m_vel_z[i] * elapsed_msec);
+
+        GLfloat half_width = m_half_width[i];
+        MyVec4 lower(m_pos_x[i] - half_width, m_pos_y[i],               m_pos_z[i] - half_width);
+        MyVec4 upper(m_pos_x[i] + half_width, m_pos_y[i] + m_height[i], m_pos_z[i] + half_width);
+        MyBoundingBox bbox(lower, upper);
+
+        SweepResult result;
+        SweepBoxThroughWorld(snapshot, bbox, motion, &result);
+
+        m_pos_x[i] += result.move.x();
+        m_pos_y[i] += result.move.y();
+        m_pos_z[i] += result.move.z();
+
+        // Whatever we ran into kills our motion in that direction.
+        // Anything sitting on the ground stops sliding, too. If a mob
+        // wants to walk around, it can set its velocity every tick.
+        if (result.hit_floor) {
+            m_vel_x[i] = 0.0f;
+            m_vel_y[i] = 0.0f;
+            m_vel_z[i] = 0.0f;
+        }
+        if (result.hit_ceiling) {
+            m_vel_y[i] = 0.0f;
+        }
+        if (result.hit_east || result.hit_west) {
+            m_vel_x[i] = 0.0f;
+        }
+        if (result.hit_north || result.hit_south) {
+            m_vel_z[i] = 0.0f;
+        }
+
+        m_on_ground[i] = result.hit_floor ? 1 : 0;
+    }
+}
+
+
+// A dirt-simple random number, from -1 to 1. Good enough for scattering boxes around.
+static GLfloat BenchmarkRandom(uint32_t *pSeed)
+{
+    *pSeed = (*pSeed * 1664525) + 1013904223;
+    GLfloat unit = static_cast<GLfloat>(*pSeed >> 8) / static_cast<GLfloat>(1 << 24);
+    return (unit * 2.0f) - 1.0f;
+}
+
+
+// Drop a whole bunch of boxes around a spot, to see how stepping holds up.
+// They start out scattered over a few chunks, up in the air, and tossed in
+// random directions. Use a fixed seed, so every run is the same workload.
+void SpawnPhysicsBenchmark(EntityPhysics *pOut, const MyVec4 &center, int count)
+{
+    const GLfloat SPREAD   = CHUNK_WIDTH * BLOCK_SCALE;
+    const GLfloat MAX_RISE = 20.0f * BLOCK_SCALE;
+    const GLfloat MAX_TOSS = 0.5f;
+    const GLfloat ENTITY_SIZE = 50.0f;
+
+    uint32_t seed = 12345;
+
+    for (int i = 0; i < count; i++) {
+        GLfloat x = SPREAD * BenchmarkRandom(&seed);
+        GLfloat y = MAX_RISE * ((BenchmarkRandom(&seed) + 1.0f) / 2.0f);
+        GLfloat z = SPREAD * BenchmarkRandom(&seed);
+        MyVec4 pos = center.plus(MyVec4(x, y, z));
+
+        GLfloat toss_x = MAX_TOSS * BenchmarkRandom(&seed);
+        GLfloat toss_z = MAX_TOSS * BenchmarkRandom(&seed);
+        MyVec4 velocity(toss_x, 0.0f, toss_z);
+
+        pOut->addEntity(pos, velocity, ENTITY_SIZE, ENTITY_SIZE);
+    }
+
+    PrintDebug(fmt::format("Spawned {} entities for the physics benchmark.\n", count));
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "stdafx.h"
+#include "my_math.h"
+
+class ChunkSnapshot;
+class GameWorld;
+
+
+// Gravity and collisions for everything that isn't the player. Mobs, dropped items,
+// projectiles, whatever. There could be thousands of these, so rather than an object
+// per entity, we keep each property in its own flat array, indexed by entity.
+// Stepping walks those arrays in slices, spread across the world's worker pool.
+// Like the player, an entity's position is the bottom-center of its bounding box.
+class EntityPhysics
+{
+public:
+    EntityPhysics();
+    ~EntityPhysics() {}
+
+    int  addEntity(const MyVec4 &pos, const MyVec4 &velocity, GLfloat width, GLfloat height);
+    void removeEntity(int index);
+    void clear();
+
+    void step(const GameWorld &world, int elapsed_msec);
+
+    // Getters.
+    int getEntityCount() const { return m_pos_x.size(); }
+
+    MyVec4 getEntityPos(int index) const;
+    MyVec4 getEntityVelocity(int index) const;
+    bool   isOnGround(int index) const { return m_on_ground[index] != 0; }
+
+    int getLastStepUsecs() const { return m_last_step_usecs; }
+
+private:
+    FORBID_COPYING(EntityPhysics)
+    FORBID_MOVING(EntityPhysics)
+
+    // Private methods.
+    void stepRange(const ChunkSnapshot &snapshot, int first, int last, GLfloat elapsed_msec, GLfloat gravity);
+
+    // Private data. Positions are in centimeters, velocities in cm/msec, just like the player.
+    static const int ENTITIES_PER_TASK = 512;
+
+    std::vector<GLfloat> m_pos_x;
+    std::vector<GLfloat> m_pos_y;
+    std::vector<GLfloat> m_pos_z;
+
+    std::vector<GLfloat> m_vel_x;
+    std::vector<GLfloat> m_vel_y;
+    std::vector<GLfloat> m_vel_z;
+
+    std::vector<GLfloat> m_half_width;
+    std::vector<GLfloat> m_height;
+
+    // Not a vector of bools, since those pack into bits,
+    // and two threads could end up writing the same byte.
+    std::vector<uint8_t> m_on_ground;
+
+    int m_last_step_usecs;
+};
+
+
+// Drop a whole bunch of boxes around a spot, to see how stepping holds up.
+void SpawnPhysicsBenchmark(EntityPhysics *pOut, const MyVec4 &center, int count);
@@ -0,0 +1,641 @@
+#include "stdafx.h"
+#include "far_terrain.h"
+#include "common_util.h"
+
+#include "chunk_blob.h"
+#include "chunk_source.h"
+#include "config.h"
+#include "format.h"
+#include "utils.h"
+
+#include "sqlite3.h"
+
+
+// How far down the skirts hang, in sample steps. The skirts hide the cracks
+// between tiles of different coarseness, so they need to be a little generous.
+static const int SKIRT_DEPTH_STEPS = 4;
+
+
+// Far tile ctor. The column tops start out empty.
+FarTile::FarTile(const GlobalPillar &origin, int step) :
+    m_origin(origin),
+    m_step(step),
+    m_samples_per_side((FAR_TILE_WIDTH / step) + 1),
+    m_highest(0)
+{
+    assert(step > 0);
+    assert((FAR_TILE_WIDTH % step) == 0);
+    m_tops.resize(m_samples_per_side * m_samples_per_side);
+}
+
+
+// Destructor.
+FarTile::~FarTile()
+{
+    freeMesh();
+}
+
+
+// Set the tops for one sample. Note the samples along the east and north
+// edges overlap with the next tile over, so the seams line up.
+void FarTile::setColumnTops(int sample_x, int sample_z, const ColumnTops &tops)
+{
+    assert((sample_x >= 0) && (sample_x < m_samples_per_side));
+    assert((sample_z >= 0) && (sample_z < m_samples_per_side));
+
+    m_tops[sample_x + (m_samples_per_side * sample_z)] = tops;
+
+    if (!tops.isEmpty() && (tops.getHighest() > m_highest)) {
+        m_highest = tops.getHighest();
+    }
+}
+
+
+// Get the tops for one sample.
+const ColumnTops &FarTile::getColumnTops(int sample_x, int sample_z) const
+{
+    assert((sample_x >= 0) && (sample_x < m_samples_per_side));
+    assert((sample_z >= 0) && (sample_z < m_samples_per_side));
+
+    return m_tops[sample_x + (m_samples_per_side * sample_z)];
+}
+
+
+// The height of the top of a sample, in world units.
+// We're on *top* of the highest block, hence the plus one.
+GLfloat FarTile::getSampleHeightCm(int sample_x, int sample_z) const
+{
+    const ColumnTops &tops = getColumnTops(sample_x, sample_z);
+    if (tops.isEmpty()) {
+        return 0.0f;
+    }
+
+    return GridToWorld(tops.getHighest() + 1);
+}
+
+
+// The world position of a sample.
+MyVec4 FarTile::getSamplePos(int sample_x, int sample_z) const
+{
+    GLfloat x = GridToWorld(m_origin.x() + (sample_x * m_step));
+    GLfloat y = getSampleHeightCm(sample_x, sample_z);
+    GLfloat z = GridToWorld(m_origin.z() + (sample_z * m_step));
+    return MyVec4(x, y, z);
+}
+
+
+// Calc a normal from the neighboring heights. At the edges of the tile,
+// just use the sample itself, which flattens things out slightly. Nobody will notice.
+MyVec4 FarTile::getSampleNormal(int sample_x, int sample_z) const
+{
+    int last = m_samples_per_side - 1;
+
+    int west_x  = (sample_x > 0)    ? sample_x - 1 : sample_x;
+    int east_x  = (sample_x < last) ? sample_x + 1 : sample_x;
+    int south_z = (sample_z > 0)    ? sample_z - 1 : sample_z;
+    int north_z = (sample_z < last) ? sample_z + 1 : sample_z;
+
+    GLfloat west  = getSampleHeightCm(west_x, sample_z);
+    GLfloat east  = getSampleHeightCm(east_x, sample_z);
+    GLfloat south = getSampleHeightCm(sample_x, south_z);
+    GLfloat north = getSampleHeightCm(sample_x, north_z);
+
+    GLfloat span = 2.0f * m_step * BLOCK_SCALE;
+    MyVec4 result(west - east, span, south - north);
+    return result.normalized();
+}
+
+
+// Texture coords just follow the world grid, so one texture repeat per block.
+MyVec2 FarTile::getSampleTexUV(int sample_x, int sample_z) const
+{
+    GLfloat u = static_cast<GLfloat>(sample_x * m_step);
+    GLfloat v = static_cast<GLfloat>(sample_z * m_step);
+    return MyVec2(u, v);
+}
+
+
+// Add one heightfield quad, if all four corners have something in them.
+// The winding matches the "top" face in "AddLandscapePatch_PNT".
+void FarTile::addTopQuad(int sample_x, int sample_z)
+{
+    int x0 = sample_x;
+    int x1 = sample_x + 1;
+    int z0 = sample_z;
+    int z1 = sample_z + 1;
+
+    const ColumnTops &tops_ll = getColumnTops(x0, z0);
+    if (tops_ll.isEmpty() ||
+        getColumnTops(x1, z0).isEmpty() ||
+        getColumnTops(x0, z1).isEmpty() ||
+        getColumnTops(x1, z1).isEmpty()) {
+        return;
+    }
+
+    Vertex_PNT vert_ll(getSamplePos(x0, z0), getSampleNormal(x0, z0), getSampleTexUV(x0, z0));
+    Vertex_PNT vert_lr(getSamplePos(x1, z0), getSampleNormal(x1, z0), getSampleTexUV(x1, z0));
+    Vertex_PNT vert_ul(getSamplePos(x0, z1), getSampleNormal(x0, z1), getSampleTexUV(x0, z1));
+    Vertex_PNT vert_ur(getSamplePos(x1, z1), getSampleNormal(x1, z1), getSampleTexUV(x1, z1));
+
+    std::array<Vertex_PNT, 6> triangles = {
+        vert_ll, vert_ur, vert_ul,
+        vert_ur, vert_ll, vert_lr,
+    };
+
+    VertList_PNT *list = tops_ll.isStoney() ? m_stone_list.get() : m_grass_list.get();
+    list->add(&triangles[0], 6);
+}
+
+
+// Hang a skirt down from every edge of the tile. A coarse tile next to
+// a fine one won't agree on the heights along the seam, and this hides the gap.
+void FarTile::addSkirts()
+{
+    int last = m_samples_per_side - 1;
+    GLfloat depth = SKIRT_DEPTH_STEPS * m_step * BLOCK_SCALE;
+    GLfloat width = static_cast<GLfloat>(m_step);
+
+    // Each skirt segment is described by its top-left and top-right samples,
+    // as seen from *outside* the tile, along with its outward normal.
+    struct Segment {
+        int left_x, left_z, right_x, right_z;
+        MyVec4 normal;
+    };
+
+    std::vector<Segment> segments;
+    segments.reserve(last * 4);
+
+    for (int i = 0; i < last; i++) {
+        segments.push_back({ i,        0,        i + 1,    0,        VEC4_SOUTHWARD });
+        segments.push_back({ i + 1,    last,     i,        last,     VEC4_NORTHWARD });
+        segments.push_back({ last,     i,        last,     i + 1,    VEC4_EASTWARD  });
+        segments.push_back({ 0,        i + 1,    0,        i,        VEC4_WESTWARD  });
+    }
+
+    for (const auto &seg : segments) {
+        const ColumnTops &left_tops  = getColumnTops(seg.left_x,  seg.left_z);
+        const ColumnTops &right_tops = getColumnTops(seg.right_x, seg.right_z);
+        if (left_tops.isEmpty() || right_tops.isEmpty()) {
+            continue;
+        }
+
+        MyVec4 upper_left  = getSamplePos(seg.left_x,  seg.left_z);
+        MyVec4 upper_right = getSamplePos(seg.right_x, seg.right_z);
+        MyVec4 lower_left (upper_left.x(),  upper_left.y()  - depth, upper_left.z());
+        MyVec4 lower_right(upper_right.x(), upper_right.y() - depth, upper_right.z());
+
+        std::array<Vertex_PNT, 6> triangles = {
+            Vertex_PNT(lower_left,  seg.normal, MyVec2(0.0f,  0.0f)),
+            Vertex_PNT(upper_right, seg.normal, MyVec2(width, width)),
+            Vertex_PNT(upper_left,  seg.normal, MyVec2(0.0f,  width)),
+            Vertex_PNT(upper_right, seg.normal, MyVec2(width, width)),
+            Vertex_PNT(lower_left,  seg.normal, MyVec2(0.0f,  0.0f)),
+            Vertex_PNT(lower_right, seg.normal, MyVec2(width, 0.0f)),
+        };
+
+        VertList_PNT *list = left_tops.isStoney() ? m_stone_list.get() : m_grass_list.get();
+        list->add(&triangles[0], 6);
+    }
+}
+
+
+// Rebuild the heightfield mesh. Main thread only, since this talks to OpenGL.
+void FarTile::rebuildMesh()
+{
+    if (m_grass_list == nullptr) {
+        m_grass_list = std::make_unique<VertList_PNT>();
+    }
+
+    if (m_stone_list == nullptr) {
+        m_stone_list = std::make_unique<VertList_PNT>();
+    }
+
+    m_grass_list->reset();
+    m_stone_list->reset();
+
+    // Most of the quads will be grass, so don't bother reserving much for the stone.
+    int quad_count = (m_samples_per_side - 1) * (m_samples_per_side - 1);
+    m_grass_list->reserve(quad_count * 6);
+
+    for     (int z = 0; z < m_samples_per_side - 1; z++) {
+        for (int x = 0; x < m_samples_per_side - 1; x++) {
+            addTopQuad(x, z);
+        }
+    }
+
+    addSkirts();
+
+    m_grass_list->update();
+    m_stone_list->update();
+}
+
+
+// Free up our OpenGL resources. Main thread only.
+void FarTile::freeMesh()
+{
+    m_grass_list = nullptr;
+    m_stone_list = nullptr;
+}
+
+
+// Same logic as for chunks. See if any corner of our bounds is above a plane.
+bool FarTile::isAbovePlane(const MyPlane &plane) const
+{
+    GLfloat west   = GridToWorld(m_origin.x());
+    GLfloat east   = GridToWorld(m_origin.x() + FAR_TILE_WIDTH);
+    GLfloat south  = GridToWorld(m_origin.z());
+    GLfloat north  = GridToWorld(m_origin.z() + FAR_TILE_WIDTH);
+    GLfloat top    = GridToWorld(m_highest + 1);
+    GLfloat bottom = GridToWorld(0);
+
+    MyVec4 corners[8] = {
+        MyVec4(west, top,    south), MyVec4(east, top,    south),
+        MyVec4(west, top,    north), MyVec4(east, top,    north),
+        MyVec4(west, bottom, south), MyVec4(east, bottom, south),
+        MyVec4(west, bottom, north), MyVec4(east, bottom, north),
+    };
+
+    for (const auto &corner : corners) {
+        if (plane.distanceToPoint(corner) >= EPSILON) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+// Load the column tops for a far tile from our SQLite file.
+// We only ask for every Nth column, and only the "tops", which is the whole point.
+std::unique_ptr<FarTile> LoadFarTile(const std::string &db_fname, const GlobalPillar &origin, int step)
+{
+    std::unique_ptr<FarTile> tile = std::make_unique<FarTile>(origin, step);
+
+    sqlite3 *db = SQL_open(db_fname);
+    if (db == nullptr) {
+        PrintDebug(fmt::format("Could not open DB '{}'", db_fname));
+        return nullptr;
+    }
+
+    // Note the "less than or equal" on the east and north edges. We want the overlap.
+    std::string buffer = fmt::format(
+        "SELECT x, y, z, block_type FROM blocks "
+        "WHERE x >= {0} AND x <= {1} "
+        "AND   z >= {2} AND z <= {3} "
+        "AND   ((x - {0}) % {4}) = 0 "
+        "AND   ((z - {2}) % {4}) = 0 "
+        "AND   block_type IN ('dirt_top', 'stone_top')",
+        origin.x(), origin.x() + FAR_TILE_WIDTH,
+        origin.z(), origin.z() + FAR_TILE_WIDTH,
+        step);
+    sqlite3_stmt *stmt = SQL_prepare(db, buffer.c_str());
+    if (stmt == nullptr) {
+        SQL_close(db);
+        assert(false);
+        return nullptr;
+    }
+
+    int ret_code = sqlite3_step(stmt);
+    while (ret_code == SQLITE_ROW) {
+        int x = sqlite3_column_int(stmt, 0);
+        int y = sqlite3_column_int(stmt, 1);
+        int z = sqlite3_column_int(stmt, 2);
+
+        const unsigned char *raw_text = sqlite3_column_text(stmt, 3);
+        const char *clean = reinterpret_cast<const char*>(raw_text);
+        std::string text(clean);
+
+        int sample_x = (x - origin.x()) / step;
+        int sample_z = (z - origin.z()) / step;
+
+        // Negative heights mean "nothing here", which is what we started with.
+        if ((y >= 0) && (y < ColumnTops::NONE)) {
+            ColumnTops tops = tile->getColumnTops(sample_x, sample_z);
+            if (text == "dirt_top") {
+                tops.dirt_top = static_cast<unsigned char>(y);
+            }
+            else if (text == "stone_top") {
+                tops.stone_top = static_cast<unsigned char>(y);
+            }
+
+            tile->setColumnTops(sample_x, sample_z, tops);
+        }
+
+        ret_code = sqlite3_step(stmt);
+    }
+
+    SQL_finalize(db, stmt);
+    SQL_close(db);
+
+    return tile;
+}
+
+
+// Same again, for a world file with chunk blobs. The tile covers a few chunks, plus
+// the overlap on the east and north edges, which spills into the next ones over.
+// The columns in a blob have to be walked in order, but skipping them is cheap.
+std::unique_ptr<FarTile> LoadFarTileFromBlobs(const std::string &db_fname, const GlobalPillar &origin, int step)
+{
+    std::unique_ptr<FarTile> tile = std::make_unique<FarTile>(origin, step);
+
+    sqlite3 *db = SQL_open(db_fname);
+    if (db == nullptr) {
+        PrintDebug(fmt::format("Could not open DB '{}'", db_fname));
+        return nullptr;
+    }
+
+    std::string buffer = fmt::format(
+        "SELECT x, z, data FROM chunks "
+        "WHERE x >= {0} AND x <= {1} "
+        "AND   z >= {2} AND z <= {3}",
+        origin.x(), origin.x() + FAR_TILE_WIDTH,
+        origin.z(), origin.z() + FAR_TILE_WIDTH);
+    sqlite3_stmt *stmt = SQL_prepare(db, buffer.c_str());
+    if (stmt == nullptr) {
+        assert(false);
+        return nullptr;
+    }
+
+    ColumnRuns column;
+
+    int ret_code = sqlite3_step(stmt);
+    while (ret_code == SQLITE_ROW) {
+        int chunk_x = sqlite3_column_int(stmt, 0);
+        int chunk_z = sqlite3_column_int(stmt, 1);
+        const void *data = sqlite3_column_blob(stmt, 2);
+        int size = sqlite3_column_bytes(stmt, 2);
+
+        ChunkBlobReader reader(static_cast<const unsigned char *>(data), size);
+
+        for     (int local_x = 0; local_x < CHUNK_WIDTH; local_x++) {
+            for (int local_z = 0; local_z < CHUNK_WIDTH; local_z++) {
+                int offset_x = chunk_x + local_x - origin.x();
+                int offset_z = chunk_z + local_z - origin.z();
+
+                bool wanted = (
+                    (offset_x >= 0) && (offset_x <= FAR_TILE_WIDTH) && ((offset_x % step) == 0) &&
+                    (offset_z >= 0) && (offset_z <= FAR_TILE_WIDTH) && ((offset_z % step) == 0));
+
+                if (!wanted) {
+                    reader.skipColumn();
+                    continue;
+                }
+
+                if (!reader.readColumn(&column)) {
+                    break;
+                }
+
+                int dirt_top, stone_top;
+                CalcColumnTops(column, &dirt_top, &stone_top);
+
+                ColumnTops tops;
+                if ((dirt_top >= 0) && (dirt_top < ColumnTops::NONE)) {
+                    tops.dirt_top = static_cast<unsigned char>(dirt_top);
+                }
+                if ((stone_top >= 0) && (stone_top < ColumnTops::NONE)) {
+                    tops.stone_top = static_cast<unsigned char>(stone_top);
+                }
+
+                tile->setColumnTops(offset_x / step, offset_z / step, tops);
+            }
+        }
+
+        if (!reader.isValid()) {
+            PrintDebug(fmt::format("Bad blob for chunk at {0}, {1}.\n", chunk_x, chunk_z));
+        }
+
+        ret_code = sqlite3_step(stmt);
+    }
+
+    SQL_finalize(db, stmt);
+    SQL_close(db);
+
+    return tile;
+}
+
+
+// Which far tile does a world position fall into.
+GlobalPillar WorldPosToFarTileOrigin(const MyVec4 &pos)
+{
+    GlobalGrid coord = WorldPosToGlobalGrid(pos, NudgeType::NONE);
+    int x = RoundDownInt(coord.x(), FAR_TILE_WIDTH);
+    int z = RoundDownInt(coord.z(), FAR_TILE_WIDTH);
+    return GlobalPillar(x, z);
+}
+
+
+// Every time the distance doubles, so does the spacing between samples.
+int CalcFarTileStep(int ring)
+{
+    if      (ring <= 1) { return 1; }
+    else if (ring <= 3) { return 2; }
+    else if (ring <= 7) { return 4; }
+    else                { return 8; }
+}
+
+
+// Far terrain ctor. Nothing gets loaded until the first game tick.
+FarTerrain::FarTerrain(const ChunkSource &chunk_source) :
+    m_chunk_source(chunk_source),
+    m_planned(false)
+{
+}
+
+
+// Destructor. Any futures still out there will block until they're done.
+FarTerrain::~FarTerrain()
+{
+    m_tile_map.clear();
+    m_loader_map.clear();
+}
+
+
+// Handle a game tick. If we've moved to a new tile, figure out what we want
+// all over again. Either way, cash in anything that arrived, and keep the queue full.
+void FarTerrain::onGameTick(const MyVec4 &camera_pos)
+{
+    GlobalPillar center = WorldPosToFarTileOrigin(camera_pos);
+
+    bool moved = (
+        (center.x() != m_center_tile.x()) ||
+        (center.z() != m_center_tile.z()));
+
+    if (!m_planned || moved) {
+        m_center_tile = center;
+        replan(camera_pos);
+        m_planned = true;
+    }
+
+    cashInArrivals();
+    launchLoads();
+}
+
+
+// Figure out which tiles we want, and how coarse each one should be.
+// Skip any tile that's entirely inside the eval region's fade, since the
+// real chunks cover that. Anything we no longer want gets dropped on the spot.
+void FarTerrain::replan(const MyVec4 &camera_pos)
+{
+    GLfloat far_distance_cm  = GetConfig().render.far_terrain.getDistanceCm();
+    GLfloat fade_distance_cm = GetConfig().render.getFadeDistanceCm();
+    GLfloat near_distance_cm = GetConfig().logic.getDrawDistanceCm() - fade_distance_cm;
+
+    GLfloat tile_cm = GridToWorld(FAR_TILE_WIDTH);
+    int radius = static_cast<int>(ceil(far_distance_cm / tile_cm));
+
+    m_wanted_map.clear();
+
+    for     (int dx = -radius; dx <= radius; dx++) {
+        for (int dz = -radius; dz <= radius; dz++) {
+            int x = m_center_tile.x() + (dx * FAR_TILE_WIDTH);
+            int z = m_center_tile.z() + (dz * FAR_TILE_WIDTH);
+
+            // Find the corner furthest from the camera.
+            GLfloat west  = GridToWorld(x);
+            GLfloat east  = GridToWorld(x + FAR_TILE_WIDTH);
+            GLfloat south = GridToWorld(z);
+            GLfloat north = GridToWorld(z + FAR_TILE_WIDTH);
+
+            GLfloat far_x = max(abs(camera_pos.x() - west),  abs(camera_pos.x() - east));
+            GLfloat far_z = max(abs(camera_pos.z() - south), abs(camera_pos.z() - north));
+            GLfloat furthest = sqrt((far_x * far_x) + (far_z * far_z));
+
+            if (furthest < near_distance_cm) {
+                continue;
+            }
+
+            int ring = max(abs(dx), abs(dz));
+            m_wanted_map[GlobalPillar(x, z)] = CalcFarTileStep(ring);
+        }
+    }
+
+    // Drop anything we don't want anymore. If we want it at a different
+    // coarseness, hang on to it until the replacement shows up, so there's no hole.
+    auto iter = m_tile_map.begin();
+    while (iter != m_tile_map.end()) {
+        if (!IS_KEY_IN_MAP(m_wanted_map, iter->first)) {
+            iter = m_tile_map.erase(iter);
+        }
+        else {
+            ++iter;
+        }
+    }
+}
+
+
+// Cash in a couple of finished loads. Building the mesh isn't free,
+// so don't do too many in one tick, or we'll get a hitch.
+void FarTerrain::cashInArrivals()
+{
+    std::vector<GlobalPillar> arrived;
+
+    for (const auto &iter : m_loader_map) {
+        if (IsFutureReady(iter.second)) {
+            arrived.emplace_back(iter.first);
+            if (static_cast<int>(arrived.size()) >= MAX_ARRIVALS_PER_TICK) {
+                break;
+            }
+        }
+    }
+
+    for (const auto &origin : arrived) {
+        auto arrival = m_loader_map.find(origin);
+        std::unique_ptr<FarTile> tile = arrival->second.get();
+        m_loader_map.erase(arrival);
+
+        // If the load failed, stop asking for it until the next re-plan.
+        if (tile == nullptr) {
+            m_wanted_map.erase(origin);
+            continue;
+        }
+
+        // Only keep it if it's still what we want.
+        const auto &wanted = m_wanted_map.find(origin);
+        if ((wanted == m_wanted_map.end()) || (wanted->second != tile->getStep())) {
+            continue;
+        }
+
+        tile->rebuildMesh();
+        m_tile_map[origin] = std::move(tile);
+    }
+}
+
+
+// Fire off loads for any tile we want but don't have, nearest first,
+// without ever having more than a handful in flight.
+void FarTerrain::launchLoads()
+{
+    int room = MAX_PENDING_LOADS - static_cast<int>(m_loader_map.size());
+    if (room <= 0) {
+        return;
+    }
+
+    std::vector<std::pair<int, GlobalPillar>> candidates;
+
+    for (const auto &iter : m_wanted_map) {
+        const GlobalPillar &origin = iter.first;
+        int step = iter.second;
+
+        if (IS_KEY_IN_MAP(m_loader_map, origin)) {
+            continue;
+        }
+
+        const auto &have = m_tile_map.find(origin);
+        if ((have != m_tile_map.end()) && (have->second->getStep() == step)) {
+            continue;
+        }
+
+        int ring = max(
+            abs(origin.x() - m_center_tile.x()),
+            abs(origin.z() - m_center_tile.z())) / FAR_TILE_WIDTH;
+        candidates.emplace_back(ring, origin);
+    }
+
+    std::sort(candidates.begin(), candidates.end(),
+        [](const std::pair<int, GlobalPillar> &one, const std::pair<int, GlobalPillar> &two) {
+            return one.first < two.first;
+        });
+
+    for (const auto &candidate : candidates) {
+        if (room <= 0) {
+            break;
+        }
+
+        const GlobalPillar &origin = candidate.second;
+        int step = m_wanted_map[origin];
+
+        auto loader_future = std::async(
+            std::launch::async, &ChunkSource::loadFarTile, &m_chunk_source, origin, step);
+        m_loader_map[origin] = std::move(loader_future);
+        room--;
+    }
+}
+
+
+// Get the list of far tiles that fall between our left and right clip planes.
+std::vector<const FarTile *> FarTerrain::getTilesToRender(
+    const MyPlane &left_plane, const MyPlane &right_plane) const
+{
+    std::vector<const FarTile *> results;
+
+    for (const auto &iter : m_tile_map) {
+        const FarTile *tile = iter.second.get();
+        if (tile->isAbovePlane(left_plane) && tile->isAbovePlane(right_plane)) {
+            results.emplace_back(tile);
+        }
+    }
+
+    return std::move(results);
+}
+
+
+// How much memory the column tops are taking up. Just the tops, not the meshes.
+int FarTerrain::getMemoryBytes() const
+{
+    int result = 0;
+    for (const auto &iter : m_tile_map) {
+        result += iter.second->getMemoryBytes();
+    }
+
+    return result;
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "draw_state_pnt.h"
+#include "my_math.h"
+#include "utils.h"
+
+class ChunkSource;
+
+
+// Far terrain is everything beyond the eval region. We never build full
+// chunks out there, just the dirt and stone tops for each column, drawn
+// as a heightfield. Think of it as a painted backdrop that happens to line up.
+
+
+// Far tiles are this many columns on a side. Four chunks' worth.
+const int FAR_TILE_WIDTH = CHUNK_WIDTH * 4;
+
+
+// The column tops for one column. Two bytes, and that's all we keep.
+// Heights are block indexes, so 255 is free to mean "nothing here".
+struct ColumnTops
+{
+    static const unsigned char NONE = 255;
+
+    ColumnTops() :
+        dirt_top(NONE),
+        stone_top(NONE) {}
+
+    DEFAULT_COPYING(ColumnTops)
+    DEFAULT_MOVING(ColumnTops)
+
+    bool isEmpty()  const { return (dirt_top == NONE) && (stone_top == NONE); }
+    bool isStoney() const { return (stone_top != NONE) && ((dirt_top == NONE) || (stone_top > dirt_top)); }
+
+    // The highest block in the column, whichever kind it is.
+    int getHighest() const {
+        if (dirt_top  == NONE) { return stone_top; }
+        if (stone_top == NONE) { return dirt_top; }
+        return (dirt_top > stone_top) ? dirt_top : stone_top;
+    }
+
+    unsigned char dirt_top;
+    unsigned char stone_top;
+};
+
+static_assert(sizeof(ColumnTops) == 2, "ColumnTops should be 2 bytes.");
+
+
+// One tile of far terrain. Tiles further away sample every Nth column,
+// which is what makes this a clipmap rather than just a really big mesh.
+// Loading the column tops is fine in a sub-thread, but the mesh is OpenGL
+// stuff, so "rebuildMesh" and "freeMesh" must only be called from the main thread.
+class FarTile
+{
+public:
+    FarTile(const GlobalPillar &origin, int step);
+    ~FarTile();
+
+    const GlobalPillar &getOrigin() const { return m_origin; }
+    int getStep() const { return m_step; }
+    int getSamplesPerSide() const { return m_samples_per_side; }
+    int getMemoryBytes() const { return m_tops.size() * sizeof(ColumnTops); }
+
+    void setColumnTops(int sample_x, int sample_z, const ColumnTops &tops);
+    const ColumnTops &getColumnTops(int sample_x, int sample_z) const;
+
+    void rebuildMesh();
+    void freeMesh();
+
+    bool isAbovePlane(const MyPlane &plane) const;
+
+    const VertList_PNT *getGrassList() const { return m_grass_list.get(); }
+    const VertList_PNT *getStoneList() const { return m_stone_list.get(); }
+
+private:
+    FORBID_DEFAULT_CTOR(FarTile)
+    FORBID_COPYING(FarTile)
+    FORBID_MOVING(FarTile)
+
+    // Private methods.
+    GLfloat getSampleHeightCm(int sample_x, int sample_z) const;
+    MyVec4  getSamplePos(int sample_x, int sample_z) const;
+    MyVec4  getSampleNormal(int sample_x, int sample_z) const;
+    MyVec2  getSampleTexUV(int sample_x, int sample_z) const;
+
+    void addTopQuad(int sample_x, int sample_z);
+    void addSkirts();
+
+    // Private data.
+    GlobalPillar m_origin;
+    int m_step;
+    int m_samples_per_side;
+    int m_highest;
+
+    std::vector<ColumnTops> m_tops;
+
+    std::unique_ptr<VertList_PNT> m_grass_list;
+    std::unique_ptr<VertList_PNT> m_stone_list;
+};
+
+
+// We'll be using threads to load far tiles, same as chunks.
+typedef std::future<std::unique_ptr<FarTile>> FarTileFuture;
+
+
+// Load the column tops for a far tile. Safe to call from a sub-thread.
+std::unique_ptr<FarTile> LoadFarTile(const std::string &db_fname, const GlobalPillar &origin, int step);
+std::unique_ptr<FarTile> LoadFarTileFromBlobs(const std::string &db_fname, const GlobalPillar &origin, int step);
+
+
+// All the far tiles around the player. This decides which tiles we want,
+// at what level of detail, and streams them in a few at a time.
+class FarTerrain
+{
+public:
+    FarTerrain(const ChunkSource &chunk_source);
+    ~FarTerrain();
+
+    void onGameTick(const MyVec4 &camera_pos);
+
+    std::vector<const FarTile *> getTilesToRender(const MyPlane &left_plane, const MyPlane &right_plane) const;
+
+    int getTileCount()    const { return m_tile_map.size(); }
+    int getPendingCount() const { return m_loader_map.size(); }
+    int getMemoryBytes()  const;
+
+private:
+    FORBID_DEFAULT_CTOR(FarTerrain)
+    FORBID_COPYING(FarTerrain)
+    FORBID_MOVING(FarTerrain)
+
+    // Private methods.
+    void replan(const MyVec4 &camera_pos);
+    void cashInArrivals();
+    void launchLoads();
+
+    // Private data.
+    static const int MAX_PENDING_LOADS = 8;
+    static const int MAX_ARRIVALS_PER_TICK = 2;
+
+    const ChunkSource &m_chunk_source;
+
+    bool m_planned;
+    GlobalPillar m_center_tile;
+
+    std::map<GlobalPillar, int> m_wanted_map;
+    std::map<GlobalPillar, std::unique_ptr<FarTile>> m_tile_map;
+    std::map<GlobalPillar, FarTileFuture> m_loader_map;
+};
+
+
+// Which tile does a world position fall into.
+GlobalPillar WorldPosToFarTileOrigin(const MyVec4 &pos);
+
+// How coarse should a tile be, given how many tiles away it is.
+int CalcFarTileStep(int ring);
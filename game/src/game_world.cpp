@@ -10,6 +10,7 @@
 #include "draw_state_pct.h"
 #include "draw_state_pt.h"
 #include "hit_test_result.h"
+#include "landscape.h"
 #include "physics.h"
 #include "player.h"
 #include "my_math.h"
@@ -19,12 +20,13 @@
 
 
 // Our game world.
-GameWorld::GameWorld(const std::string &db_fname) :
-    m_db_fname(db_fname),
+GameWorld::GameWorld(std::unique_ptr<ChunkSource> chunk_source) :
+    m_chunk_source(std::move(chunk_source)),
     m_paused(false),
     m_game_time_msecs(0),
     m_time_since_worker_msecs(0),
-    m_player(std::make_unique<Player>(*this))
+    m_player(std::make_unique<Player>(*this)),
+    m_hit_test_vert_list(UploadType::STREAMING)
 {
     setPlayerAtStart();
 
@@ -41,7 +43,8 @@ GameWorld::GameWorld(const std::string &db_fname) :
     int count = 0;
 
     for (const auto &origin : bigger_region.getEntirety()) {
-        auto loader_future = std::async(std::launch::async, LoadChunk, m_db_fname, this, origin);
+        auto loader_future = std::async(
+            std::launch::async, &ChunkSource::loadChunk, m_chunk_source.get(), this, origin);
         future_vec.push_back(std::move(loader_future));
         count++;
     }
@@ -58,6 +61,11 @@ GameWorld::GameWorld(const std::string &db_fname) :
 
     PrintDebug("Threads are completed.\n");
 
+    // The far terrain streams itself in, starting with the first game tick.
+    if (GetConfig().render.far_terrain.enabled) {
+        m_far_terrain = std::make_unique<FarTerrain>(*m_chunk_source);
+    }
+
     // Now that all the chunks are loaded, finish up any last calculations.
     for (auto &iter : m_chunk_map) {
         Chunk *chunk = iter.second.get();
@@ -66,6 +74,16 @@ GameWorld::GameWorld(const std::string &db_fname) :
         chunk->rebuildExposedBlockSet(&totals);
         chunk->rebuildLandscape();
     }
+
+    // If we're benchmarking meshing, now's the time, with everything loaded.
+    if (GetConfig().debug.meshing_benchmark) {
+        RunMeshingBenchmark(*this);
+    }
+
+    // If we're benchmarking physics, rain down a bunch of entities around the player.
+    if (GetConfig().debug.physics_benchmark) {
+        SpawnPhysicsBenchmark(&m_entity_physics, m_player->getPlayerPos(), PHYSICS_BENCHMARK_COUNT);
+    }
 }
 
 
@@ -84,7 +102,7 @@ GameWorld::~GameWorld()
 // and one quarter of the way up.
 void GameWorld::setPlayerAtStart()
 {
-    MyVec4 start = GetPlayerStartPos(m_db_fname);
+    MyVec4 start = m_chunk_source->getPlayerStartPos();
     m_player->setPlayerPos(start);
     m_player->setCameraPitch(0.0f);
     m_player->setCameraYaw(0.0f);
@@ -97,17 +115,35 @@ void GameWorld::setPlayerAtStart()
 // It's possible that this hasn't been loaded yet.
 const Chunk *GameWorld::getChunk(const ChunkOrigin &origin) const
 {
-    if (!IS_KEY_IN_MAP(m_chunk_map, origin)) {
+    const auto &iter = m_chunk_map.find(origin);
+    if (iter == m_chunk_map.end()) {
         return nullptr;
     }
 
-    const auto &iter = m_chunk_map.find(origin);
     const Chunk *pResult = iter->second.get();
     assert(pResult != nullptr);
     return pResult;
 }
 
 
+// Is there anything solid inside a box? Only blocks the box actually
+// overlaps count, so a box sitting right on the floor says no.
+bool GameWorld::anySolidBlockInBox(const MyBoundingBox &bbox) const
+{
+    GlobalGrid lower(
+        static_cast<int>(floor(bbox.minX() / BLOCK_SCALE)),
+        static_cast<int>(floor(bbox.minY() / BLOCK_SCALE)),
+        static_cast<int>(floor(bbox.minZ() / BLOCK_SCALE)));
+
+    GlobalGrid upper(
+        static_cast<int>(ceil(bbox.maxX() / BLOCK_SCALE)) - 1,
+        static_cast<int>(ceil(bbox.maxY() / BLOCK_SCALE)) - 1,
+        static_cast<int>(ceil(bbox.maxZ() / BLOCK_SCALE)) - 1);
+
+    return AnySolidBlockInRange(*this, lower, upper);
+}
+
+
 // Get a list of the origins of all the currently loaded chunks.
 // TODO: Why does "emplace_back" cause a compiler error here? More C++ deep voodoo.
 std::vector<ChunkOrigin> GameWorld::getLoadedChunkOrigins() const
@@ -137,6 +173,7 @@ void GameWorld::onGameTick(int elapsed_msec, const EventStateMsg &msg)
     // Update everything in the world.
     m_player->onGameTick(elapsed_msec, msg);
     PlayerCollisionTest(*m_player, elapsed_msec);
+    m_entity_physics.step(*this, elapsed_msec);
 
     // Since the player moved, see if we need to recalc any of the world.
     MyVec4      camera_pos   = m_player->getCameraPos();
@@ -157,6 +194,11 @@ void GameWorld::onGameTick(int elapsed_msec, const EventStateMsg &msg)
         m_time_since_worker_msecs = 0;
     }
 
+    // The far terrain keeps its own pace. It only loads column tops, so it's cheap.
+    if (m_far_terrain != nullptr) {
+        m_far_terrain->onGameTick(camera_pos);
+    }
+
     // Recalc our hit test, and we're done.
     calcHitTest();
     m_game_time_msecs += elapsed_msec;
@@ -199,7 +241,8 @@ void GameWorld::loadWorldAsNeeded()
         if (!already_loaded) {
             bool already_queued = IS_KEY_IN_MAP(m_chunk_loader_map, origin);
             if (!already_queued) {
-                auto &loader_future = std::async(std::launch::async, LoadChunk, m_db_fname, this, origin);
+                auto &loader_future = std::async(
+                    std::launch::async, &ChunkSource::loadChunk, m_chunk_source.get(), this, origin);
                 m_chunk_loader_map[origin] = std::move(loader_future);
             }
         }
@@ -217,13 +260,11 @@ void GameWorld::loadWorldAsNeeded()
             Chunk &chunk = *iter.second;
             int last_touched = m_game_time_msecs - chunk.getLastTouchedMsecs();
             if (last_touched > EXPIRATION_TIME_MSECS) {
-                chunk.landscape.freeSurfaceLists();
-
                 // BIG TODO: Add logic to save the chunk here.
 
-                // We can't delete keys as we walk the map.
-                // Instead, set a null, and wait for the next block.
-                m_chunk_map[origin] = nullptr;
+                // We can't delete keys as we walk the map. Instead, hand
+                // the chunk back to the pool, and wait for the next block.
+                m_chunk_pool.release(std::move(iter.second));
             }
         }
     }
@@ -243,41 +284,19 @@ void GameWorld::loadWorldAsNeeded()
 }
 
 
-// Calc our hit test, only in the eval region.
+// Calc our hit test. We walk the block grid out from the camera, so this
+// only costs as much as the hit test distance, not the size of the eval region.
 void GameWorld::calcHitTest()
 {
-    bool success = false;
-
-    MyRay  camera_ray = m_player->getCameraRay();
-    MyVec4 camera_pos = m_player->getCameraPos();
+    MyRay camera_ray = m_player->getCameraRay();
+    GLfloat hit_test_distance = GetConfig().logic.getHitTestDistanceCm();
 
-    GLfloat best_distance = FLT_MAX;
-    Chunk *best_chunk = nullptr;
     HitTestResult best_detail;
+    bool success = DoWorldHitTest(*this, camera_ray, hit_test_distance, &best_detail);
 
-    GLfloat hit_test_distance = GetConfig().logic.getHitTestDistanceCm();
-    int block_count = static_cast<int>((hit_test_distance / 100.0f) / CHUNK_WIDTH);
-    EvalRegion region = WorldPosToEvalRegion(camera_pos, block_count);
-
-    for     (int x = region.west();  x <= region.east();  x += CHUNK_WIDTH) {
-        for (int z = region.south(); z <= region.north(); z += CHUNK_WIDTH) {
-            ChunkOrigin origin(x, z);
-            Chunk *chunk = m_chunk_map[origin].get();
-
-            HitTestResult detail;
-            bool this_test = DoChunkHitTest(*chunk, camera_ray, &detail);
-            if (this_test && (detail.getDist() < best_distance)) {
-                success       = true;
-                best_distance = detail.getDist();
-                best_chunk    = chunk;
-                best_detail   = std::move(detail);
-            }
-        }
-    }
-
-    // If we weren't close enough, then never mind.
-    if (best_distance > hit_test_distance) {
-        success = false;
+    const Chunk *best_chunk = nullptr;
+    if (success) {
+        best_chunk = getChunk(best_detail.getChunkOrigin());
     }
 
     // Once we're done, *then* rebuild the quad list.
@@ -300,26 +319,146 @@ void GameWorld::calcHitTest()
 }
 
 
-// DEBUG: Obviously we want more graceful logic here!
-// Recalculating just 9 stripes vs all of them. But hey, it's a start.
+// Delete whatever block we're looking at.
 void GameWorld::deleteBlockInFrontOfUs()
 {
     if (m_hit_test_success) {
-        const auto &origin       = m_hit_test_result.getChunkOrigin();
-        const auto &global_coord = m_hit_test_result.getGlobalCoord();
-        const auto &local_coord  = GlobalGridToLocal(global_coord, origin);
+        setBlock(m_hit_test_result.getGlobalCoord(), BlockType::AIR);
+    }
+}
 
-        const auto &iter = m_chunk_map.find(origin);
-        Chunk *chunk = iter->second.get();
 
-        assert(chunk != nullptr);
-        assert(chunk->IsGlobalGridWithin(global_coord));
+// Change one block, and patch up the landscape around it.
+// Return false if the block isn't loaded.
+bool GameWorld::setBlock(const GlobalGrid &coord, BlockType block_type)
+{
+    if (!coord.isWithinWorld() || (getChunk(GlobalGridToChunkOrigin(coord)) == nullptr)) {
+        return false;
+    }
 
-        chunk->setBlockType(local_coord, BlockType::AIR);
+    WorldEditBatch batch;
+    batch.setBlock(coord, block_type);
+    applyEditBatch(batch);
+    return true;
+}
 
-        SurfaceTotals totals;
-        chunk->rebuildExposedBlockSet(&totals);
-        chunk->rebuildLandscape();
+
+// Apply a whole batch of edits. First, every edit goes straight into block storage,
+// in one pass. Then each edited block and its six neighbors get their exposures
+// recalculated, exactly once each, no matter how many edits touched them. Neighbors
+// can be over in the next chunk. Only sections whose surfaces actually changed get
+// remeshed, and each of those only once. Building the verts happens on the worker pool,
+// and then we hand them to OpenGL back here. Edits to chunks that aren't loaded get dropped.
+void GameWorld::applyEditBatch(const WorldEditBatch &batch)
+{
+    typedef std::bitset<CHUNK_WIDTH * CHUNK_HEIGHT * CHUNK_WIDTH> BlockBits;
+    typedef std::bitset<LANDSCAPE_SECTION_COUNT> SectionBits;
+
+    // Which blocks need new exposures, per chunk.
+    std::map<Chunk *, std::unique_ptr<BlockBits>> touched_map;
+
+    // Remember whichever chunk we looked at last. Edits tend to come in runs.
+    Chunk *last_chunk = nullptr;
+    ChunkOrigin last_origin;
+
+    auto find_chunk = [this, &last_chunk, &last_origin](const GlobalGrid &grid) -> Chunk * {
+        ChunkOrigin origin = GlobalGridToChunkOrigin(grid);
+        if ((last_chunk == nullptr) || (origin != last_origin)) {
+            const auto &iter = m_chunk_map.find(origin);
+            if (iter == m_chunk_map.end()) {
+                return nullptr;
+            }
+            last_chunk  = iter->second.get();
+            last_origin = origin;
+        }
+        return last_chunk;
+    };
+
+    auto touch = [&touched_map, &find_chunk](const GlobalGrid &grid) {
+        if (!grid.isWithinWorld()) {
+            return;
+        }
+
+        Chunk *chunk = find_chunk(grid);
+        if (chunk == nullptr) {
+            return;
+        }
+
+        std::unique_ptr<BlockBits> &bits = touched_map[chunk];
+        if (bits == nullptr) {
+            bits = std::make_unique<BlockBits>();
+        }
+
+        LocalGrid local = GlobalGridToLocal(grid, chunk->getOrigin());
+        bits->set((((local.y() * CHUNK_WIDTH) + local.z()) * CHUNK_WIDTH) + local.x());
+    };
+
+    // Pass one: change the blocks, and note everything whose exposures might have changed.
+    for (const BlockEdit &edit : batch.getEdits()) {
+        const GlobalGrid &coord = edit.coord;
+
+        Chunk *chunk = find_chunk(coord);
+        if (chunk == nullptr) {
+            continue;
+        }
+
+        chunk->setBlockType(GlobalGridToLocal(coord, chunk->getOrigin()), edit.block_type);
+
+        touch(coord);
+        touch(GlobalGrid(coord.x() - 1, coord.y(), coord.z()));
+        touch(GlobalGrid(coord.x() + 1, coord.y(), coord.z()));
+        touch(GlobalGrid(coord.x(), coord.y() - 1, coord.z()));
+        touch(GlobalGrid(coord.x(), coord.y() + 1, coord.z()));
+        touch(GlobalGrid(coord.x(), coord.y(), coord.z() - 1));
+        touch(GlobalGrid(coord.x(), coord.y(), coord.z() + 1));
+    }
+
+    // Pass two: recalc those exposures, and note which sections changed.
+    std::vector<std::pair<Chunk *, int>> dirty_sections;
+
+    for (const auto &iter : touched_map) {
+        Chunk *chunk = iter.first;
+        const BlockBits &bits = *iter.second;
+        SectionBits dirty;
+
+        int index = 0;
+        for         (int y = 0; y < CHUNK_HEIGHT; y++) {
+            for     (int z = 0; z < CHUNK_WIDTH;  z++) {
+                for (int x = 0; x < CHUNK_WIDTH;  x++, index++) {
+                    if (bits.test(index) && chunk->recalcExposuresForBlock(LocalGrid(x, y, z))) {
+                        dirty.set(LocalYToSection(y));
+                    }
+                }
+            }
+        }
+
+        for (int section = 0; section < LANDSCAPE_SECTION_COUNT; section++) {
+            if (dirty.test(section)) {
+                dirty_sections.emplace_back(chunk, section);
+            }
+        }
+    }
+
+    // Pass three: remesh. One section's not worth a thread.
+    if (dirty_sections.size() == 1) {
+        dirty_sections[0].first->landscape.rebuildSection(dirty_sections[0].second);
+        return;
+    }
+
+    // Each section gets its own slice, and its own slot to put its verts in.
+    int section_count = static_cast<int>(dirty_sections.size());
+    std::vector<std::unique_ptr<SectionVerts>> section_verts(section_count);
+
+    m_worker_pool.runSlices(section_count, 1, [&dirty_sections, &section_verts](int first, int last) {
+        for (int i = first; i < last; i++) {
+            // These get handed back to us, so they can't live in the worker's scratch arena.
+            section_verts[i] = std::make_unique<SectionVerts>(nullptr);
+            dirty_sections[i].first->landscape.buildSectionVerts(dirty_sections[i].second, section_verts[i].get());
+        }
+    });
+
+    for (int i = 0; i < section_count; i++) {
+        dirty_sections[i].first->landscape.applySectionVerts(dirty_sections[i].second, *section_verts[i]);
     }
 }
 
@@ -3,9 +3,15 @@
 #include "stdafx.h"
 
 #include "chunk_io.h"
+#include "chunk_pool.h"
+#include "chunk_source.h"
+#include "entity_physics.h"
+#include "far_terrain.h"
 #include "hit_test_result.h"
 #include "my_math.h"
 #include "wavefront_object.h"
+#include "worker_pool.h"
+#include "world_edit_batch.h"
 
 
 struct sqlite3;
@@ -24,11 +30,9 @@ typedef std::future<std::unique_ptr<Chunk>> ChunkFuture;
 class GameWorld
 {
 public:
-    GameWorld(const std::string &db_fname);
+    GameWorld(std::unique_ptr<ChunkSource> chunk_source);
     ~GameWorld();
 
-    const std::string &getDatabaseFilename() { return m_db_fname; }
-
     // TODO: Clean up events and make this constant again.
     Player &getPlayer() const { return *m_player; }
 
@@ -37,10 +41,13 @@ public:
     void onGameTick(int elapsed_msec, const EventStateMsg &msg);
 
     const Chunk *getChunk(const ChunkOrigin &origin) const;
+    bool anySolidBlockInBox(const MyBoundingBox &bbox) const;
     std::vector<ChunkOrigin> getLoadedChunkOrigins() const;
 
     void setPlayerAtStart();
     void deleteBlockInFrontOfUs();
+    bool setBlock(const GlobalGrid &coord, BlockType block_type);
+    void applyEditBatch(const WorldEditBatch &batch);
 
     // Getters.
     bool isPaused() const { return m_paused; }
@@ -54,6 +61,21 @@ public:
     const HitTestResult &getHitTestResult()   const { return m_hit_test_result; }
     const VertList_PT   &getHitTestVertList() const { return m_hit_test_vert_list; }
 
+    // This will be null if far terrain is turned off.
+    const FarTerrain *getFarTerrain() const { return m_far_terrain.get(); }
+
+    const EntityPhysics &getEntityPhysics() const { return m_entity_physics; }
+
+    // For splitting up work the main thread needs done right away. Handing out work
+    // doesn't change the world, so even the const parts of the game can use it.
+    WorkerPool &getWorkerPool() const { return m_worker_pool; }
+
+    // The loader threads get their chunks from here.
+    ChunkPool &getChunkPool() { return m_chunk_pool; }
+    const ChunkPool &getChunkPool() const { return m_chunk_pool; }
+
+    const ChunkSource &getChunkSource() const { return *m_chunk_source; }
+
 private:
     FORBID_DEFAULT_CTOR(GameWorld)
     FORBID_COPYING(GameWorld)
@@ -65,8 +87,10 @@ private:
 
     // Private data
     static const int WORKER_PACE_MSECS = 2000;
+    static const int PHYSICS_BENCHMARK_COUNT = 10000;
 
-    std::string m_db_fname;
+    // Like the pool, the source has to outlive the loaders, and the far terrain.
+    std::unique_ptr<ChunkSource> m_chunk_source;
     std::unique_ptr<Player> m_player;
 
     bool m_paused;
@@ -76,10 +100,19 @@ private:
     GlobalGrid  m_current_grid_coord;
     ChunkOrigin m_current_chunk_origin;
 
+    // The pool has to outlive the chunk maps, since loaders still in flight will use it.
+    ChunkPool m_chunk_pool;
+
     std::map<ChunkOrigin, std::unique_ptr<Chunk>> m_chunk_map;
 
     std::map<ChunkOrigin, ChunkFuture> m_chunk_loader_map;
 
+    std::unique_ptr<FarTerrain> m_far_terrain;
+
+    EntityPhysics m_entity_physics;
+
+    mutable WorkerPool m_worker_pool;
+
     bool m_hit_test_success;
     HitTestResult m_hit_test_result;
     VertList_PT m_hit_test_vert_list;
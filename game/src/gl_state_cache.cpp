@@ -0,0 +1,108 @@
+#include "stdafx.h"
+#include "gl_state_cache.h"
+#include "common_util.h"
+
+
+// Our one expedient state cache.
+static GLStateCache g_gl_state_cache;
+
+GLStateCache &GetGLStateCache() {
+    return g_gl_state_cache;
+}
+
+
+// Default ctor. We don't know anything yet.
+GLStateCache::GLStateCache() :
+    m_change_count(0)
+{
+    invalidate();
+}
+
+
+// Forget everything we think we know. The next request for anything will go through.
+// This doesn't reset the change count, since that keeps running for the whole game.
+void GLStateCache::invalidate()
+{
+    m_program_ID  = static_cast<GLuint>(-1);
+    m_active_unit = -1;
+    m_depth_func  = GL_NONE;
+
+    m_cull_face  = -1;
+    m_depth_test = -1;
+    m_blend      = -1;
+
+    m_texture_targets.fill(GL_NONE);
+    m_texture_IDs.fill(static_cast<GLuint>(-1));
+}
+
+
+// Switch programs, if we aren't using it already.
+void GLStateCache::useProgram(GLuint program_ID)
+{
+    if (m_program_ID != program_ID) {
+        glUseProgram(program_ID);
+        m_program_ID = program_ID;
+        m_change_count++;
+    }
+}
+
+
+// Bind a texture to a unit, if it isn't there already.
+void GLStateCache::bindTexture(int unit, GLenum target, GLuint texture_ID)
+{
+    assert((unit >= 0) && (unit < MAX_TEXTURE_UNITS));
+
+    if ((m_texture_targets[unit] == target) && (m_texture_IDs[unit] == texture_ID)) {
+        return;
+    }
+
+    if (m_active_unit != unit) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        m_active_unit = unit;
+    }
+
+    glBindTexture(target, texture_ID);
+    m_texture_targets[unit] = target;
+    m_texture_IDs[unit]     = texture_ID;
+    m_change_count++;
+}
+
+
+// Enable or disable something, if it isn't that way already.
+void GLStateCache::setCapability(GLenum cap, bool enabled)
+{
+    int *current = lookupCapability(cap);
+    int wanted = enabled ? 1 : 0;
+
+    if (*current != wanted) {
+        (enabled ? glEnable : glDisable)(cap);
+        *current = wanted;
+        m_change_count++;
+    }
+}
+
+
+// Set the depth function, if it isn't set already.
+void GLStateCache::setDepthFunc(GLenum depth_func)
+{
+    if (m_depth_func != depth_func) {
+        glDepthFunc(depth_func);
+        m_depth_func = depth_func;
+        m_change_count++;
+    }
+}
+
+
+// Find where we're shadowing a given capability.
+// We only track the handful the draw states actually toggle.
+int *GLStateCache::lookupCapability(GLenum cap)
+{
+    switch (cap) {
+    case GL_CULL_FACE:  return &m_cull_face;
+    case GL_DEPTH_TEST: return &m_depth_test;
+    case GL_BLEND:      return &m_blend;
+    default:
+        PrintTheImpossible(__FILE__, __LINE__, static_cast<int>(cap));
+        return &m_blend;
+    }
+}
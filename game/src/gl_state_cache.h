@@ -0,0 +1,52 @@
+#pragma once
+
+#include "stdafx.h"
+
+
+// A shadow copy of the bits of OpenGL state our draw states care about.
+// Every change goes through here, and if OpenGL is already in the state
+// we're asking for, we skip the call. We also count the calls we *didn't*
+// skip, which is what the HUD's "state changes" really means now.
+// SFML messes with all of this behind our backs, so "invalidate" once a frame.
+class GLStateCache
+{
+public:
+    static const int MAX_TEXTURE_UNITS = 4;
+
+    GLStateCache();
+    ~GLStateCache() {}
+
+    void invalidate();
+
+    void useProgram(GLuint program_ID);
+    void bindTexture(int unit, GLenum target, GLuint texture_ID);
+    void setCapability(GLenum cap, bool enabled);
+    void setDepthFunc(GLenum depth_func);
+
+    int getChangeCount() const { return m_change_count; }
+
+private:
+    FORBID_COPYING(GLStateCache)
+    FORBID_MOVING(GLStateCache)
+
+    // Private methods.
+    int *lookupCapability(GLenum cap);
+
+    // Private data. For the capabilities, -1 means "no idea".
+    GLuint m_program_ID;
+    int    m_active_unit;
+    GLenum m_depth_func;
+
+    int m_cull_face;
+    int m_depth_test;
+    int m_blend;
+
+    std::array<GLenum, MAX_TEXTURE_UNITS> m_texture_targets;
+    std::array<GLuint, MAX_TEXTURE_UNITS> m_texture_IDs;
+
+    int m_change_count;
+};
+
+
+// Get at our one expedient global state cache.
+GLStateCache &GetGLStateCache();
@@ -7,6 +7,8 @@
 #include "game_world.h"
 #include "player.h"
 #include "renderer.h"
+#include "scratch_arena.h"
+#include "streaming_buffer.h"
 #include "utils.h"
 
 
@@ -146,18 +148,38 @@ void HeadsUpDisplay::render(const GameWorld &game_world, const RenderStats &stat
 
         m_window.draw(m_debugging_text);
         m_debugging_text.move(0.0f, move_amount);
+
+        // Once chunks are streaming along, the heap count should stop going up.
+        ScratchStats scratch = GetScratchStats();
+        std::string scratch_msg = fmt::format(
+            "Scratch: {0} builds, {1} heap allocs, {2} KB peak",
+            scratch.scope_count, scratch.heap_alloc_count, scratch.peak_bytes_used / 1024);
+        m_debugging_text.setString(scratch_msg);
+
+        m_window.draw(m_debugging_text);
+        m_debugging_text.move(0.0f, move_amount);
     }
 
     // Print our render stats.
     if (config.debug.hud_render_stats) {
         std::string readable = ReadableNumber(stats.triangle_count);
         std::string msg = fmt::format(
-            "Render: {0} states, {1} tris",
-            stats.state_changes, readable);
+            "Render: {0} draws, {1} state changes, {2} tris",
+            stats.draw_calls, stats.state_changes, readable);
         m_debugging_text.setString(msg);
 
         m_window.draw(m_debugging_text);
         m_debugging_text.move(0.0f, move_amount);
+
+        if (config.render.overdraw.enabled) {
+            std::string overdraw_msg = fmt::format(
+                "Overdraw: {0:.2f} front-to-back, {1:.2f} loop order",
+                stats.overdraw_front_to_back, stats.overdraw_loop_order);
+            m_debugging_text.setString(overdraw_msg);
+
+            m_window.draw(m_debugging_text);
+            m_debugging_text.move(0.0f, move_amount);
+        }
     }
 
     // Print our mouse position.
@@ -187,6 +209,18 @@ void HeadsUpDisplay::render(const GameWorld &game_world, const RenderStats &stat
         m_debugging_text.move(0.0f, move_amount);
     }
 
+    // Print how long the entity physics step took.
+    if (config.debug.physics_benchmark) {
+        const EntityPhysics &entities = game_world.getEntityPhysics();
+        std::string msg = fmt::format(
+            "Physics: {0} entities, {1:.2f} msec/step",
+            entities.getEntityCount(), entities.getLastStepUsecs() / 1000.0f);
+        m_debugging_text.setString(msg);
+
+        m_window.draw(m_debugging_text);
+        m_debugging_text.move(0.0f, move_amount);
+    }
+
     // Print the player's collision details.
     if (config.debug.hud_collision) {
         std::string msg = fmt::format("Collision: {}", collision_line);
@@ -240,6 +274,48 @@ void HeadsUpDisplay::render(const GameWorld &game_world, const RenderStats &stat
 
         m_window.draw(m_debugging_text);
         m_debugging_text.move(0.0f, move_amount);
+
+        // Once we're streaming, loads should be getting recycled chunks, not new ones.
+        const ChunkPool &chunk_pool = game_world.getChunkPool();
+        std::string pool_msg = fmt::format(
+            "Chunk Pool: {0} free, {1} created, {2} reused",
+            chunk_pool.getFreeCount(), chunk_pool.getCreatedCount(), chunk_pool.getReusedCount());
+        m_debugging_text.setString(pool_msg);
+
+        m_window.draw(m_debugging_text);
+        m_debugging_text.move(0.0f, move_amount);
+
+        // Generated worlds say how fast they're being made up.
+        std::string source_msg = game_world.getChunkSource().getStatsText();
+        if (!source_msg.empty()) {
+            m_debugging_text.setString(source_msg);
+
+            m_window.draw(m_debugging_text);
+            m_debugging_text.move(0.0f, move_amount);
+        }
+
+        // If we've got far terrain, show how that's doing too.
+        const FarTerrain *far_terrain = game_world.getFarTerrain();
+        if (far_terrain != nullptr) {
+            std::string far_msg = fmt::format(
+                "Far Tiles: In memory = {0} ({1} bytes), pending = {2}, rendered = {3}",
+                far_terrain->getTileCount(),
+                ReadableNumber(far_terrain->getMemoryBytes()),
+                far_terrain->getPendingCount(),
+                stats.far_tiles_rendered);
+            m_debugging_text.setString(far_msg);
+
+            m_window.draw(m_debugging_text);
+            m_debugging_text.move(0.0f, move_amount);
+        }
+
+        // Wavefront objects are instanced, so they're cheap until they aren't.
+        std::string wf_msg = fmt::format(
+            "Objects: Instances rendered = {0}", stats.wf_instances_rendered);
+        m_debugging_text.setString(wf_msg);
+
+        m_window.draw(m_debugging_text);
+        m_debugging_text.move(0.0f, move_amount);
     }
 
     // Print our framerate.
@@ -249,6 +325,18 @@ void HeadsUpDisplay::render(const GameWorld &game_world, const RenderStats &stat
 
         m_window.draw(m_debugging_text);
         m_debugging_text.move(0.0f, move_amount);
+
+        // If the streaming buffer ever makes us wait on the GPU, we want to know.
+        const StreamingBuffer &stream = GetStreamingBuffer();
+        if (stream.isCreated()) {
+            std::string stream_msg = fmt::format(
+                "Streaming: {0} bytes used, {1} stalls",
+                ReadableNumber(stream.getRegionUsed()), stream.getStallCount());
+            m_debugging_text.setString(stream_msg);
+
+            m_window.draw(m_debugging_text);
+            m_debugging_text.move(0.0f, move_amount);
+        }
     }
 
     // That's the end of text-based output...
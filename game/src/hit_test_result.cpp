@@ -35,175 +35,117 @@ std::string HitTestResult::toString() const
 }
 
 
-// All of thes hit-testers will return "bool", but deal with
-// "HitTestEnum" internally, so that we can still debug what's going on.
-// For each, if we hit a block, and that block is not empty, then there's your answer.
-// Note that we have to burrow "inward" a bit to find the proper grid coord.
-
-
-// Try each Z-plane, from near to far.
-static bool CheckSouthFaces(
-    const Chunk &chunk, const MyRay &eye_ray,
-    GlobalGrid *pOut_coord, MyVec4 *pOut_impact, GLfloat *pOut_distance)
+// Set up one axis for the voxel walk. We want which way we're stepping,
+// how far along the ray until we cross the first grid boundary, and how
+// far along the ray it takes to cross one whole block. If the ray is
+// parallel to this axis, we never cross anything, so those are infinite.
+static void InitVoxelAxis(
+    GLfloat start, GLfloat dir, int grid,
+    int *pOut_step, GLfloat *pOut_t_max, GLfloat *pOut_t_delta)
 {
-    int near_z = chunk.getOrigin().z();
-    int far_z  = chunk.getOrigin().z() + CHUNK_WIDTH - 1;
-
-    for (int grid_z = near_z; grid_z <= far_z; grid_z++) {
-        MyPlane plane = GetSouthGridPlane(grid_z);
-
-        MyVec4  impact;
-        GLfloat distance;
-        HitTestType hit = WorldHitTest(eye_ray, plane, &impact, &distance);
-        if (hit == HitTestType::SUCCESS) {
-            GlobalGrid global_coord = WorldPosToGlobalGrid(impact, NudgeType::NORTH);
-            if (chunk.IsGlobalGridWithin(global_coord)) {
-                LocalGrid local_coord = GlobalGridToLocal(global_coord, chunk.getOrigin());
-                BlockType block_type  = chunk.getBlockType(local_coord);
-
-                if (IsBlockTypeFilled(block_type)) {
-                    *pOut_coord    = global_coord;
-                    *pOut_impact   = impact;
-                    *pOut_distance = distance;
-                    return true;
-                }
-            }
-        }
+    if (dir > 0.0f) {
+        GLfloat boundary = static_cast<GLfloat>((grid + 1) * BLOCK_SCALE);
+        *pOut_step    = 1;
+        *pOut_t_max   = (boundary - start) / dir;
+        *pOut_t_delta = BLOCK_SCALE / dir;
     }
-
-    return false;
-}
-
-
-// Try each Z-plane, from near to far.
-static bool CheckNorthFaces(
-    const Chunk &chunk, const MyRay &eye_ray,
-    GlobalGrid *pOut_coord, MyVec4 *pOut_impact, GLfloat *pOut_distance)
-{
-    int near_z = chunk.getOrigin().z() + CHUNK_WIDTH;
-    int far_z  = chunk.getOrigin().z() + 1;
-
-    for (int grid_z = near_z; grid_z >= far_z; grid_z--) {
-        MyPlane plane = GetNorthGridPlane(grid_z);
-
-        MyVec4  impact;
-        GLfloat distance;
-        HitTestType hit = WorldHitTest(eye_ray, plane, &impact, &distance);
-        if (hit == HitTestType::SUCCESS) {
-            GlobalGrid global_coord = WorldPosToGlobalGrid(impact, NudgeType::SOUTH);
-            if (chunk.IsGlobalGridWithin(global_coord)) {
-                LocalGrid local_coord = GlobalGridToLocal(global_coord, chunk.getOrigin());
-                BlockType block_type  = chunk.getBlockType(local_coord);
-
-                if (IsBlockTypeFilled(block_type)) {
-                    *pOut_coord    = global_coord;
-                    *pOut_impact   = impact;
-                    *pOut_distance = distance;
-                    return true;
-                }
-            }
-        }
+    else if (dir < 0.0f) {
+        GLfloat boundary = static_cast<GLfloat>(grid * BLOCK_SCALE);
+        *pOut_step    = -1;
+        *pOut_t_max   = (boundary - start) / dir;
+        *pOut_t_delta = BLOCK_SCALE / -dir;
     }
-
-    return false;
-}
-
-
-// Try each X-plane, from nearest to farthest.
-static bool CheckWestFaces(
-    const Chunk &chunk, const MyRay &eye_ray,
-    GlobalGrid *pOut_coord, MyVec4 *pOut_impact, GLfloat *pOut_distance)
-{
-    int near_x = chunk.getOrigin().x();
-    int far_x  = chunk.getOrigin().x() + CHUNK_WIDTH - 1;
-
-    for (int grid_x = near_x; grid_x <= far_x; grid_x++) {
-        MyPlane plane = GetWestGridPlane(grid_x);
-
-        MyVec4  impact;
-        GLfloat distance;
-        HitTestType hit = WorldHitTest(eye_ray, plane, &impact, &distance);
-        if (hit == HitTestType::SUCCESS) {
-            GlobalGrid global_coord = WorldPosToGlobalGrid(impact, NudgeType::EAST);
-            if (chunk.IsGlobalGridWithin(global_coord)) {
-                LocalGrid local_coord = GlobalGridToLocal(global_coord, chunk.getOrigin());
-                BlockType block_type  = chunk.getBlockType(local_coord);
-
-                if (IsBlockTypeFilled(block_type)) {
-                    *pOut_coord    = global_coord;
-                    *pOut_impact   = impact;
-                    *pOut_distance = distance;
-                    return true;
-                }
-            }
-        }
+    else {
+        *pOut_step    = 0;
+        *pOut_t_max   = FLT_MAX;
+        *pOut_t_delta = FLT_MAX;
     }
-
-    return false;
 }
 
 
-// Try each X-plane, from nearest to farthest.
-static bool CheckEastFaces(
-    const Chunk &chunk, const MyRay &eye_ray,
-    GlobalGrid *pOut_coord, MyVec4 *pOut_impact, GLfloat *pOut_distance)
+// The first call available outside this file. This is Amanatides and Woo's
+// voxel traversal: start at the camera's block, and step one block at a time
+// across whichever grid boundary the ray reaches next, until we land in a filled
+// block. The axis we stepped along tells us which face we came in through.
+// This costs one step per block travelled, and we only look up a new chunk
+// when we cross into one. We skip the block we start in, since there's no face to hit.
+bool DoWorldHitTest(const GameWorld &world, const MyRay &eye_ray, GLfloat max_distance, HitTestResult *pOut)
 {
-    int near_x = chunk.getOrigin().x() + CHUNK_WIDTH;
-    int far_x  = chunk.getOrigin().x() + 1;
-
-    for (int grid_x = near_x; grid_x >= far_x; grid_x--) {
-        MyPlane plane = GetEastGridPlane(grid_x);
+    const MyVec4 &start = eye_ray.getStart();
+    const MyVec4 &dir   = eye_ray.getDir();
+
+    GlobalGrid start_coord = WorldPosToGlobalGrid(start, NudgeType::NONE);
+    int x = start_coord.x();
+    int y = start_coord.y();
+    int z = start_coord.z();
+
+    int step_x, step_y, step_z;
+    GLfloat t_max_x, t_max_y, t_max_z;
+    GLfloat t_delta_x, t_delta_y, t_delta_z;
+    InitVoxelAxis(start.x(), dir.x(), x, &step_x, &t_max_x, &t_delta_x);
+    InitVoxelAxis(start.y(), dir.y(), y, &step_y, &t_max_y, &t_delta_y);
+    InitVoxelAxis(start.z(), dir.z(), z, &step_z, &t_max_z, &t_delta_z);
+
+    FaceType face = FaceType::NONE;
+    GLfloat  dist = 0.0f;
+
+    const Chunk *chunk = nullptr;
+    ChunkOrigin chunk_origin;
+    bool have_chunk = false;
+
+    while (dist <= max_distance) {
+
+        // Step into the next block, across whichever boundary is nearest.
+        if ((t_max_x < t_max_y) && (t_max_x < t_max_z)) {
+            x   += step_x;
+            dist = t_max_x;
+            t_max_x += t_delta_x;
+            face = (step_x > 0) ? FaceType::WEST : FaceType::EAST;
+        }
+        else if (t_max_y < t_max_z) {
+            y   += step_y;
+            dist = t_max_y;
+            t_max_y += t_delta_y;
+            face = (step_y > 0) ? FaceType::BOTTOM : FaceType::TOP;
+        }
+        else {
+            z   += step_z;
+            dist = t_max_z;
+            t_max_z += t_delta_z;
+            face = (step_z > 0) ? FaceType::SOUTH : FaceType::NORTH;
+        }
 
-        MyVec4  impact;
-        GLfloat distance;
-        HitTestType hit = WorldHitTest(eye_ray, plane, &impact, &distance);
-        if (hit == HitTestType::SUCCESS) {
-            GlobalGrid global_coord = WorldPosToGlobalGrid(impact, NudgeType::WEST);
-            if (chunk.IsGlobalGridWithin(global_coord)) {
-                LocalGrid local_coord = GlobalGridToLocal(global_coord, chunk.getOrigin());
-                BlockType block_type  = chunk.getBlockType(local_coord);
+        if (dist > max_distance) {
+            break;
+        }
 
-                if (IsBlockTypeFilled(block_type)) {
-                    *pOut_coord    = global_coord;
-                    *pOut_impact   = impact;
-                    *pOut_distance = distance;
-                    return true;
-                }
+        // Above or below the world. If we're heading further out, we're never coming back.
+        if ((y < 0) || (y >= CHUNK_HEIGHT)) {
+            bool leaving = (y < 0) ? (step_y <= 0) : (step_y >= 0);
+            if (leaving) {
+                break;
             }
+            continue;
         }
-    }
-
-    return false;
-}
-
-
-// Try each Y-plane, from nearest to farthest.
-static bool CheckTopFaces(
-    const Chunk &chunk, const MyRay &eye_ray,
-    GlobalGrid *pOut_coord, MyVec4 *pOut_impact, GLfloat *pOut_distance)
-{
-    int high_y = CHUNK_HEIGHT;
-    int low_y  = 1;
 
-    for (int grid_y = high_y; grid_y >= low_y; grid_y--) {
-        MyPlane plane = GetTopGridPlane(grid_y);
+        // Only look up the chunk when we cross into a new one.
+        GlobalGrid coord(x, y, z);
+        ChunkOrigin origin = GlobalGridToChunkOrigin(coord);
+        if (!have_chunk || (origin != chunk_origin)) {
+            chunk = world.getChunk(origin);
+            chunk_origin = origin;
+            have_chunk = true;
+        }
 
-        MyVec4  impact;
-        GLfloat distance;
-        HitTestType hit = WorldHitTest(eye_ray, plane, &impact, &distance);
-        if (hit == HitTestType::SUCCESS) {
-            GlobalGrid global_coord = WorldPosToGlobalGrid(impact, NudgeType::DOWN);
-            if (chunk.IsGlobalGridWithin(global_coord)) {
-                LocalGrid local_coord = GlobalGridToLocal(global_coord, chunk.getOrigin());
-                BlockType block_type  = chunk.getBlockType(local_coord);
+        if (chunk == nullptr) {
+            continue;
+        }
 
-                if (IsBlockTypeFilled(block_type)) {
-                    *pOut_coord    = global_coord;
-                    *pOut_impact   = impact;
-                    *pOut_distance = distance;
-                    return true;
-                }
-            }
+        LocalGrid local_coord = GlobalGridToLocal(coord, chunk_origin);
+        if (chunk->isBlockSolid(local_coord.x(), local_coord.y(), local_coord.z())) {
+            MyVec4 impact = start.plus(dir.times(dist));
+            *pOut = HitTestResult(chunk_origin, coord, face, impact, dist);
+            return true;
         }
     }
 
@@ -211,143 +153,30 @@ static bool CheckTopFaces(
 }
 
 
-// Try each Y-plane, from lowest to highest.
-static bool CheckBottomFaces(
-    const Chunk &chunk, const MyRay &eye_ray,
-    GlobalGrid *pOut_coord, MyVec4 *pOut_impact, GLfloat *pOut_distance)
+// Hit test a whole batch of rays, say for line-of-sight checks. Each result
+// lines up with its ray, and a miss has a face of "NONE". The world is only
+// read from, so big batches get split up across the world's worker pool. This has to be
+// called from the main thread, since that's the only one that changes the world.
+void DoWorldHitTestBatch(
+    const GameWorld &world, const std::vector<MyRay> &rays, GLfloat max_distance,
+    std::vector<HitTestResult> *pOut_results)
 {
-    int low_y  = 0;
-    int high_y = CHUNK_HEIGHT - 1;
+    const int RAYS_PER_TASK = 64;
 
-    for (int grid_y = low_y; grid_y <= high_y; grid_y++) {
-        MyPlane plane = GetBottomGridPlane(grid_y);
+    int ray_count = rays.size();
+    pOut_results->clear();
+    pOut_results->resize(ray_count);
 
-        MyVec4  impact;
-        GLfloat distance;
-        HitTestType hit = WorldHitTest(eye_ray, plane, &impact, &distance);
-        if (hit == HitTestType::SUCCESS) {
-            GlobalGrid global_coord = WorldPosToGlobalGrid(impact, NudgeType::UP);
-            if (chunk.IsGlobalGridWithin(global_coord)) {
-                LocalGrid local_coord = GlobalGridToLocal(global_coord, chunk.getOrigin());
-                BlockType block_type  = chunk.getBlockType(local_coord);
-
-                if (IsBlockTypeFilled(block_type)) {
-                    *pOut_coord    = global_coord;
-                    *pOut_impact   = impact;
-                    *pOut_distance = distance;
-                    return true;
-                }
+    auto do_range = [&world, &rays, max_distance, pOut_results](int first, int last) {
+        for (int i = first; i < last; i++) {
+            HitTestResult result;
+            if (DoWorldHitTest(world, rays[i], max_distance, &result)) {
+                (*pOut_results)[i] = std::move(result);
             }
         }
-    }
-
-    return false;
-}
-
-
-// The first call available outside this file.
-bool DoChunkHitTest(const Chunk &chunk, const MyRay &eye_ray, HitTestResult *pOut)
-{
-    // Test each of the six faces. The winner is whichever is closest.
-    FaceType winner  = FaceType::NONE;
-    GLfloat  closest = FLT_MAX;
-
-    // South faces.
-    GlobalGrid south_coord;
-    MyVec4  south_impact;
-    GLfloat south_dist = 0.0f;
-    bool south_hit = CheckSouthFaces(chunk, eye_ray, &south_coord, &south_impact, &south_dist);
-    if (south_hit && (south_dist < closest)) {
-        winner  = FaceType::SOUTH;
-        closest = south_dist;
-    }
-
-    // North faces.
-    GlobalGrid north_coord;
-    MyVec4  north_impact;
-    GLfloat north_dist = 0.0f;
-    bool north_hit = CheckNorthFaces(chunk, eye_ray, &north_coord, &north_impact, &north_dist);
-    if (north_hit && (north_dist < closest)) {
-        winner  = FaceType::NORTH;
-        closest = north_dist;
-    }
-
-    // West faces.
-    GlobalGrid west_coord;
-    MyVec4  west_impact;
-    GLfloat west_dist = 0.0;
-    bool west_hit = CheckWestFaces(chunk, eye_ray, &west_coord, &west_impact, &west_dist);
-    if (west_hit && (west_dist < closest)) {
-        winner  = FaceType::WEST;
-        closest = west_dist;
-    }
-
-    // East faces.
-    GlobalGrid east_coord;
-    MyVec4  east_impact;
-    GLfloat east_dist = 0.0;
-    bool east_hit = CheckEastFaces(chunk, eye_ray, &east_coord, &east_impact, &east_dist);
-    if (east_hit && (east_dist < closest)) {
-        winner  = FaceType::EAST;
-        closest = east_dist;
-    }
-
-    // Top faces.
-    GlobalGrid top_coord;
-    MyVec4  top_impact;
-    GLfloat top_dist   = 0.0;
-    bool top_hit = CheckTopFaces(chunk, eye_ray, &top_coord, &top_impact, &top_dist);
-    if (top_hit && (top_dist < closest)) {
-        winner  = FaceType::TOP;
-        closest = top_dist;
-    }
-
-    // Bottom faces.
-    GlobalGrid bottom_coord;
-    MyVec4  bottom_impact;
-    GLfloat bottom_dist = 0.0;
-    bool bottom_hit = CheckBottomFaces(chunk, eye_ray, &bottom_coord, &bottom_impact, &bottom_dist);
-    if (bottom_hit && (bottom_dist < closest)) {
-        winner  = FaceType::BOTTOM;
-        closest = bottom_dist;
-    }
-
-    // All done. Draw the winner.
-    const ChunkOrigin &origin = chunk.getOrigin();
+    };
 
-    switch (winner) {
-    case FaceType::NONE:
-        // If we got to here, we didn't hit anything.
-        return false;
-
-    case FaceType::SOUTH:
-        *pOut = HitTestResult(origin, south_coord, FaceType::SOUTH, south_impact, south_dist);
-        return true;
-
-    case FaceType::NORTH:
-        *pOut = HitTestResult(origin, north_coord, FaceType::NORTH, north_impact, north_dist);
-        return true;
-
-    case FaceType::WEST:
-        *pOut = HitTestResult(origin, west_coord, FaceType::WEST, west_impact, west_dist);
-        return true;
-
-    case FaceType::EAST:
-        *pOut = HitTestResult(origin, east_coord, FaceType::EAST, east_impact, east_dist);
-        return true;
-
-    case FaceType::TOP:
-        *pOut = HitTestResult(origin, top_coord, FaceType::TOP, top_impact, top_dist);
-        return true;
-
-    case FaceType::BOTTOM:
-        *pOut = HitTestResult(origin, bottom_coord, FaceType::BOTTOM, bottom_impact, bottom_dist);
-        return true;
-
-    default:
-        PrintTheImpossible(__FILE__, __LINE__, static_cast<int>(winner));
-        return false;
-    }
+    world.getWorkerPool().runSlices(ray_count, RAYS_PER_TASK, do_range);
 }
 
 
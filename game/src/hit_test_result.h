@@ -49,6 +49,14 @@ private:
 };
 
 
-// The two functions that do the work.
-bool DoChunkHitTest(const Chunk &chunk, const MyRay &eye_ray, HitTestResult *pOut);
+class GameWorld;
+
+
+// The functions that do the work. Distances are in world units.
+bool DoWorldHitTest(const GameWorld &world, const MyRay &eye_ray, GLfloat max_distance, HitTestResult *pOut);
+
+void DoWorldHitTestBatch(
+    const GameWorld &world, const std::vector<MyRay> &rays, GLfloat max_distance,
+    std::vector<HitTestResult> *pOut_results);
+
 void ChunkHitTestToQuad(const Chunk &chunk, const HitTestResult &details, VertList_PT *pOut);
\ No newline at end of file
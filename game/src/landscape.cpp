@@ -2,13 +2,16 @@
 #include "stdafx.h"
 #include "landscape.h"
 #include "chunk.h"
+#include "game_world.h"
 
 
 // Our only allowed constructor.
 Landscape::Landscape(Chunk &owner) :
     m_owner(owner)
 {
-
+    for (SectionRanges &ranges : m_section_ranges) {
+        ranges.fill({ 0, 0, 0 });
+    }
 }
 
 
@@ -41,45 +44,74 @@ VertList_PNT &Landscape::getSurfaceList_RW(SurfaceType surf)
 }
 
 
-// Return the count for a particular surface type.
+// Return the count for a particular surface type. That's the real verts in
+// every section, without the padding after them, which doesn't draw anything.
 int Landscape::getCountForSurface(SurfaceType surf) const
 {
     int index = static_cast<int>(surf);
     if (m_vert_lists.at(index) == nullptr) {
         return 0;
     }
-    else {
-        int result = m_vert_lists.at(index)->getByteCount();
-        return result;
+
+    int result = 0;
+    for (const SectionRange &range : m_section_ranges.at(index)) {
+        result += range.used;
     }
+
+    return result;
 }
 
 
-// Rebuild our surface lists.
+// Slack at the end of each section's range, so that a few edits can be patched in
+// place. A quarter again, plus enough for one block with all six faces showing.
+static int SectionCapacity(int used)
+{
+    if (used == 0) {
+        return 0;
+    }
+
+    return used + (used / 4) + (6 * 6);
+}
+
+
+// What we fill the slack with. Every corner of every triangle is the same point,
+// so they don't cover any pixels, and the rasterizer throws them right out.
+static const Vertex_PNT PADDING_VERT(MyVec4(0, 0, 0), MyVec4(0, 0, 0), MyVec2(0, 0));
+
+
+// Rebuild our surface lists. This does every section at once,
+// so it's for when the chunk first loads, or after big changes.
 void Landscape::rebuildSurfaceLists()
 {
-    // Recalc our exposures, both inner and along edges.
+    // Everything but the surface lists themselves is scratch.
+    ScratchScope scratch;
+
+    // The exposure pass already counted every face in every section, so
+    // each section's lists get sized exactly once, and never have to grow.
     SurfaceTotals totals;
+    std::array<SectionVerts, LANDSCAPE_SECTION_COUNT> sections;
 
-    // Clear out our surface lists.
-    for (int i = 0; i < SURFACE_TYPE_COUNT; i++) {
-        if (m_vert_lists.at(i) != nullptr) {
-            m_vert_lists.at(i)->reset();
-        }
+    for (int s = 0; s < LANDSCAPE_SECTION_COUNT; s++) {
+        const SurfaceTotals &section_totals = m_owner.getSectionTotals(s);
+        sections.at(s).reserve(section_totals);
+        totals.add(section_totals);
     }
 
-    // Populate those surface lists.
-    std::vector<LocalGrid> coords = m_owner.getExposedBlockList();
-
-    for (LocalGrid coord : coords) {
-        m_owner.addToSurfaceLists(coord);
+    // Sort the exposed blocks out into their sections.
+    const std::vector<LocalGrid> &coords = m_owner.getExposedBlockList();
+    for (const LocalGrid &coord : coords) {
+        int section = LocalYToSection(coord.y());
+        m_owner.addToSurfaceLists(coord, &sections.at(section));
     }
 
-    // All done.
+    // Lay out each surface list, one section after another.
     for (int i = 0; i < SURFACE_TYPE_COUNT; i++) {
-        if (m_vert_lists.at(i) != nullptr) {
-            m_vert_lists.at(i)->update();
+        SectionVertLists section_verts;
+        for (int s = 0; s < LANDSCAPE_SECTION_COUNT; s++) {
+            section_verts.at(s) = &sections.at(s).surfaces.at(i);
         }
+
+        layoutSurfaceList(static_cast<SurfaceType>(i), section_verts);
     }
 
     const auto &origin = m_owner.getOrigin();
@@ -98,6 +130,136 @@ void Landscape::rebuildSurfaceLists()
 }
 
 
+// Rebuild just one section.
+void Landscape::rebuildSection(int section)
+{
+    ScratchScope scratch;
+
+    SectionVerts verts;
+    buildSectionVerts(section, &verts);
+    applySectionVerts(section, verts);
+}
+
+
+// Swap in new verts for one section. If they fit in the section's range,
+// overwrite that range, and only it goes out to the video card. If they
+// don't fit, lay out that one surface list again, with fresh slack.
+void Landscape::applySectionVerts(int section, const SectionVerts &verts)
+{
+    assert((section >= 0) && (section < LANDSCAPE_SECTION_COUNT));
+
+    ScratchScope scratch;
+
+    for (int i = 0; i < SURFACE_TYPE_COUNT; i++) {
+        const SectionVertList &new_verts = verts.surfaces.at(i);
+        const int new_count = new_verts.size();
+
+        VertList_PNT *list  = m_vert_lists.at(i).get();
+        SectionRange &range = m_section_ranges.at(i).at(section);
+
+        // Nothing before, nothing now.
+        if ((new_count == 0) && (range.used == 0)) {
+            continue;
+        }
+
+        // It fits. Only patch as far as we need to, to cover up whatever was there before.
+        if ((list != nullptr) && (new_count <= range.capacity)) {
+            int patch_count = max(new_count, range.used);
+
+            SectionVertList patch(new_verts.begin(), new_verts.end());
+            patch.resize(patch_count, PADDING_VERT);
+            list->patch(range.first, patch.data(), patch_count);
+
+            range.used = new_count;
+            continue;
+        }
+
+        // It doesn't fit. Pull the other sections back out of the list, and start over.
+        std::array<SectionVertList, LANDSCAPE_SECTION_COUNT> old_sections;
+        SectionVertLists section_verts;
+
+        for (int s = 0; s < LANDSCAPE_SECTION_COUNT; s++) {
+            if (s == section) {
+                section_verts.at(s) = &new_verts;
+                continue;
+            }
+
+            const SectionRange &other = m_section_ranges.at(i).at(s);
+            if ((list != nullptr) && (other.used > 0)) {
+                auto begin = list->getVerts().begin() + other.first;
+                old_sections.at(s).assign(begin, begin + other.used);
+            }
+
+            section_verts.at(s) = &old_sections.at(s);
+        }
+
+        layoutSurfaceList(static_cast<SurfaceType>(i), section_verts);
+    }
+}
+
+
+// Get the verts for all the exposed blocks in one section. The verts go
+// wherever "pOut" says, so they can outlive our scratch scope if they need to.
+void Landscape::buildSectionVerts(int section, SectionVerts *pOut) const
+{
+    assert((section >= 0) && (section < LANDSCAPE_SECTION_COUNT));
+
+    int min_y = section * LANDSCAPE_SECTION_HEIGHT;
+    int max_y = min_y + LANDSCAPE_SECTION_HEIGHT - 1;
+
+    ScratchScope scratch;
+    ScratchVector<LocalGrid> coords;
+    m_owner.getExposedBlocksInRange(min_y, max_y, &coords);
+
+    pOut->reserve(m_owner.getSectionTotals(section));
+
+    for (const LocalGrid &coord : coords) {
+        m_owner.addToSurfaceLists(coord, pOut);
+    }
+}
+
+
+// Lay out a whole surface list from scratch, one section after another,
+// each followed by its slack. Then send the whole thing to the video card.
+void Landscape::layoutSurfaceList(SurfaceType surf, const SectionVertLists &sections)
+{
+    int index = static_cast<int>(surf);
+    SectionRanges &ranges = m_section_ranges.at(index);
+
+    int total = 0;
+    for (const SectionVertList *verts : sections) {
+        total += SectionCapacity(verts->size());
+    }
+
+    // If there's nothing to draw, don't bother creating a list.
+    if ((total == 0) && (m_vert_lists.at(index) == nullptr)) {
+        ranges.fill({ 0, 0, 0 });
+        return;
+    }
+
+    VertList_PNT &list = getSurfaceList_RW(surf);
+    list.reset();
+    list.reserve(total);
+
+    for (int s = 0; s < LANDSCAPE_SECTION_COUNT; s++) {
+        const SectionVertList &verts = *sections.at(s);
+        const int used     = verts.size();
+        const int capacity = SectionCapacity(used);
+
+        ranges.at(s) = { list.getItemCount(), capacity, used };
+
+        if (used > 0) {
+            list.add(verts.data(), used);
+        }
+        for (int pad = used; pad < capacity; pad++) {
+            list.add(&PADDING_VERT, 1);
+        }
+    }
+
+    list.update();
+}
+
+
 // Free up any surface lists.
 void Landscape::freeSurfaceLists() {
     for (int i = 0; i < SURFACE_TYPE_COUNT; i++) {
@@ -106,5 +268,93 @@ void Landscape::freeSurfaceLists() {
         }
     }
 
+    for (SectionRanges &ranges : m_section_ranges) {
+        ranges.fill({ 0, 0, 0 });
+    }
+
     m_vert_lists.empty();
+}
+
+
+// Build the verts for every section of some chunks, a few times over. With "presize", each
+// section's lists are sized from its face counts first. Without, they grow as they go,
+// like they used to. Return the most scratch memory that any one chunk needed.
+static size_t BuildAllSectionVerts(
+    const std::vector<const Chunk *> &chunks, int pass_count, bool presize, int *pOut_vert_count)
+{
+    size_t peak_bytes = 0;
+    int vert_count = 0;
+
+    for (int pass = 0; pass < pass_count; pass++) {
+        vert_count = 0;
+
+        for (const Chunk *chunk : chunks) {
+            ScratchScope scratch;
+            ScratchVector<LocalGrid> coords;
+
+            for (int s = 0; s < LANDSCAPE_SECTION_COUNT; s++) {
+                SectionVerts verts;
+                if (presize) {
+                    verts.reserve(chunk->getSectionTotals(s));
+                }
+
+                int min_y = s * LANDSCAPE_SECTION_HEIGHT;
+                chunk->getExposedBlocksInRange(min_y, min_y + LANDSCAPE_SECTION_HEIGHT - 1, &coords);
+
+                for (const LocalGrid &coord : coords) {
+                    chunk->addToSurfaceLists(coord, &verts);
+                }
+
+                for (const SectionVertList &list : verts.surfaces) {
+                    vert_count += list.size();
+                }
+            }
+
+            peak_bytes = max(peak_bytes, GetScratchArena().getBytesUsed());
+        }
+    }
+
+    *pOut_vert_count = vert_count;
+    return peak_bytes;
+}
+
+
+// Time building the verts for every loaded chunk, both with the lists sized up front
+// and without, and print how it went. Nothing goes to the video card, so this is
+// just the CPU side of meshing. Results go to the debug output.
+void RunMeshingBenchmark(const GameWorld &world)
+{
+    const int PASS_COUNT = 10;
+
+    std::vector<const Chunk *> chunks;
+    for (const ChunkOrigin &origin : world.getLoadedChunkOrigins()) {
+        chunks.emplace_back(world.getChunk(origin));
+    }
+
+    if (chunks.empty()) {
+        return;
+    }
+
+    const int build_count = chunks.size() * PASS_COUNT;
+    int presized_verts = 0;
+    int growing_verts  = 0;
+
+    sf::Clock clock;
+    size_t presized_bytes = BuildAllSectionVerts(chunks, PASS_COUNT, true, &presized_verts);
+    GLfloat presized_msecs = clock.restart().asMicroseconds() / 1000.0f;
+
+    size_t growing_bytes = BuildAllSectionVerts(chunks, PASS_COUNT, false, &growing_verts);
+    GLfloat growing_msecs = clock.restart().asMicroseconds() / 1000.0f;
+
+    assert(presized_verts == growing_verts);
+
+    PrintDebug(fmt::format(
+        "Meshing benchmark: {0} chunks, {1} passes, {2} verts per pass.\n",
+        chunks.size(), PASS_COUNT, presized_verts));
+    PrintDebug(fmt::format(
+        "    Presized: {0:.3f} msec/chunk, {1} KB peak scratch per chunk.\n",
+        presized_msecs / build_count, presized_bytes / 1024));
+    PrintDebug(fmt::format(
+        "    Growing:  {0:.3f} msec/chunk, {1} KB peak scratch per chunk.\n",
+        growing_msecs / build_count, growing_bytes / 1024));
 }
\ No newline at end of file
@@ -1,34 +1,104 @@
-#pragma once
-
-#include "stdafx.h"
-
-#include "block.h"
-#include "draw_state_pnt.h"
-
-class Chunk;
-
-
-// Everything dealing with Surface Lists must only be called
-// from the main thread, since they involve OpenGL buffers.
-class Landscape
-{
-public:
-    Landscape(Chunk &owner);
-    ~Landscape();
-
-    int getCountForSurface(SurfaceType surf) const;
-    const VertList_PNT *getSurfaceList_RO(SurfaceType surf) const;
-    VertList_PNT &getSurfaceList_RW(SurfaceType surf);
-    void rebuildSurfaceLists();
-    void freeSurfaceLists();
-
-private:
-    FORBID_DEFAULT_CTOR(Landscape)
-    FORBID_COPYING(Landscape)
-    FORBID_MOVING(Landscape)
-
-    // Private data
-    Chunk &m_owner;
-
-    std::array<std::unique_ptr<VertList_PNT>, SURFACE_TYPE_COUNT> m_vert_lists;
-};
\ No newline at end of file
+#pragma once
+
+#include "stdafx.h"
+
+#include "block.h"
+#include "chunk_stripe.h"
+#include "draw_state_pnt.h"
+#include "scratch_arena.h"
+
+class Chunk;
+class GameWorld;
+
+
+// Each chunk's landscape is cut up into horizontal sections. Within a surface list,
+// each section gets its own range of verts, with a little slack at the end.
+// Editing a block only rebuilds the section it's in, and sends just that range.
+const int LANDSCAPE_SECTION_HEIGHT = 16;
+const int LANDSCAPE_SECTION_COUNT  = CHUNK_HEIGHT / LANDSCAPE_SECTION_HEIGHT;
+
+static_assert((CHUNK_HEIGHT % LANDSCAPE_SECTION_HEIGHT) == 0, "Sections have to divide the chunk evenly");
+
+inline int LocalYToSection(int local_y) { return local_y / LANDSCAPE_SECTION_HEIGHT; }
+
+
+// The verts for one section, with one list for each surface type. By default
+// these live in the calling thread's scratch arena, so they're gone as soon as
+// its scope ends. Pass a null arena for ones that have to outlive that.
+typedef ScratchVector<Vertex_PNT> SectionVertList;
+
+struct SectionVerts
+{
+    SectionVerts() {}
+
+    explicit SectionVerts(ScratchArena *arena) {
+        for (SectionVertList &list : surfaces) {
+            list = SectionVertList(ScratchAllocator<Vertex_PNT>(arena));
+        }
+    }
+
+    std::array<SectionVertList, SURFACE_TYPE_COUNT> surfaces;
+
+    SectionVertList &getList(SurfaceType surf) {
+        return surfaces.at(static_cast<int>(surf));
+    }
+
+    // Make exactly enough room for every face we're about to add, six verts each.
+    void reserve(const SurfaceTotals &totals) {
+        for (int i = 0; i < SURFACE_TYPE_COUNT; i++) {
+            surfaces.at(i).reserve(6 * totals.get(static_cast<SurfaceType>(i)));
+        }
+    }
+};
+
+
+// Everything dealing with Surface Lists must only be called
+// from the main thread, since they involve OpenGL buffers.
+class Landscape
+{
+public:
+    Landscape(Chunk &owner);
+    ~Landscape();
+
+    int getCountForSurface(SurfaceType surf) const;
+    const VertList_PNT *getSurfaceList_RO(SurfaceType surf) const;
+    VertList_PNT &getSurfaceList_RW(SurfaceType surf);
+    void rebuildSurfaceLists();
+    void rebuildSection(int section);
+    void freeSurfaceLists();
+
+    // Rebuilding a section, in two halves. Building the verts only reads
+    // the chunk, so that's fine on a worker thread. Applying them is OpenGL.
+    void buildSectionVerts(int section, SectionVerts *pOut) const;
+    void applySectionVerts(int section, const SectionVerts &verts);
+
+private:
+    FORBID_DEFAULT_CTOR(Landscape)
+    FORBID_COPYING(Landscape)
+    FORBID_MOVING(Landscape)
+
+    // Where one section lives in a surface list. "used" is how many verts are real,
+    // and the rest of "capacity" is padding, which draws as nothing at all.
+    struct SectionRange
+    {
+        int first;
+        int capacity;
+        int used;
+    };
+
+    typedef std::array<SectionRange, LANDSCAPE_SECTION_COUNT> SectionRanges;
+    typedef std::array<const SectionVertList *, LANDSCAPE_SECTION_COUNT> SectionVertLists;
+
+    // Private methods.
+    void layoutSurfaceList(SurfaceType surf, const SectionVertLists &sections);
+
+    // Private data
+    Chunk &m_owner;
+
+    std::array<std::unique_ptr<VertList_PNT>, SURFACE_TYPE_COUNT> m_vert_lists;
+    std::array<SectionRanges, SURFACE_TYPE_COUNT> m_section_ranges;
+};
+
+
+// Time building the verts for every loaded chunk, and print how it went.
+void RunMeshingBenchmark(const GameWorld &world);
@@ -1,4 +1,3 @@
-
 #include "stdafx.h"
 #include "physics.h"
 
@@ -10,445 +9,368 @@
 #include "player.h"
 
 
-// Tweak things by one centimeter to avoid edge cases.
-static const GLfloat TWEAK = 1.0f;
-
-bool IsWorldBlockFilled(const GameWorld &world, const GlobalGrid &coord);
-int  FloorToBlock(GLfloat val);
-int  CeilToBlock(GLfloat val);
+// Anything closer than this, in centimeters, counts as touching. Positions
+// are floats, and out at the edges of the world they get a bit mushy, so
+// a box that's sitting on the floor might end up a hair inside of it.
+static const GLfloat CONTACT_TOLERANCE = 0.1f;
 
-bool CollisionCheckDown (Player &player, int msec);
-bool CollisionCheckUp   (Player &player, int msec);
-bool CollisionCheckNorth(Player &player, int msec);
-bool CollisionCheckSouth(Player &player, int msec);
-bool CollisionCheckEast (Player &player, int msec);
-bool CollisionCheckWest (Player &player, int msec);
+// Each pass of the sweep can hit, at most, one new axis. So three passes
+// is enough to end up pinned in a corner.
+static const int MAX_SWEEP_PASSES = 3;
 
 
-// Run collision tests in all six directions.
-void PlayerCollisionTest(Player &player, int msec)
+// Which way a sweep is going along one axis, and where the box is along it.
+struct SweepAxis
 {
-    // If "noclip" is on, don't bother.
-    if (GetConfig().debug.noclip) {
-        return;
-    }
+    GLfloat box_min;
+    GLfloat box_max;
+    GLfloat motion;
+};
 
-    std::string msg = "";
 
-    // Start with up/down collisions.
-    if (CollisionCheckDown(player, msec)) {
-        msg += (msg == "") ? "Down" : " Down";
-    }
-    if (CollisionCheckUp(player, msec)) {
-        msg += (msg == "") ? "Up" : " Up";
-    }
-
-    // For north/south (Z) vs east/west (X), figure out which
-    // axis is more predominant, and check those first. This
-    // way, we don't have to shrink BBoxes quite so much, to
-    // avoid "snagging" into walls.
-    MyVec4 vert = player.getHorzMotion();
-    GLfloat x = vert.x();
-    GLfloat z = vert.z();
-    bool z_is_bigger = ::abs(z) > ::abs(x);
-
-    // Z is bigger, so North/South first.
-    if (z_is_bigger) {
-        if (CollisionCheckNorth(player, msec)) {
-            msg += (msg == "") ? "North" : " North";
-        }
-        if (CollisionCheckSouth(player, msec)) {
-            msg += (msg == "") ? "South" : " South";
-        }
-        if (CollisionCheckEast(player, msec)) {
-            msg += (msg == "") ? "East" : " East";
-        }
-        if (CollisionCheckWest(player, msec)) {
-            msg += (msg == "") ? "West" : " West";
-        }
-    }
+// Grab pointers to all the loaded chunks, sorted, so we can binary search them.
+ChunkSnapshot::ChunkSnapshot(const GameWorld &world)
+{
+    std::vector<ChunkOrigin> origins = world.getLoadedChunkOrigins();
+    m_chunks.reserve(origins.size());
 
-    // X is bigger, so East/West first.
-    else {
-        if (CollisionCheckEast(player, msec)) {
-            msg += (msg == "") ? "East" : " East";
-        }
-        if (CollisionCheckWest(player, msec)) {
-            msg += (msg == "") ? "West" : " West";
-        }
-        if (CollisionCheckNorth(player, msec)) {
-            msg += (msg == "") ? "North" : " North";
-        }
-        if (CollisionCheckSouth(player, msec)) {
-            msg += (msg == "") ? "South" : " South";
-        }
+    for (const ChunkOrigin &origin : origins) {
+        m_chunks.emplace_back(origin, world.getChunk(origin));
     }
-
-    // All done.
-    SetHudCollisionLine(msg);
 }
 
 
-// Return true if a block within the world is filled. We're going to rely
-// on locality of reference to hope that this doesn't hammer memory too bad.
-bool IsWorldBlockFilled(const GameWorld &world, const GlobalGrid &coord)
+// Look up a chunk. Just like the game world, this is null if it's not loaded.
+const Chunk *ChunkSnapshot::getChunk(const ChunkOrigin &origin) const
 {
-    if (!coord.isWithinWorld()) {
-        return false;
-    }
+    auto iter = std::lower_bound(m_chunks.begin(), m_chunks.end(), origin,
+        [](const std::pair<ChunkOrigin, const Chunk *> &item, const ChunkOrigin &key) {
+            return item.first < key;
+        });
 
-    ChunkOrigin origin = GlobalGridToChunkOrigin(coord);
-    LocalGrid local_coord = GlobalGridToLocal(coord, origin);
-
-    const Chunk *chunk = world.getChunk(origin);
-    if (chunk == nullptr) {
-        return false;
-    }
-    else {
-        BlockType bt = chunk->getBlockType(local_coord);
-        bool result = IsBlockTypeFilled(bt);
-        return result;
+    if ((iter == m_chunks.end()) || (iter->first != origin)) {
+        return nullptr;
     }
-}
 
-
-// Floor exactly to our block scale.
-int FloorToBlock(GLfloat val)
-{
-    int block_scale = static_cast<int>(BLOCK_SCALE);
-    int int_val = static_cast<int>(val);
-    int rounded = RoundDownInt(int_val, block_scale);
-    int result  = rounded / block_scale;
-    return result;
+    return iter->second;
 }
 
 
-// Ceiling exactly to our block scale.
-int CeilToBlock(GLfloat val)
+// Look up filled blocks, hanging on to whichever chunk we looked at last.
+// The blocks around a box almost always come out of the same chunk or two.
+// The source is anything with a "getChunk", so either the world or a snapshot.
+template <typename T>
+class BlockLookup
 {
-    int block_scale = static_cast<int>(BLOCK_SCALE);
-    int int_val = static_cast<int>(val);
-    int rounded = RoundUpInt(int_val, block_scale);
-    int result  = rounded / block_scale;
-    return result;
-}
-
-
-// Check a collisioin against the floor (-Y direction).
-bool CollisionCheckDown(Player &player, int msec)
+public:
+    BlockLookup(const T &source) :
+        m_source(source),
+        m_chunk(nullptr),
+        m_have_chunk(false) {}
+
+    bool isFilled(int x, int y, int z);
+
+private:
+    FORBID_DEFAULT_CTOR(BlockLookup)
+    FORBID_COPYING(BlockLookup)
+    FORBID_MOVING(BlockLookup)
+
+    const T &m_source;
+    const Chunk *m_chunk;
+    ChunkOrigin  m_chunk_origin;
+    bool m_have_chunk;
+};
+
+
+// Return true if a block within the world is filled. Above and below
+// the world, and in chunks that aren't loaded, there's nothing to hit.
+template <typename T>
+bool BlockLookup<T>::isFilled(int x, int y, int z)
 {
-    GLfloat y_motion = player.getVertMotion().y();
-    GLfloat x_motion = player.getHorzMotion().x();
-    GLfloat z_motion = player.getHorzMotion().z();
-
-    const GameWorld     &world = player.getGameWorld();
-    const MyBoundingBox &bbox  = player.getBoundingBox();
-
-    // If the player has no -Y motion, don't bother.
-    if (y_motion >= 0) {
+    if ((y < 0) || (y >= CHUNK_HEIGHT)) {
         return false;
     }
 
-    // For checking to fall through the floor, shrink our bounding box
-    // so that we don't "stick" to walls and be able to climb them.
-    GLfloat shrink_x = (::abs(x_motion) * msec) + TWEAK;
-    GLfloat shrink_z = (::abs(z_motion) * msec) + TWEAK;
-
-    // Establish the boundaries of blocks to look at.
-    int min_x = FloorToBlock(bbox.minX() + shrink_x);
-    int max_x = CeilToBlock (bbox.maxX() - shrink_x);
-    int min_z = FloorToBlock(bbox.minZ() + shrink_z);
-    int max_z = CeilToBlock (bbox.maxZ() - shrink_z);
-
-    int constant_y = FloorToBlock(bbox.minY());
-
-    bool collision = false;
-    for     (int x = min_x; x < max_x; x++) {
-        for (int z = min_z; z < max_z; z++) {
-            GlobalGrid coord(x, constant_y, z);
-            if (IsWorldBlockFilled(world, coord)) {
-                collision = true;
-            }
-        }
+    GlobalGrid coord(x, y, z);
+    ChunkOrigin origin = GlobalGridToChunkOrigin(coord);
+    if (!m_have_chunk || (origin != m_chunk_origin)) {
+        m_chunk = m_source.getChunk(origin);
+        m_chunk_origin = origin;
+        m_have_chunk = true;
     }
 
-    // If we collide, plant the player at that spot. The is the
-    // only place where we don't tweak the offset when corrrecting
-    // where the player ends up, since otherwise the constant
-    // effect of gravity would cause visual jitter.
-    if (collision) {
-        player.setOnSolidGround(true);
-
-        MyVec4  pos = player.getPlayerPos();
-        GLfloat the_floor = (constant_y + 1) * BLOCK_SCALE;
-
-        MyVec4  new_pos(pos.x(), the_floor, pos.z());
-        player.setPlayerPos(new_pos);
-        return true;
-    }
-    else {
-        player.setOnSolidGround(false);
+    if (m_chunk == nullptr) {
+        return false;
     }
 
-    return false;
+    LocalGrid local_coord = GlobalGridToLocal(coord, origin);
+    return m_chunk->isBlockSolid(local_coord.x(), local_coord.y(), local_coord.z());
 }
 
 
-// Check a collisioin against the ceiling (+Y direction). Really rare.
-bool CollisionCheckUp(Player &player, int msec)
+// Which block a world position falls in. Floor it properly, since
+// a plain cast rounds the wrong way for negative coordinates.
+static int WorldToBlock(GLfloat val)
 {
-    GLfloat y_motion = player.getVertMotion().y();
-    GLfloat x_motion = player.getHorzMotion().x();
-    GLfloat z_motion = player.getHorzMotion().z();
-
-    const GameWorld     &world = player.getGameWorld();
-    const MyBoundingBox &bbox  = player.getBoundingBox();
+    return static_cast<int>(floor(val / BLOCK_SCALE));
+}
 
-    // If the player has no +Y motion, don't bother.
-    if (y_motion <= 0) {
-        return false;
-    }
 
-    // For checking against the ceiling, shrink our bounding box
-    // so that we don't "stick" to walls and be able to climb them.
-    GLfloat shrink_x = (::abs(x_motion) * msec) + TWEAK;
-    GLfloat shrink_z = (::abs(z_motion) * msec) + TWEAK;
-
-    // Establish the boundaries of blocks to look at.
-    int min_x = FloorToBlock(bbox.minX() + shrink_x);
-    int max_x = CeilToBlock (bbox.maxX() - shrink_x);
-    int min_z = FloorToBlock(bbox.minZ() + shrink_z);
-    int max_z = CeilToBlock (bbox.maxZ() - shrink_z);
-
-    int constant_y = FloorToBlock(bbox.maxY());
-
-    bool collision = false;
-    for     (int x = min_x; x < max_x; x++) {
-        for (int z = min_z; z < max_z; z++) {
-            GlobalGrid coord(x, constant_y, z);
-            if (IsWorldBlockFilled(world, coord)) {
-                collision = true;
-            }
+// Figure out when, along one axis, the box starts and stops overlapping
+// a block. Times are in terms of the whole motion, so 0 is where we start,
+// and 1 is where we'd end up. Return false if this axis never overlaps at all.
+// If we're already overlapping along this axis, the entry time is "forever ago".
+static bool SweepOneAxis(
+    const SweepAxis &axis, GLfloat block_min, GLfloat block_max,
+    GLfloat *pOut_entry, GLfloat *pOut_exit)
+{
+    // Not moving along this axis, so we either overlap the whole time, or never.
+    if (axis.motion == 0.0f) {
+        if ((axis.box_max - CONTACT_TOLERANCE <= block_min) ||
+            (axis.box_min + CONTACT_TOLERANCE >= block_max)) {
+            return false;
         }
-    }
-
-    // If we collided, prevent further motion in the +Y direction.
-    // Also unique to here, bounce the player right back down.
-    if (collision) {
-        MyVec4  pos = player.getPlayerPos();
-        GLfloat the_ceiling = constant_y * BLOCK_SCALE;
-        GLfloat offset = bbox.getHeight() + TWEAK;
 
-        MyVec4  new_pos(pos.x(), the_ceiling - offset, pos.z());
-        player.setPlayerPos(new_pos);
-
-        player.bounceOffCeiling();
+        *pOut_entry = -FLT_MAX;
+        *pOut_exit  =  FLT_MAX;
         return true;
     }
 
-    return false;
-}
-
-
-// Check a collisioin against what's in the +Z direction.
-bool CollisionCheckNorth(Player &player, int msec)
-{
-    GLfloat x_motion = player.getHorzMotion().x();
-    GLfloat z_motion = player.getHorzMotion().z();
-
-    const GameWorld     &world = player.getGameWorld();
-    const MyBoundingBox &bbox  = player.getBoundingBox();
+    // How far until our leading edge reaches the block,
+    // and how far until our trailing edge leaves it.
+    GLfloat near_dist, far_dist;
+    if (axis.motion > 0.0f) {
+        near_dist = block_min - axis.box_max;
+        far_dist  = block_max - axis.box_min;
+    }
+    else {
+        near_dist = axis.box_min - block_max;
+        far_dist  = axis.box_max - block_min;
+    }
 
-    // If the player has no +Z motion, don't bother.
-    if (z_motion <= 0) {
+    // The block is behind us, or we're just grazing it on the way out.
+    if (far_dist <= CONTACT_TOLERANCE) {
         return false;
     }
 
-    // Shrink the bounding box so that it doesn't scrape the
-    // floor and ceilinng, and vertically a bit to avoid edge cases.
-    GLfloat shrink_x = (::abs(x_motion) * msec) + TWEAK;
-
-    // Establish the boundaries of blocks to look at.
-    int min_x = FloorToBlock(bbox.minX() + shrink_x);
-    int max_x = CeilToBlock (bbox.maxX() - shrink_x);
-    int min_y = FloorToBlock(bbox.minY() + TWEAK);
-    int max_y = CeilToBlock (bbox.maxY() - TWEAK);
+    GLfloat speed = fabs(axis.motion);
 
-    int constant_z = FloorToBlock(bbox.maxZ());
-
-    bool collision = false;
-    for     (int x = min_x; x < max_x; x++) {
-        for (int y = min_y; y < max_y; y++) {
-            GlobalGrid coord(x, y, constant_z);
-            if (IsWorldBlockFilled(world, coord)) {
-                collision = true;
-            }
-        }
+    // If we're a hair inside of it, treat that as touching. Any deeper,
+    // and we were already overlapping along this axis before we started.
+    if (near_dist > -CONTACT_TOLERANCE) {
+        *pOut_entry = max(near_dist, 0.0f) / speed;
     }
-
-    // If we collided, prevent further motion in the +Z direction.
-    if (collision) {
-        MyVec4  pos = player.getPlayerPos();
-        GLfloat north_wall = constant_z * BLOCK_SCALE;
-        GLfloat offset = (bbox.getDepth() / 2.0f) + TWEAK;
-
-        MyVec4 new_pos(pos.x(), pos.y(), north_wall - offset);
-        player.setPlayerPos(new_pos);
-        return true;
+    else {
+        *pOut_entry = -FLT_MAX;
     }
 
-    return false;
+    *pOut_exit = far_dist / speed;
+    return true;
 }
 
 
-// Check a collisioin against what's in the -Z direction.
-bool CollisionCheckSouth(Player &player, int msec)
+// Sweep a box through the world, and slide it along whatever it runs into.
+// For every filled block the swept box could possibly touch, we find the time
+// of impact, and take the earliest one. We move the box right up against that
+// block, drop the part of the motion that goes into it, and sweep what's left.
+// Since we look at every block between here and there, even a really fast box
+// can't skip over a thin wall. This knows nothing about players, so anything
+// with a bounding box can use it.
+template <typename T>
+static void SweepBox(
+    const T &source, const MyBoundingBox &bbox, const MyVec4 &motion, SweepResult *pOut_result)
 {
-    GLfloat x_motion = player.getHorzMotion().x();
-    GLfloat z_motion = player.getHorzMotion().z();
-
-    const GameWorld     &world = player.getGameWorld();
-    const MyBoundingBox &bbox  = player.getBoundingBox();
+    pOut_result->move = MyVec4(0, 0, 0);
+    pOut_result->hit_floor   = false;
+    pOut_result->hit_ceiling = false;
+    pOut_result->hit_north   = false;
+    pOut_result->hit_south   = false;
+    pOut_result->hit_east    = false;
+    pOut_result->hit_west    = false;
+
+    BlockLookup<T> lookup(source);
+
+    // Work with plain arrays, so we can loop over the axes. 0 = X, 1 = Y, 2 = Z.
+    GLfloat box_min[3] = { bbox.minX(), bbox.minY(), bbox.minZ() };
+    GLfloat box_max[3] = { bbox.maxX(), bbox.maxY(), bbox.maxZ() };
+    GLfloat remaining[3] = { motion.x(), motion.y(), motion.z() };
+    GLfloat moved[3] = { 0.0f, 0.0f, 0.0f };
+
+    for (int pass = 0; pass < MAX_SWEEP_PASSES; pass++) {
+        if ((remaining[0] == 0.0f) && (remaining[1] == 0.0f) && (remaining[2] == 0.0f)) {
+            break;
+        }
 
-    // If the player has no -Z motion, don't bother.
-    if (z_motion >= 0) {
-        return false;
-    }
+        // The range of blocks the box could touch along the way.
+        int block_lo[3];
+        int block_hi[3];
+        for (int i = 0; i < 3; i++) {
+            GLfloat lo = min(box_min[i], box_min[i] + remaining[i]) - CONTACT_TOLERANCE;
+            GLfloat hi = max(box_max[i], box_max[i] + remaining[i]) + CONTACT_TOLERANCE;
+            block_lo[i] = WorldToBlock(lo);
+            block_hi[i] = WorldToBlock(hi);
+        }
 
-    // Shrink the bounding box so that it doesn't scrape the
-    // floor and ceilinng, and vertically a bit to avoid edge cases.
-    GLfloat shrink_x = (::abs(x_motion) * msec) + TWEAK;
+        // Most of the time, there's nothing solid anywhere near us. If so, a few
+        // masked words of solid bits tell us that, and we can skip the whole sweep.
+        GlobalGrid range_lo(block_lo[0], block_lo[1], block_lo[2]);
+        GlobalGrid range_hi(block_hi[0], block_hi[1], block_hi[2]);
+        if (!AnySolidBlockInRange(source, range_lo, range_hi)) {
+            for (int i = 0; i < 3; i++) {
+                moved[i] += remaining[i];
+            }
+            break;
+        }
 
-    // Establish the boundaries of blocks to look at.
-    int min_x = FloorToBlock(bbox.minX() + shrink_x);
-    int max_x = CeilToBlock (bbox.maxX() - shrink_x);
-    int min_y = FloorToBlock(bbox.minY() + TWEAK);
-    int max_y = CeilToBlock (bbox.maxY() - TWEAK);
+        // Find the earliest impact. Ties go to whichever we found first,
+        // and the next pass will pick up the other one.
+        GLfloat best_time = 1.0f;
+        int     best_axis = -1;
+        GLfloat best_face = 0.0f;
+
+        for         (int x = block_lo[0]; x <= block_hi[0]; x++) {
+            for     (int y = block_lo[1]; y <= block_hi[1]; y++) {
+                for (int z = block_lo[2]; z <= block_hi[2]; z++) {
+                    if (!lookup.isFilled(x, y, z)) {
+                        continue;
+                    }
+
+                    int grid[3] = { x, y, z };
+                    GLfloat entry = -FLT_MAX;
+                    GLfloat leave =  FLT_MAX;
+                    int entry_axis = -1;
+                    bool overlaps = true;
+
+                    for (int i = 0; i < 3; i++) {
+                        GLfloat block_min = grid[i] * BLOCK_SCALE;
+                        GLfloat block_max = block_min + BLOCK_SCALE;
+
+                        SweepAxis axis = { box_min[i], box_max[i], remaining[i] };
+                        GLfloat axis_entry, axis_exit;
+                        if (!SweepOneAxis(axis, block_min, block_max, &axis_entry, &axis_exit)) {
+                            overlaps = false;
+                            break;
+                        }
+
+                        if (axis_entry > entry) {
+                            entry = axis_entry;
+                            entry_axis = i;
+                        }
+                        leave = min(leave, axis_exit);
+                    }
+
+                    // No entry axis means we're already stuck inside this block.
+                    // Let the box move on out of it, rather than trapping it there.
+                    if (!overlaps || (entry_axis == -1) || (entry >= leave) || (entry > best_time)) {
+                        continue;
+                    }
+
+                    // Don't let a later tie steal a hit from an earlier one.
+                    if ((entry == best_time) && (best_axis != -1)) {
+                        continue;
+                    }
+
+                    best_time = entry;
+                    best_axis = entry_axis;
+                    best_face = (remaining[entry_axis] > 0.0f) ?
+                        grid[entry_axis] * BLOCK_SCALE :
+                        (grid[entry_axis] + 1) * BLOCK_SCALE;
+                }
+            }
+        }
 
-    int constant_z = FloorToBlock(bbox.minZ());
+        // Nothing in the way, so take the whole rest of the trip.
+        if (best_axis == -1) {
+            for (int i = 0; i < 3; i++) {
+                box_min[i] += remaining[i];
+                box_max[i] += remaining[i];
+                moved[i]   += remaining[i];
+            }
+            break;
+        }
 
-    bool collision = false;
-    for     (int x = min_x; x < max_x; x++) {
-        for (int y = min_y; y < max_y; y++) {
-            GlobalGrid coord(x, y, constant_z);
-            if (IsWorldBlockFilled(world, coord)) {
-                collision = true;
+        // Move up to the point of impact. Along the axis we hit, snap right onto
+        // the block's face, so we don't pile up rounding error tick after tick.
+        bool positive = (remaining[best_axis] > 0.0f);
+        for (int i = 0; i < 3; i++) {
+            GLfloat step = remaining[i] * best_time;
+            if (i == best_axis) {
+                step = positive ?
+                    best_face - box_max[i] :
+                    best_face - box_min[i];
             }
+
+            box_min[i] += step;
+            box_max[i] += step;
+            moved[i]   += step;
+            remaining[i] -= remaining[i] * best_time;
         }
-    }
 
-    // If we collided, prevent further motion in the -Z direction.
-    if (collision) {
-        MyVec4  pos = player.getPlayerPos();
-        GLfloat south_wall = (constant_z + 1) * BLOCK_SCALE;
-        GLfloat offset = (bbox.getDepth() / 2.0f) + TWEAK;
+        // Note what we hit, and slide along it with whatever's left.
+        switch (best_axis) {
+        case 0: (positive ? pOut_result->hit_east    : pOut_result->hit_west)  = true; break;
+        case 1: (positive ? pOut_result->hit_ceiling : pOut_result->hit_floor) = true; break;
+        case 2: (positive ? pOut_result->hit_north   : pOut_result->hit_south) = true; break;
+        default:
+            PrintTheImpossible(__FILE__, __LINE__, best_axis);
+            break;
+        }
 
-        MyVec4  new_pos(pos.x(), pos.y(), south_wall + offset);
-        player.setPlayerPos(new_pos);
-        return true;
+        remaining[best_axis] = 0.0f;
     }
 
-    return false;
+    pOut_result->move = MyVec4(moved[0], moved[1], moved[2]);
 }
 
 
-// Check a collisioin against what's in the +X direction.
-bool CollisionCheckEast(Player &player, int msec)
+// Sweep against the live world. Only do this from the main thread.
+void SweepBoxThroughWorld(
+    const GameWorld &world, const MyBoundingBox &bbox, const MyVec4 &motion, SweepResult *pOut_result)
 {
-    GLfloat x_motion = player.getHorzMotion().x();
-    GLfloat z_motion = player.getHorzMotion().z();
-
-    const GameWorld     &world = player.getGameWorld();
-    const MyBoundingBox &bbox  = player.getBoundingBox();
-
-    // If the player has no +X motion, don't bother.
-    if (x_motion <= 0) {
-        return false;
-    }
-
-    // Shrink the bounding box so that it doesn't scrape the
-    // floor and ceilinng, and vertically a bit to avoid edge cases.
-    GLfloat shrink_z = (::abs(z_motion) * msec) + TWEAK;
-
-    // Establish the boundaries of blocks to look at.
-    int min_y = FloorToBlock(bbox.minY() + TWEAK);
-    int max_y = CeilToBlock (bbox.maxY() - TWEAK);
-    int min_z = FloorToBlock(bbox.minZ() + shrink_z);
-    int max_z = CeilToBlock (bbox.maxZ() - shrink_z);
-
-    int constant_x = FloorToBlock(bbox.maxX());
-
-    bool collision = false;
-    for     (int y = min_y; y < max_y; y++) {
-        for (int z = min_z; z < max_z; z++) {
-            GlobalGrid coord(constant_x, y, z);
-            if (IsWorldBlockFilled(world, coord)) {
-                collision = true;
-            }
-        }
-    }
-
-    // If we collided, prevent further motion in the +X direction.
-    if (collision) {
-        MyVec4  pos = player.getPlayerPos();
-        GLfloat east_wall = constant_x * BLOCK_SCALE;
-        GLfloat offset = (bbox.getWidth() / 2.0f) + TWEAK;
-
-        MyVec4 new_pos(east_wall - offset, pos.y(), pos.z());
-        player.setPlayerPos(new_pos);
-        return true;
-    }
-
-    return false;
+    SweepBox(world, bbox, motion, pOut_result);
 }
 
 
-// Check a collisioin against what's in the -X direction.
-bool CollisionCheckWest(Player &player, int msec)
+// Sweep against a snapshot. This one's safe from worker threads.
+void SweepBoxThroughWorld(
+    const ChunkSnapshot &snapshot, const MyBoundingBox &bbox, const MyVec4 &motion, SweepResult *pOut_result)
 {
-    GLfloat x_motion = player.getHorzMotion().x();
-    GLfloat z_motion = player.getHorzMotion().z();
+    SweepBox(snapshot, bbox, motion, pOut_result);
+}
 
-    const GameWorld     &world = player.getGameWorld();
-    const MyBoundingBox &bbox  = player.getBoundingBox();
 
-    // If the player has no -X motion, don't bother.
-    if (x_motion >= 0) {
-        return false;
+// Move the player for this tick, and sort out what they bumped into.
+// The player's motion doesn't get applied until now, so we can sweep
+// from where they were to where they want to be.
+void PlayerCollisionTest(Player &player, int msec)
+{
+    // If "noclip" is on, don't bother. The player already moved themselves.
+    if (GetConfig().debug.noclip) {
+        return;
     }
 
-    // Shrink the bounding box so that it doesn't scrape the
-    // floor and ceilinng, and vertically a bit to avoid edge cases.
-    GLfloat shrink_z = (::abs(z_motion) * msec) + TWEAK;
+    GLfloat msec_f = static_cast<GLfloat>(msec);
+    MyVec4 motion = player.getHorzMotion().plus(player.getVertMotion()).times(msec_f);
 
-    // Establish the boundaries of blocks to look at.
-    int min_y = FloorToBlock(bbox.minY() + TWEAK);
-    int max_y = CeilToBlock (bbox.maxY() - TWEAK);
-    int min_z = FloorToBlock(bbox.minZ() + shrink_z);
-    int max_z = CeilToBlock (bbox.maxZ() - shrink_z);
+    SweepResult result;
+    SweepBoxThroughWorld(player.getGameWorld(), player.getBoundingBox(), motion, &result);
 
-    int constant_x = FloorToBlock(bbox.minX());
+    MyVec4 new_pos = player.getPlayerPos().plus(result.move);
+    player.setPlayerPos(new_pos);
 
-    bool collision = false;
-    for     (int y = min_y; y < max_y; y++) {
-        for (int z = min_z; z < max_z; z++) {
-            GlobalGrid coord(constant_x, y, z);
-            if (IsWorldBlockFilled(world, coord)) {
-                collision = true;
-            }
-        }
+    player.setOnSolidGround(result.hit_floor);
+    if (result.hit_ceiling) {
+        player.bounceOffCeiling();
     }
 
-    // If we collided, prevent further motion in the -X direction.
-    if (collision) {
-        MyVec4  pos = player.getPlayerPos();
-        GLfloat west_wall = (constant_x + 1) * BLOCK_SCALE;
-        GLfloat offset = (bbox.getWidth() / 2.0f) + TWEAK;
-
-        MyVec4 new_pos(west_wall + offset, pos.y(), pos.z());
-        player.setPlayerPos(new_pos);
-        return true;
-    }
+    // All done. Tell the HUD what we ran into.
+    std::string msg = "";
+    if (result.hit_floor)   { msg += (msg == "") ? "Down"  : " Down";  }
+    if (result.hit_ceiling) { msg += (msg == "") ? "Up"    : " Up";    }
+    if (result.hit_north)   { msg += (msg == "") ? "North" : " North"; }
+    if (result.hit_south)   { msg += (msg == "") ? "South" : " South"; }
+    if (result.hit_east)    { msg += (msg == "") ? "East"  : " East";  }
+    if (result.hit_west)    { msg += (msg == "") ? "West"  : " West";  }
 
-    return false;
+    SetHudCollisionLine(msg);
 }
@@ -1,7 +1,59 @@
 #pragma once
 
 #include "stdafx.h"
+#include "chunk.h"
+#include "my_math.h"
 
+class GameWorld;
 class Player;
 
-void PlayerCollisionTest(Player &player, int msec);
\ No newline at end of file
+
+// A read-only picture of which chunks are loaded, for physics running on worker threads.
+// Chunks are only ever swapped in and out on the main thread, and never while
+// a physics step is in flight, so hanging on to plain pointers is safe. Workers
+// only ever look up blocks through here, and never touch the world's chunk map.
+class ChunkSnapshot
+{
+public:
+    ChunkSnapshot(const GameWorld &world);
+    ~ChunkSnapshot() {}
+
+    const Chunk *getChunk(const ChunkOrigin &origin) const;
+    int getChunkCount() const { return m_chunks.size(); }
+
+private:
+    FORBID_DEFAULT_CTOR(ChunkSnapshot)
+    FORBID_COPYING(ChunkSnapshot)
+    FORBID_MOVING(ChunkSnapshot)
+
+    // Private data. Sorted by origin, so lookups are a binary search.
+    std::vector<std::pair<ChunkOrigin, const Chunk *>> m_chunks;
+};
+
+
+// What happened when we swept a box through the world. "move" is how far
+// the box actually got to go, after sliding along whatever it ran into.
+// The contact flags say which of the box's faces ended up touching a block.
+struct SweepResult
+{
+    MyVec4 move;
+
+    bool hit_floor;
+    bool hit_ceiling;
+    bool hit_north;
+    bool hit_south;
+    bool hit_east;
+    bool hit_west;
+
+    bool hitAnything() const {
+        return hit_floor || hit_ceiling || hit_north || hit_south || hit_east || hit_west;
+    }
+};
+
+void SweepBoxThroughWorld(
+    const GameWorld &world, const MyBoundingBox &bbox, const MyVec4 &motion, SweepResult *pOut_result);
+
+void SweepBoxThroughWorld(
+    const ChunkSnapshot &snapshot, const MyBoundingBox &bbox, const MyVec4 &motion, SweepResult *pOut_result);
+
+void PlayerCollisionTest(Player &player, int msec);
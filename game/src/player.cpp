@@ -219,18 +219,8 @@ void Player::calcStandardMotion(int elapsed_msec, const EventStateMsg &msg)
 
     m_vert_motion = m_vert_motion.plus(add_to_gravity);
 
-    // Apply the vertical and horizontal movement.
-    MyVec4  player_pos = m_player_pos;
-    GLfloat elapsed_msec_f = static_cast<GLfloat>(elapsed_msec);
-
-    MyVec4 vert_in_cm = m_horz_motion.times(elapsed_msec_f);
-    player_pos = MyMatrix4by4::Translate(vert_in_cm).times(player_pos);
-
-    MyVec4 horz_in_cm = m_vert_motion.times(elapsed_msec_f);
-    player_pos = MyMatrix4by4::Translate(horz_in_cm).times(player_pos);
-
-    // Update both the player *and* camera positions.
-    setPlayerPos(player_pos);
+    // Don't apply the movement here. The collision sweep in "PlayerCollisionTest"
+    // takes it from here, and moves the player as far as the world lets them.
 }
 
 
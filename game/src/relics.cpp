@@ -6,6 +6,7 @@
 #include "config.h"
 #include "chunk.h"
 #include "chunk_io.h"
+#include "chunk_source.h"
 #include "draw_state_pct.h"
 #include "event_handler.h"
 #include "game_world.h"
@@ -13,6 +14,7 @@
 #include "hit_test_result.h"
 #include "renderer.h"
 #include "resource_pool.h"
+#include "streaming_buffer.h"
 #include "utils.h"
 #include "wavefront_object.h"
 
@@ -93,6 +95,30 @@ std::string GetDatabaseFilename()
 }
 
 
+// Figure out where the world's chunks come from. Either a world file
+// from the editor, or a generator that makes them up as we go.
+std::unique_ptr<ChunkSource> CreateChunkSource()
+{
+    const ConfigWorld &config = GetConfig().world;
+
+    if (config.procedural) {
+        auto procedural = std::make_unique<ProceduralChunkSource>(config);
+        if (!procedural->init()) {
+            return nullptr;
+        }
+
+        return std::move(procedural);
+    }
+
+    std::string db_fname = GetDatabaseFilename();
+    if (db_fname == "") {
+        return nullptr;
+    }
+
+    return std::make_unique<DatabaseChunkSource>(db_fname);
+}
+
+
 #if 0
 // A main method for testing our Wavefront File parser.
 int WINAPI wWinMain(
@@ -249,15 +275,18 @@ int WINAPI wWinMain(
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
 
-    // Open our database file.
-    std::string db_fname = GetDatabaseFilename();
-    if (db_fname == "") {
-        PrintDebug("Could not open database file!\n");
+    // The streaming buffer. If we can't get one, that's okay, we'll just upload the slow way.
+    CreateStreamingBuffer();
+
+    // Open our database file, or get the generator going.
+    std::unique_ptr<ChunkSource> chunk_source = CreateChunkSource();
+    if (chunk_source == nullptr) {
+        PrintDebug("Could not open database file, or start the generator!\n");
         return 1;
     }
 
     // The game world.
-    std::unique_ptr<GameWorld> game_world = std::make_unique<GameWorld>(db_fname);
+    std::unique_ptr<GameWorld> game_world = std::make_unique<GameWorld>(std::move(chunk_source));
     if (game_world == nullptr) {
         PrintDebug("Could not create the game world!\n");
         return 1;
@@ -312,6 +341,9 @@ int WINAPI wWinMain(
             break;
         }
 
+        // Everything we upload from here on goes into this frame's streaming region.
+        GetStreamingBuffer().beginFrame();
+
         // When enough time has passed, update the game state.
         int new_time = clock.getElapsedTime().asMilliseconds();
         int elapsed  = new_time - now;
@@ -342,11 +374,15 @@ int WINAPI wWinMain(
         // Render the GUI overlay.
         heads_up_display.render(*game_world, stats, fps_snapshot);
 
+        // Fence off this frame's streaming region.
+        GetStreamingBuffer().endFrame();
+
         // All done. Flip to the new results.
         window.display();
     }
 
-    // All done.
+    // All done. Free up the streaming buffer while OpenGL is still around.
+    DestroyStreamingBuffer();
     window.setMouseCursorVisible(true);
 
     // Finally, look for more potential leaks.
@@ -0,0 +1,168 @@
+#include "stdafx.h"
+#include "render_queue.h"
+#include "common_util.h"
+
+
+// How many bits each part of the sort key gets.
+// Program and texture IDs are small numbers handed out by OpenGL,
+// so sixteen bits each is plenty.
+static const int KEY_DEPTH_BITS   = 28;
+static const int KEY_TEXTURE_BITS = 16;
+static const int KEY_PROGRAM_BITS = 16;
+
+static const int KEY_TEXTURE_SHIFT = KEY_DEPTH_BITS;
+static const int KEY_PROGRAM_SHIFT = KEY_TEXTURE_SHIFT + KEY_TEXTURE_BITS;
+static const int KEY_LAYER_SHIFT   = KEY_PROGRAM_SHIFT + KEY_PROGRAM_BITS;
+
+
+// Build a sort key. Anything too big for its slot gets clamped or masked.
+uint64_t MakeRenderKey(RenderLayer layer, GLuint program_ID, GLuint texture_ID, int depth_bucket)
+{
+    const uint64_t DEPTH_MASK   = (1ULL << KEY_DEPTH_BITS)   - 1;
+    const uint64_t TEXTURE_MASK = (1ULL << KEY_TEXTURE_BITS) - 1;
+    const uint64_t PROGRAM_MASK = (1ULL << KEY_PROGRAM_BITS) - 1;
+
+    uint64_t depth = 0;
+    if (depth_bucket > 0) {
+        depth = static_cast<uint64_t>(depth_bucket);
+        if (depth > DEPTH_MASK) {
+            depth = DEPTH_MASK;
+        }
+    }
+
+    uint64_t result =
+        (static_cast<uint64_t>(layer) << KEY_LAYER_SHIFT) |
+        ((program_ID & PROGRAM_MASK)  << KEY_PROGRAM_SHIFT) |
+        ((texture_ID & TEXTURE_MASK)  << KEY_TEXTURE_SHIFT) |
+        depth;
+    return result;
+}
+
+
+// The common part of adding any item.
+RenderItem &RenderQueue::addItem(
+    RenderLayer layer, int depth_bucket, RenderItemType type,
+    const DrawState_Base &draw_state, GLuint texture_ID, const void *vert_list)
+{
+    RenderItem item;
+    item.key  = MakeRenderKey(layer, draw_state.getProgramID(), texture_ID, depth_bucket);
+    item.type = type;
+    item.draw_state      = &draw_state;
+    item.texture         = nullptr;
+    item.cubemap_texture = nullptr;
+    item.vert_list       = vert_list;
+    item.instance_list   = nullptr;
+    item.first_instance  = 0;
+    item.instance_count  = 0;
+
+    m_items.emplace_back(item);
+    return m_items.back();
+}
+
+
+// Add a position-only list. That's the skybox, so it gets a cubemap.
+void RenderQueue::add(
+    RenderLayer layer, int depth_bucket,
+    const DrawState_P &draw_state, const DrawCubemapTexture &cubemap_texture, const VertList_P &vert_list)
+{
+    RenderItem &item = addItem(
+        layer, depth_bucket, RenderItemType::VERTS_P,
+        draw_state, cubemap_texture.getTextureId(), &vert_list);
+    item.cubemap_texture = &cubemap_texture;
+}
+
+
+// Add a position and tex UV list.
+void RenderQueue::add(
+    RenderLayer layer, int depth_bucket,
+    const DrawState_PT &draw_state, const DrawTexture &texture, const VertList_PT &vert_list)
+{
+    RenderItem &item = addItem(
+        layer, depth_bucket, RenderItemType::VERTS_PT,
+        draw_state, texture.getTextureId(), &vert_list);
+    item.texture = &texture;
+}
+
+
+// Add a position, normal, and tex UV list.
+void RenderQueue::add(
+    RenderLayer layer, int depth_bucket,
+    const DrawState_PNT &draw_state, const DrawTexture &texture, const VertList_PNT &vert_list)
+{
+    RenderItem &item = addItem(
+        layer, depth_bucket, RenderItemType::VERTS_PNT,
+        draw_state, texture.getTextureId(), &vert_list);
+    item.texture = &texture;
+}
+
+
+// Add a range of instances of a position, normal, and tex UV list.
+void RenderQueue::add(
+    RenderLayer layer, int depth_bucket,
+    const DrawState_PNT_Instanced &draw_state, const DrawTexture &texture, const VertList_PNT &vert_list,
+    const InstanceList_Move &instance_list, int first_instance, int instance_count)
+{
+    RenderItem &item = addItem(
+        layer, depth_bucket, RenderItemType::VERTS_PNT_INSTANCED,
+        draw_state, texture.getTextureId(), &vert_list);
+    item.texture        = &texture;
+    item.instance_list  = &instance_list;
+    item.first_instance = first_instance;
+    item.instance_count = instance_count;
+}
+
+
+// Sort everything, and draw it. The draw states go through the state cache,
+// so when two items in a row share a program or texture, that's free.
+void RenderQueue::submit()
+{
+    std::sort(m_items.begin(), m_items.end(),
+        [](const RenderItem &a, const RenderItem &b) { return a.key < b.key; });
+
+    for (const RenderItem &item : m_items) {
+        submitItem(item);
+    }
+}
+
+
+// Draw one item. This is where we get our types back.
+void RenderQueue::submitItem(const RenderItem &item) const
+{
+    switch (item.type) {
+    case RenderItemType::VERTS_P: {
+        const auto *draw_state = static_cast<const DrawState_P *>(item.draw_state);
+        const auto *vert_list  = static_cast<const VertList_P *>(item.vert_list);
+        draw_state->updateUniformCubemapTexture(0, *item.cubemap_texture);
+        draw_state->render(*vert_list);
+        break;
+    }
+
+    case RenderItemType::VERTS_PT: {
+        const auto *draw_state = static_cast<const DrawState_PT *>(item.draw_state);
+        const auto *vert_list  = static_cast<const VertList_PT *>(item.vert_list);
+        draw_state->updateUniformTexture(0, *item.texture);
+        draw_state->render(*vert_list);
+        break;
+    }
+
+    case RenderItemType::VERTS_PNT: {
+        const auto *draw_state = static_cast<const DrawState_PNT *>(item.draw_state);
+        const auto *vert_list  = static_cast<const VertList_PNT *>(item.vert_list);
+        draw_state->updateUniformTexture(0, *item.texture);
+        draw_state->render(*vert_list);
+        break;
+    }
+
+    case RenderItemType::VERTS_PNT_INSTANCED: {
+        const auto *draw_state = static_cast<const DrawState_PNT_Instanced *>(item.draw_state);
+        const auto *vert_list  = static_cast<const VertList_PNT *>(item.vert_list);
+        draw_state->updateUniformTexture(0, *item.texture);
+        draw_state->render(*vert_list, *item.instance_list, item.first_instance, item.instance_count);
+        break;
+    }
+
+    default:
+        PrintTheImpossible(__FILE__, __LINE__, static_cast<int>(item.type));
+        break;
+    }
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "draw_cubemap_texture.h"
+#include "draw_state_p.h"
+#include "draw_state_pnt.h"
+#include "draw_state_pnt_instanced.h"
+#include "draw_state_pt.h"
+#include "draw_texture.h"
+
+
+// Which pass a draw item belongs to. This goes in the top bits of the sort key,
+// so the layers always happen in this order, no matter what else is in the key.
+// The far terrain fades in where the landscape fades out, so it has to come after.
+enum class RenderLayer : int
+{
+    SKYBOX      = 0,
+    OPAQUE      = 1,
+    FAR_TERRAIN = 2,
+    OBJECTS     = 3,
+    OVERLAY     = 4
+};
+
+
+// Build a sort key. From the top down, it's the layer, then the program,
+// then the texture, and then whatever depth bucket the caller wants.
+// Sorting by this keeps program and texture switches to a minimum.
+uint64_t MakeRenderKey(RenderLayer layer, GLuint program_ID, GLuint texture_ID, int depth_bucket);
+
+
+// Which kind of vert list a draw item points at.
+enum class RenderItemType : int
+{
+    VERTS_P,
+    VERTS_PT,
+    VERTS_PNT,
+    VERTS_PNT_INSTANCED
+};
+
+
+// One draw call's worth of stuff. Just pointers, since everything here
+// lives in the resource pool or the game world, and outlives the frame.
+struct RenderItem
+{
+    uint64_t       key;
+    RenderItemType type;
+
+    const DrawState_Base     *draw_state;
+    const DrawTexture        *texture;
+    const DrawCubemapTexture *cubemap_texture;
+    const void               *vert_list;
+
+    const InstanceList_Move *instance_list;
+    int first_instance;
+    int instance_count;
+};
+
+
+// Everything we want to draw this frame. Callers set up their uniforms,
+// add their items in whatever order is convenient, and then "submit"
+// sorts it all out. Uniforms live with the program, so those survive the shuffle.
+class RenderQueue
+{
+public:
+    RenderQueue() {}
+    ~RenderQueue() {}
+
+    void clear() { m_items.clear(); }
+
+    void add(RenderLayer layer, int depth_bucket,
+        const DrawState_P &draw_state, const DrawCubemapTexture &cubemap_texture, const VertList_P &vert_list);
+
+    void add(RenderLayer layer, int depth_bucket,
+        const DrawState_PT &draw_state, const DrawTexture &texture, const VertList_PT &vert_list);
+
+    void add(RenderLayer layer, int depth_bucket,
+        const DrawState_PNT &draw_state, const DrawTexture &texture, const VertList_PNT &vert_list);
+
+    void add(RenderLayer layer, int depth_bucket,
+        const DrawState_PNT_Instanced &draw_state, const DrawTexture &texture, const VertList_PNT &vert_list,
+        const InstanceList_Move &instance_list, int first_instance, int instance_count);
+
+    void submit();
+
+    int getItemCount() const { return m_items.size(); }
+
+private:
+    FORBID_COPYING(RenderQueue)
+    FORBID_MOVING(RenderQueue)
+
+    // Private methods.
+    RenderItem &addItem(RenderLayer layer, int depth_bucket, RenderItemType type,
+        const DrawState_Base &draw_state, GLuint texture_ID, const void *vert_list);
+
+    void submitItem(const RenderItem &item) const;
+
+    // Private data. We hang on to this between frames, so it keeps its capacity.
+    std::vector<RenderItem> m_items;
+};
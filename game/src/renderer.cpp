@@ -6,12 +6,23 @@
 #include "config.h"
 #include "draw_state_p.h"
 #include "draw_state_pnt.h"
+#include "draw_state_pnt_instanced.h"
 #include "draw_state_pt.h"
 #include "draw_texture.h"
+#include "far_terrain.h"
+#include "gl_state_cache.h"
+#include "format.h"
 #include "player.h"
 #include "resource_pool.h"
 
 
+// Destructor. The OpenGL context is still around at this point.
+Renderer::~Renderer()
+{
+    freeOverdrawTarget();
+}
+
+
 bool Renderer::init()
 {
     buildSkyboxVertList();
@@ -102,24 +113,17 @@ void Renderer::buildSkyboxVertList()
 }
 
 
-// Get the list of all the chunks we want to render.
-std::vector<const Chunk *> Renderer::getChunksToRender(RenderStats *pOut_stats)
+// Build our left and right frustum planes.
+// Anything that's not above both of these is out of view.
+void Renderer::calcClipPlanes(MyPlane *pOut_left, MyPlane *pOut_right) const
 {
-    std::vector<const Chunk *> results;
-
-    GLfloat field_of_view    = GetConfig().render.field_of_view;
-    int     eval_block_count = GetConfig().logic.eval_block_count;
-    GLfloat draw_distance    = GetConfig().logic.getDrawDistanceCm();
+    GLfloat field_of_view = GetConfig().render.field_of_view;
 
     const Player &player = m_world.getPlayer();
     MyVec4  camera_pos   = player.getCameraPos();
     GLfloat camera_pitch = player.getCameraPitch();
     GLfloat camea_yaw    = player.getCameraYaw();
-    
-    pOut_stats->chunks_considered = 0;
-    pOut_stats->chunks_rendered   = 0;
 
-    // Build our left and right frustum planes.
     MyMatrix4by4 pitch_rotate = MyMatrix4by4::RotateX(-camera_pitch);
 
     GLfloat offset = field_of_view / 2.0f;
@@ -127,16 +131,45 @@ std::vector<const Chunk *> Renderer::getChunksToRender(RenderStats *pOut_stats)
     MyMatrix4by4 left_rotate = MyMatrix4by4::RotateY(camea_yaw - offset);
     MyVec4  left_dir_1 = left_rotate.times(VEC4_EASTWARD);
     MyVec4  left_dir_2 = pitch_rotate.times(left_dir_1);
-    MyPlane left_clip_plane = MyRay(camera_pos, left_dir_2).toPlane();
+    *pOut_left = MyRay(camera_pos, left_dir_2).toPlane();
 
     MyMatrix4by4 right_rotate = MyMatrix4by4::RotateY(camea_yaw + offset);
     MyVec4  right_dir_1 = right_rotate.times(VEC4_WESTWARD);
     MyVec4  right_dir_2 = pitch_rotate.times(right_dir_1);
-    MyPlane right_clip_plane = MyRay(camera_pos, right_dir_2).toPlane();
+    *pOut_right = MyRay(camera_pos, right_dir_2).toPlane();
+}
+
+
+// Get the list of all the chunks we want to render.
+std::vector<const Chunk *> Renderer::getChunksToRender(RenderStats *pOut_stats)
+{
+    std::vector<const Chunk *> results;
 
-    // Look up every chunk within our eval region.
+    int     eval_block_count = GetConfig().logic.eval_block_count;
+    GLfloat draw_distance    = GetConfig().logic.getDrawDistanceCm();
+
+    const Player &player = m_world.getPlayer();
+    MyVec4  camera_pos   = player.getCameraPos();
+    
+    pOut_stats->chunks_considered = 0;
+    pOut_stats->chunks_rendered   = 0;
+
+    MyPlane left_clip_plane;
+    MyPlane right_clip_plane;
+    calcClipPlanes(&left_clip_plane, &right_clip_plane);
+
+    // Look up every chunk within our eval region. We bucket them by ring,
+    // which is how many chunks away they are from the camera's chunk, and
+    // hand them back nearest first. Drawing the opaque stuff front-to-back
+    // lets early-Z throw away whatever is hidden behind it.
+    ChunkOrigin camera_origin = WorldToChunkOrigin(camera_pos);
     EvalRegion region = WorldPosToEvalRegion(camera_pos, eval_block_count);
 
+    m_ring_buckets.resize(eval_block_count + 1);
+    for (auto &bucket : m_ring_buckets) {
+        bucket.clear();
+    }
+
     for     (int x = region.west();  x <= region.east();  x += CHUNK_WIDTH) {
         for (int z = region.south(); z <= region.north(); z += CHUNK_WIDTH) {
             pOut_stats->chunks_considered++;
@@ -149,13 +182,21 @@ std::vector<const Chunk *> Renderer::getChunksToRender(RenderStats *pOut_stats)
                 bool keep = chunk->isAbovePlane(left_clip_plane) &&
                     chunk->isAbovePlane(right_clip_plane);
                 if (keep) {
-                    results.emplace_back(chunk);
+                    int ring = max(
+                        abs(x - camera_origin.x()),
+                        abs(z - camera_origin.z())) / CHUNK_WIDTH;
+                    m_ring_buckets[ring].emplace_back(chunk);
                     pOut_stats->chunks_rendered++;
                 }
             }
         }
     }
 
+    results.reserve(pOut_stats->chunks_rendered);
+    for (const auto &bucket : m_ring_buckets) {
+        results.insert(results.end(), bucket.begin(), bucket.end());
+    }
+
     return std::move(results);
 }
 
@@ -167,40 +208,201 @@ RenderStats Renderer::renderWorld()
 
     RenderStats stats;
 
+    // SFML has been at the OpenGL state since last frame, so don't trust anything.
+    GLStateCache &cache = GetGLStateCache();
+    cache.invalidate();
+    int changes_before = cache.getChangeCount();
+
     // Rebuild our uniform matrices.
     rebuildUniformMatrices();
 
-    // Render the sky.
-    renderSkybox(&stats);
+    // Everything below just queues up draw items. Nothing gets drawn until the end.
+    m_render_queue.clear();
+
+    // Queue up the sky.
+    queueSkybox(&stats);
 
     // Build a list of all our chunks.
     std::vector<const Chunk *> chunk_vec = getChunksToRender(&stats);
 
-    // Render our surfaces.
+    // Queue up our surfaces.
     const auto &pool = GetResourcePool();
     const auto &grass_tex = pool.getGrassTexture();
     const auto &dirt_tex  = pool.getDirtTexture();
     const auto &stone_tex = pool.getStoneTexture();
     const auto &coal_tex  = pool.getCoalTexture();
 
-    renderLandscapeList(SurfaceType::GRASS_TOP, chunk_vec, grass_tex, &stats);
-    renderLandscapeList(SurfaceType::DIRT,      chunk_vec, dirt_tex,  &stats);
-    renderLandscapeList(SurfaceType::STONE,     chunk_vec, stone_tex, &stats);
-    renderLandscapeList(SurfaceType::COAL,      chunk_vec, coal_tex,  &stats);
-
-    // Render any wavefront objects.
-    renderWFObjects(chunk_vec, &stats);
+    queueLandscapeList(SurfaceType::GRASS_TOP, chunk_vec, grass_tex, &stats);
+    queueLandscapeList(SurfaceType::DIRT,      chunk_vec, dirt_tex,  &stats);
+    queueLandscapeList(SurfaceType::STONE,     chunk_vec, stone_tex, &stats);
+    queueLandscapeList(SurfaceType::COAL,      chunk_vec, coal_tex,  &stats);
+
+    // The far terrain, then any wavefront objects, and finally our hit test.
+    // Their layers in the sort key make sure they get drawn in that order.
+    queueFarTerrain(&stats);
+    queueWFObjects(chunk_vec, &stats);
+    queueHitTest(&stats);
+
+    // Sort it all, and draw it.
+    m_render_queue.submit();
+
+    stats.draw_calls    = m_render_queue.getItemCount();
+    stats.state_changes = cache.getChangeCount() - changes_before;
+
+    // If we're measuring overdraw, do it twice. Once the way we really draw,
+    // and once in plain old x-then-z order, so we can see what the sorting buys us.
+    if (conf_render.overdraw.enabled && prepareOverdrawTarget()) {
+        stats.overdraw_front_to_back = measureOverdraw(chunk_vec);
+
+        std::vector<const Chunk *> loop_order = chunk_vec;
+        std::sort(loop_order.begin(), loop_order.end(),
+            [](const Chunk *a, const Chunk *b) {
+                const ChunkOrigin &origin_a = a->getOrigin();
+                const ChunkOrigin &origin_b = b->getOrigin();
+                if (origin_a.x() != origin_b.x()) {
+                    return origin_a.x() < origin_b.x();
+                }
+                return origin_a.z() < origin_b.z();
+            });
 
-    // Finally, render our hit test.
-    renderHitTest(&stats);
+        stats.overdraw_loop_order = measureOverdraw(loop_order);
+    }
 
     return stats;
 }
 
 
+// Make sure our overdraw target exists, and matches the window size.
+// It's a single float channel, so additive blending can count past 255.
+bool Renderer::prepareOverdrawTarget()
+{
+    sf::Vector2u dims = m_window.getSize();
+    int width  = static_cast<int>(dims.x);
+    int height = static_cast<int>(dims.y);
+
+    if ((m_overdraw_fbo != 0) && (width == m_overdraw_width) && (height == m_overdraw_height)) {
+        return true;
+    }
 
-// Render our sky.
-void Renderer::renderSkybox(RenderStats *pOut_stats)
+    freeOverdrawTarget();
+
+    glGenTextures(1, &m_overdraw_color_tex);
+    glBindTexture(GL_TEXTURE_2D, m_overdraw_color_tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, width, height, 0, GL_RED, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenRenderbuffers(1, &m_overdraw_depth_rb);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_overdraw_depth_rb);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &m_overdraw_fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_overdraw_fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_overdraw_color_tex, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_overdraw_depth_rb);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // We just bound a texture behind the state cache's back.
+    GetGLStateCache().invalidate();
+
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        PrintDebug(fmt::format("Overdraw framebuffer is incomplete: {}\n", status));
+        freeOverdrawTarget();
+        return false;
+    }
+
+    m_overdraw_width  = width;
+    m_overdraw_height = height;
+    m_overdraw_pixels.resize(width * height);
+    return true;
+}
+
+
+// Free up the overdraw target. Safe to call even if there isn't one.
+void Renderer::freeOverdrawTarget()
+{
+    if (m_overdraw_fbo != 0) {
+        glDeleteFramebuffers(1, &m_overdraw_fbo);
+        m_overdraw_fbo = 0;
+    }
+
+    if (m_overdraw_depth_rb != 0) {
+        glDeleteRenderbuffers(1, &m_overdraw_depth_rb);
+        m_overdraw_depth_rb = 0;
+    }
+
+    if (m_overdraw_color_tex != 0) {
+        glDeleteTextures(1, &m_overdraw_color_tex);
+        m_overdraw_color_tex = 0;
+    }
+
+    m_overdraw_width  = 0;
+    m_overdraw_height = 0;
+}
+
+
+// Draw the opaque landscape into our overdraw target, in the order given,
+// with every fragment that passes the depth test adding one. Then read it
+// back, and return the average fragments per pixel. This stalls the pipeline,
+// so it's strictly for measuring. Surfaces go in the same order as the queue.
+GLfloat Renderer::measureOverdraw(const std::vector<const Chunk *> &chunk_vec)
+{
+    const Player &player = m_world.getPlayer();
+    GLfloat camera_yaw   = player.getCameraYaw();
+    GLfloat camera_pitch = player.getCameraPitch();
+    MyVec4  camera_pos   = player.getCameraPos();
+
+    const auto &overdraw_ds = GetResourcePool().getOverdrawDrawState();
+
+    overdraw_ds.updateUniformMatrix4by4("mat_frustum", m_frustum_matrix);
+    overdraw_ds.updateUniformFloat("camera_yaw",   camera_yaw);
+    overdraw_ds.updateUniformFloat("camera_pitch", camera_pitch);
+    overdraw_ds.updateUniformVec4("camera_pos",    camera_pos);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_overdraw_fbo);
+
+    const GLfloat zero_color[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    const GLfloat far_depth = 1.0f;
+    glClearBufferfv(GL_COLOR, 0, zero_color);
+    glClearBufferfv(GL_DEPTH, 0, &far_depth);
+
+    glBlendFunc(GL_ONE, GL_ONE);
+
+    const SurfaceType surfaces[] = {
+        SurfaceType::GRASS_TOP, SurfaceType::DIRT, SurfaceType::STONE, SurfaceType::COAL
+    };
+
+    for (SurfaceType surf : surfaces) {
+        for (const Chunk *chunk : chunk_vec) {
+            const VertList_PNT *vert_list = chunk->landscape.getSurfaceList_RO(surf);
+            if ((vert_list != nullptr) && (vert_list->getItemCount() > 0)) {
+                overdraw_ds.render(*vert_list);
+            }
+        }
+    }
+
+    glReadPixels(
+        0, 0, m_overdraw_width, m_overdraw_height,
+        GL_RED, GL_FLOAT, &m_overdraw_pixels[0]);
+
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    double total = 0.0;
+    for (GLfloat val : m_overdraw_pixels) {
+        total += val;
+    }
+
+    return static_cast<GLfloat>(total / m_overdraw_pixels.size());
+}
+
+
+
+// Queue up our sky.
+void Renderer::queueSkybox(RenderStats *pOut_stats)
 {
     const auto &pool = GetResourcePool();
     const auto &skybox_tex = pool.getSkyboxTexture();
@@ -208,15 +410,14 @@ void Renderer::renderSkybox(RenderStats *pOut_stats)
 
     skybox_ds.updateUniformMatrix4by4("mat_frustum", m_frustum_matrix);
     skybox_ds.updateUniformMatrix4by4("mat_frustum_rotate", m_frustum_rotate_matrix);
-    skybox_ds.updateUniformCubemapTexture(0, skybox_tex);
-    skybox_ds.render(m_skybox_vert_list);
 
-    pOut_stats->state_changes++;
+    m_render_queue.add(RenderLayer::SKYBOX, 0, skybox_ds, skybox_tex, m_skybox_vert_list);
+    pOut_stats->triangle_count += m_skybox_vert_list.getTriCount();
 }
 
 
-// Render one of our landscapes. This should use standard depth testing, and no blending.
-void Renderer::renderLandscapeList(
+// Queue up one of our landscapes. This should use standard depth testing, and no blending.
+void Renderer::queueLandscapeList(
     SurfaceType surf, const std::vector<const Chunk *> &chunk_vec, 
     const DrawTexture &tex, RenderStats *pOut_stats)
 {
@@ -251,26 +452,87 @@ void Renderer::renderLandscapeList(
     landscape_ds.updateUniformFloat("camera_pitch", camera_pitch);
     landscape_ds.updateUniformVec4("camera_pos",    camera_pos);
 
-    landscape_ds.updateUniformTexture(0, tex);
-
+    // The chunk list is already nearest first, so its index makes a fine depth bucket.
+    int depth_bucket = 0;
     for (auto iter : chunk_vec) {
+        depth_bucket++;
+
         const VertList_PNT *vert_list = iter->landscape.getSurfaceList_RO(surf);
         if (vert_list != nullptr) {
             int item_count = vert_list->getItemCount();
             if (item_count > 0) {
-                landscape_ds.render(*vert_list);
+                m_render_queue.add(RenderLayer::OPAQUE, depth_bucket, landscape_ds, tex, *vert_list);
                 pOut_stats->triangle_count += vert_list->getTriCount();
             }
         }
     }
+}
+
+
+// Queue up the far terrain, beyond the eval region.
+// Same depth testing and blending as the landscape, but with its own shader.
+void Renderer::queueFarTerrain(RenderStats *pOut_stats)
+{
+    const FarTerrain *far_terrain = m_world.getFarTerrain();
+    if (far_terrain == nullptr) {
+        return;
+    }
+
+    MyPlane left_clip_plane;
+    MyPlane right_clip_plane;
+    calcClipPlanes(&left_clip_plane, &right_clip_plane);
+
+    std::vector<const FarTile *> tile_vec = far_terrain->getTilesToRender(left_clip_plane, right_clip_plane);
+    if (tile_vec.empty()) {
+        return;
+    }
+
+    // Pluck out what we need from the game world.
+    GLfloat fade_distance_cm = GetConfig().render.getFadeDistanceCm();
+    GLfloat near_distance_cm = GetConfig().logic.getDrawDistanceCm();
+    GLfloat far_distance_cm  = GetConfig().render.far_terrain.getDistanceCm();
+
+    const Player &player = m_world.getPlayer();
+    GLfloat camera_yaw   = player.getCameraYaw();
+    GLfloat camera_pitch = player.getCameraPitch();
+    MyVec4  camera_pos   = player.getCameraPos();
+
+    const auto &pool = GetResourcePool();
+    const auto &far_terrain_ds = pool.getFarTerrainDrawState();
+
+    far_terrain_ds.updateUniformMatrix4by4("mat_frustum", m_frustum_matrix);
+    far_terrain_ds.updateUniformFloat("fade_distance", fade_distance_cm);
+    far_terrain_ds.updateUniformFloat("near_distance", near_distance_cm);
+    far_terrain_ds.updateUniformFloat("far_distance",  far_distance_cm);
+
+    far_terrain_ds.updateUniformFloat("camera_yaw",   camera_yaw);
+    far_terrain_ds.updateUniformFloat("camera_pitch", camera_pitch);
+    far_terrain_ds.updateUniformVec4("camera_pos",    camera_pos);
+
+    // Grass and stone. The sort key will group these by texture.
+    const auto &grass_tex = pool.getGrassTexture();
+    const auto &stone_tex = pool.getStoneTexture();
+
+    for (const FarTile *tile : tile_vec) {
+        const VertList_PNT *grass_list = tile->getGrassList();
+        if ((grass_list != nullptr) && (grass_list->getItemCount() > 0)) {
+            m_render_queue.add(RenderLayer::FAR_TERRAIN, 0, far_terrain_ds, grass_tex, *grass_list);
+            pOut_stats->triangle_count += grass_list->getTriCount();
+        }
+
+        const VertList_PNT *stone_list = tile->getStoneList();
+        if ((stone_list != nullptr) && (stone_list->getItemCount() > 0)) {
+            m_render_queue.add(RenderLayer::FAR_TERRAIN, 0, far_terrain_ds, stone_tex, *stone_list);
+            pOut_stats->triangle_count += stone_list->getTriCount();
+        }
+    }
 
-    pOut_stats->state_changes++;
+    pOut_stats->far_tiles_rendered = tile_vec.size();
 }
 
 
-// Render our wavefront objects.
-// TODO: For now, just get this working. Worry about speed later.
-void Renderer::renderWFObjects(
+// Queue up our wavefront objects.
+void Renderer::queueWFObjects(
     std::vector<const Chunk *> &chunk_list, RenderStats *pOut_stats)
 {
     GLfloat fade_distance_cm = GetConfig().render.getFadeDistanceCm();
@@ -291,26 +553,62 @@ void Renderer::renderWFObjects(
     wavefront_ds.updateUniformFloat("camera_pitch", camera_pitch);
     wavefront_ds.updateUniformVec4 ("camera_pos",   camera_pos);
 
+    // Bucket every instance in view by the object it came from.
+    for (auto &iter : m_wf_batch_map) {
+        iter.second.clear();
+    }
+
     for (const auto &chunk_it : chunk_list) {
         for (const auto &instance : chunk_it->getWFInstances()) {
-            const WFObject &original = instance->getOriginal();
+            const WFObject *original = &instance->getOriginal();
+            m_wf_batch_map[original].emplace_back(instance->getMove());
+        }
+    }
 
-            for (const std::string &group_name : original.getGroupNames()) {
-                const auto &face_group   = original.getGroup(group_name);
-                const auto *draw_texture = face_group.getMaterial()->getDrawTexture();
-                const auto &vert_list    = face_group.getVertList();
+    // Pack all the buckets into one instance list, and send it out once.
+    m_wf_instance_list.reset();
+    for (const auto &iter : m_wf_batch_map) {
+        const auto &moves = iter.second;
+        if (moves.size() > 0) {
+            m_wf_instance_list.add(&moves[0], moves.size());
+        }
+    }
 
-                wavefront_ds.updateUniformTexture(0, *draw_texture);
-                wavefront_ds.render(vert_list);
-            }
+    if (m_wf_instance_list.getItemCount() == 0) {
+        return;
+    }
+
+    m_wf_instance_list.update();
+
+    // Now it's one draw call per face group, no matter how many instances there are.
+    int first_instance = 0;
+    for (const auto &iter : m_wf_batch_map) {
+        const WFObject *original = iter.first;
+        int instance_count = iter.second.size();
+        if (instance_count == 0) {
+            continue;
+        }
+
+        for (const WFGroup *face_group : original->getGroupList()) {
+            const auto *draw_texture = face_group->getMaterial()->getDrawTexture();
+            const auto &vert_list    = face_group->getVertList();
+
+            m_render_queue.add(
+                RenderLayer::OBJECTS, 0, wavefront_ds, *draw_texture, vert_list,
+                m_wf_instance_list, first_instance, instance_count);
+
+            pOut_stats->triangle_count += vert_list.getTriCount() * instance_count;
         }
+
+        pOut_stats->wf_instances_rendered += instance_count;
+        first_instance += instance_count;
     }
 }
 
 
-// Render the hit-test program.
+// Queue up the hit-test program.
 // Don't use depth testing here, since it overlays the rest. Allow blending.
-void Renderer::renderHitTest(RenderStats *pOut_stats)
+void Renderer::queueHitTest(RenderStats *pOut_stats)
 {
     const auto &pool = GetResourcePool();
     const auto &hit_test_tex = pool.getHitTestTexture();
@@ -327,16 +625,16 @@ void Renderer::renderHitTest(RenderStats *pOut_stats)
     const VertList_PT &vert_list = m_world.getHitTestVertList();
     int item_count = vert_list.getItemCount();
     if (item_count > 0) {
+        vert_list.refresh();
+
         hit_test_ds.updateUniformMatrix4by4("mat_frustum", m_frustum_matrix);
         hit_test_ds.updateUniformFloat("fade_distance", fade_distance_cm);
         hit_test_ds.updateUniformFloat("draw_distance", draw_distance_cm);
         hit_test_ds.updateUniformFloat("camera_yaw",   camera_yaw);
         hit_test_ds.updateUniformFloat("camera_pitch", camera_pitch);
         hit_test_ds.updateUniformVec4("camera_pos",    camera_pos);
-        hit_test_ds.updateUniformTexture(0, hit_test_tex);
-        hit_test_ds.render(vert_list);
 
-        pOut_stats->state_changes++;
+        m_render_queue.add(RenderLayer::OVERLAY, 0, hit_test_ds, hit_test_tex, vert_list);
         pOut_stats->triangle_count += vert_list.getTriCount();
     }
 }
@@ -3,8 +3,10 @@
 #include "stdafx.h"
 #include "draw_cubemap_texture.h"
 #include "draw_state_p.h"
+#include "draw_state_pnt_instanced.h"
 #include "draw_texture.h"
 #include "game_world.h"
+#include "render_queue.h"
 
 
 struct RenderStats
@@ -13,12 +15,24 @@ struct RenderStats
         chunks_considered(0),
         chunks_rendered(0),
         state_changes(0),
-        triangle_count(0) {}
+        draw_calls(0),
+        triangle_count(0),
+        far_tiles_rendered(0),
+        wf_instances_rendered(0),
+        overdraw_front_to_back(0.0f),
+        overdraw_loop_order(0.0f) {}
 
     int chunks_considered;
     int chunks_rendered;
     int state_changes;
+    int draw_calls;
     int triangle_count;
+    int far_tiles_rendered;
+    int wf_instances_rendered;
+
+    // Average fragments per pixel, only filled in when measuring overdraw.
+    GLfloat overdraw_front_to_back;
+    GLfloat overdraw_loop_order;
 };
 
 
@@ -28,7 +42,15 @@ class Renderer
 public:
     Renderer(const sf::Window &window, const GameWorld &world) :
         m_window(window),
-        m_world(world) {}
+        m_world(world),
+        m_wf_instance_list(UploadType::STREAMING),
+        m_overdraw_fbo(0),
+        m_overdraw_color_tex(0),
+        m_overdraw_depth_rb(0),
+        m_overdraw_width(0),
+        m_overdraw_height(0) {}
+
+    ~Renderer();
 
     bool init();
     RenderStats renderWorld();
@@ -42,19 +64,26 @@ private:
     void rebuildUniformMatrices();
     void buildSkyboxVertList();
 
+    void calcClipPlanes(MyPlane *pOut_left, MyPlane *pOut_right) const;
     std::vector<const Chunk *> getChunksToRender(RenderStats *pOut_stats);
 
-    void renderSkybox(RenderStats *pOut_stats);
+    void queueSkybox(RenderStats *pOut_stats);
 
-    void renderLandscapeList(
+    void queueLandscapeList(
         SurfaceType surf, 
         const std::vector<const Chunk *> &chunk_list,
         const DrawTexture &tex,
         RenderStats *pOut_stats);
 
-    void renderWFObjects(std::vector<const Chunk *> &chunk_list, RenderStats *pOut_stats);
+    void queueFarTerrain(RenderStats *pOut_stats);
+
+    void queueWFObjects(std::vector<const Chunk *> &chunk_list, RenderStats *pOut_stats);
+
+    void queueHitTest(RenderStats *pOut_stats);
 
-    void renderHitTest(RenderStats *pOut_stats);
+    bool prepareOverdrawTarget();
+    void freeOverdrawTarget();
+    GLfloat measureOverdraw(const std::vector<const Chunk *> &chunk_vec);
 
     // Private data.
     const sf::Window &m_window;
@@ -64,4 +93,22 @@ private:
     MyMatrix4by4 m_frustum_rotate_matrix;
 
     VertList_P m_skybox_vert_list;
+
+    RenderQueue m_render_queue;
+
+    // Visible chunks, bucketed by how many chunks away from the camera they are.
+    std::vector<std::vector<const Chunk *>> m_ring_buckets;
+
+    // Every Wavefront instance we're drawing this frame, bucketed by object.
+    // We hang on to these between frames, so the vectors keep their capacity.
+    std::map<const WFObject *, std::vector<Instance_Move>> m_wf_batch_map;
+    InstanceList_Move m_wf_instance_list;
+
+    // For measuring overdraw. Only created if the config asks for it.
+    GLuint m_overdraw_fbo;
+    GLuint m_overdraw_color_tex;
+    GLuint m_overdraw_depth_rb;
+    int    m_overdraw_width;
+    int    m_overdraw_height;
+    std::vector<GLfloat> m_overdraw_pixels;
 };
@@ -39,6 +39,8 @@ void ResourcePool::clear()
     m_landscape_draw_state = nullptr;
     m_skybox_draw_state    = nullptr;
     m_hit_test_draw_state  = nullptr;
+    m_far_terrain_draw_state = nullptr;
+    m_overdraw_draw_state    = nullptr;
 
     m_wfobject_map.clear();
 }
@@ -111,10 +113,10 @@ bool ResourcePool::loadShaders()
         settings.enable_depth_test = true;
         settings.depth_func = GL_LEQUAL;
         settings.draw_mode  = GL_TRIANGLES;
-        settings.vert_shader_fname = conf_render.landscape.vert_shader;
-        settings.frag_shader_fname = conf_render.landscape.frag_shader;
+        settings.vert_shader_fname = conf_render.wavefront.vert_shader;
+        settings.frag_shader_fname = conf_render.wavefront.frag_shader;
 
-        auto result = std::make_unique<DrawState_PNT>(1);
+        auto result = std::make_unique<DrawState_PNT_Instanced>(1);
 
         bool success = (
             result->addUniformMatrix4by4("mat_frustum") &&
@@ -218,6 +220,67 @@ bool ResourcePool::loadShaders()
 
         m_hit_test_draw_state = std::move(result);
     }
+
+    // Init our far terrain draw state, if we're using it.
+    // This fades *in* where the landscape fades out, so it needs the near distance too.
+    if (conf_render.far_terrain.enabled) {
+        DrawStateSettings settings;
+        settings.title = "far_terrain";
+        settings.enable_blending   = true;
+        settings.enable_depth_test = true;
+        settings.depth_func = GL_LEQUAL;
+        settings.draw_mode  = GL_TRIANGLES;
+        settings.vert_shader_fname = conf_render.far_terrain.vert_shader;
+        settings.frag_shader_fname = conf_render.far_terrain.frag_shader;
+
+        auto result = std::make_unique<DrawState_PNT>(1);
+
+        bool success = (
+            result->addUniformMatrix4by4("mat_frustum") &&
+            result->addUniformFloat("fade_distance") &&
+            result->addUniformFloat("near_distance") &&
+            result->addUniformFloat("far_distance") &&
+            result->addUniformFloat("camera_yaw") &&
+            result->addUniformFloat("camera_pitch") &&
+            result->addUniformVec4("camera_pos") &&
+            result->create(settings));
+
+        if (!success) {
+            PrintDebug("Could not create the far terrain draw state. Bye!\n");
+            return false;
+        }
+
+        m_far_terrain_draw_state = std::move(result);
+    }
+
+    // Init our overdraw draw state, if we're measuring that. Every fragment that
+    // passes the depth test adds one, so blending is on, but there are no textures.
+    if (conf_render.overdraw.enabled) {
+        DrawStateSettings settings;
+        settings.title = "overdraw";
+        settings.enable_blending   = true;
+        settings.enable_depth_test = true;
+        settings.depth_func = GL_LEQUAL;
+        settings.draw_mode  = GL_TRIANGLES;
+        settings.vert_shader_fname = conf_render.overdraw.vert_shader;
+        settings.frag_shader_fname = conf_render.overdraw.frag_shader;
+
+        auto result = std::make_unique<DrawState_PNT>(0);
+
+        bool success = (
+            result->addUniformMatrix4by4("mat_frustum") &&
+            result->addUniformFloat("camera_yaw") &&
+            result->addUniformFloat("camera_pitch") &&
+            result->addUniformVec4("camera_pos") &&
+            result->create(settings));
+
+        if (!success) {
+            PrintDebug("Could not create the overdraw draw state. Bye!\n");
+            return false;
+        }
+
+        m_overdraw_draw_state = std::move(result);
+    }
    
     // All done.
     return true;
@@ -6,6 +6,7 @@
 #include "draw_state_p.h"
 #include "draw_state_pt.h"
 #include "draw_state_pnt.h"
+#include "draw_state_pnt_instanced.h"
 #include "draw_texture.h"
 #include "my_math.h"
 #include "wavefront_object.h"
@@ -34,11 +35,17 @@ public:
 
     const DrawCubemapTexture &getSkyboxTexture() const { return *m_skybox_tex; }
 
-    const DrawState_PNT &getWavefrontDrawState() const { return *m_wavefront_draw_state; }
+    const DrawState_PNT_Instanced &getWavefrontDrawState() const { return *m_wavefront_draw_state; }
     const DrawState_PNT &getLandscapeDrawState() const { return *m_landscape_draw_state; }
     const DrawState_P   &getSkyboxDrawState()    const { return *m_skybox_draw_state; }
     const DrawState_PT  &getHitTestDrawState()   const { return *m_hit_test_draw_state; }
 
+    // Only valid if far terrain is enabled in the config.
+    const DrawState_PNT &getFarTerrainDrawState() const { return *m_far_terrain_draw_state; }
+
+    // Only valid if overdraw measurement is enabled in the config.
+    const DrawState_PNT &getOverdrawDrawState() const { return *m_overdraw_draw_state; }
+
 private:
     FORBID_COPYING(ResourcePool)
     FORBID_MOVING(ResourcePool)
@@ -58,10 +65,12 @@ private:
 
     std::unique_ptr<DrawCubemapTexture> m_skybox_tex;
 
-    std::unique_ptr<DrawState_PNT> m_wavefront_draw_state;
+    std::unique_ptr<DrawState_PNT_Instanced> m_wavefront_draw_state;
     std::unique_ptr<DrawState_PNT> m_landscape_draw_state;
     std::unique_ptr<DrawState_P>   m_skybox_draw_state;
     std::unique_ptr<DrawState_PT>  m_hit_test_draw_state;
+    std::unique_ptr<DrawState_PNT> m_far_terrain_draw_state;
+    std::unique_ptr<DrawState_PNT> m_overdraw_draw_state;
 
     std::map<std::string, std::unique_ptr<WFObject>> m_wfobject_map;
 };
@@ -0,0 +1,146 @@
+#include "stdafx.h"
+#include "scratch_arena.h"
+
+#include <atomic>
+
+
+// Totals over every thread's arena.
+static std::atomic<int>    g_scope_count(0);
+static std::atomic<int>    g_heap_alloc_count(0);
+static std::atomic<size_t> g_peak_bytes_used(0);
+
+// Each thread gets its own. The chunk loaders run on the thread pool, so these stick around.
+static thread_local ScratchArena g_scratch_arena;
+
+ScratchArena &GetScratchArena() {
+    return g_scratch_arena;
+}
+
+ScratchStats GetScratchStats() {
+    ScratchStats stats;
+    stats.scope_count      = g_scope_count;
+    stats.heap_alloc_count = g_heap_alloc_count;
+    stats.peak_bytes_used  = g_peak_bytes_used;
+    return stats;
+}
+
+
+// Default ctor. No memory until somebody asks for it.
+ScratchArena::ScratchArena() :
+    m_block_index(0),
+    m_block_used(0),
+    m_bytes_used(0),
+    m_capacity(0),
+    m_peak_bytes_used(0),
+    m_heap_alloc_count(0),
+    m_scope_depth(0)
+{
+    m_blocks.reserve(MAX_BLOCK_COUNT);
+}
+
+
+// Carve out some memory. If the current block's full, move on to
+// the next one, and if we're out of blocks, get another from the heap.
+void *ScratchArena::allocate(size_t byte_count, size_t alignment)
+{
+    assert((alignment > 0) && ((alignment & (alignment - 1)) == 0));
+    assert(m_scope_depth > 0);
+
+    while (m_block_index < static_cast<int>(m_blocks.size())) {
+        Block &block = m_blocks[m_block_index];
+
+        uintptr_t base   = reinterpret_cast<uintptr_t>(block.data.get());
+        uintptr_t start  = (base + m_block_used + (alignment - 1)) & ~(alignment - 1);
+        size_t    offset = start - base;
+
+        if ((offset + byte_count) <= block.size) {
+            m_bytes_used += (offset + byte_count) - m_block_used;
+            m_block_used  = offset + byte_count;
+            return block.data.get() + offset;
+        }
+
+        m_block_index++;
+        m_block_used = 0;
+    }
+
+    addBlock(byte_count + alignment);
+    return allocate(byte_count, alignment);
+}
+
+
+// Get another block from the heap. Each one is at least as big as all the others put
+// together, so a big chunk only takes a few of these. The vector of blocks never grows.
+void ScratchArena::addBlock(size_t min_bytes)
+{
+    assert(static_cast<int>(m_blocks.size()) < MAX_BLOCK_COUNT);
+
+    size_t size = max(max(MIN_BLOCK_BYTES, m_capacity), min_bytes);
+
+    Block block;
+    block.data = std::make_unique<unsigned char[]>(size);
+    block.size = size;
+    m_blocks.emplace_back(std::move(block));
+
+    m_block_index = m_blocks.size() - 1;
+    m_block_used  = 0;
+    m_capacity   += size;
+
+    m_heap_alloc_count++;
+    g_heap_alloc_count++;
+}
+
+
+// Throw everything away. If we needed more than one block, swap them all
+// for one block big enough to hold the lot, so next time we only need the one.
+void ScratchArena::reset()
+{
+    assert(m_scope_depth == 0);
+
+    if (m_bytes_used > m_peak_bytes_used) {
+        m_peak_bytes_used = m_bytes_used;
+
+        size_t peak = g_peak_bytes_used;
+        while ((m_peak_bytes_used > peak) && !g_peak_bytes_used.compare_exchange_weak(peak, m_peak_bytes_used)) {
+        }
+    }
+
+    if (m_blocks.size() > 1) {
+        size_t total = m_capacity;
+
+        m_blocks.clear();
+        m_capacity = 0;
+        addBlock(total);
+    }
+
+    m_block_index = 0;
+    m_block_used  = 0;
+    m_bytes_used  = 0;
+}
+
+
+// Leave a scope. Only the outermost one counts.
+void ScratchArena::endScope()
+{
+    assert(m_scope_depth > 0);
+
+    m_scope_depth--;
+    if (m_scope_depth == 0) {
+        reset();
+        g_scope_count++;
+    }
+}
+
+
+// Ctor. Start a scope on this thread's arena.
+ScratchScope::ScratchScope() :
+    m_arena(GetScratchArena())
+{
+    m_arena.beginScope();
+}
+
+
+// Destructor. Everything allocated since the outermost scope started goes away.
+ScratchScope::~ScratchScope()
+{
+    m_arena.endScope();
+}
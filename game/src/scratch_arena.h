@@ -0,0 +1,140 @@
+#pragma once
+
+#include "stdafx.h"
+
+
+// A bump allocator for throwaway data, like everything that gets built up while
+// loading and meshing a chunk. Allocating is just moving a pointer along, and freeing
+// does nothing at all. Everything goes away at once, when the outermost scope ends.
+// Resetting keeps the memory around, and if it took more than one block last time,
+// they get merged into one big block, so after the first few chunks, building
+// one doesn't touch the heap. Each thread has its own arena, so no locking.
+class ScratchArena
+{
+public:
+    ScratchArena();
+    ~ScratchArena() {}
+
+    void *allocate(size_t byte_count, size_t alignment);
+    void reset();
+
+    void beginScope() { m_scope_depth++; }
+    void endScope();
+
+    // Getters.
+    size_t getBytesUsed()     const { return m_bytes_used; }
+    size_t getCapacity()      const { return m_capacity; }
+    size_t getPeakBytesUsed() const { return m_peak_bytes_used; }
+    int    getHeapAllocCount() const { return m_heap_alloc_count; }
+
+private:
+    FORBID_COPYING(ScratchArena)
+    FORBID_MOVING(ScratchArena)
+
+    // Private methods.
+    void addBlock(size_t min_bytes);
+
+    // Private data.
+    static const size_t MIN_BLOCK_BYTES = 1024 * 1024;
+    static const int    MAX_BLOCK_COUNT = 32;
+
+    struct Block
+    {
+        std::unique_ptr<unsigned char[]> data;
+        size_t size;
+    };
+
+    std::vector<Block> m_blocks;
+    int    m_block_index;
+    size_t m_block_used;
+
+    size_t m_bytes_used;
+    size_t m_capacity;
+    size_t m_peak_bytes_used;
+    int    m_heap_alloc_count;
+    int    m_scope_depth;
+};
+
+
+// Everything allocated from this thread's arena inside one of these gets freed when it ends.
+// Scopes can nest, and only the outermost one actually resets anything.
+class ScratchScope
+{
+public:
+    ScratchScope();
+    ~ScratchScope();
+
+private:
+    FORBID_COPYING(ScratchScope)
+    FORBID_MOVING(ScratchScope)
+
+    ScratchArena &m_arena;
+};
+
+
+// Get at the calling thread's arena.
+ScratchArena &GetScratchArena();
+
+
+// Totals over every arena, for the HUD. If the heap count stops
+// going up while the scope count keeps going, we're in steady state.
+struct ScratchStats
+{
+    int    scope_count;
+    int    heap_alloc_count;
+    size_t peak_bytes_used;
+};
+
+ScratchStats GetScratchStats();
+
+
+// Lets the standard containers allocate out of an arena. With no arena,
+// it's just the plain old heap, for data that has to outlive the scope,
+// or get handed off to another thread.
+template<typename T>
+class ScratchAllocator
+{
+public:
+    typedef T value_type;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    ScratchAllocator() : m_arena(&GetScratchArena()) {}
+    explicit ScratchAllocator(ScratchArena *arena) : m_arena(arena) {}
+
+    template<typename U>
+    ScratchAllocator(const ScratchAllocator<U> &other) : m_arena(other.getArena()) {}
+
+    T *allocate(size_t count) {
+        if (m_arena == nullptr) {
+            return static_cast<T *>(::operator new(count * sizeof(T)));
+        }
+        return static_cast<T *>(m_arena->allocate(count * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *ptr, size_t count) {
+        if (m_arena == nullptr) {
+            ::operator delete(ptr);
+        }
+    }
+
+    ScratchArena *getArena() const { return m_arena; }
+
+private:
+    ScratchArena *m_arena;
+};
+
+template<typename T, typename U>
+inline bool operator==(const ScratchAllocator<T> &a, const ScratchAllocator<U> &b) {
+    return a.getArena() == b.getArena();
+}
+
+template<typename T, typename U>
+inline bool operator!=(const ScratchAllocator<T> &a, const ScratchAllocator<U> &b) {
+    return a.getArena() != b.getArena();
+}
+
+
+// A vector that lives in the calling thread's arena, unless it's told otherwise.
+template<typename T>
+using ScratchVector = std::vector<T, ScratchAllocator<T>>;
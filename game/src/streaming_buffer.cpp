@@ -0,0 +1,194 @@
+#include "stdafx.h"
+#include "streaming_buffer.h"
+#include "common_util.h"
+
+#include "config.h"
+#include "format.h"
+
+
+// Our one expedient streaming buffer.
+static StreamingBuffer g_streaming_buffer;
+
+bool CreateStreamingBuffer() {
+    int region_bytes = GetConfig().render.streaming_buffer_megs * 1024 * 1024;
+    return g_streaming_buffer.create(region_bytes);
+}
+
+void DestroyStreamingBuffer() {
+    g_streaming_buffer.destroy();
+}
+
+StreamingBuffer &GetStreamingBuffer() {
+    return g_streaming_buffer;
+}
+
+
+// Default ctor. Nothing happens until "create".
+StreamingBuffer::StreamingBuffer() :
+    m_buffer_ID(0),
+    m_mapped(nullptr),
+    m_in_frame(false),
+    m_region_bytes(0),
+    m_region_index(0),
+    m_region_used(0),
+    m_frame_number(0),
+    m_stall_count(0)
+{
+    m_fences.fill(nullptr);
+}
+
+
+// Destructor. By now, the OpenGL context might be long gone,
+// so don't touch anything here. Call "destroy" before that happens.
+StreamingBuffer::~StreamingBuffer()
+{
+}
+
+
+// Create our buffer storage, and map it for good.
+// This needs OpenGL 4.4 or the "ARB_buffer_storage" extension.
+bool StreamingBuffer::create(int region_bytes)
+{
+    assert(!isCreated());
+    assert(region_bytes > 0);
+
+    if (!GLEW_ARB_buffer_storage) {
+        PrintDebug("No support for buffer storage. Streaming buffer is disabled.\n");
+        return false;
+    }
+
+    GLsizeiptr total_bytes = static_cast<GLsizeiptr>(region_bytes) * REGION_COUNT;
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    glGenBuffers(1, &m_buffer_ID);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer_ID);
+    glBufferStorage(GL_COPY_WRITE_BUFFER, total_bytes, nullptr, flags);
+
+    void *mapped = glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, total_bytes, flags);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    if (mapped == nullptr) {
+        PrintDebug("Could not map the streaming buffer. Streaming buffer is disabled.\n");
+        glDeleteBuffers(1, &m_buffer_ID);
+        m_buffer_ID = 0;
+        return false;
+    }
+
+    m_mapped = static_cast<unsigned char *>(mapped);
+    m_region_bytes = region_bytes;
+    m_region_index = 0;
+    m_region_used  = 0;
+
+    PrintDebug(fmt::format(
+        "Created a streaming buffer, {0} regions of {1} bytes.\n",
+        REGION_COUNT, ReadableNumber(region_bytes)));
+    return true;
+}
+
+
+// Free everything up. Safe to call even if we were never created.
+void StreamingBuffer::destroy()
+{
+    for (auto &fence : m_fences) {
+        if (fence != nullptr) {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+
+    if (m_buffer_ID != 0) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer_ID);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        glDeleteBuffers(1, &m_buffer_ID);
+        m_buffer_ID = 0;
+    }
+
+    m_mapped = nullptr;
+}
+
+
+// Start a new frame. If the GPU is still reading from the region we're
+// about to write into, we have to wait. With three regions, that should be rare.
+// If it's still not done after waiting, we can't touch that region, so this
+// frame doesn't stream at all. Everything falls back to its own buffer, and
+// the next frame tries the same region again.
+void StreamingBuffer::beginFrame()
+{
+    if (!isCreated()) {
+        return;
+    }
+
+    GLsync &fence = m_fences[m_region_index];
+    if (fence != nullptr) {
+        GLenum result = glClientWaitSync(fence, 0, 0);
+        if ((result == GL_TIMEOUT_EXPIRED) || (result == GL_WAIT_FAILED)) {
+            m_stall_count++;
+
+            // One second, in nanoseconds. If it takes longer than that, we've got bigger problems.
+            const GLuint64 ONE_SECOND = 1000000000;
+            result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, ONE_SECOND);
+            if ((result == GL_TIMEOUT_EXPIRED) || (result == GL_WAIT_FAILED)) {
+                PrintDebug(fmt::format("Streaming buffer region {} is still busy, skipping a frame.\n", m_region_index));
+                return;
+            }
+        }
+
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    m_region_used = 0;
+    m_in_frame = true;
+}
+
+
+// End a frame. Fence off whatever we wrote, and move on to the next region.
+// If "beginFrame" couldn't get us a region, there's nothing to fence off.
+void StreamingBuffer::endFrame()
+{
+    if (!isCreated() || !m_in_frame) {
+        return;
+    }
+
+    GLsync &fence = m_fences[m_region_index];
+    assert(fence == nullptr);
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    m_region_index = (m_region_index + 1) % REGION_COUNT;
+    m_frame_number++;
+    m_in_frame = false;
+}
+
+
+// Grab some space in the current region. Return null if there's no room,
+// and the caller will have to do things the old-fashioned way.
+// The offset is from the start of the whole buffer, not the region.
+// Outside of a frame there's no fence to protect us, so don't hand anything out.
+void *StreamingBuffer::allocate(int byte_count, int alignment, GLintptr *pOut_offset)
+{
+    if (!isCreated() || !m_in_frame) {
+        return nullptr;
+    }
+
+    assert(alignment > 0);
+
+    // Vertex lists draw from "first = offset / vertex size", so the offset
+    // has to be a multiple of the alignment from the start of the whole buffer.
+    GLintptr base   = static_cast<GLintptr>(m_region_index) * m_region_bytes;
+    GLintptr offset = base + m_region_used;
+
+    int remainder = static_cast<int>(offset % alignment);
+    if (remainder != 0) {
+        offset += alignment - remainder;
+    }
+
+    if ((offset + byte_count) > (base + m_region_bytes)) {
+        return nullptr;
+    }
+
+    m_region_used = static_cast<int>((offset + byte_count) - base);
+
+    *pOut_offset = offset;
+    return m_mapped + offset;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "stdafx.h"
+
+
+// One big vertex buffer, mapped once and left mapped forever, carved up into
+// three regions. Each frame writes into the next region, and a fence tells us
+// when the GPU is done reading from it. This means uploading vertex data is
+// just a memcpy, with no "glBufferData" reallocations, and no driver stalls.
+// Everything in here must only be called from the main thread.
+class StreamingBuffer
+{
+public:
+    static const int REGION_COUNT = 3;
+
+    StreamingBuffer();
+    ~StreamingBuffer();
+
+    bool create(int region_bytes);
+    void destroy();
+
+    void beginFrame();
+    void endFrame();
+
+    void *allocate(int byte_count, int alignment, GLintptr *pOut_offset);
+
+    bool   isCreated()      const { return m_mapped != nullptr; }
+    GLuint getBufferID()    const { return m_buffer_ID; }
+    int    getFrameNumber() const { return m_frame_number; }
+    int    getStallCount()  const { return m_stall_count; }
+    int    getRegionUsed()  const { return m_region_used; }
+    bool   isInFrame()      const { return m_in_frame; }
+
+private:
+    FORBID_COPYING(StreamingBuffer)
+    FORBID_MOVING(StreamingBuffer)
+
+    // Private data.
+    GLuint m_buffer_ID;
+    unsigned char *m_mapped;
+    bool m_in_frame;
+
+    int m_region_bytes;
+    int m_region_index;
+    int m_region_used;
+
+    int m_frame_number;
+    int m_stall_count;
+
+    std::array<GLsync, REGION_COUNT> m_fences;
+};
+
+
+// Get at our one expedient global streaming buffer.
+// If it couldn't be created, uploads fall back to the old ways.
+bool CreateStreamingBuffer();
+void DestroyStreamingBuffer();
+StreamingBuffer &GetStreamingBuffer();
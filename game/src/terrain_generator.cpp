@@ -0,0 +1,195 @@
+#include "stdafx.h"
+#include "terrain_generator.h"
+
+#include "common_util.h"
+#include "dirt_levels.h"
+#include "format.h"
+#include "simplex_noise.h"
+
+
+// Turn a seed into how far to slide the noise. Salt it, so each kind of noise
+// lands somewhere different. Zero leaves the noise alone, so with the same
+// heightmap and settings, we build exactly what the world editor would.
+static double SeedToNoiseOffset(int seed, uint32_t salt)
+{
+    if (seed == 0) {
+        return 0.0;
+    }
+
+    uint32_t hash = static_cast<uint32_t>(seed) ^ (salt * 2654435761u);
+    hash = (hash * 1664525u) + 1013904223u;
+    hash ^= (hash >> 16);
+
+    // Somewhere from 0 to 4096, in noise units. Any further, and floats get grainy.
+    return (hash % 65536) / 16.0;
+}
+
+
+// How many bits deep a PNG's samples are, from its header, or zero if it isn't a PNG.
+// SFML quietly squashes 16-bit PNGs down to 8 bits, so this is how we spot them.
+static int ReadPngBitDepth(const std::string &fname)
+{
+    static const unsigned char SIGNATURE[8] = { 137, 'P', 'N', 'G', '\r', '\n', 26, '\n' };
+
+    // The signature, then the IHDR chunk's length, type, width and height, then the depth.
+    unsigned char header[25] = {};
+    std::ifstream file(fname, std::ios::binary);
+    if (!file.read(reinterpret_cast<char *>(header), sizeof(header))) {
+        return 0;
+    }
+
+    if ((memcmp(header, SIGNATURE, sizeof(SIGNATURE)) != 0) || (memcmp(&header[12], "IHDR", 4) != 0)) {
+        return 0;
+    }
+
+    return header[24];
+}
+
+
+// The column recipe for our config, with the stone noise slid over by the seed.
+static ColumnRecipe MakeColumnRecipe(const ConfigGenerator &config)
+{
+    ColumnRecipe recipe;
+    recipe.stone_percent      = config.stone_percent;
+    recipe.stone_subtracted   = config.stone_subtracted;
+    recipe.stone_displacement = config.stone_displacement;
+    recipe.stone_noise_scale  = config.stone_noise_scale;
+    recipe.coal_density       = config.coal_density;
+    recipe.noise_offset_x     = SeedToNoiseOffset(config.seed, 1);
+    recipe.noise_offset_z     = SeedToNoiseOffset(config.seed, 2);
+    return recipe;
+}
+
+
+// Ctor. Nothing gets loaded until "init".
+TerrainGenerator::TerrainGenerator(const ConfigGenerator &config) :
+    m_config(config),
+    m_recipe(MakeColumnRecipe(config)),
+    m_hills_offset_x(SeedToNoiseOffset(config.seed, 3)),
+    m_hills_offset_z(SeedToNoiseOffset(config.seed, 4)),
+    m_hmap_width(0),
+    m_hmap_height(0)
+{
+}
+
+
+// Load the heightmap, if there is one. Return false if there is, but it won't load.
+// Only 8-bit heightmaps work here, since that's all SFML reads. The world editor
+// spreads 16-bit ones over the heights differently, so rather than quietly build
+// something else, those get turned away.
+bool TerrainGenerator::init()
+{
+    if (m_config.heightmap.empty()) {
+        PrintDebug("No heightmap, so the generator will make up fractal hills.\n");
+        return true;
+    }
+
+    std::string full_name = RESOURCE_PATH + m_config.heightmap;
+
+    int bit_depth = ReadPngBitDepth(full_name);
+    if (bit_depth > 8) {
+        PrintDebug(fmt::format(
+            "Heightmap '{0}' is {1} bits. The generator only does 8-bit heightmaps.\n",
+            full_name, bit_depth));
+        return false;
+    }
+
+    sf::Image image;
+    if (!image.loadFromFile(full_name)) {
+        PrintDebug(fmt::format("Could not load heightmap '{}'.\n", full_name));
+        return false;
+    }
+
+    sf::Vector2u size = image.getSize();
+    m_hmap_width  = static_cast<int>(size.x);
+    m_hmap_height = static_cast<int>(size.y);
+    m_hmap_heights.resize(m_hmap_width * m_hmap_height);
+
+    for     (int y = 0; y < m_hmap_height; y++) {
+        for (int x = 0; x < m_hmap_width;  x++) {
+            sf::Color color = image.getPixel(x, y);
+            int level = EightBitToLevel(color.r, color.g, color.b);
+            m_hmap_heights[x + (m_hmap_width * y)] = LevelToDirtHeight(level, 8);
+        }
+    }
+
+    PrintDebug(fmt::format(
+        "Generator heightmap '{0}' is {1} x {2}, and repeats forever.\n",
+        m_config.heightmap, m_hmap_width, m_hmap_height));
+    return true;
+}
+
+
+// How high the dirt goes for a column. Negative means nothing gets built there.
+// The editor puts the center of the heightmap at the origin, with Z going up the
+// image, so we do the same, and then just wrap around at the edges.
+int TerrainGenerator::calcDirtHeight(int world_x, int world_z) const
+{
+    if (m_hmap_heights.empty()) {
+        return calcFractalHeight(world_x, world_z);
+    }
+
+    int x = world_x + (m_hmap_width / 2);
+    int y = (m_hmap_height / 2) - world_z;
+
+    x -= RoundDownInt(x, m_hmap_width);
+    y -= RoundDownInt(y, m_hmap_height);
+
+    return m_hmap_heights[x + (m_hmap_width * y)];
+}
+
+
+// Rolling hills, from a few octaves of noise. Each octave is twice as
+// bumpy as the last, and counts for half as much.
+int TerrainGenerator::calcFractalHeight(int world_x, int world_z) const
+{
+    double total     = 0.0;
+    double weight    = 0.0;
+    double amplitude = 1.0;
+    double frequency = 1.0 / FRACTAL_SCALE;
+
+    for (int octave = 0; octave < FRACTAL_OCTAVES; octave++) {
+        double noise_x = (world_x * frequency) + m_hills_offset_x;
+        double noise_z = (world_z * frequency) + m_hills_offset_z;
+
+        total  += amplitude * simplex_noise_2(noise_x, noise_z);
+        weight += amplitude;
+
+        amplitude *= 0.5;
+        frequency *= 2.0;
+    }
+
+    int height = FRACTAL_BASE_HEIGHT + static_cast<int>((total / weight) * FRACTAL_HEIGHT_RANGE);
+    if (height < 0) {
+        height = 0;
+    }
+
+    return height;
+}
+
+
+// Given our landscape top, calc where the stone top goes.
+int TerrainGenerator::calcStoneHeight(int world_x, int world_z, int dirt_height) const
+{
+    return CalcStoneHeight(m_recipe, world_x, world_z, dirt_height);
+}
+
+
+// Calc the blocks and rows for one column, the same way the world editor does.
+void TerrainGenerator::calcColumn(int world_x, int world_z, GeneratedColumn *pOut) const
+{
+    CalcColumn(m_recipe, world_x, world_z, calcDirtHeight(world_x, world_z), pOut);
+}
+
+
+// Everything that changes what gets generated.
+std::string TerrainGenerator::getDescription() const
+{
+    return fmt::format(
+        "seed={0} heightmap='{1}' stone_percent={2} stone_subtracted={3} "
+        "stone_displacement={4} stone_noise_scale={5} coal_density={6}",
+        m_config.seed, m_config.heightmap,
+        m_config.stone_percent, m_config.stone_subtracted,
+        m_config.stone_displacement, m_config.stone_noise_scale,
+        m_config.coal_density);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "stdafx.h"
+#include "column_recipe.h"
+#include "config.h"
+#include "utils.h"
+
+
+// Makes up terrain from scratch, one column at a time. It's the same recipe the
+// world editor bakes into world files, from "column_recipe.h": dirt from a heightmap,
+// stone under that, pushed up and down by 2D noise, and coal wherever 3D noise dips.
+// The difference is the heightmap repeats forever, or if there isn't one,
+// a few octaves of noise make the hills. Nothing changes after "init",
+// so any number of loader threads can share one of these.
+class TerrainGenerator
+{
+public:
+    TerrainGenerator(const ConfigGenerator &config);
+    ~TerrainGenerator() {}
+
+    bool init();
+
+    int  calcDirtHeight(int world_x, int world_z) const;
+    int  calcStoneHeight(int world_x, int world_z, int dirt_height) const;
+    void calcColumn(int world_x, int world_z, GeneratedColumn *pOut) const;
+
+    // Everything that changes what gets generated, so stale caches can be spotted.
+    std::string getDescription() const;
+
+private:
+    FORBID_DEFAULT_CTOR(TerrainGenerator)
+    FORBID_COPYING(TerrainGenerator)
+    FORBID_MOVING(TerrainGenerator)
+
+    // Private methods.
+    int calcFractalHeight(int world_x, int world_z) const;
+
+    // Private data. The fractal hills, for when there's no heightmap.
+    static const int FRACTAL_OCTAVES = 5;
+    static const int FRACTAL_BASE_HEIGHT = 48;
+    static const int FRACTAL_HEIGHT_RANGE = 40;
+    static const int FRACTAL_SCALE = 256;
+
+    ConfigGenerator m_config;
+    ColumnRecipe m_recipe;
+
+    // The seed just slides the noise somewhere else. The stone's slide is in the recipe.
+    double m_hills_offset_x;
+    double m_hills_offset_z;
+
+    // The heightmap, already turned into dirt heights. Indexed by "x + (width * y)".
+    int m_hmap_width;
+    int m_hmap_height;
+    std::vector<int> m_hmap_heights;
+};
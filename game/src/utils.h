@@ -1,6 +1,7 @@
 
 #pragma once
 
+#include "block_surfaces.h"
 #include "my_math.h"
 
 // A breakpoint to be triggered just once, when we hit the spacebar.
@@ -28,19 +29,8 @@ bool IsFutureReady(std::future<R> const& f) {
 }
 
 
-// Useful general-purpose enums and functions.
-enum class FaceType
-{
-    NONE   = 0,
-    SOUTH  = 1,
-    NORTH  = 2,
-    WEST   = 3,
-    EAST   = 4,
-    TOP    = 5,
-    BOTTOM = 6
-};
-
-
+// Useful general-purpose enums and functions. "FaceType" is in "block_surfaces.h",
+// since the world editor needs it too.
 enum class EdgeType
 {
     NONE  = 0,
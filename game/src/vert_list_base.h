@@ -1,6 +1,19 @@
 #pragma once
 
 #include "stdafx.h"
+#include "streaming_buffer.h"
+
+
+// How a vert list gets its data to the video card.
+// Static lists keep their own buffer, which only ever grows, and the data
+// gets there by way of the streaming buffer, using a GPU-side copy.
+// Streaming lists get drawn straight out of the streaming buffer,
+// which is what you want for anything that changes every frame.
+enum class UploadType
+{
+    STATIC,
+    STREAMING
+};
 
 
 // A call to "clear" can reset these, but otherwise, we'll alway rebuild from scratch.
@@ -9,7 +22,7 @@ template<typename T>
 class VertList_Base
 {
 public:
-    VertList_Base();
+    VertList_Base(UploadType upload_type = UploadType::STATIC);
 
     virtual ~VertList_Base();
 
@@ -17,8 +30,10 @@ public:
 
     void addQuad(const T(&items)[4]);
     void add(const T *items, int count);
+    void patch(int first, const T *items, int count);
     void reset();
     bool update();
+    bool refresh() const;
 
     void reserve(int cap) { m_verts.reserve(cap); }
 
@@ -26,27 +41,46 @@ public:
     inline int  getItemCount() const { return m_verts.size(); }
     inline int  getByteCount() const { return m_verts.size() * sizeof(T); }
     inline int  getTriCount()  const { return m_verts.size() / 3; }
-    inline GLuint getVertexBufferID() const { return m_vertex_buffer_ID; }
+    inline int  getFirstItem() const { return m_first_item; }
+    inline GLuint getVertexBufferID() const { return m_draw_buffer_ID; }
     inline const std::vector<T> &getVerts() const { return m_verts; }
 
 private:
     FORBID_COPYING(VertList_Base)
 
-    // Private data.
+    // Private methods.
+    bool uploadToStream() const;
+    void uploadToOwnBuffer() const;
+
+    // Private data. The mutable stuff is just bookkeeping for where
+    // the verts currently live, which "refresh" is allowed to move around.
+    UploadType m_upload_type;
     GLuint m_vertex_buffer_ID;
     bool   m_current;
     std::vector<T> m_verts;
+
+    mutable int    m_capacity_bytes;
+    mutable GLuint m_draw_buffer_ID;
+    mutable int    m_first_item;
+    mutable int    m_upload_frame;
 };
 
 
 // Default ctor. Get our buffer ID.
 template<typename T>
-VertList_Base<T>::VertList_Base() :
+VertList_Base<T>::VertList_Base(UploadType upload_type) :
+    m_upload_type(upload_type),
     m_vertex_buffer_ID(0),
-    m_current(false)
+    m_current(false),
+    m_capacity_bytes(0),
+    m_draw_buffer_ID(0),
+    m_first_item(0),
+    m_upload_frame(-1)
 {
     glGenBuffers(1, &m_vertex_buffer_ID);
     assert(m_vertex_buffer_ID != 0);
+
+    m_draw_buffer_ID = m_vertex_buffer_ID;
 }
 
 
@@ -56,6 +90,7 @@ VertList_Base<T>::~VertList_Base()
 {
     glDeleteBuffers(1, &m_vertex_buffer_ID);
     m_vertex_buffer_ID = 0;
+    m_draw_buffer_ID = 0;
 }
 
 
@@ -83,6 +118,38 @@ void VertList_Base<T>::add(const T *items, int count)
 }
 
 
+// Overwrite some verts that are already there. If the list is already up
+// on the video card, in its own buffer, just send that range along. Otherwise,
+// the whole thing goes out with the next "update", like usual.
+template<typename T>
+void VertList_Base<T>::patch(int first, const T *items, int count)
+{
+    assert((first >= 0) && ((first + count) <= static_cast<int>(m_verts.size())));
+
+    if (count == 0) {
+        return;
+    }
+
+    for (int i = 0; i < count; i++) {
+        m_verts[first + i] = items[i];
+    }
+
+    bool on_card =
+        m_current &&
+        (m_upload_type == UploadType::STATIC) &&
+        (m_draw_buffer_ID == m_vertex_buffer_ID);
+
+    if (!on_card) {
+        m_current = false;
+        return;
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_vertex_buffer_ID);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, first * sizeof(T), count * sizeof(T), &m_verts.at(first));
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+
 // Empty out everything.
 // If we are realized, that's okay, but free that up first.
 template<typename T>
@@ -109,14 +176,103 @@ bool VertList_Base<T>::update()
         return false;
     }
 
-    // Update the buffer.
+    // Streaming lists try the streaming buffer first. If it's full, or
+    // we're outside of a frame, then fall back to our own buffer.
+    if ((m_upload_type != UploadType::STREAMING) || !uploadToStream()) {
+        uploadToOwnBuffer();
+    }
+
+    m_current = true;
+    return true;
+}
+
+
+// A streaming list only lives in the streaming buffer for one frame.
+// If we're drawing it again in a later frame, send it again.
+// This is logically const, since the verts themselves don't change.
+template<typename T>
+bool VertList_Base<T>::refresh() const
+{
+    if ((m_upload_type != UploadType::STREAMING) || (m_verts.size() == 0)) {
+        return false;
+    }
+
+    const StreamingBuffer &stream = GetStreamingBuffer();
+    if ((m_draw_buffer_ID != stream.getBufferID()) ||
+        (m_upload_frame == stream.getFrameNumber())) {
+        return false;
+    }
+
+    if (!uploadToStream()) {
+        uploadToOwnBuffer();
+    }
+
+    return true;
+}
+
+
+// Copy our verts into the streaming buffer, and draw from there.
+// The offset has to land on a whole vertex, so "first" comes out even.
+template<typename T>
+bool VertList_Base<T>::uploadToStream() const
+{
+    StreamingBuffer &stream = GetStreamingBuffer();
+
     const int byte_count = m_verts.size() * sizeof(T);
-    const int item_count = m_verts.size();
 
-    glBindBuffer(GL_ARRAY_BUFFER, m_vertex_buffer_ID);
-    glBufferData(GL_ARRAY_BUFFER, byte_count, &m_verts.at(0), GL_STATIC_DRAW);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    GLintptr offset = 0;
+    void *dest = stream.allocate(byte_count, sizeof(T), &offset);
+    if (dest == nullptr) {
+        return false;
+    }
 
-    m_current = true;
+    memcpy(dest, &m_verts.at(0), byte_count);
+
+    m_draw_buffer_ID = stream.getBufferID();
+    m_first_item     = static_cast<int>(offset / sizeof(T));
+    m_upload_frame   = stream.getFrameNumber();
     return true;
 }
+
+
+// Copy our verts into our own buffer. We only reallocate when we need to grow,
+// and then by half again, so a chunk that gets edited a lot settles down fast.
+// If there's room in the streaming buffer, stage through that, and let the
+// GPU do the copy. Otherwise, it's a plain old "glBufferSubData".
+template<typename T>
+void VertList_Base<T>::uploadToOwnBuffer() const
+{
+    const int byte_count = m_verts.size() * sizeof(T);
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_vertex_buffer_ID);
+
+    if (byte_count > m_capacity_bytes) {
+        int new_capacity = m_capacity_bytes + (m_capacity_bytes / 2);
+        if (new_capacity < byte_count) {
+            new_capacity = byte_count;
+        }
+
+        glBufferData(GL_COPY_WRITE_BUFFER, new_capacity, nullptr, GL_STATIC_DRAW);
+        m_capacity_bytes = new_capacity;
+    }
+
+    StreamingBuffer &stream = GetStreamingBuffer();
+
+    GLintptr offset = 0;
+    void *staging = stream.allocate(byte_count, 4, &offset);
+    if (staging != nullptr) {
+        memcpy(staging, &m_verts.at(0), byte_count);
+        glBindBuffer(GL_COPY_READ_BUFFER, stream.getBufferID());
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offset, 0, byte_count);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+    else {
+        glBufferSubData(GL_COPY_WRITE_BUFFER, 0, byte_count, &m_verts.at(0));
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    m_draw_buffer_ID = m_vertex_buffer_ID;
+    m_first_item     = 0;
+    m_upload_frame   = -1;
+}
@@ -297,8 +297,10 @@ void WFObject::createFaceGroup(int line_num, const std::string &name)
         return;
     }
 
+    auto group = std::make_unique<WFGroup>(name);
     m_group_names.emplace_back(name);
-    m_group_map.emplace(name, std::make_unique<WFGroup>(name));
+    m_group_list.emplace_back(group.get());
+    m_group_map.emplace(name, std::move(group));
 }
 
 
@@ -118,6 +118,11 @@ public:
         return *m_group_map.at(name);
     }
 
+    // Same groups as above, but no map lookups. Good for rendering.
+    const std::vector<const WFGroup *> &getGroupList() const {
+        return m_group_list;
+    }
+
     std::string toDescr() const;
     bool conclude() const;
 
@@ -161,6 +166,7 @@ private:
 
     std::vector<std::string> m_group_names;
     std::map<std::string, std::unique_ptr<WFGroup>> m_group_map;
+    std::vector<const WFGroup *> m_group_list;
 };
 
 
@@ -0,0 +1,107 @@
+#include "stdafx.h"
+#include "worker_pool.h"
+
+
+// Default ctor. One thread for every core but ours, since the caller pitches in too.
+WorkerPool::WorkerPool() :
+    m_stopping(false)
+{
+    int thread_count = static_cast<int>(std::thread::hardware_concurrency()) - 1;
+    if (thread_count < 1) {
+        thread_count = 1;
+    }
+
+    for (int i = 0; i < thread_count; i++) {
+        m_threads.emplace_back(&WorkerPool::workerLoop, this);
+    }
+}
+
+
+// Destructor. Nobody can be waiting on a job by now, so just tell everybody to quit.
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_slice_ready.notify_all();
+
+    for (auto &thread : m_threads) {
+        thread.join();
+    }
+}
+
+
+// Run "func" over [0, count), a slice at a time. The calling thread runs slices too,
+// rather than just sitting there, and returns once the last one is done.
+void WorkerPool::runSlices(int count, int slice_size, const SliceFunc &func)
+{
+    if (count <= 0) {
+        return;
+    }
+
+    assert(slice_size > 0);
+    if (count <= slice_size) {
+        func(0, count);
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    int slices_left = 0;
+    for (int first = 0; first < count; first += slice_size) {
+        int last = first + slice_size;
+        if (last > count) {
+            last = count;
+        }
+
+        m_slices.push_back(Slice{ &func, first, last, &slices_left });
+        slices_left++;
+    }
+
+    m_slice_ready.notify_all();
+
+    while (slices_left > 0) {
+        if (!m_slices.empty()) {
+            Slice slice = m_slices.front();
+            m_slices.pop_front();
+            runSlice(slice, &lock);
+        }
+        else {
+            m_slice_done.wait(lock);
+        }
+    }
+}
+
+
+// Each worker just runs slices until we shut down.
+void WorkerPool::workerLoop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    for (;;) {
+        m_slice_ready.wait(lock, [this]() { return m_stopping || !m_slices.empty(); });
+        if (m_stopping) {
+            return;
+        }
+
+        Slice slice = m_slices.front();
+        m_slices.pop_front();
+        runSlice(slice, &lock);
+    }
+}
+
+
+// Run one slice, with the lock let go while it runs, and
+// wake up whoever's waiting if it was their last one.
+void WorkerPool::runSlice(const Slice &slice, std::unique_lock<std::mutex> *pLock)
+{
+    pLock->unlock();
+    (*slice.func)(slice.first, slice.last);
+    pLock->lock();
+
+    (*slice.slices_left)--;
+    if (*slice.slices_left == 0) {
+        m_slice_done.notify_all();
+    }
+}
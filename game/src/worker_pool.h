@@ -0,0 +1,56 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+
+// A few threads that stick around for the whole game, for splitting up work the
+// main thread needs done right now, like stepping entities, or a batch of hit tests.
+// Starting a thread every time would cost more than some of these jobs do.
+// The caller hands over a count and a slice size, and the slices get run on the
+// workers and on the calling thread, and it doesn't return until they're all done.
+// Anything that fits in one slice just runs on the calling thread.
+// Only the main thread should be handing out work.
+class WorkerPool
+{
+public:
+    WorkerPool();
+    ~WorkerPool();
+
+    typedef std::function<void(int first, int last)> SliceFunc;
+    void runSlices(int count, int slice_size, const SliceFunc &func);
+
+    int getThreadCount() const { return static_cast<int>(m_threads.size()); }
+
+private:
+    FORBID_COPYING(WorkerPool)
+    FORBID_MOVING(WorkerPool)
+
+    // One slice of one job. It points back at the job's count of
+    // slices still to go, which lives on the caller's stack.
+    struct Slice
+    {
+        const SliceFunc *func;
+        int first;
+        int last;
+        int *slices_left;
+    };
+
+    // Private methods.
+    void workerLoop();
+    void runSlice(const Slice &slice, std::unique_lock<std::mutex> *pLock);
+
+    // Private data.
+    std::mutex m_mutex;
+    std::condition_variable m_slice_ready;
+    std::condition_variable m_slice_done;
+    std::deque<Slice> m_slices;
+    bool m_stopping;
+
+    std::vector<std::thread> m_threads;
+};
@@ -0,0 +1,63 @@
+#include "stdafx.h"
+#include "world_edit_batch.h"
+
+#include "utils.h"
+
+
+// Change one block. Anything above or below the world gets quietly dropped.
+void WorldEditBatch::setBlock(const GlobalGrid &coord, BlockType block_type)
+{
+    if (coord.isWithinWorld()) {
+        m_edits.emplace_back(coord, block_type);
+    }
+}
+
+
+// Fill a box of blocks. Both corners are inclusive, and can come in either order.
+void WorldEditBatch::fillRegion(const GlobalGrid &lower, const GlobalGrid &upper, BlockType block_type)
+{
+    int min_x = min(lower.x(), upper.x());
+    int max_x = max(lower.x(), upper.x());
+    int min_z = min(lower.z(), upper.z());
+    int max_z = max(lower.z(), upper.z());
+
+    // Clip the height to the world, since anything else would get dropped anyway.
+    int min_y = max(min(lower.y(), upper.y()), 0);
+    int max_y = min(max(lower.y(), upper.y()), CHUNK_HEIGHT - 1);
+    if (min_y > max_y) {
+        return;
+    }
+
+    m_edits.reserve(m_edits.size() +
+        (max_x - min_x + 1) * (max_y - min_y + 1) * (max_z - min_z + 1));
+
+    for         (int x = min_x; x <= max_x; x++) {
+        for     (int z = min_z; z <= max_z; z++) {
+            for (int y = min_y; y <= max_y; y++) {
+                m_edits.emplace_back(GlobalGrid(x, y, z), block_type);
+            }
+        }
+    }
+}
+
+
+// Fill a ball of blocks. A block's in if its center is within the radius of the center block's.
+void WorldEditBatch::fillSphere(const GlobalGrid &center, int radius, BlockType block_type)
+{
+    if (radius < 0) {
+        return;
+    }
+
+    int radius_squared = radius * radius;
+
+    for         (int dx = -radius; dx <= radius; dx++) {
+        for     (int dz = -radius; dz <= radius; dz++) {
+            for (int dy = -radius; dy <= radius; dy++) {
+                if (((dx * dx) + (dy * dy) + (dz * dz)) <= radius_squared) {
+                    GlobalGrid coord(center.x() + dx, center.y() + dy, center.z() + dz);
+                    setBlock(coord, block_type);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "stdafx.h"
+#include "common_util.h"
+#include "my_math.h"
+
+
+// One block change.
+struct BlockEdit
+{
+    BlockEdit(const GlobalGrid &arg_coord, BlockType arg_block_type) :
+        coord(arg_coord), block_type(arg_block_type) {}
+
+    GlobalGrid coord;
+    BlockType  block_type;
+};
+
+
+// A whole pile of block changes, to be applied all at once by "GameWorld::applyEditBatch".
+// Explosions, placing structures, fill tools, that sort of thing. The point is that
+// nothing gets remeshed until the very end, and then each dirty section only once.
+// Edits can cross chunk boundaries, and if two edits hit the same block, the later one wins.
+class WorldEditBatch
+{
+public:
+    WorldEditBatch() {}
+    ~WorldEditBatch() {}
+
+    void setBlock(const GlobalGrid &coord, BlockType block_type);
+    void fillRegion(const GlobalGrid &lower, const GlobalGrid &upper, BlockType block_type);
+    void fillSphere(const GlobalGrid &center, int radius, BlockType block_type);
+    void clear() { m_edits.clear(); }
+
+    int getEditCount() const { return m_edits.size(); }
+    const std::vector<BlockEdit> &getEdits() const { return m_edits; }
+
+private:
+    FORBID_COPYING(WorldEditBatch)
+    FORBID_MOVING(WorldEditBatch)
+
+    // Private data.
+    std::vector<BlockEdit> m_edits;
+};
@@ -4,7 +4,25 @@
 
 -- The world itself.
 world = {
-    file_name = 'worlds/collision_pit.world'
+    file_name = 'worlds/collision_pit.world',
+
+    -- Or skip the world file, and make the world up as we walk around it.
+    -- Anything generated gets kept in the cache file, so it's only made once.
+    procedural = false,
+    cache_name = 'worlds/generated.cache',
+
+    -- The heightmap repeats forever. Leave it blank for fractal hills instead.
+    -- It has to be 8 bits, since 16-bit PNGs and raw files won't load here.
+    -- A seed of zero with the same heightmap matches what the editor bakes.
+    generator = {
+        seed = 0,
+        heightmap = '',
+        stone_percent = 50,
+        stone_subtracted = 4,
+        stone_displacement = 8,
+        stone_noise_scale = 100,
+        coal_density = 1.0
+    }
 }
 
 -- Debugging.
@@ -14,6 +32,8 @@ debug = {
 
     noclip = false,
     draw_transitions = true,
+    physics_benchmark = false,
+    meshing_benchmark = false,
 
     hud_game_clock = true,
     hud_framerate = true,
@@ -54,6 +74,8 @@ render = {
     far_plane      = 1000.0,
     fade_distance  = 5.0,
 
+    streaming_buffer_megs = 16,
+
     wavefront = {
         vert_shader = 'shaders/wavefront_PNT.vert',
         frag_shader = 'shaders/wavefront_PNT.frag'
@@ -86,6 +108,21 @@ render = {
         vert_shader = 'shaders/hit_test_PT.vert',
         frag_shader = 'shaders/hit_test_PT.frag',
         texture = 'textures/hit_test.png'
+    },
+
+    -- Heightfield-only terrain beyond the eval region. Distance is in meters.
+    far_terrain = {
+        enabled  = false,
+        distance = 500.0,
+        vert_shader = 'shaders/far_terrain_PNT.vert',
+        frag_shader = 'shaders/far_terrain_PNT.frag'
+    },
+
+    -- Overdraw measurement. Shows average fragments per pixel in the render stats.
+    overdraw = {
+        enabled = false,
+        vert_shader = 'shaders/landscape_PNT.vert',
+        frag_shader = 'shaders/overdraw_PNT.frag'
     }
 }
 
@@ -0,0 +1,57 @@
+#version 330
+
+// Our "far terrain" frag shader.
+// This is the mirror image of the landscape shader. Where the landscape
+// fades out at the edge of the eval region, we fade in, and then we fade
+// out again at the far distance.
+
+uniform float     fade_distance;
+uniform float     near_distance;
+uniform float     far_distance;
+uniform sampler2D textures[1];
+
+
+in vec2  var_texuv;
+in float var_incident;
+in float var_dist;
+
+
+layout(location = 0) out vec4 FragColor;
+
+
+void main() {
+    float fade_in_start  = near_distance - fade_distance;
+    float fade_out_start = far_distance  - fade_distance;
+
+    // Inside the eval region, the real landscape has this covered.
+    // Discard rather than draw nothing, so we don't write to the depth buffer.
+    if ((var_dist < fade_in_start) || (var_dist > far_distance)) {
+        discard;
+    }
+
+    // 50 percent seems like a suitable amount of the effect.
+    float fresnel = 0.5 * (1 - var_incident);
+
+    // Darken things a bit when we're not looking at them dead-on.
+    vec4 tex_color = mix(
+        texture2D(textures[0], var_texuv),
+        vec4(0, 0, 0, 1),
+        fresnel);
+
+    // Fade in across the edge of the eval region.
+    if (var_dist < near_distance) {
+        float mix_factor = (var_dist - fade_in_start) / fade_distance;
+        FragColor = mix(vec4(tex_color.rgb, 0.0), tex_color, mix_factor);
+    }
+
+    // Fade out towards the horizon.
+    else if (var_dist > fade_out_start) {
+        float mix_factor = (var_dist - fade_out_start) / fade_distance;
+        FragColor = mix(tex_color, vec4(tex_color.rgb, 0.0), mix_factor);
+    }
+
+    // Everything in-between, draw normally.
+    else {
+        FragColor = tex_color;
+    }
+}
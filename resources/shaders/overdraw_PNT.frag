@@ -0,0 +1,19 @@
+#version 330
+
+// Our "overdraw" frag shader. Paired with the landscape vert shader.
+// Every fragment that makes it this far adds one to the red channel,
+// and with additive blending into a float target, that's a fragment count.
+
+in vec2  var_texuv;
+in float var_incident;
+in float var_dist;
+
+
+layout(location = 0) out vec4 FragColor;
+
+
+void main() {
+    // Only red lands in the target. The rest just keeps the
+    // vert shader's outputs, and therefore its attributes, alive.
+    FragColor = vec4(1.0, var_texuv.x, var_incident, var_dist);
+}
@@ -1,10 +1,12 @@
 #version 330
 
-// Our "landscape" vert shader.
+// Our "wavefront" vert shader. Same as the landscape, except every
+// instance of an object gets moved into place by its own "in_move".
 
-layout (location = 0) in vec4 in_position;
-layout (location = 4) in vec4 in_normal;
-layout (location = 8) in vec2 in_texuv;
+layout (location = 0)  in vec4 in_position;
+layout (location = 4)  in vec4 in_normal;
+layout (location = 8)  in vec2 in_texuv;
+layout (location = 12) in vec4 in_move;
 
 
 uniform mat4  mat_frustum;
@@ -44,17 +46,16 @@ mat4 rotate_y(float r) {
 
 void main()
 {
-    float angle_of_view = radians(45.0);
-    float aspect_ratio  = 1920.0 / 1080.0;
+    vec4 world_pos = in_position + vec4(in_move.xyz, 0.0);
 
     gl_Position = mat_frustum
         * rotate_x(radians( camera_pitch))
         * rotate_y(radians(-camera_yaw))
         * translate(-camera_pos.x, -camera_pos.y, -camera_pos.z)
-        * in_position;
+        * world_pos;
 
     var_texuv    = in_texuv;
-    var_incident = dot(in_normal, normalize(camera_pos - in_position));
-    var_dist     = distance(camera_pos.xz, in_position.xz);
+    var_incident = dot(in_normal, normalize(camera_pos - world_pos));
+    var_dist     = distance(camera_pos.xz, world_pos.xz);
 }
 
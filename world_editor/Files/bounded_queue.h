@@ -0,0 +1,81 @@
+#pragma once
+
+#include "stdafx.h"
+
+
+// A first-in, first-out queue with a fixed limit, for handing work from
+// a bunch of producer threads to one consumer. Pushing blocks while the queue
+// is full, and popping blocks while it's empty. That way the producers can't
+// run too far ahead of the consumer, and pile up memory.
+// Closing the queue wakes everybody up. After that, pushes fail, and pops
+// only succeed until whatever's left has been drained.
+template<typename T>
+class BoundedQueue
+{
+public:
+    BoundedQueue(int max_size) :
+        m_max_size(max_size),
+        m_closed(false) {}
+
+    ~BoundedQueue() {}
+
+    // Add an item, waiting for room if we have to.
+    // Return false if the queue was closed, in which case the item is dropped.
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_not_full.wait(lock, [this]() {
+            return m_closed || (static_cast<int>(m_items.size()) < m_max_size);
+        });
+
+        if (m_closed) {
+            return false;
+        }
+
+        m_items.emplace_back(std::move(item));
+        m_not_empty.notify_one();
+        return true;
+    }
+
+    // Take the oldest item, waiting for one if we have to.
+    // Return false if the queue was closed and there's nothing left.
+    bool pop(T *pOut) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_not_empty.wait(lock, [this]() {
+            return m_closed || !m_items.empty();
+        });
+
+        if (m_items.empty()) {
+            return false;
+        }
+
+        *pOut = std::move(m_items.front());
+        m_items.pop_front();
+        m_not_full.notify_one();
+        return true;
+    }
+
+    // No more pushing. Anybody waiting gets woken up.
+    void close() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_not_full.notify_all();
+        m_not_empty.notify_all();
+    }
+
+private:
+    // Disallow the default ctor, copying, and moving.
+    BoundedQueue() = delete;
+    BoundedQueue(const BoundedQueue &that) = delete;
+    void operator=(const BoundedQueue &that) = delete;
+    BoundedQueue(BoundedQueue &&that) = delete;
+    void operator=(BoundedQueue &&that) = delete;
+
+    // Private data.
+    std::mutex m_mutex;
+    std::condition_variable m_not_full;
+    std::condition_variable m_not_empty;
+
+    std::list<T> m_items;
+    int  m_max_size;
+    bool m_closed;
+};
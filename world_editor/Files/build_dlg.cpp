@@ -0,0 +1,144 @@
+#include "stdafx.h"
+#include "build_dlg.h"
+
+#include "format.h"
+
+enum {
+    ID_PROGRESS_TIMER
+};
+
+
+// How often to show the latest progress, in msecs.
+static const int PROGRESS_TIMER_MSECS = 100;
+
+// The gauge goes from zero to this.
+static const int GAUGE_RANGE = 1000;
+
+
+// The only allowed ctor. Start saving to this file right away.
+// The caller needs to call "ShowModal".
+BuildDialog::BuildDialog(wxWindow *parent, const BuildSettings &settings, const DirtHeightMap &height_map,
+                         const std::string &fname) :
+    wxDialog(parent, wxID_ANY, "Saving World"),
+    m_generator(settings, height_map),
+    m_fname(fname),
+    m_success(false),
+    m_progress_timer(this, ID_PROGRESS_TIMER)
+{
+    const int BORDER = 5;
+    const int GAUGE_WIDTH = 400;
+
+    // The gauge, and the numbers under it.
+    m_gauge = new wxGauge(this, wxID_ANY, GAUGE_RANGE, wxDefaultPosition, wxSize(GAUGE_WIDTH, -1));
+    m_progress_text = new wxStaticText(this, wxID_ANY, "Starting...\n\n\n");
+
+    wxStaticBoxSizer *progress_box = new wxStaticBoxSizer(wxVERTICAL, this, wxT(" Progress "));
+    progress_box->Add(m_gauge, 0, wxALL | wxEXPAND, BORDER);
+    progress_box->Add(m_progress_text, 1, wxALL | wxEXPAND, BORDER);
+
+    // Just the one button.
+    m_cancel_button = new wxButton(this, wxID_CANCEL, wxT("Cancel"));
+
+    wxBoxSizer *vbox = new wxBoxSizer(wxVERTICAL);
+    vbox->Add(progress_box, 1, wxALL | wxEXPAND, BORDER);
+    vbox->Add(m_cancel_button, 0, wxALL | wxALIGN_RIGHT, BORDER);
+    SetSizerAndFit(vbox);
+
+    // Bind our events.
+    Bind(wxEVT_BUTTON, &BuildDialog::onCancelClick, this, wxID_CANCEL);
+    Bind(wxEVT_CLOSE_WINDOW, &BuildDialog::onClose, this);
+    Bind(wxEVT_TIMER, &BuildDialog::onProgressTimer, this, ID_PROGRESS_TIMER);
+
+    // And away we go. The generator calls us from its own thread,
+    // so all we do there is hang onto the latest.
+    m_generator.setProgressFunc([this](const BuildProgress &progress) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_latest_progress = progress;
+    });
+
+    m_result = std::async(std::launch::async, [this]() {
+        return m_generator.saveToDatabase(m_fname, &m_build_stats);
+    });
+
+    m_progress_timer.Start(PROGRESS_TIMER_MSECS);
+}
+
+
+// Dtor. If we're somehow still saving, stop, and wait for it.
+BuildDialog::~BuildDialog()
+{
+    m_progress_timer.Stop();
+
+    if (m_result.valid()) {
+        m_generator.cancel();
+        m_result.wait();
+    }
+}
+
+
+// Show this progress.
+void BuildDialog::showProgress(const BuildProgress &progress)
+{
+    m_shown_progress = progress;
+    m_gauge->SetValue(static_cast<int>(progress.getFraction() * GAUGE_RANGE));
+    m_progress_text->SetLabel(progress.toString());
+}
+
+
+// The save's done. Grab how it went, and close.
+void BuildDialog::finish()
+{
+    m_progress_timer.Stop();
+    m_success = m_result.get();
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        showProgress(m_latest_progress);
+    }
+
+    EndModal(m_success ? wxID_OK : wxID_CANCEL);
+}
+
+
+// Ask the generator to stop. It finishes the region it's on, so
+// we don't close until the timer sees that it's stopped.
+void BuildDialog::onCancelClick(wxCommandEvent &event)
+{
+    m_generator.cancel();
+    m_cancel_button->Disable();
+    m_progress_text->SetLabel(m_shown_progress.toString() + "\nCancelling...");
+}
+
+
+// Closing the window is the same as cancelling.
+void BuildDialog::onClose(wxCloseEvent &event)
+{
+    if (!m_generator.wasCancelled()) {
+        wxCommandEvent dummy;
+        onCancelClick(dummy);
+    }
+
+    if (event.CanVeto()) {
+        event.Veto();
+    }
+}
+
+
+// Show the latest progress, and close once the save is done.
+void BuildDialog::onProgressTimer(wxTimerEvent &event)
+{
+    if (m_result.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+        finish();
+        return;
+    }
+
+    BuildProgress progress;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        progress = m_latest_progress;
+    }
+
+    if (!m_generator.wasCancelled()) {
+        showProgress(progress);
+    }
+}
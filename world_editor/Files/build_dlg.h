@@ -0,0 +1,63 @@
+#pragma once
+
+#include "stdafx.h"
+#include "build_progress.h"
+#include "build_settings.h"
+#include "build_stats.h"
+#include "world_generator.h"
+
+
+// Saves a world in the background, and shows how it's going. The generator runs on a
+// thread of its own, and tells us about every region it finishes. We only keep the
+// latest, and the timer shows it, so the dialog never waits on the generator, and the
+// generator never waits on the dialog. Cancelling stops after the region it's on, and
+// the dialog closes itself once the save is done, one way or another.
+class BuildDialog : public wxDialog
+{
+public:
+    BuildDialog(wxWindow *parent, const BuildSettings &settings, const DirtHeightMap &height_map,
+                const std::string &fname);
+    ~BuildDialog();
+
+    // How it went. Only good once the dialog's closed.
+    bool wasSuccessful() const { return m_success; }
+    bool wasCancelled() const { return m_generator.wasCancelled(); }
+    const BuildStats &getBuildStats() const { return m_build_stats; }
+    const BuildProgress &getProgress() const { return m_shown_progress; }
+    const std::string &getLastError() const { return m_generator.getLastError(); }
+
+private:
+    // Disallow the default ctor, copying, and moving.
+    BuildDialog() = delete;
+    BuildDialog(const BuildDialog &that) = delete;
+    void operator=(const BuildDialog &that) = delete;
+    BuildDialog(BuildDialog &&that) = delete;
+    void operator=(BuildDialog &&that) = delete;
+
+    // Private methods.
+    void showProgress(const BuildProgress &progress);
+    void finish();
+
+    void onCancelClick(wxCommandEvent &event);
+    void onClose(wxCloseEvent &event);
+    void onProgressTimer(wxTimerEvent &event);
+
+    // Private data. The generator has to outlive the thread that's using it.
+    WorldGenerator m_generator;
+    std::string m_fname;
+    std::future<bool> m_result;
+
+    BuildStats m_build_stats;
+    bool m_success;
+
+    // The latest progress, from the generator's thread.
+    std::mutex m_mutex;
+    BuildProgress m_latest_progress;
+
+    // What we're showing.
+    BuildProgress m_shown_progress;
+    wxGauge *m_gauge;
+    wxStaticText *m_progress_text;
+    wxButton *m_cancel_button;
+    wxTimer m_progress_timer;
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "stdafx.h"
+#include "common_util.h"
+#include "format.h"
+
+
+// How far along a save is. Just simple data, no resources. Columns are heightmap
+// pixels. A save that picks up where an earlier one stopped counts what that one
+// already did as done, but only what this one did counts towards the speed.
+class BuildProgress
+{
+public:
+    // Default ctor.
+    BuildProgress() :
+        regions_done(0),
+        regions_total(0),
+        regions_resumed(0),
+        columns_done(0),
+        columns_total(0),
+        columns_resumed(0),
+        elapsed_secs(0.0) {}
+
+    // How far along, from zero to one.
+    double getFraction() const {
+        if (columns_total <= 0) {
+            return (regions_done >= regions_total) ? 1.0 : 0.0;
+        }
+        return columns_done / static_cast<double>(columns_total);
+    }
+
+    // Columns per second, for this save only.
+    double getColumnsPerSec() const {
+        if (elapsed_secs <= 0.0) {
+            return 0.0;
+        }
+        return (columns_done - columns_resumed) / elapsed_secs;
+    }
+
+    // How long until we're done, going at the speed we've gone so far.
+    // Negative if there's nothing to go on yet.
+    double getSecsLeft() const {
+        double speed = getColumnsPerSec();
+        if (speed <= 0.0) {
+            return -1.0;
+        }
+        return (columns_total - columns_done) / speed;
+    }
+
+    // Show this as a string.
+    std::string toString() const {
+        std::string result = fmt::format(
+            "Regions: {0} of {1}, {2:0.1f}%\n"
+            "Columns: {3} of {4}",
+            regions_done, regions_total, getFraction() * 100.0,
+            columns_done, columns_total);
+
+        if (regions_resumed > 0) {
+            result += fmt::format("\nPicked up {0} regions from an earlier save.", regions_resumed);
+        }
+
+        double secs_left = getSecsLeft();
+        if (secs_left >= 0.0) {
+            result += fmt::format(
+                "\nSpeed:   {0} columns/sec, about {1} secs left",
+                ReadableNumber(static_cast<long long>(getColumnsPerSec())), static_cast<int>(secs_left + 0.5));
+        }
+
+        return std::move(result);
+    }
+
+    // Public data. It's all just counts.
+    int regions_done;
+    int regions_total;
+    int regions_resumed;
+    long long columns_done;
+    long long columns_total;
+    long long columns_resumed;
+    double elapsed_secs;
+};
@@ -96,7 +96,11 @@ public:
 private:
     // Private methods.
     void showErrorMsg(const std::string &msg) {
+#ifdef WORLD_GEN_HEADLESS
+        fprintf(stderr, "%s\n", msg.c_str());
+#else
         wxMessageBox(msg, "Build Settings", wxOK | wxICON_EXCLAMATION, nullptr);
+#endif
     }
 
     // Private data.
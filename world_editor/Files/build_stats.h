@@ -9,7 +9,9 @@ class BuildStats
 {
 public:
     // Default ctor.
-    BuildStats() {}
+    BuildStats() {
+        m_counts.fill(0);
+    }
 
     // Copy ctor.
     BuildStats(const BuildStats &that) :
@@ -33,27 +35,42 @@ public:
 
     // Adders and removers.
     void add(BlockType bt)  { 
-        m_counts[bt]++;
+        m_counts[static_cast<int>(bt)]++;
+    }
+
+    void add(BlockType bt, long long count) {
+        m_counts[static_cast<int>(bt)] += count;
+    }
+
+    void add(const BuildStats &that) {
+        for (int i = 0; i < BLOCK_TYPE_COUNT; i++) {
+            m_counts[i] += that.m_counts[i];
+        }
     }
 
-    int getTotal() const {
-        int result = 0;
-        for (const auto &iter : m_counts) {
-            result += iter.second;
+    long long getCount(BlockType bt) const {
+        return m_counts[static_cast<int>(bt)];
+    }
+
+    long long getTotal() const {
+        long long result = 0;
+        for (long long count : m_counts) {
+            result += count;
         }
+        return result;
     }
 
     // Show this as a string.
     std::string toString() const {
         std::string result = "";
 
-        int dirt  = getCount(BlockType::DIRT);
-        int stone = getCount(BlockType::STONE);
-        int air   = getCount(BlockType::AIR);
-        int coal  = getCount(BlockType::COAL);
+        long long dirt  = getCount(BlockType::DIRT);
+        long long stone = getCount(BlockType::STONE);
+        long long air   = getCount(BlockType::AIR);
+        long long coal  = getCount(BlockType::COAL);
 
-        int total_blocks = dirt + stone + air + coal;
-        int db_writes = 0;
+        long long total_blocks = dirt + stone + air + coal;
+        long long db_writes = 0;
 
         if (dirt > 0) {
             double dirt_pct = (dirt / ((double) total_blocks)) * 100.0;
@@ -110,17 +127,10 @@ public:
     }
 
 private:
-    // Private methods.
-    int getCount(BlockType bt) const {
-        const auto iter = m_counts.find(bt);
-        if (iter == m_counts.end()) {
-            return 0;
-        }
-        else {
-            return iter->second;
-        }
-    }
+    // Private data. One count per block type, indexed by the type. Workers keep
+    // their own, and these get added up at the end, so this has to be cheap.
+    // A big heightmap has well over two billion blocks, so they're 64 bits.
+    static const int BLOCK_TYPE_COUNT = static_cast<int>(BlockType::COAL) + 1;
 
-    // Private data.
-    std::map<BlockType, int> m_counts;
+    std::array<long long, BLOCK_TYPE_COUNT> m_counts;
 };
\ No newline at end of file
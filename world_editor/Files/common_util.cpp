@@ -4,7 +4,10 @@
 
 #include "format.h"
 #include "sqlite3.h"
+
+#ifndef WORLD_GEN_HEADLESS
 #include <psapi.h>
+#endif
 
 
 /**
@@ -23,10 +26,10 @@
 
 
 // Turn a number into a nice readable string.
-std::string ReadableNumber(int value) {
-    const int GB = 1024 * 1024 * 1024;
-    const int MB = 1024 * 1024;
-    const int KB = 1024;
+std::string ReadableNumber(long long value) {
+    const long long GB = 1024 * 1024 * 1024;
+    const long long MB = 1024 * 1024;
+    const long long KB = 1024;
 
     if (value >= GB) {
         return fmt::format("{0:.1f}G", value / float(GB));
@@ -44,8 +47,12 @@ std::string ReadableNumber(int value) {
 
 
 // Find out how much memory the app is using.
+// The headless build doesn't bother, and just says zero.
 int GetMemoryUsage()
 {
+#ifdef WORLD_GEN_HEADLESS
+    return 0;
+#else
     PROCESS_MEMORY_COUNTERS_EX pmc;
     memset(&pmc, 0, sizeof(pmc));
     pmc.cb = sizeof(PROCESS_MEMORY_COUNTERS_EX);
@@ -57,6 +64,7 @@ int GetMemoryUsage()
         sizeof(PROCESS_MEMORY_COUNTERS_EX));
     int result = pmc.PrivateUsage;
     return result;
+#endif
 }
 
 
@@ -65,7 +73,9 @@ int GetMemoryUsage()
 // causes a crash here.
 void PrintDebug(const std::string &msg)
 {
+#ifndef WORLD_GEN_HEADLESS
     OutputDebugStringA(msg.c_str());
+#endif
     printf(msg.c_str());
 }
 
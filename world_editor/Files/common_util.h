@@ -1,6 +1,7 @@
 #pragma once
 
 #include "stdafx.h"
+#include "rounding.h"
 
 /**
  * Common data structures and utility methods. 
@@ -26,7 +27,7 @@ enum class BlockType : unsigned char {
 
 
 // Debug printing.
-std::string ReadableNumber(int val);
+std::string ReadableNumber(long long val);
 int GetMemoryUsage();
 
 void PrintDebug(const std::string &msg);
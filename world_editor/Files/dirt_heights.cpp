@@ -0,0 +1,228 @@
+#include "stdafx.h"
+#include "dirt_heights.h"
+
+#include "format.h"
+
+
+// Hash some dirt heights, carrying on from an earlier hash.
+std::uint64_t HashDirtHeights(const DirtHeightMap &heights, std::uint64_t hash)
+{
+    for (std::uint8_t height : heights.heights) {
+        hash ^= height;
+        hash *= 1099511628211ull;
+    }
+
+    return hash;
+}
+
+
+// Read a whole heightmap's worth of dirt heights, a band at a time. The
+// levels are only ever in memory a band at a time, and the heights are a
+// byte a pixel. If it won't load, it's all empty.
+bool ReadDirtHeightMap(const std::string &fname, DirtHeightMap *pOut, std::string *pOut_error)
+{
+    *pOut = DirtHeightMap();
+
+    HeightmapReader reader;
+    if (!reader.open(fname)) {
+        *pOut_error = reader.getLastError();
+        return false;
+    }
+
+    int width  = reader.getWidth();
+    int height = reader.getHeight();
+    int bit_depth = reader.getBitDepth();
+
+    pOut->width  = width;
+    pOut->height = height;
+    pOut->row_count = height;
+    pOut->heights.resize(width * height);
+
+    HeightmapBand band;
+    while (!reader.isDone()) {
+        if (!reader.readBand(HeightmapReader::BAND_ROWS, &band)) {
+            *pOut_error = reader.getLastError();
+            *pOut = DirtHeightMap();
+            return false;
+        }
+
+        int first = width * band.first_row;
+        int count = width * band.row_count;
+
+        for (int i = 0; i < count; i++) {
+            pOut->heights[first + i] = DirtHeightMap::encode(LevelToDirtHeight(band.levels[i], bit_depth));
+        }
+    }
+
+    return true;
+}
+
+
+// Default ctor. Nothing's open until "open".
+DirtHeightBands::DirtHeightBands() :
+    m_width(0),
+    m_height(0),
+    m_hash(DIRT_HASH_START),
+    m_reader_row(0),
+    m_next_band(0)
+{
+}
+
+
+// Get ready to read a heightmap. This reads it all once, just for the hash,
+// a band at a time. "setBands" goes back to the top for the real thing.
+bool DirtHeightBands::open(const std::string &fname)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_fname = fname;
+    m_last_error.clear();
+    m_hash = DIRT_HASH_START;
+    m_row_ranges.clear();
+    m_uses_left.clear();
+    m_loaded.clear();
+    m_next_band = 0;
+
+    m_reader = std::make_unique<HeightmapReader>();
+    m_reader_row = 0;
+    if (!m_reader->open(fname)) {
+        m_last_error = m_reader->getLastError();
+        return false;
+    }
+
+    m_width  = m_reader->getWidth();
+    m_height = m_reader->getHeight();
+
+    DirtHeightMap rows;
+    for (int first_row = 0; first_row < m_height; first_row += HeightmapReader::BAND_ROWS) {
+        int last_row = std::min(first_row + HeightmapReader::BAND_ROWS, m_height);
+        if (!readRows(first_row, last_row, &rows)) {
+            return false;
+        }
+        m_hash = HashDirtHeights(rows, m_hash);
+    }
+
+    return true;
+}
+
+
+// Say which bands of rows are going to be wanted, as "[first, last)" pairs, in
+// order, and how many times each one gets used. They can't overlap. A band
+// that never gets used doesn't get kept, but it still gets read past.
+// This starts reading from the top again.
+bool DirtHeightBands::setBands(const std::vector<std::pair<int, int>> &row_ranges, const std::vector<int> &use_counts)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    assert(row_ranges.size() == use_counts.size());
+
+    m_row_ranges = row_ranges;
+    m_uses_left  = use_counts;
+    m_loaded.assign(row_ranges.size(), nullptr);
+    m_next_band = 0;
+
+    m_last_error.clear();
+    m_reader = std::make_unique<HeightmapReader>();
+    m_reader_row = 0;
+    if (!m_reader->open(m_fname)) {
+        m_last_error = m_reader->getLastError();
+        return false;
+    }
+
+    return true;
+}
+
+
+// Get one band of rows, reading it if nobody has yet. Every one of these has to be
+// matched with a "release". Returns null if the heightmap couldn't be read.
+std::shared_ptr<const DirtHeightMap> DirtHeightBands::acquire(int band_index)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    while (m_next_band <= band_index) {
+        if (!m_last_error.empty()) {
+            return nullptr;
+        }
+
+        int band = m_next_band++;
+        auto rows = std::make_shared<DirtHeightMap>();
+        if (!readRows(m_row_ranges[band].first, m_row_ranges[band].second, rows.get())) {
+            return nullptr;
+        }
+
+        if (m_uses_left[band] > 0) {
+            m_loaded[band] = rows;
+        }
+    }
+
+    return m_loaded[band_index];
+}
+
+
+// Done with a band. Once everybody is, it's gone.
+void DirtHeightBands::release(int band_index)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    assert(m_uses_left[band_index] > 0);
+    m_uses_left[band_index]--;
+    if (m_uses_left[band_index] == 0) {
+        m_loaded[band_index] = nullptr;
+    }
+}
+
+
+// Whatever went wrong last.
+std::string DirtHeightBands::getLastError() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_last_error;
+}
+
+
+// Read rows "[first_row, last_row)" into some dirt heights, skipping over any
+// before them. The reader only goes forward, so they have to come in order.
+// The lock has to be held.
+bool DirtHeightBands::readRows(int first_row, int last_row, DirtHeightMap *pOut)
+{
+    assert(first_row >= m_reader_row);
+
+    while (m_reader_row < first_row) {
+        int skip_rows = first_row - m_reader_row;
+        if (skip_rows > HeightmapReader::BAND_ROWS) {
+            skip_rows = HeightmapReader::BAND_ROWS;
+        }
+        if (!m_reader->readBand(skip_rows, &m_band)) {
+            m_last_error = m_reader->getLastError();
+            return false;
+        }
+        m_reader_row += skip_rows;
+    }
+
+    int row_count = last_row - first_row;
+
+    pOut->width  = m_width;
+    pOut->height = m_height;
+    pOut->first_row = first_row;
+    pOut->row_count = row_count;
+    pOut->heights.resize(m_width * row_count);
+
+    if (row_count == 0) {
+        return true;
+    }
+
+    if (!m_reader->readBand(row_count, &m_band)) {
+        m_last_error = m_reader->getLastError();
+        return false;
+    }
+    m_reader_row += row_count;
+
+    int bit_depth = m_reader->getBitDepth();
+    int count = m_width * row_count;
+
+    for (int i = 0; i < count; i++) {
+        pOut->heights[i] = DirtHeightMap::encode(LevelToDirtHeight(m_band.levels[i], bit_depth));
+    }
+
+    return true;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "stdafx.h"
+#include "dirt_levels.h"
+#include "heightmap_reader.h"
+
+
+// Some rows of the heightmap, turned into dirt heights. Usually it's all of them, and
+// then it's "first_row" zero and "row_count" rows. The width and height are always the
+// whole heightmap's. Bitmaps aren't something to go poking at from a bunch of threads at
+// once, but this is. Each height is stored one higher than the dirt goes, so nothing at
+// all is zero, and they all fit in an unsigned byte. Indexed by "x + (width * row)".
+struct DirtHeightMap
+{
+    DirtHeightMap() : width(0), height(0), first_row(0), row_count(0) {}
+
+    // How high the dirt goes at a pixel, or -1 for nothing, or if it's not one of our rows.
+    int getDirtHeight(int x, int y) const {
+        int row = y - first_row;
+        if ((x < 0) || (x >= width) || (row < 0) || (row >= row_count)) {
+            return -1;
+        }
+        return static_cast<int>(heights[x + (width * row)]) - 1;
+    }
+
+    static std::uint8_t encode(int dirt_height) {
+        return static_cast<std::uint8_t>(dirt_height + 1);
+    }
+
+    int width;
+    int height;
+    int first_row;
+    int row_count;
+    std::vector<std::uint8_t> heights;
+};
+
+static_assert(MAX_DIRT_HEIGHT + 1 <= UINT8_MAX, "Dirt heights have to fit in a byte");
+
+
+// Hash some dirt heights, carrying on from an earlier hash, so the whole heightmap
+// can be done a band at a time. It's FNV-1a. Nothing fancy, it just has to notice if
+// anything changed.
+const std::uint64_t DIRT_HASH_START = 14695981039346656037ull;
+std::uint64_t HashDirtHeights(const DirtHeightMap &heights, std::uint64_t hash);
+
+// Read a whole heightmap's worth of dirt heights, a band at a time.
+bool ReadDirtHeightMap(const std::string &fname, DirtHeightMap *pOut, std::string *pOut_error);
+
+
+// A heightmap's dirt heights, read a band of rows at a time, straight from the file,
+// for building worlds too big to keep all of in memory. Whoever's building says up
+// front which bands of rows they'll want, in the order they're in the file, and how
+// many times each band gets used. Bands get read the first time somebody wants them,
+// along with any before them that haven't been, and they get let go once they've been
+// used that many times. Any thread can ask for them.
+class DirtHeightBands
+{
+public:
+    DirtHeightBands();
+    ~DirtHeightBands() {}
+
+    bool open(const std::string &fname);
+    bool setBands(const std::vector<std::pair<int, int>> &row_ranges, const std::vector<int> &use_counts);
+
+    std::shared_ptr<const DirtHeightMap> acquire(int band_index);
+    void release(int band_index);
+
+    // Getters. The hash is the whole heightmap's, from "open".
+    int getWidth() const { return m_width; }
+    int getHeight() const { return m_height; }
+    std::uint64_t getHash() const { return m_hash; }
+    std::string getLastError() const;
+
+private:
+    // Disallow copying and moving.
+    DirtHeightBands(const DirtHeightBands &that) = delete;
+    void operator=(const DirtHeightBands &that) = delete;
+    DirtHeightBands(DirtHeightBands &&that) = delete;
+    void operator=(DirtHeightBands &&that) = delete;
+
+    // Private methods.
+    bool readRows(int first_row, int last_row, DirtHeightMap *pOut);
+
+    // Private data. Reading the file is one band at a time, so that's all locked.
+    std::string m_fname;
+    int m_width;
+    int m_height;
+    std::uint64_t m_hash;
+
+    mutable std::mutex m_mutex;
+    std::string m_last_error;
+    std::unique_ptr<HeightmapReader> m_reader;
+    int m_reader_row;
+    HeightmapBand m_band;
+
+    std::vector<std::pair<int, int>> m_row_ranges;
+    std::vector<int> m_uses_left;
+    std::vector<std::shared_ptr<const DirtHeightMap>> m_loaded;
+    int m_next_band;
+};
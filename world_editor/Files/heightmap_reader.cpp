@@ -0,0 +1,480 @@
+#include "stdafx.h"
+#include "heightmap_reader.h"
+
+#include "format.h"
+
+#include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
+#include <climits>
+#include <png.h>
+#include <regex>
+
+
+// libpng's errors jump back to whoever called it, with the message in "m_last_error".
+// Nothing between the "setjmp" and the libpng call can have a destructor to skip.
+static void OnPngError(png_structp png, png_const_charp msg)
+{
+    std::string *last_error = static_cast<std::string *>(png_get_error_ptr(png));
+    *last_error = msg;
+    png_longjmp(png, 1);
+}
+
+
+// Warnings are about things like bad gamma chunks. We don't care.
+static void OnPngWarning(png_structp /* png */, png_const_charp /* msg */)
+{
+}
+
+
+// Default ctor. Nothing's open until "open".
+HeightmapFile::HeightmapFile() :
+    m_file(nullptr),
+    m_png(nullptr),
+    m_png_info(nullptr),
+    m_width(0),
+    m_height(0),
+    m_channels(0),
+    m_bytes_per_sample(0),
+    m_big_endian(true),
+    m_interlaced(false),
+    m_rows_read(0)
+{
+}
+
+
+// Destructor.
+HeightmapFile::~HeightmapFile()
+{
+    close();
+}
+
+
+// Open a file, and read enough of it to know how big it is.
+// Return false if it's not a heightmap we know how to read.
+bool HeightmapFile::open(const std::string &fname)
+{
+    close();
+
+    m_fname = fname;
+    m_last_error.clear();
+    m_rows_read = 0;
+
+    m_file = fopen(fname.c_str(), "rb");
+    if (m_file == nullptr) {
+        m_last_error = fmt::format("Could not open '{}'.", fname);
+        return false;
+    }
+
+    std::string ext = boost::algorithm::to_lower_copy(boost::filesystem::path(fname).extension().string());
+    bool success = ((ext == ".r16") || (ext == ".raw")) ? openRaw() : openPng();
+
+    if (!success) {
+        m_last_error = fmt::format("Could not read '{0}': {1}", fname, m_last_error);
+        close();
+    }
+
+    return success;
+}
+
+
+// Read the next row down, as levels.
+bool HeightmapFile::readRow(unsigned short *pOut_levels)
+{
+    if (m_rows_read >= m_height) {
+        m_last_error = fmt::format("Tried to read past the bottom of '{}'.", m_fname);
+        return false;
+    }
+
+    const unsigned char *row = m_row.data();
+
+    if (m_interlaced) {
+        if (m_whole_image.empty() && !readPngImage()) {
+            m_last_error = fmt::format("Could not decode '{0}': {1}", m_fname, m_last_error);
+            return false;
+        }
+        row = &m_whole_image[m_rows_read * m_row.size()];
+    }
+    else if (m_png != nullptr) {
+        if (!readPngRow(m_row.data())) {
+            m_last_error = fmt::format("Could not decode '{0}': {1}", m_fname, m_last_error);
+            return false;
+        }
+    }
+    else if (fread(m_row.data(), 1, m_row.size(), m_file) != m_row.size()) {
+        m_last_error = fmt::format("'{}' ended early.", m_fname);
+        return false;
+    }
+
+    convertRow(row, pOut_levels);
+    m_rows_read++;
+
+    // That's everything, so let go of the file as soon as we can.
+    if (m_rows_read == m_height) {
+        close();
+    }
+
+    return true;
+}
+
+
+// Get a PNG ready to read a row at a time. Let libpng turn palettes into color, and
+// anything under 8 bits into 8 bits, and throw away any alpha. That leaves gray or
+// RGB, at 8 or 16 bits.
+bool HeightmapFile::openPng()
+{
+    m_png = png_create_read_struct(PNG_LIBPNG_VER_STRING, &m_last_error, OnPngError, OnPngWarning);
+    if (m_png != nullptr) {
+        m_png_info = png_create_info_struct(m_png);
+    }
+    if (m_png_info == nullptr) {
+        m_last_error = "Out of memory.";
+        return false;
+    }
+
+    if (setjmp(png_jmpbuf(m_png))) {
+        return false;
+    }
+
+    png_init_io(m_png, m_file);
+    png_read_info(m_png, m_png_info);
+
+    png_set_palette_to_rgb(m_png);
+    png_set_expand_gray_1_2_4_to_8(m_png);
+    png_set_strip_alpha(m_png);
+    int passes = png_set_interlace_handling(m_png);
+    png_read_update_info(m_png, m_png_info);
+
+    m_width  = png_get_image_width(m_png, m_png_info);
+    m_height = png_get_image_height(m_png, m_png_info);
+    m_channels = png_get_channels(m_png, m_png_info);
+    m_bytes_per_sample = (png_get_bit_depth(m_png, m_png_info) == 16) ? 2 : 1;
+    m_big_endian = true;
+    m_interlaced = (passes > 1);
+
+    if ((m_channels != 1) && (m_channels != 3)) {
+        m_last_error = fmt::format("{} channels is a strange number of channels.", m_channels);
+        return false;
+    }
+
+    m_row.resize(png_get_rowbytes(m_png, m_png_info));
+    return true;
+}
+
+
+// Get a raw file ready to read. There's no header, so the only way to know
+// how big it is, is to assume it's square, and go by the file size.
+bool HeightmapFile::openRaw()
+{
+    boost::system::error_code error;
+    std::uintmax_t file_size = boost::filesystem::file_size(m_fname, error);
+    if (error) {
+        m_last_error = error.message();
+        return false;
+    }
+
+    std::uintmax_t samples = file_size / 2;
+    int side = static_cast<int>(sqrt(static_cast<double>(samples)) + 0.5);
+
+    if ((file_size % 2 != 0) || (static_cast<std::uintmax_t>(side) * side != samples)) {
+        m_last_error = fmt::format("{} bytes isn't a square of 16-bit samples.", file_size);
+        return false;
+    }
+
+    m_width  = side;
+    m_height = side;
+    m_channels = 1;
+    m_bytes_per_sample = 2;
+    m_big_endian = false;
+    m_interlaced = false;
+
+    m_row.resize(2 * side);
+    return true;
+}
+
+
+// Decode the next row of a PNG.
+bool HeightmapFile::readPngRow(unsigned char *pOut_row)
+{
+    if (setjmp(png_jmpbuf(m_png))) {
+        return false;
+    }
+
+    png_read_row(m_png, pOut_row, nullptr);
+    return true;
+}
+
+
+// An interlaced PNG spreads every row out over the whole file, so
+// the only way to get the first one is to decode all of them.
+bool HeightmapFile::readPngImage()
+{
+    m_whole_image.resize(m_row.size() * m_height);
+
+    if (setjmp(png_jmpbuf(m_png))) {
+        return false;
+    }
+
+    for         (int pass = 0; pass < PNG_INTERLACE_ADAM7_PASSES; pass++) {
+        for     (int y = 0; y < m_height; y++) {
+            png_read_row(m_png, &m_whole_image[y * m_row.size()], nullptr);
+        }
+    }
+
+    return true;
+}
+
+
+// Turn one row of samples into levels. Average the color channels in their
+// own bit depth, so 8-bit color comes out exactly the way it always has.
+void HeightmapFile::convertRow(const unsigned char *row, unsigned short *pOut_levels) const
+{
+    const int stride = m_channels * m_bytes_per_sample;
+
+    for (int x = 0; x < m_width; x++) {
+        const unsigned char *pixel = &row[x * stride];
+        int total = 0;
+
+        for (int channel = 0; channel < m_channels; channel++) {
+            const unsigned char *sample = &pixel[channel * m_bytes_per_sample];
+
+            if (m_bytes_per_sample == 1) {
+                total += sample[0];
+            }
+            else if (m_big_endian) {
+                total += (sample[0] << 8) | sample[1];
+            }
+            else {
+                total += (sample[1] << 8) | sample[0];
+            }
+        }
+
+        int level = total / m_channels;
+        if (m_bytes_per_sample == 1) {
+            level *= 257;
+        }
+
+        pOut_levels[x] = static_cast<unsigned short>(level);
+    }
+}
+
+
+// Let go of the file, and anything we kept from it.
+void HeightmapFile::close()
+{
+    if (m_png != nullptr) {
+        png_destroy_read_struct(&m_png, &m_png_info, nullptr);
+        m_png = nullptr;
+        m_png_info = nullptr;
+    }
+
+    if (m_file != nullptr) {
+        fclose(m_file);
+        m_file = nullptr;
+    }
+
+    m_row.clear();
+    m_whole_image.clear();
+    m_whole_image.shrink_to_fit();
+}
+
+
+// Default ctor. Nothing's open until "open".
+HeightmapReader::HeightmapReader() :
+    m_tiles_across(0),
+    m_tiles_down(0),
+    m_width(0),
+    m_height(0),
+    m_rows_read(0),
+    m_bit_depth(0),
+    m_tile_row(-1),
+    m_rows_into_tile(0)
+{
+}
+
+
+// Get ready to read a heightmap, or a grid of tiles if that's what this is one of.
+// This reads every tile's size, but none of their pixels.
+bool HeightmapReader::open(const std::string &fname)
+{
+    m_last_error.clear();
+    m_tile_fnames.clear();
+    m_tile_widths.clear();
+    m_tile_heights.clear();
+    m_open_files.clear();
+
+    m_width  = 0;
+    m_height = 0;
+    m_rows_read = 0;
+    m_bit_depth = 0;
+    m_tile_row = -1;
+    m_rows_into_tile = 0;
+
+    return findTiles(fname) && measureTiles();
+}
+
+
+// Read up to "max_rows" more rows, carrying on from the last band.
+// Return false if something went wrong along the way.
+bool HeightmapReader::readBand(int max_rows, HeightmapBand *pOut)
+{
+    int row_count = std::min(max_rows, m_height - m_rows_read);
+
+    pOut->first_row = m_rows_read;
+    pOut->row_count = row_count;
+    pOut->levels.resize(m_width * row_count);
+
+    for (int i = 0; i < row_count; i++) {
+        if ((m_tile_row < 0) || (m_rows_into_tile == m_tile_heights[m_tile_row])) {
+            if (!openTileRow(m_tile_row + 1)) {
+                return false;
+            }
+        }
+
+        // One row of every tile across makes one row of the heightmap.
+        unsigned short *out = &pOut->levels[m_width * i];
+
+        for (int col = 0; col < m_tiles_across; col++) {
+            HeightmapFile &file = *m_open_files[col];
+            if (!file.readRow(out)) {
+                m_last_error = file.getLastError();
+                return false;
+            }
+            out += m_tile_widths[col];
+        }
+
+        m_rows_into_tile++;
+        m_rows_read++;
+    }
+
+    return true;
+}
+
+
+// If the file's named like a tile, find the rest of the grid it's in.
+// Otherwise, it's a grid of one.
+bool HeightmapReader::findTiles(const std::string &fname)
+{
+    boost::filesystem::path path(fname);
+    std::string stem = path.stem().string();
+    std::string ext  = path.extension().string();
+
+    static const std::regex TILE_PATTERN("(.*)_x[0-9]+_y[0-9]+");
+    std::smatch match;
+
+    if (!std::regex_match(stem, match, TILE_PATTERN)) {
+        m_tile_fnames.push_back(fname);
+        m_tiles_across = 1;
+        m_tiles_down   = 1;
+        return true;
+    }
+
+    std::string prefix = (path.parent_path() / match[1].str()).string();
+    auto tile_fname = [&prefix, &ext](int col, int row) {
+        return fmt::format("{0}_x{1}_y{2}{3}", prefix, col, row, ext);
+    };
+
+    // The top row and the left column say how big the grid is.
+    m_tiles_across = 0;
+    while (boost::filesystem::is_regular_file(tile_fname(m_tiles_across, 0))) {
+        m_tiles_across++;
+    }
+
+    m_tiles_down = 0;
+    while (boost::filesystem::is_regular_file(tile_fname(0, m_tiles_down))) {
+        m_tiles_down++;
+    }
+
+    if ((m_tiles_across == 0) || (m_tiles_down == 0)) {
+        m_last_error = fmt::format("'{0}' looks like a tile, but there's no '{1}'.", fname, tile_fname(0, 0));
+        return false;
+    }
+
+    for     (int row = 0; row < m_tiles_down;   row++) {
+        for (int col = 0; col < m_tiles_across; col++) {
+            std::string tile = tile_fname(col, row);
+            if (!boost::filesystem::is_regular_file(tile)) {
+                m_last_error = fmt::format("Tile '{}' is missing.", tile);
+                return false;
+            }
+            m_tile_fnames.push_back(tile);
+        }
+    }
+
+    return true;
+}
+
+
+// Open every tile just long enough to see how big it is, and make sure they all line up.
+bool HeightmapReader::measureTiles()
+{
+    m_tile_widths.assign(m_tiles_across, 0);
+    m_tile_heights.assign(m_tiles_down, 0);
+
+    HeightmapFile file;
+
+    for     (int row = 0; row < m_tiles_down;   row++) {
+        for (int col = 0; col < m_tiles_across; col++) {
+            const std::string &tile = m_tile_fnames[col + (m_tiles_across * row)];
+            if (!file.open(tile)) {
+                m_last_error = file.getLastError();
+                return false;
+            }
+
+            int width  = file.getWidth();
+            int height = file.getHeight();
+            m_bit_depth = std::max(m_bit_depth, file.getBitDepth());
+
+            if (row == 0) {
+                m_tile_widths[col] = width;
+            }
+            if (col == 0) {
+                m_tile_heights[row] = height;
+            }
+
+            if ((width != m_tile_widths[col]) || (height != m_tile_heights[row])) {
+                m_last_error = fmt::format(
+                    "Tile '{0}' is {1} x {2}, but the tiles it lines up with are {3} x {4}.",
+                    tile, width, height, m_tile_widths[col], m_tile_heights[row]);
+                return false;
+            }
+        }
+    }
+
+    long long total_width  = 0;
+    long long total_height = 0;
+    for (int width : m_tile_widths) {
+        total_width += width;
+    }
+    for (int height : m_tile_heights) {
+        total_height += height;
+    }
+
+    if (total_width * total_height > INT_MAX) {
+        m_last_error = fmt::format("{0} x {1} is too big a heightmap.", total_width, total_height);
+        return false;
+    }
+
+    m_width  = static_cast<int>(total_width);
+    m_height = static_cast<int>(total_height);
+    return true;
+}
+
+
+// Close the last row of tiles, and open the next one.
+bool HeightmapReader::openTileRow(int tile_row)
+{
+    m_open_files.clear();
+
+    for (int col = 0; col < m_tiles_across; col++) {
+        std::unique_ptr<HeightmapFile> file = std::make_unique<HeightmapFile>();
+        if (!file->open(m_tile_fnames[col + (m_tiles_across * tile_row)])) {
+            m_last_error = file->getLastError();
+            return false;
+        }
+        m_open_files.emplace_back(std::move(file));
+    }
+
+    m_tile_row = tile_row;
+    m_rows_into_tile = 0;
+    return true;
+}
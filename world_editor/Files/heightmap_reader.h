@@ -0,0 +1,140 @@
+#pragma once
+
+#include "stdafx.h"
+
+struct png_struct_def;
+struct png_info_def;
+
+
+// Heightmaps get read a band of rows at a time, so nothing ever needs the whole image
+// in memory at once. Whatever the source, every pixel comes out as a 16-bit level. An
+// 8-bit pixel's level is its value times 257, so 0 and 255 turn into 0 and 65535. Color
+// pixels are the average of red, green and blue, the way they always were. Alpha gets
+// ignored.
+//
+// The sources:
+//   - PNGs, 8 or 16 bits, gray or color. Interlaced PNGs can't be read a row at a time,
+//     so those get decoded whole, the first time a row is needed.
+//   - Raw files, ".r16" or ".raw". Headerless, 16-bit little-endian gray, and square,
+//     since the size has to come from the file size.
+//   - Tiles of either, named "<name>_x<col>_y<row>.<ext>", with "_x0_y0" the top left.
+//     Picking any one of them reads the whole grid. Every tile in a column has to be as
+//     wide as the others, and every tile in a row as tall.
+
+
+// One band of rows. Indexed by "x + (width * (y - first_row))".
+struct HeightmapBand
+{
+    HeightmapBand() : first_row(0), row_count(0) {}
+
+    int first_row;
+    int row_count;
+    std::vector<unsigned short> levels;
+};
+
+
+// One file, PNG or raw, read from the top row down.
+class HeightmapFile
+{
+public:
+    HeightmapFile();
+    ~HeightmapFile();
+
+    bool open(const std::string &fname);
+    bool readRow(unsigned short *pOut_levels);
+
+    int getWidth() const { return m_width; }
+    int getHeight() const { return m_height; }
+    int getBitDepth() const { return m_bytes_per_sample * 8; }
+    const std::string &getLastError() const { return m_last_error; }
+
+private:
+    // Disallow copying and moving.
+    HeightmapFile(const HeightmapFile &that) = delete;
+    void operator=(const HeightmapFile &that) = delete;
+    HeightmapFile(HeightmapFile &&that) = delete;
+    void operator=(HeightmapFile &&that) = delete;
+
+    // Private methods.
+    bool openPng();
+    bool openRaw();
+    bool readPngRow(unsigned char *pOut_row);
+    bool readPngImage();
+    void convertRow(const unsigned char *row, unsigned short *pOut_levels) const;
+    void close();
+
+    // Private data. PNGs are big-endian, raw files are little-endian.
+    std::string m_fname;
+    std::string m_last_error;
+    FILE *m_file;
+
+    png_struct_def *m_png;
+    png_info_def   *m_png_info;
+
+    int  m_width;
+    int  m_height;
+    int  m_channels;
+    int  m_bytes_per_sample;
+    bool m_big_endian;
+    bool m_interlaced;
+    int  m_rows_read;
+
+    std::vector<unsigned char> m_row;
+    std::vector<unsigned char> m_whole_image;
+};
+
+
+// The whole heightmap, whether it's one file or a grid of tiles. Only one row of
+// tiles is ever open at once, and only one row of each of those is ever in memory.
+class HeightmapReader
+{
+public:
+    HeightmapReader();
+    ~HeightmapReader() {}
+
+    bool open(const std::string &fname);
+    bool readBand(int max_rows, HeightmapBand *pOut);
+
+    // Getters.
+    int getWidth() const { return m_width; }
+    int getHeight() const { return m_height; }
+    int getTileCount() const { return m_tiles_across * m_tiles_down; }
+    int getBitDepth() const { return m_bit_depth; }
+    bool isDone() const { return m_rows_read >= m_height; }
+    const std::string &getLastError() const { return m_last_error; }
+
+    // A good band size. A 16k wide heightmap is 8 megs a band.
+    static const int BAND_ROWS = 256;
+
+private:
+    // Disallow copying and moving.
+    HeightmapReader(const HeightmapReader &that) = delete;
+    void operator=(const HeightmapReader &that) = delete;
+    HeightmapReader(HeightmapReader &&that) = delete;
+    void operator=(HeightmapReader &&that) = delete;
+
+    // Private methods.
+    bool findTiles(const std::string &fname);
+    bool measureTiles();
+    bool openTileRow(int tile_row);
+
+    // Private data. The tile names are indexed by "col + (m_tiles_across * row)".
+    std::string m_last_error;
+    std::vector<std::string> m_tile_fnames;
+    int m_tiles_across;
+    int m_tiles_down;
+    std::vector<int> m_tile_widths;
+    std::vector<int> m_tile_heights;
+
+    int m_width;
+    int m_height;
+    int m_rows_read;
+
+    // 16 if any tile is 16 bits, or 8 if they all are.
+    int m_bit_depth;
+
+    // The tile row we're in the middle of, and how far into it we are.
+    int m_tile_row;
+    int m_rows_into_tile;
+    std::vector<std::unique_ptr<HeightmapFile>> m_open_files;
+};
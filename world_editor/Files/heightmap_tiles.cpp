@@ -0,0 +1,172 @@
+#include "stdafx.h"
+#include "heightmap_tiles.h"
+
+#include "common_util.h"
+
+
+// Sort tiles by zoom, then by where they are. Any order will do, so long as it's the same one.
+bool HeightmapTiles::TileKey::operator<(const TileKey &that) const
+{
+    if (zoom_scale != that.zoom_scale) {
+        return zoom_scale < that.zoom_scale;
+    }
+    if (zoom_shift != that.zoom_shift) {
+        return zoom_shift < that.zoom_shift;
+    }
+    if (tile_x != that.tile_x) {
+        return tile_x < that.tile_x;
+    }
+    return tile_y < that.tile_y;
+}
+
+
+// The only allowed constructor. The pixels have to outlive the tiles.
+HeightmapTiles::HeightmapTiles(const HeightmapPixels &pixels) :
+    m_pixels(pixels),
+    m_use_count(0)
+{
+}
+
+
+// Get a tile, making it first if we haven't already got it.
+// The reference is good until the next "trimCache".
+const wxBitmap &HeightmapTiles::getTile(int zoom_scale, int zoom_shift, int tile_x, int tile_y)
+{
+    assert((zoom_scale == 1) || (zoom_shift == 0));
+
+    TileKey key = { zoom_scale, zoom_shift, tile_x, tile_y };
+
+    auto iter = m_cache.find(key);
+    if (iter == m_cache.end()) {
+        CachedTile tile;
+        tile.bitmap = renderTile(key);
+        iter = m_cache.emplace(key, std::move(tile)).first;
+    }
+
+    m_use_count++;
+    iter->second.last_used = m_use_count;
+    return *iter->second.bitmap;
+}
+
+
+// If there are too many tiles, throw out the ones that were drawn the longest ago.
+// Call this once the drawing's done, so nothing on screen goes anywhere.
+void HeightmapTiles::trimCache()
+{
+    int excess = static_cast<int>(m_cache.size()) - MAX_CACHED_TILES;
+    if (excess <= 0) {
+        return;
+    }
+
+    // Every tile was last used at a different time, so there's exactly "excess" at or under this.
+    std::vector<int> uses;
+    uses.reserve(m_cache.size());
+    for (const auto &iter : m_cache) {
+        uses.push_back(iter.second.last_used);
+    }
+
+    std::nth_element(uses.begin(), uses.begin() + (excess - 1), uses.end());
+    int oldest_kept = uses[excess - 1];
+
+    for (auto iter = m_cache.begin(); iter != m_cache.end(); ) {
+        if (iter->second.last_used <= oldest_kept) {
+            iter = m_cache.erase(iter);
+        }
+        else {
+            ++iter;
+        }
+    }
+}
+
+
+// Get the heightmap at this zoom shift, shrinking it down some more if we haven't been
+// this far out yet. Each level averages the level above it, two by two. At the right and
+// bottom edges, there might only be one or two pixels to go on, so average those instead.
+const HeightmapPixels &HeightmapTiles::getLevel(int zoom_shift)
+{
+    if (zoom_shift == 0) {
+        return m_pixels;
+    }
+
+    while (static_cast<int>(m_pyramid.size()) < zoom_shift) {
+        const HeightmapPixels &source = m_pyramid.empty() ? m_pixels : m_pyramid.back();
+
+        HeightmapPixels level;
+        level.width  = (source.width  + 1) / 2;
+        level.height = (source.height + 1) / 2;
+        level.gray.resize(level.width * level.height);
+
+        for     (int y = 0; y < level.height; y++) {
+            for (int x = 0; x < level.width;  x++) {
+                int total = 0;
+                int count = 0;
+
+                for     (int source_y = y * 2; (source_y < (y * 2) + 2) && (source_y < source.height); source_y++) {
+                    for (int source_x = x * 2; (source_x < (x * 2) + 2) && (source_x < source.width);  source_x++) {
+                        total += source.getPixel(source_x, source_y);
+                        count++;
+                    }
+                }
+
+                level.gray[x + (level.width * y)] = static_cast<unsigned char>(total / count);
+            }
+        }
+
+        m_pyramid.emplace_back(std::move(level));
+    }
+
+    return m_pyramid[zoom_shift - 1];
+}
+
+
+// Draw one tile. Every column of the tile shows the same column of the heightmap
+// all the way down, and the same for rows, so work those out once, up front.
+// The math is the canvas's screen to world math, but from the tile's corner.
+// Anything off the edge of the heightmap is just left black.
+std::unique_ptr<wxBitmap> HeightmapTiles::renderTile(const TileKey &key)
+{
+    const HeightmapPixels &level = getLevel(key.zoom_shift);
+
+    int shrink = 1 << key.zoom_shift;
+
+    int level_xs[TILE_SIZE];
+    int level_ys[TILE_SIZE];
+
+    for (int i = 0; i < TILE_SIZE; i++) {
+        int zoomed_x = (key.tile_x * TILE_SIZE) + i;
+        int zoomed_y = (key.tile_y * TILE_SIZE) + i;
+
+        int hmap_x = (RoundDownInt(zoomed_x * shrink, key.zoom_scale) / key.zoom_scale) + (m_pixels.width  / 2);
+        int hmap_y = (RoundDownInt(zoomed_y * shrink, key.zoom_scale) / key.zoom_scale) + (m_pixels.height / 2);
+
+        bool x_inside = (hmap_x >= 0) && (hmap_x < m_pixels.width);
+        bool y_inside = (hmap_y >= 0) && (hmap_y < m_pixels.height);
+
+        level_xs[i] = x_inside ? (hmap_x >> key.zoom_shift) : -1;
+        level_ys[i] = y_inside ? (hmap_y >> key.zoom_shift) : -1;
+    }
+
+    // New images start out black.
+    wxImage image(TILE_SIZE, TILE_SIZE);
+    unsigned char *out = image.GetData();
+
+    for (int y = 0; y < TILE_SIZE; y++) {
+        if (level_ys[y] < 0) {
+            continue;
+        }
+
+        for (int x = 0; x < TILE_SIZE; x++) {
+            if (level_xs[x] < 0) {
+                continue;
+            }
+
+            unsigned char pixel = level.getPixel(level_xs[x], level_ys[y]);
+            unsigned char *dest = &out[3 * (x + (TILE_SIZE * y))];
+            dest[0] = pixel;
+            dest[1] = pixel;
+            dest[2] = pixel;
+        }
+    }
+
+    return std::make_unique<wxBitmap>(image);
+}
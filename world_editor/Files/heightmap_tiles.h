@@ -0,0 +1,81 @@
+#pragma once
+
+#include "stdafx.h"
+
+
+// The heightmap's pixels, as gray, a byte apiece. Indexed by "x + (width * y)",
+// so looking any one of them up is cheap.
+struct HeightmapPixels
+{
+    HeightmapPixels() : width(0), height(0) {}
+
+    unsigned char getPixel(int x, int y) const { return gray[x + (width * y)]; }
+
+    int width;
+    int height;
+    std::vector<unsigned char> gray;
+};
+
+
+// The heightmap, cut up into square tiles for the canvas to draw, at whatever zoom it's at.
+// Zoomed in, every heightmap pixel is "zoom_scale" screen pixels wide. Zoomed out, every
+// screen pixel covers "1 << zoom_shift" heightmap pixels, so those tiles come from a pyramid
+// of smaller copies, each half the size of the last, and every pixel is an average, rather
+// than whichever one happened to land there. Only one of the two is ever past its minimum.
+//
+// Tiles are numbered in zoomed pixels, out from the world origin, so panning never changes
+// which tile is which. They only get made the first time they're drawn, and the ones that
+// haven't been drawn for a while get thrown out once there are too many.
+class HeightmapTiles
+{
+public:
+    HeightmapTiles(const HeightmapPixels &pixels);
+    ~HeightmapTiles() {}
+
+    const wxBitmap &getTile(int zoom_scale, int zoom_shift, int tile_x, int tile_y);
+    void trimCache();
+
+    static const int TILE_SIZE = 256;
+
+private:
+    // Disallow the default ctor, copying, and moving.
+    HeightmapTiles() = delete;
+    HeightmapTiles(const HeightmapTiles &that) = delete;
+    void operator=(const HeightmapTiles &that) = delete;
+    HeightmapTiles(HeightmapTiles &&that) = delete;
+    void operator=(HeightmapTiles &&that) = delete;
+
+    // Which tile, at which zoom.
+    struct TileKey
+    {
+        int zoom_scale;
+        int zoom_shift;
+        int tile_x;
+        int tile_y;
+
+        bool operator<(const TileKey &that) const;
+    };
+
+    // A tile, and when it was last drawn.
+    struct CachedTile
+    {
+        std::unique_ptr<wxBitmap> bitmap;
+        int last_used;
+    };
+
+    // Private methods.
+    const HeightmapPixels &getLevel(int zoom_shift);
+    std::unique_ptr<wxBitmap> renderTile(const TileKey &key);
+
+    // Private data. A screen's worth of tiles is a few dozen, so this
+    // leaves plenty of room for panning around and zooming back and forth.
+    static const int MAX_CACHED_TILES = 256;
+
+    const HeightmapPixels &m_pixels;
+
+    // Level "n" is "1 << (n + 1)" times smaller than the heightmap.
+    std::vector<HeightmapPixels> m_pyramid;
+
+    std::map<TileKey, CachedTile> m_cache;
+    int m_use_count;
+};
@@ -1,8 +1,10 @@
 
 #include "stdafx.h"
 
+#include "common_util.h"
 #include "world_editor.h"
 #include "my_canvas.h"
+#include "terrain_preview.h"
 #include "world_data.h"
 
 
@@ -21,10 +23,12 @@ END_EVENT_TABLE();
 
 static const int MIN_ZOOM_SCALE = 1;
 static const int MAX_ZOOM_SCALE = 16;
+static const int MAX_ZOOM_SHIFT = 4;
 
 
 static const wxColor COLOR_RED(255, 0, 0);
 static const wxColor COLOR_PURPLE(255, 0, 255, 128);
+static const wxColor COLOR_YELLOW(255, 255, 0);
 
 
 // Canvas ctor.
@@ -33,13 +37,14 @@ MyCanvas::MyCanvas(MyMainFrame *parent) :
     m_parent(parent),
     m_panning_mode(false),
     m_zoom_scale(MIN_ZOOM_SCALE),
+    m_zoom_shift(0),
     m_center_x(0),
     m_center_y(0),
     m_old_mouse_x(0),
     m_old_mouse_y(0),
-    m_old_zoom_scale(MIN_ZOOM_SCALE),
-    m_old_heightmap(nullptr),
-    m_zoomed_heightmap(nullptr)
+    m_has_pick(false),
+    m_picked_x(0),
+    m_picked_z(0)
 {
 }
 
@@ -47,19 +52,23 @@ MyCanvas::MyCanvas(MyMainFrame *parent) :
 // Destructor.
 MyCanvas::~MyCanvas()
 {
-    if (m_zoomed_heightmap != nullptr) {
-        m_zoomed_heightmap->FreeResource();
-        delete m_zoomed_heightmap;
-        m_zoomed_heightmap = nullptr;
-    }
 }
 
 
+// Divide, rounding down, even for negative numbers.
+static int DivideDown(int val, int divisor)
+{
+    return RoundDownInt(val, divisor) / divisor;
+}
+
+
+// World coords to screen coords, and back again. Every world pixel covers the
+// screen pixels from where it lands, up to where the next one over does.
 int MyCanvas::X_worldToScreen(int x) const 
 {
     int width  = GetSize().GetWidth();
     int center = (width / 2) - m_center_x;
-    return center + (x * m_zoom_scale);
+    return center + DivideDown(x * m_zoom_scale, 1 << m_zoom_shift);
 }
 
 
@@ -67,7 +76,7 @@ int MyCanvas::Y_worldToScreen(int y) const
 {
     int height = GetSize().GetHeight();
     int center = (height / 2) - m_center_y;
-    return center - (y * m_zoom_scale);
+    return center - DivideDown(y * m_zoom_scale, 1 << m_zoom_shift);
 }
 
 
@@ -75,12 +84,7 @@ int MyCanvas::X_screenToWorld(int x) const
 {
     int width = GetSize().GetWidth();
     int center = (width / 2) - m_center_x;
-    if ((x - center) >= 0) {
-        return (x - center) / m_zoom_scale;
-    }
-    else {
-        return ((x - center) / m_zoom_scale) - 1;
-    }
+    return DivideDown((x - center) * (1 << m_zoom_shift), m_zoom_scale);
 }
 
 
@@ -88,12 +92,16 @@ int MyCanvas::Y_screenToWorld(int y) const
 {
     int height = GetSize().GetHeight();
     int center = (height / 2) - m_center_y;
-    if ((y - center) < 0) {
-        return -(y - center) / m_zoom_scale;
-    }
-    else {
-        return (-(y - center) / m_zoom_scale) - 1;
-    }
+    return -DivideDown((y - center) * (1 << m_zoom_shift), m_zoom_scale);
+}
+
+
+// Where the terrain preview should look. If nothing's been
+// picked yet, that's the middle of the heightmap.
+void MyCanvas::getPickedSpot(int *pOut_x, int *pOut_z) const
+{
+    *pOut_x = m_has_pick ? m_picked_x : 0;
+    *pOut_z = m_has_pick ? m_picked_z : 0;
 }
 
 
@@ -125,9 +133,18 @@ void MyCanvas::onKeyUp(wxKeyEvent &evt)
 }
 
 
-// On left mouse down.
+// On left mouse down, pick that spot for the terrain preview.
+// The canvas's Y is the world's Z.
 void MyCanvas::onMouseLeftDown(wxMouseEvent &evt)
 {
+    if (m_parent->getWorldData() == nullptr) {
+        return;
+    }
+
+    m_has_pick = true;
+    m_picked_x = X_screenToWorld(evt.GetX());
+    m_picked_z = Y_screenToWorld(evt.GetY());
+    repaintCanvas();
 }
 
 
@@ -151,9 +168,9 @@ void MyCanvas::onMouseMove(wxMouseEvent &evt)
     int screen_x = X_screenToWorld(x);
     int screen_y = Y_screenToWorld(y);
 
-    wxBitmap *heightmap = world->getHeightmap();
-    int width  = heightmap->GetWidth();
-    int height = heightmap->GetHeight();
+    const HeightmapPixels &pixels = world->getHeightmapPixels();
+    int width  = pixels.width;
+    int height = pixels.height;
 
     int map_x =   screen_x + (width  / 2);
     int map_y =  -screen_y + (height / 2);
@@ -164,23 +181,14 @@ void MyCanvas::onMouseMove(wxMouseEvent &evt)
         return;
     }
 
-    // Sample that one pixel.
-    wxNativePixelData data(*heightmap);
-    if (!data) {
-        SetToolTip(wxString(""));
-        return;
-    }
-
-    wxNativePixelData::Iterator p(data);
-    p.Offset(data, map_x, map_y);
-    unsigned char r = p.Red();
-    unsigned char g = p.Green();
-    unsigned char b = p.Blue();
+    // Sample that one pixel, and the dirt height it turned into.
+    unsigned char gray = pixels.getPixel(map_x, map_y);
+    int dirt_height = world->getDirtHeights().getDirtHeight(map_x, map_y);
 
-    char msg[64];
+    char msg[96];
     sprintf(msg,
-        "Screen Pos: %d, %d\nHeightmap Pos: %d, %d\n%u %u %u",
-        screen_x, screen_y, map_x, map_y, r, g, b);
+        "Screen Pos: %d, %d\nHeightmap Pos: %d, %d\nGray: %u, Dirt Height: %d",
+        screen_x, screen_y, map_x, map_y, gray, dirt_height);
     SetToolTip(wxString(msg));
 }
 
@@ -213,19 +221,24 @@ void MyCanvas::repaintCanvas()
 
 
 // Change the zoom scale, and clamp it to the allowed values.
+// Zooming in goes up a pixel at a time. Zooming out past one to one goes in halves.
 void MyCanvas::changeZoomScale(bool positive)
 {
-    int new_value = m_zoom_scale + (positive ? 1 : -1);
-    if (new_value < MIN_ZOOM_SCALE) {
-        new_value = MIN_ZOOM_SCALE;
-    }
-    else if (new_value > MAX_ZOOM_SCALE) {
-        new_value = MAX_ZOOM_SCALE;
+    if (positive) {
+        if (m_zoom_shift > 0) {
+            m_zoom_shift--;
+        }
+        else if (m_zoom_scale < MAX_ZOOM_SCALE) {
+            m_zoom_scale++;
+        }
     }
-
-    if (m_zoom_scale != new_value) {
-        m_zoom_scale = new_value;
-        rebuildZoomedHeightmap();
+    else {
+        if (m_zoom_scale > MIN_ZOOM_SCALE) {
+            m_zoom_scale--;
+        }
+        else if (m_zoom_shift < MAX_ZOOM_SHIFT) {
+            m_zoom_shift++;
+        }
     }
 }
 
@@ -245,72 +258,61 @@ void MyCanvas::render(wxDC &dc)
     if (world_data != nullptr) {
         renderWorldData(world_data, dc);
         renderGrid(dc);
+        renderPickedSpot(dc);
     }
 }
 
 
-// Whenever we zoom in on the bitmap, rebuild our cached version.
-// Image sizing is expensive, so we don't want to do this if we don't need to.
-void MyCanvas::rebuildZoomedHeightmap()
+// Draw the heightmap, a tile at a time. Only the tiles that are on screen, and
+// that the heightmap reaches, get drawn. The tiles already know about our zoom, so
+// they're drawn as-is, and anything we've drawn before comes straight from the cache.
+void MyCanvas::renderWorldData(WorldData *world_data, wxDC &dc)
 {
-    // If there's no loaded world, don't bother.
-    WorldData *world_data = m_parent->getWorldData();
-    if (world_data == nullptr) {
-        return;
-    }
+    const HeightmapPixels &pixels = world_data->getHeightmapPixels();
+    int width  = pixels.width;
+    int height = pixels.height;
 
-    // If we've already built this, and nothing has changed, don't bother.
-    wxBitmap *heightmap = world_data->getHeightmap();
-    if ((m_zoomed_heightmap != nullptr) &&
-        (m_old_heightmap  == heightmap) &&
-        (m_old_zoom_scale == m_zoom_scale)) {
-        return;
-    }
+    // Offset the drawing so the center of the heightmap is at the screen origin.
+    int left   = X_worldToScreen(-width  / 2);
+    int top    = Y_worldToScreen( height / 2);
+    int right  = X_worldToScreen(width - (width / 2));
+    int bottom = Y_worldToScreen((height / 2) - height);
 
-    // Free up any previous one.
-    if (m_zoomed_heightmap != nullptr) {
-        m_zoomed_heightmap->FreeResource();
-        m_zoomed_heightmap = nullptr;
+    // Tiles are lined up on the world origin, so work from there.
+    wxSize size = GetSize();
+    int origin_x = X_worldToScreen(0);
+    int origin_y = Y_worldToScreen(0);
+
+    int first_x = (left   > 0) ? left   : 0;
+    int first_y = (top    > 0) ? top    : 0;
+    int last_x  = (right  < size.GetWidth())  ? right  : size.GetWidth();
+    int last_y  = (bottom < size.GetHeight()) ? bottom : size.GetHeight();
+
+    const int tile_size = HeightmapTiles::TILE_SIZE;
+    HeightmapTiles &tiles = world_data->getHeightmapTiles();
+
+    if ((first_x < last_x) && (first_y < last_y)) {
+        int first_tile_x = DivideDown(first_x - origin_x, tile_size);
+        int first_tile_y = DivideDown(first_y - origin_y, tile_size);
+        int last_tile_x  = DivideDown(last_x - 1 - origin_x, tile_size);
+        int last_tile_y  = DivideDown(last_y - 1 - origin_y, tile_size);
+
+        for     (int tile_x = first_tile_x; tile_x <= last_tile_x; tile_x++) {
+            for (int tile_y = first_tile_y; tile_y <= last_tile_y; tile_y++) {
+                const wxBitmap &tile = tiles.getTile(m_zoom_scale, m_zoom_shift, tile_x, tile_y);
+                wxPoint pos(origin_x + (tile_x * tile_size), origin_y + (tile_y * tile_size));
+                dc.DrawBitmap(tile, pos, false);
+            }
+        }
     }
 
-    // Build our bigger image.
-    int width  = heightmap->GetWidth();
-    int height = heightmap->GetHeight();
-
-    wxImage image = heightmap->ConvertToImage();
-    m_zoomed_heightmap = new wxBitmap(
-        image.Scale(width  * m_zoom_scale,
-                    height * m_zoom_scale,
-                    wxIMAGE_QUALITY_NEAREST));
-
-    // Remember when to do this again.
-    m_old_zoom_scale = m_zoom_scale;
-    m_old_heightmap  = heightmap;
-}
-
-
-// And cache the image. Shit gets expensive.
-void MyCanvas::renderWorldData(WorldData *world_data, wxDC &dc)
-{
-    wxBitmap *bitmap = world_data->getHeightmap();
-    int width  = bitmap->GetWidth();
-    int height = bitmap->GetHeight();
-    rebuildZoomedHeightmap();
-
-    // Offset the drawing so the center of the bitmap is at the screen origin.
-    int screen_x = X_worldToScreen(-width  / 2);
-    int screen_y = Y_worldToScreen( height / 2);
-
-    // But, the DC doesn't know about our zoom scale, so draw the zoomed version.
-    dc.DrawBitmap(*m_zoomed_heightmap, wxPoint(screen_x, screen_y), false);
+    tiles.trimCache();
 
     // Draw a red outline around the heightmap.
     wxPen *pen = wxThePenList->FindOrCreatePen(COLOR_RED, 1, wxPENSTYLE_SOLID);
     dc.SetPen(*pen);
     dc.SetBrush(*wxTRANSPARENT_BRUSH);
-    dc.DrawRectangle(wxRect(screen_x, screen_y,
-                            width  * m_zoom_scale,
-                            height * m_zoom_scale));
+    dc.DrawRectangle(wxRect(left, top, right - left, bottom - top));
 }
 
 
@@ -333,6 +335,29 @@ void MyCanvas::renderGrid(wxDC &dc)
 }
 
 
+// Outline the chunks the terrain preview would show, around the picked spot.
+// Same as the heightmap's outline, the bottom edge is one under the last row.
+void MyCanvas::renderPickedSpot(wxDC &dc)
+{
+    if (!m_has_pick) {
+        return;
+    }
+
+    int first_x, first_z;
+    TerrainPreview::getWindowBounds(m_picked_x, m_picked_z, &first_x, &first_z);
+
+    int left   = X_worldToScreen(first_x);
+    int right  = X_worldToScreen(first_x + TerrainPreview::WINDOW_WIDTH);
+    int top    = Y_worldToScreen(first_z + TerrainPreview::WINDOW_WIDTH - 1);
+    int bottom = Y_worldToScreen(first_z - 1);
+
+    wxPen *pen = wxThePenList->FindOrCreatePen(COLOR_YELLOW, 1, wxPENSTYLE_SOLID);
+    dc.SetPen(*pen);
+    dc.SetBrush(*wxTRANSPARENT_BRUSH);
+    dc.DrawRectangle(wxRect(left, top, right - left, bottom - top));
+}
+
+
 // This is too useful to get rid of. We'll add it back one day.
 #if 0
 static const wxColor COLOR_GRID_ORIGIN(255, 0, 255);
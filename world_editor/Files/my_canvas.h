@@ -20,6 +20,8 @@ public:
     int X_screenToWorld(int x) const;
     int Y_screenToWorld(int y) const;
 
+    void getPickedSpot(int *pOut_x, int *pOut_z) const;
+
     void onSize(wxSizeEvent& evt);
     void onKeyDown(wxKeyEvent &evt);
     void onKeyUp(wxKeyEvent &evt);
@@ -41,21 +43,25 @@ private:
     void operator=(const MyCanvas &that) = delete;
 
     void changeZoomScale(bool positive);
-    void rebuildZoomedHeightmap();
     void renderWorldData(WorldData *world_data, wxDC &dc);
     void renderGrid(wxDC &dc);
+    void renderPickedSpot(wxDC &dc);
 
     MyMainFrame *m_parent;
 
+    // Zoomed in, every heightmap pixel is "m_zoom_scale" screen pixels wide.
+    // Zoomed out, every screen pixel is "1 << m_zoom_shift" heightmap pixels wide.
     bool m_panning_mode;
     int  m_zoom_scale;
+    int  m_zoom_shift;
 
     int  m_center_x;
     int  m_center_y;
     int  m_old_mouse_x;
     int  m_old_mouse_y;
 
-    int m_old_zoom_scale;
-    const wxBitmap *m_old_heightmap;
-    wxBitmap *m_zoomed_heightmap;
+    // The last spot clicked on, in world coords, for the terrain preview to look at.
+    bool m_has_pick;
+    int  m_picked_x;
+    int  m_picked_z;
 };
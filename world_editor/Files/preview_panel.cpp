@@ -0,0 +1,187 @@
+#include "stdafx.h"
+#include "preview_panel.h"
+
+#include "format.h"
+
+
+// Every block top is two units across and one deep, and this many units tall.
+static const double BLOCK_TALL = 1.2;
+static const int MARGIN = 8;
+
+// The dirt on top is grass, same as the game. Faces get darker the further they turn from the sun.
+static const wxColour COLOR_GRASS(96, 160, 64);
+static const wxColour COLOR_DIRT(134, 96, 67);
+static const wxColour COLOR_STONE(128, 128, 128);
+static const wxColour COLOR_COAL(40, 40, 40);
+
+static const int SHADE_TOP   = 100;
+static const int SHADE_NORTH = 80;
+static const int SHADE_EAST  = 60;
+
+
+// What color a face is, before shading.
+static const wxColour &GetFaceColor(SurfaceType surf_type, FaceType face_type)
+{
+    switch (surf_type) {
+    case SurfaceType::GRASS_TOP:
+        return COLOR_GRASS;
+
+    case SurfaceType::DIRT:
+        return (face_type == FaceType::TOP) ? COLOR_GRASS : COLOR_DIRT;
+
+    case SurfaceType::STONE:
+        return COLOR_STONE;
+
+    case SurfaceType::COAL:
+        return COLOR_COAL;
+
+    default:
+        PrintTheImpossible(__FILE__, __LINE__, static_cast<int>(surf_type));
+        return COLOR_STONE;
+    }
+}
+
+
+// Darken a color by a percent.
+static wxColour ShadeColor(const wxColour &color, int percent)
+{
+    return wxColour(
+        (color.Red()   * percent) / 100,
+        (color.Green() * percent) / 100,
+        (color.Blue()  * percent) / 100);
+}
+
+
+// Ctor. There's nothing to draw until the first mesh shows up.
+PreviewPanel::PreviewPanel(wxWindow *parent, const wxSize &size) :
+    wxPanel(parent, wxID_ANY, wxDefaultPosition, size)
+{
+    SetMinSize(size);
+
+    Bind(wxEVT_PAINT, &PreviewPanel::onPaint, this);
+    Bind(wxEVT_SIZE,  &PreviewPanel::onSize,  this);
+
+    renderMesh();
+}
+
+
+// Swap in a new mesh, and draw it.
+void PreviewPanel::setMesh(PreviewMesh &&mesh)
+{
+    m_mesh = std::move(mesh);
+    renderMesh();
+    Refresh(false);
+}
+
+
+// Paint whatever we drew last.
+void PreviewPanel::onPaint(wxPaintEvent &evt)
+{
+    wxPaintDC dc(this);
+    if (m_bitmap.IsOk()) {
+        dc.DrawBitmap(m_bitmap, 0, 0, false);
+    }
+}
+
+
+// A new size means drawing it all again, to fit.
+void PreviewPanel::onSize(wxSizeEvent &evt)
+{
+    renderMesh();
+    Refresh(false);
+    evt.Skip();
+}
+
+
+// Draw every face into our bitmap, in order, so the nearer ones cover the ones behind.
+// Scale it all so the whole window fits, however tall the terrain is.
+void PreviewPanel::renderMesh()
+{
+    wxSize size = GetClientSize();
+    if ((size.GetWidth() <= 0) || (size.GetHeight() <= 0)) {
+        return;
+    }
+
+    m_bitmap = wxBitmap(size.GetWidth(), size.GetHeight());
+
+    wxMemoryDC dc(m_bitmap);
+    dc.SetBackground(*wxBLACK_BRUSH);
+    dc.Clear();
+    dc.SetTextForeground(*wxWHITE);
+
+    if (m_mesh.width == 0) {
+        dc.DrawText("Pick a height map to see the terrain.", MARGIN, MARGIN);
+        return;
+    }
+
+    double width   = m_mesh.width;
+    double heights = m_mesh.top_y + 1;
+
+    double units_across = 2.0 * width;
+    double units_down   = width + (heights * BLOCK_TALL);
+
+    double scale_x = (size.GetWidth()  - (2 * MARGIN)) / units_across;
+    double scale_y = (size.GetHeight() - (2 * MARGIN)) / units_down;
+    double scale   = (scale_x < scale_y) ? scale_x : scale_y;
+
+    // The window's south-west corner, at the bottom of the world. Center it all up.
+    double origin_x = size.GetWidth() / 2.0;
+    double origin_y = MARGIN + (heights * BLOCK_TALL * scale) +
+                      ((size.GetHeight() - (2 * MARGIN) - (units_down * scale)) / 2.0);
+
+    auto project = [origin_x, origin_y, scale](int x, int y, int z) {
+        double screen_x = origin_x + ((x - z) * scale);
+        double screen_y = origin_y + ((x + z) * scale / 2.0) - (y * BLOCK_TALL * scale);
+        return wxPoint(static_cast<int>(screen_x + 0.5), static_cast<int>(screen_y + 0.5));
+    };
+
+    for (const PreviewFace &face : m_mesh.faces) {
+        int x = face.x;
+        int y = face.y;
+        int z = face.z;
+
+        wxPoint corners[4];
+        int shade = SHADE_TOP;
+
+        switch (face.face_type) {
+        case FaceType::TOP:
+            corners[0] = project(x,     y + 1, z);
+            corners[1] = project(x + 1, y + 1, z);
+            corners[2] = project(x + 1, y + 1, z + 1);
+            corners[3] = project(x,     y + 1, z + 1);
+            shade = SHADE_TOP;
+            break;
+
+        case FaceType::EAST:
+            corners[0] = project(x + 1, y,     z);
+            corners[1] = project(x + 1, y,     z + 1);
+            corners[2] = project(x + 1, y + 1, z + 1);
+            corners[3] = project(x + 1, y + 1, z);
+            shade = SHADE_EAST;
+            break;
+
+        case FaceType::NORTH:
+            corners[0] = project(x,     y,     z + 1);
+            corners[1] = project(x + 1, y,     z + 1);
+            corners[2] = project(x + 1, y + 1, z + 1);
+            corners[3] = project(x,     y + 1, z + 1);
+            shade = SHADE_NORTH;
+            break;
+
+        default:
+            PrintTheImpossible(__FILE__, __LINE__, static_cast<int>(face.face_type));
+            continue;
+        }
+
+        // Outline each face in its own color, so rounding doesn't leave cracks.
+        wxColour color = ShadeColor(GetFaceColor(face.surf_type, face.face_type), shade);
+        dc.SetPen(*wxThePenList->FindOrCreatePen(color, 1, wxPENSTYLE_SOLID));
+        dc.SetBrush(*wxTheBrushList->FindOrCreateBrush(color, wxBRUSHSTYLE_SOLID));
+        dc.DrawPolygon(4, corners);
+    }
+
+    if (m_mesh.chunks_done < m_mesh.chunks_total) {
+        std::string msg = fmt::format("Generating, {0} of {1} chunks...", m_mesh.chunks_done, m_mesh.chunks_total);
+        dc.DrawText(msg.c_str(), MARGIN, MARGIN);
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "stdafx.h"
+#include "terrain_preview.h"
+
+
+// Draws a terrain preview mesh, as if you were looking down at it from the
+// north-east. Drawing all the faces is slow enough that we only do it when
+// there's a new mesh, and paint from a bitmap the rest of the time.
+class PreviewPanel : public wxPanel
+{
+public:
+    PreviewPanel(wxWindow *parent, const wxSize &size);
+    ~PreviewPanel() {}
+
+    void setMesh(PreviewMesh &&mesh);
+
+private:
+    // Disallow the default ctor, copying, and moving.
+    PreviewPanel() = delete;
+    PreviewPanel(const PreviewPanel &that) = delete;
+    void operator=(const PreviewPanel &that) = delete;
+    PreviewPanel(PreviewPanel &&that) = delete;
+    void operator=(PreviewPanel &&that) = delete;
+
+    // Private methods.
+    void onPaint(wxPaintEvent &evt);
+    void onSize(wxSizeEvent &evt);
+    void renderMesh();
+
+    // Private data.
+    PreviewMesh m_mesh;
+    wxBitmap m_bitmap;
+};
@@ -11,19 +11,29 @@ enum {
     ID_STONE_SUBTRACTED_SPINNER,
     ID_STONE_DISPLACEMENT_SPINNER,
     ID_STONE_NOISE_SCALE_SPINNER,
-    ID_COAL_DENSITY_SPINNER
+    ID_COAL_DENSITY_SPINNER,
+    ID_PREVIEW_TIMER
 };
 
 
-// Default ctor.
-// For any "magic values" in here such as borders, or spinner ranges, I'm just
-// making stuff up. Feel free to tweak this later if you don't like how it works.
-SettingsDialog::SettingsDialog(wxWindow *parent) :
-    wxDialog(parent, wxID_ANY, "World Settings")
+// How often to check for a new terrain preview, in msecs.
+static const int PREVIEW_TIMER_MSECS = 100;
+
+
+// The only allowed ctor. Start from these settings, and preview the terrain around
+// this spot, in world coords. For any "magic values" in here such as borders, or spinner
+// ranges, I'm just making stuff up. Feel free to tweak this later if you don't like how it works.
+SettingsDialog::SettingsDialog(wxWindow *parent, const BuildSettings &settings, int preview_x, int preview_z) :
+    wxDialog(parent, wxID_ANY, "World Settings"),
+    m_build_settings(settings),
+    m_preview_timer(this, ID_PREVIEW_TIMER),
+    m_preview_x(preview_x),
+    m_preview_z(preview_z)
 {
     const int BORDER = 5;
     const int WIDE_WIDTH = 400;
     const int THIN_WIDTH = 75;
+    const int PREVIEW_SIZE = 400;
 
     // Create our panel and grid.
     m_panel = new wxPanel(this, -1);
@@ -84,10 +94,22 @@ SettingsDialog::SettingsDialog(wxWindow *parent) :
     wxStaticBoxSizer *static_box = new wxStaticBoxSizer(wxHORIZONTAL, this, wxT(" Build Settings "));
     static_box->Add(m_panel);
 
+    // The stats preview, in a static box of its own.
+    m_preview_text = new wxStaticText(this, -1, "Pick a height map to see the build stats.");
+
+    wxStaticBoxSizer *preview_box = new wxStaticBoxSizer(wxHORIZONTAL, this, wxT(" Build Stats "));
+    preview_box->Add(m_preview_text, 1, wxALL, BORDER);
+
     // Our "show stats" check box.
     m_show_stats_checkbox = new wxCheckBox(this, -1, "Show build stats once we're done");
     m_show_stats_checkbox->SetValue(true);
 
+    // The terrain preview goes off to the side, since it's big.
+    m_preview_panel = new PreviewPanel(this, wxSize(PREVIEW_SIZE, PREVIEW_SIZE));
+
+    wxStaticBoxSizer *terrain_box = new wxStaticBoxSizer(wxHORIZONTAL, this, wxT(" Terrain Preview "));
+    terrain_box->Add(m_preview_panel, 1, wxALL | wxEXPAND, BORDER);
+
     // A horizontal box for our buttons.
     wxButton *okayButton   = new wxButton(this, wxID_OK, wxT("OK"));
     wxButton *cancelButton = new wxButton(this, wxID_CANCEL, wxT("Cancel"));
@@ -97,18 +119,35 @@ SettingsDialog::SettingsDialog(wxWindow *parent) :
     button_box->Add(okayButton,   0, wxALL, BORDER);
     button_box->Add(cancelButton, 0, wxALL, BORDER);
 
+    // A vertical box for the settings and stats, with the terrain next to it.
+    wxBoxSizer *settings_vbox = new wxBoxSizer(wxVERTICAL);
+    settings_vbox->Add(static_box, 1, wxALL, BORDER);
+    settings_vbox->Add(preview_box, 0, wxALL | wxEXPAND, BORDER);
+    settings_vbox->Add(m_show_stats_checkbox, 0, wxALL, BORDER);
+
+    wxBoxSizer *content_hbox = new wxBoxSizer(wxHORIZONTAL);
+    content_hbox->Add(settings_vbox, 0, wxEXPAND);
+    content_hbox->Add(terrain_box, 1, wxALL | wxEXPAND, BORDER);
+
     // A vertical box for the dialog content.
     wxBoxSizer *vbox = new wxBoxSizer(wxVERTICAL);
-    vbox->Add(static_box, 1, wxALL, BORDER);
-    vbox->Add(m_show_stats_checkbox, 0, wxALL, BORDER);
+    vbox->Add(content_hbox, 1, wxEXPAND);
     vbox->Add(button_box, 0, wxALL, BORDER);
     SetSizer(vbox);
 
     // Bind our events.
     Bind(wxEVT_BUTTON, &SettingsDialog::onOkayClick, this, wxID_OK);
+    Bind(wxEVT_FILEPICKER_CHANGED, &SettingsDialog::onHeightMapChanged, this, ID_HEIGHT_MAP_PICKER);
+    Bind(wxEVT_SPINCTRLDOUBLE, &SettingsDialog::onSettingChanged, this, ID_STONE_PERCENT_SPINNER, ID_COAL_DENSITY_SPINNER);
+    Bind(wxEVT_TIMER, &SettingsDialog::onPreviewTimer, this, ID_PREVIEW_TIMER);
 
     // And away we go. The caller needs to call "ShowModal".
     readFromBuildSettings();
+    if (!m_build_settings.getHeightMapFilename().empty()) {
+        loadPreviewData();
+    }
+
+    m_preview_timer.Start(PREVIEW_TIMER_MSECS);
     Fit();
     Centre();
 }
@@ -136,8 +175,7 @@ void SettingsDialog::addGridControl(wxControl *ctrl, int row, int preferred_widt
 void SettingsDialog::readFromBuildSettings()
 {
     const std::string &our_fname = m_build_settings.getHeightMapFilename();
-    wxFileName dlg_fname;
-    dlg_fname.SetFullName(our_fname.c_str());
+    wxFileName dlg_fname(our_fname.c_str());
     m_height_map_picker->SetFileName(dlg_fname);
 
     double stone_pct = m_build_settings.getStonePercent();
@@ -157,9 +195,9 @@ void SettingsDialog::readFromBuildSettings()
 }
 
 
-// TODO: Ideally we'd be calling "on close" rather than dealing
-// with the button press directly. Figure this out later.
-void SettingsDialog::onOkayClick(wxCommandEvent& event)
+// Write our dialog contents out to some build settings.
+// Return false if any of them aren't valid.
+bool SettingsDialog::writeToBuildSettings(BuildSettings *pOut) const
 {
     wxString dlg_fname = m_height_map_picker->GetFileName().GetFullPath();
     std::string fname = dlg_fname.ToStdString();
@@ -170,17 +208,122 @@ void SettingsDialog::onOkayClick(wxCommandEvent& event)
     double stone_noise_scale  = m_stone_noise_scale_spinner->GetValue();
     double coal_density       = m_coal_density_spinner->GetValue();
 
+    return (
+        pOut->setHeightMapFilename(fname) &&
+        pOut->setStonePercent(stone_pct) &&
+        pOut->setStoneSubtracted(stone_subtracted) &&
+        pOut->setStoneDisplacement(stone_displacement) &&
+        pOut->setStoneNoiseScale(stone_noise_scale) &&
+        pOut->setCoalDensity(coal_density));
+}
+
+
+// Rerun the dry run with whatever's in the dialog right now. It runs in the background,
+// and the timer shows the stats once they're in. After the first one, only what the
+// last change touched gets redone. The terrain takes longer, and it catches up too.
+void SettingsDialog::updatePreview()
+{
+    if (m_preview_data == nullptr) {
+        return;
+    }
+
+    // If the height map is in the middle of changing, wait for it.
     BuildSettings new_settings;
+    if (!writeToBuildSettings(&new_settings) ||
+        (new_settings.getHeightMapFilename() != m_preview_data->getBuildSettings().getHeightMapFilename())) {
+        return;
+    }
+
+    m_preview_data->setBuildSettings(new_settings);
+    m_stats_preview->request(new_settings);
+    m_terrain_preview->request(new_settings, m_preview_x, m_preview_z);
+}
+
 
-    bool valid = (
-        new_settings.setHeightMapFilename(fname) &&
-        new_settings.setStonePercent(stone_pct) &&
-        new_settings.setStoneSubtracted(stone_subtracted) &&
-        new_settings.setStoneDisplacement(stone_displacement) &&
-        new_settings.setStoneNoiseScale(stone_noise_scale) &&
-        new_settings.setCoalDensity(coal_density));
+// Hand over the heightmap we loaded for the preview, so it doesn't get loaded
+// all over again, along with everything the dry runs worked out.
+std::unique_ptr<WorldData> SettingsDialog::takePreviewData()
+{
+    if ((m_preview_data == nullptr) ||
+        (m_preview_data->getBuildSettings().getHeightMapFilename() != m_build_settings.getHeightMapFilename())) {
+        return nullptr;
+    }
+
+    m_terrain_preview = nullptr;
+    m_stats_preview = nullptr;
+    m_preview_data->setBuildSettings(m_build_settings);
+    return std::move(m_preview_data);
+}
+
+
+// Load whatever height map is in the dialog, and start the stats and the terrain from scratch.
+// The stats and terrain previews are looking at the old height map, so they go first.
+void SettingsDialog::loadPreviewData()
+{
+    m_terrain_preview = nullptr;
+    m_stats_preview = nullptr;
+    m_preview_data = nullptr;
+
+    BuildSettings new_settings;
+    if (!writeToBuildSettings(&new_settings)) {
+        m_preview_text->SetLabel("Pick a height map to see the build stats.");
+        m_preview_panel->setMesh(PreviewMesh());
+        return;
+    }
+
+    m_preview_data = std::make_unique<WorldData>(new_settings);
+    m_stats_preview = std::make_unique<StatsPreview>(m_preview_data->getDirtHeights(), m_preview_data->getDryRunCache());
+    m_terrain_preview = std::make_unique<TerrainPreview>(m_preview_data->getDirtHeights());
+    m_preview_text->SetLabel("Counting the blocks...");
+    updatePreview();
+}
+
+
+// A new height map means loading it.
+void SettingsDialog::onHeightMapChanged(wxFileDirPickerEvent &event)
+{
+    loadPreviewData();
+}
+
+
+// Any of the spinners changed.
+void SettingsDialog::onSettingChanged(wxSpinDoubleEvent &event)
+{
+    updatePreview();
+}
+
+
+// If the stats are in, or the terrain preview has a new mesh for us, show them.
+void SettingsDialog::onPreviewTimer(wxTimerEvent &event)
+{
+    BuildStats stats;
+    int msecs;
+    if ((m_stats_preview != nullptr) && m_stats_preview->takeStats(&stats, &msecs)) {
+        std::string descr = fmt::format(
+            "{0}\n\n(Took {1} msecs.)",
+            stats.toString(), msecs);
+        m_preview_text->SetLabel(descr.c_str());
+        Fit();
+    }
+
+    if (m_terrain_preview == nullptr) {
+        return;
+    }
+
+    PreviewMesh mesh;
+    if (m_terrain_preview->takeMesh(&mesh)) {
+        m_preview_panel->setMesh(std::move(mesh));
+    }
+}
+
+
+// TODO: Ideally we'd be calling "on close" rather than dealing
+// with the button press directly. Figure this out later.
+void SettingsDialog::onOkayClick(wxCommandEvent& event)
+{
+    BuildSettings new_settings;
 
-    if (valid) {
+    if (writeToBuildSettings(&new_settings)) {
         m_build_settings = new_settings;
         EndModal(wxID_OK);
     }
@@ -2,24 +2,36 @@
 
 #include "stdafx.h"
 #include "build_settings.h"
+#include "preview_panel.h"
+#include "stats_preview.h"
+#include "terrain_preview.h"
+#include "world_data.h"
 
 
 class SettingsDialog : public wxDialog
 {
 public:
-    SettingsDialog(wxWindow *parent);
+    SettingsDialog(wxWindow *parent, const BuildSettings &settings, int preview_x, int preview_z);
     ~SettingsDialog() {}
 
     const BuildSettings &getBuildSettings() const { return m_build_settings; }
     bool getShowStats() const { return m_show_stats_checkbox->GetValue(); }
 
+    std::unique_ptr<WorldData> takePreviewData();
+
 private:
     // Private methods.
     void addGridLabel(const std::string &text, int row);
     void addGridControl(wxControl *ctrl, int row, int preferred_width);
     void readFromBuildSettings();
+    bool writeToBuildSettings(BuildSettings *pOut) const;
+    void loadPreviewData();
+    void updatePreview();
 
     void onOkayClick(wxCommandEvent &event);
+    void onHeightMapChanged(wxFileDirPickerEvent &event);
+    void onSettingChanged(wxSpinDoubleEvent &event);
+    void onPreviewTimer(wxTimerEvent &event);
 
     // Private data.
     BuildSettings m_build_settings;
@@ -34,4 +46,19 @@ private:
     wxSpinCtrlDouble *m_stone_noise_scale_spinner;
     wxSpinCtrlDouble *m_coal_density_spinner;
     wxCheckBox *m_show_stats_checkbox;
+
+    // The heightmap, loaded as soon as it's picked, so the stats can keep up
+    // with the settings as they change. They get counted in the background,
+    // using the heightmap, so they're declared after it. The timer checks in on them.
+    std::unique_ptr<WorldData> m_preview_data;
+    std::unique_ptr<StatsPreview> m_stats_preview;
+    wxStaticText *m_preview_text;
+
+    // The terrain around one spot, built from that same heightmap. It has to go
+    // before the heightmap does, so it's declared after. The timer checks in on it too.
+    std::unique_ptr<TerrainPreview> m_terrain_preview;
+    PreviewPanel *m_preview_panel;
+    wxTimer m_preview_timer;
+    int m_preview_x;
+    int m_preview_z;
 };
\ No newline at end of file
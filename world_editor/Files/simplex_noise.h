@@ -1,9 +0,0 @@
-#pragma once
-
-#include "stdafx.h"
-
-
-// The standard versions.
-double simplex_noise_2(double xin, double yin);
-double simplex_noise_3(double xin, double yin, double zin);
-double simplex_noise_4(double x, double y, double z, double w);
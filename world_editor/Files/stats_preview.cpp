@@ -0,0 +1,93 @@
+#include "stdafx.h"
+#include "stats_preview.h"
+
+#include <chrono>
+
+
+// The only allowed constructor. Nothing happens until the first request.
+StatsPreview::StatsPreview(const DirtHeightMap &height_map, DryRunCache *pCache) :
+    m_height_map(height_map),
+    m_cache(pCache),
+    m_generation(0),
+    m_stats_ready(false),
+    m_stats_generation(-1),
+    m_msecs(0)
+{
+}
+
+
+// Destructor. The worker's using the cache, so it has to stop first.
+StatsPreview::~StatsPreview()
+{
+    cancel();
+}
+
+
+// Count the blocks for these settings. Whatever the worker was doing before
+// is out of date, so stop it, and start again.
+void StatsPreview::request(const BuildSettings &settings)
+{
+    cancel();
+
+    int generation = m_generation;
+    m_generator = std::make_unique<WorldGenerator>(settings, m_height_map);
+    m_worker = std::async(std::launch::async, &StatsPreview::run, this, generation);
+}
+
+
+// Get the stats for the latest request, and how long they took,
+// if they're done, and we haven't already handed them out.
+bool StatsPreview::takeStats(BuildStats *pOut_stats, int *pOut_msecs)
+{
+    std::lock_guard<std::mutex> lock(m_stats_mutex);
+
+    if (!m_stats_ready || (m_stats_generation != m_generation)) {
+        return false;
+    }
+
+    *pOut_stats = m_stats;
+    *pOut_msecs = m_msecs;
+    m_stats_ready = false;
+    return true;
+}
+
+
+// Tell the worker to give up, and wait until it has. Its
+// threads only check between tiles, so this is never much of a wait.
+void StatsPreview::cancel()
+{
+    m_generation++;
+
+    if (m_worker.valid()) {
+        m_generator->cancel();
+        m_worker.wait();
+        m_worker = std::future<void>();
+    }
+
+    m_generator = nullptr;
+}
+
+
+// The worker. Do the dry run, and if nobody changed their mind in the meantime, post the stats.
+void StatsPreview::run(int generation)
+{
+    auto start_time = std::chrono::steady_clock::now();
+
+    BuildStats stats = m_generator->performDryRun(m_cache);
+    if (m_generator->wasCancelled()) {
+        return;
+    }
+
+    auto end_time = std::chrono::steady_clock::now();
+    int msecs = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count());
+
+    std::lock_guard<std::mutex> lock(m_stats_mutex);
+    if (m_generation != generation) {
+        return;
+    }
+
+    m_stats = stats;
+    m_msecs = msecs;
+    m_stats_generation = generation;
+    m_stats_ready = true;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "stdafx.h"
+#include "build_settings.h"
+#include "build_stats.h"
+#include "world_generator.h"
+
+
+// The build stats for the settings in the dialog, counted by a dry run on a worker
+// thread, so the spinners never wait on it. Every request cancels whatever the last
+// one was doing, which stops after the tiles it's on. The dry run cache is only ever
+// touched by the worker, and a cancelled run leaves it in good shape, since each tile
+// is either brought up to date or left the way it was. Results get tagged with
+// the request they're for, and only the latest one gets handed out.
+class StatsPreview
+{
+public:
+    StatsPreview(const DirtHeightMap &height_map, DryRunCache *pCache);
+    ~StatsPreview();
+
+    void request(const BuildSettings &settings);
+    bool takeStats(BuildStats *pOut_stats, int *pOut_msecs);
+
+private:
+    // Disallow the default ctor, copying, and moving.
+    StatsPreview() = delete;
+    StatsPreview(const StatsPreview &that) = delete;
+    void operator=(const StatsPreview &that) = delete;
+    StatsPreview(StatsPreview &&that) = delete;
+    void operator=(StatsPreview &&that) = delete;
+
+    // Private methods.
+    void cancel();
+    void run(int generation);
+
+    // Private data. The heightmap and the cache have to outlive the preview.
+    const DirtHeightMap &m_height_map;
+    DryRunCache *m_cache;
+
+    // The generator for the latest request. "cancel" waits for
+    // the worker to stop before it lets go of it.
+    std::unique_ptr<WorldGenerator> m_generator;
+    std::atomic<int> m_generation;
+    std::future<void> m_worker;
+
+    // The latest stats, waiting for the GUI thread to come and get them.
+    std::mutex m_stats_mutex;
+    bool m_stats_ready;
+    int m_stats_generation;
+    BuildStats m_stats;
+    int m_msecs;
+};
@@ -10,19 +10,34 @@
 #define _CRT_SECURE_NO_WARNINGS
 #endif
 
+// The headless world generator builds the generator files on their own,
+// without Windows or wxWidgets. See "world_gen_cli".
+#ifndef WORLD_GEN_HEADLESS
 #include "targetver.h"
 
 // Exclude rarely-used stuff from Windows headers.
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
+#endif
 
 // C headers.
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <malloc.h>
 #include <memory.h>
+#include <stdint.h>
+
+#ifndef WORLD_GEN_HEADLESS
 #include <tchar.h>
+#endif
 
 // C++ headers.
+#include <algorithm>
+#include <array>
+#include <functional>
 #include <map>
 #include <list>
 #include <memory>
@@ -31,7 +46,14 @@
 #include <sstream>
 #include <string>
 
+#include <atomic>
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <thread>
+
 // My headers.
+#ifndef WORLD_GEN_HEADLESS
 #include "wx/wxprec.h"
 
 #include "wx/dcbuffer.h"
@@ -42,3 +64,4 @@
 #include "wx/rawbmp.h"
 #include "wx/spinctrl.h"
 #include "wx/time.h"
+#endif
@@ -0,0 +1,257 @@
+#include "stdafx.h"
+#include "terrain_preview.h"
+
+#include "chunk_blob.h"
+
+
+// Would these settings build the same terrain? The heightmap never changes under us.
+static bool IsSameTerrain(const BuildSettings &a, const BuildSettings &b)
+{
+    return (
+        (a.getStonePercent()      == b.getStonePercent()) &&
+        (a.getStoneSubtracted()   == b.getStoneSubtracted()) &&
+        (a.getStoneDisplacement() == b.getStoneDisplacement()) &&
+        (a.getStoneNoiseScale()   == b.getStoneNoiseScale()) &&
+        (a.getCoalDensity()       == b.getCoalDensity()));
+}
+
+
+// The only allowed constructor. Nothing happens until the first request.
+TerrainPreview::TerrainPreview(const DirtHeightMap &height_map) :
+    m_height_map(height_map),
+    m_generation(0),
+    m_mesh_ready(false)
+{
+}
+
+
+// Destructor. The worker's using our data, so it has to stop first.
+TerrainPreview::~TerrainPreview()
+{
+    cancel();
+}
+
+
+// Which chunks the window covers, given the spot in the middle of it.
+// Returns the south-west corner of the window, in world coords.
+void TerrainPreview::getWindowBounds(int center_x, int center_z, int *pOut_first_x, int *pOut_first_z)
+{
+    int half = (WINDOW_CHUNKS / 2) * CHUNK_BLOB_WIDTH;
+
+    *pOut_first_x = RoundDownInt(center_x, CHUNK_BLOB_WIDTH) - half;
+    *pOut_first_z = RoundDownInt(center_z, CHUNK_BLOB_WIDTH) - half;
+}
+
+
+// Preview the terrain around a spot, with these settings. Whatever the worker was
+// doing before is out of date, so stop it, and start again, keeping any chunks that
+// are still good.
+void TerrainPreview::request(const BuildSettings &settings, int center_x, int center_z)
+{
+    cancel();
+
+    if (!IsSameTerrain(settings, m_settings)) {
+        m_chunk_blobs.clear();
+    }
+    m_settings = settings;
+
+    int first_x, first_z;
+    getWindowBounds(center_x, center_z, &first_x, &first_z);
+
+    // Anything outside the new window isn't worth hanging on to.
+    for (auto iter = m_chunk_blobs.begin(); iter != m_chunk_blobs.end(); ) {
+        int origin_x = iter->first.first;
+        int origin_z = iter->first.second;
+
+        bool inside = (
+            (origin_x >= first_x) && (origin_x < first_x + WINDOW_WIDTH) &&
+            (origin_z >= first_z) && (origin_z < first_z + WINDOW_WIDTH));
+
+        if (inside) {
+            ++iter;
+        }
+        else {
+            iter = m_chunk_blobs.erase(iter);
+        }
+    }
+
+    int generation = m_generation;
+    m_worker = std::async(std::launch::async, &TerrainPreview::run, this, settings, first_x, first_z, generation);
+}
+
+
+// Get the latest mesh, if there's one we haven't already handed out.
+bool TerrainPreview::takeMesh(PreviewMesh *pOut)
+{
+    std::lock_guard<std::mutex> lock(m_mesh_mutex);
+
+    if (!m_mesh_ready) {
+        return false;
+    }
+
+    *pOut = std::move(m_mesh);
+    m_mesh_ready = false;
+    return true;
+}
+
+
+// Tell the worker to give up, and wait until it has. It only
+// checks between chunks, so this is never much of a wait.
+void TerrainPreview::cancel()
+{
+    m_generation++;
+
+    if (m_worker.valid()) {
+        m_worker.wait();
+        m_worker = std::future<void>();
+    }
+}
+
+
+// The worker. Generate whichever chunks in the window we don't already have, the middle
+// one first, and then out from there. Put out a new mesh after every one, so there's
+// something to look at right away. If a newer request comes in, just stop.
+void TerrainPreview::run(BuildSettings settings, int first_x, int first_z, int generation)
+{
+    WorldGenerator generator(settings, m_height_map);
+
+    std::vector<std::pair<int, int>> order;
+    for     (int chunk_x = 0; chunk_x < WINDOW_CHUNKS; chunk_x++) {
+        for (int chunk_z = 0; chunk_z < WINDOW_CHUNKS; chunk_z++) {
+            order.emplace_back(chunk_x, chunk_z);
+        }
+    }
+
+    const int middle = WINDOW_CHUNKS / 2;
+    std::sort(order.begin(), order.end(), [middle](const std::pair<int, int> &a, const std::pair<int, int> &b) {
+        int a_dist = abs(a.first - middle) + abs(a.second - middle);
+        int b_dist = abs(b.first - middle) + abs(b.second - middle);
+        return a_dist < b_dist;
+    });
+
+    int chunks_done = 0;
+    bool generated_any = false;
+
+    for (const std::pair<int, int> &chunk : order) {
+        if (m_generation != generation) {
+            return;
+        }
+
+        int origin_x = first_x + (chunk.first  * CHUNK_BLOB_WIDTH);
+        int origin_z = first_z + (chunk.second * CHUNK_BLOB_WIDTH);
+        std::pair<int, int> key(origin_x, origin_z);
+
+        chunks_done++;
+
+        if (m_chunk_blobs.find(key) != m_chunk_blobs.end()) {
+            continue;
+        }
+
+        // All-air chunks still get a blob, so we know not to do them again.
+        ChunkBuffer buffer;
+        BuildStats ignored;
+        generator.calcChunk(origin_x, origin_z, &buffer, &ignored);
+        m_chunk_blobs[key] = std::move(buffer.data);
+
+        PreviewMesh mesh;
+        buildMesh(first_x, first_z, chunks_done, &mesh);
+
+        std::lock_guard<std::mutex> lock(m_mesh_mutex);
+        m_mesh = std::move(mesh);
+        m_mesh_ready = true;
+        generated_any = true;
+    }
+
+    // Everything was already there, but the window might have moved, so the mesh didn't.
+    if (!generated_any) {
+        PreviewMesh mesh;
+        buildMesh(first_x, first_z, chunks_done, &mesh);
+
+        std::lock_guard<std::mutex> lock(m_mesh_mutex);
+        m_mesh = std::move(mesh);
+        m_mesh_ready = true;
+    }
+}
+
+
+// Turn whatever chunks we've got into faces. First, unpack them into one big grid of
+// blocks, the same way the game fills in a chunk, with anything we haven't got yet as
+// air. Then, find every block's surfaces the same way the game does, with the edges of
+// the window as air, the same as the edges of a chunk are in the game, so the sides show
+// a cross section of the ground. Only the faces we can see go in. Going back to front,
+// that's along each diagonal, then bottom to top, since nothing on one diagonal can
+// cover anything else on it.
+void TerrainPreview::buildMesh(int first_x, int first_z, int chunks_done, PreviewMesh *pOut) const
+{
+    const int width = WINDOW_WIDTH;
+
+    std::vector<BlockType> blocks(width * width * CHUNK_BLOB_HEIGHT, BlockType::AIR);
+    std::vector<int> tops(width * width, -1);
+
+    auto block_at = [&blocks, width](int x, int y, int z) -> BlockType & {
+        return blocks[(((x * width) + z) * CHUNK_BLOB_HEIGHT) + y];
+    };
+
+    for (const auto &iter : m_chunk_blobs) {
+        int offset_x = iter.first.first  - first_x;
+        int offset_z = iter.first.second - first_z;
+        const std::vector<unsigned char> &data = iter.second;
+
+        ReadChunkBlobBlocks(data.data(), static_cast<int>(data.size()),
+            [&block_at, &tops, width, offset_x, offset_z](int local_x, int y, int local_z, BlockType block_type) {
+                int x = offset_x + local_x;
+                int z = offset_z + local_z;
+                block_at(x, y, z) = block_type;
+
+                int &top = tops[(x * width) + z];
+                if (y > top) {
+                    top = y;
+                }
+            });
+    }
+
+    pOut->width        = width;
+    pOut->top_y        = 0;
+    pOut->chunks_done  = chunks_done;
+    pOut->chunks_total = WINDOW_CHUNKS * WINDOW_CHUNKS;
+    pOut->faces.clear();
+
+    BlockSurfaces surfs;
+
+    for (int diagonal = 0; diagonal < (width * 2) - 1; diagonal++) {
+        int min_x = (diagonal < width) ? 0 : diagonal - width + 1;
+        int max_x = (diagonal < width) ? diagonal : width - 1;
+
+        for (int x = min_x; x <= max_x; x++) {
+            int z = diagonal - x;
+            int top = tops[(x * width) + z];
+
+            for (int y = 0; y <= top; y++) {
+                BlockType block_type = block_at(x, y, z);
+                if (block_type == BlockType::AIR) {
+                    continue;
+                }
+
+                CalcBlockSurfaces(block_type, x, y, z, width, CHUNK_BLOB_HEIGHT, false, block_at, &surfs);
+
+                short short_x = static_cast<short>(x);
+                short short_y = static_cast<short>(y);
+                short short_z = static_cast<short>(z);
+
+                if (surfs.east != SurfaceType::NOTHING) {
+                    pOut->faces.push_back({ short_x, short_y, short_z, surfs.east, FaceType::EAST });
+                }
+                if (surfs.north != SurfaceType::NOTHING) {
+                    pOut->faces.push_back({ short_x, short_y, short_z, surfs.north, FaceType::NORTH });
+                }
+                if (surfs.top != SurfaceType::NOTHING) {
+                    pOut->faces.push_back({ short_x, short_y, short_z, surfs.top, FaceType::TOP });
+                }
+            }
+
+            if (top > pOut->top_y) {
+                pOut->top_y = top;
+            }
+        }
+    }
+}
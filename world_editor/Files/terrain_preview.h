@@ -0,0 +1,90 @@
+#pragma once
+
+#include "stdafx.h"
+#include "block_surfaces.h"
+#include "build_settings.h"
+#include "common_util.h"
+#include "world_generator.h"
+
+
+// One face of one block, in window coords, where the window's south-west corner
+// is X=0, Z=0. The preview looks down from the north-east, so the only faces it
+// can see are the top, east and north ones.
+struct PreviewFace
+{
+    short x;
+    short y;
+    short z;
+    SurfaceType surf_type;
+    FaceType face_type;
+};
+
+
+// Everything the preview panel needs to draw a window of chunks. The faces are
+// already sorted back to front, so they can just be drawn in order.
+struct PreviewMesh
+{
+    PreviewMesh() : width(0), top_y(0), chunks_done(0), chunks_total(0) {}
+
+    int width;
+    int top_y;
+    int chunks_done;
+    int chunks_total;
+    std::vector<PreviewFace> faces;
+};
+
+
+// A few chunks' worth of terrain, generated in memory around one spot, so the build
+// settings can be tuned without saving the world and starting up the game. The chunks
+// are the exact blobs a save would write. They're unpacked and checked for faces by
+// the same code the game's chunks are, in "common", with transitions off, so a face
+// shows here wherever the game would show one.
+//
+// The generating happens on a worker thread. Every request cancels whatever the last
+// one was doing, and the chunks it already made get kept, as long as the settings
+// didn't change. The middle chunk goes first, and a new mesh is ready after every
+// chunk, so the preview fills in as it goes.
+class TerrainPreview
+{
+public:
+    TerrainPreview(const DirtHeightMap &height_map);
+    ~TerrainPreview();
+
+    void request(const BuildSettings &settings, int center_x, int center_z);
+    bool takeMesh(PreviewMesh *pOut);
+
+    static void getWindowBounds(int center_x, int center_z, int *pOut_first_x, int *pOut_first_z);
+
+    // How many chunks the window is, each way. Odd, so there's a middle one.
+    static const int WINDOW_CHUNKS = 3;
+    static const int WINDOW_WIDTH = WINDOW_CHUNKS * CHUNK_BLOB_WIDTH;
+
+private:
+    // Disallow the default ctor, copying, and moving.
+    TerrainPreview() = delete;
+    TerrainPreview(const TerrainPreview &that) = delete;
+    void operator=(const TerrainPreview &that) = delete;
+    TerrainPreview(TerrainPreview &&that) = delete;
+    void operator=(TerrainPreview &&that) = delete;
+
+    // Private methods.
+    void cancel();
+    void run(BuildSettings settings, int first_x, int first_z, int generation);
+    void buildMesh(int first_x, int first_z, int chunks_done, PreviewMesh *pOut) const;
+
+    // Private data. The heightmap has to outlive the preview.
+    const DirtHeightMap &m_height_map;
+
+    // Only the worker touches these while it's running, and "request"
+    // waits for it to stop before it does, so there's nothing to lock.
+    BuildSettings m_settings;
+    std::map<std::pair<int, int>, std::vector<unsigned char>> m_chunk_blobs;
+
+    std::atomic<int> m_generation;
+    std::future<void> m_worker;
+
+    // The latest mesh, waiting for the GUI thread to come and get it.
+    std::mutex m_mesh_mutex;
+    bool m_mesh_ready;
+    PreviewMesh m_mesh;
+};
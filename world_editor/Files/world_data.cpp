@@ -1,11 +1,10 @@
-
 #include "stdafx.h"
 #include "world_data.h"
 
+#include "build_dlg.h"
 #include "common_util.h"
 #include "format.h"
-#include "simplex_noise.h"
-#include "sqlite3.h"
+#include "heightmap_reader.h"
 
 #include <boost/filesystem.hpp>
 
@@ -13,7 +12,8 @@
 // The only allowed constructor.
 WorldData::WorldData(const BuildSettings &settings) :
     m_build_settings(settings),
-    m_database_fname("")
+    m_database_fname(""),
+    m_tiles(m_pixels)
 {
     const std::string &fname = m_build_settings.getHeightMapFilename();
 
@@ -23,395 +23,120 @@ WorldData::WorldData(const BuildSettings &settings) :
         assert(false);
     }
 
-    wxBitmap *bitmap = new wxBitmap(fname, wxBITMAP_TYPE_PNG);
-    m_height_map = bitmap;
+    // Read it once, up front. Everything else works from the pixels and the heights.
+    std::string error;
+    if (!readHeightmap(fname, &error)) {
+        wxMessageBox(error, "Error", wxICON_ERROR);
+    }
 }
 
 
 // Destructor.
 WorldData::~WorldData()
 {
-    m_height_map->FreeResource();
-    delete m_height_map;
-    m_height_map = nullptr;
 }
 
 
 // Peform a dry run, to see what our build stats would be,
 // before performing all the I/O needed to write out the database.
+// Anything the last settings change didn't affect comes from the cache.
 BuildStats WorldData::performDryRun() const
 {
-    BuildStats stats;
-
-    wxNativePixelData pixels(*m_height_map);
-    if (!pixels) {
-        return stats;
-    }
-
-    wxNativePixelData::Iterator pixel_iter;
-
-    // Calc each column and write it to the database.
-    int hmap_width  = m_height_map->GetWidth();
-    int hmap_height = m_height_map->GetHeight();
-    for (int x = 0; x < hmap_width; x++) {
-        for (int y = 0; y < hmap_height; y++) {
-
-            pixel_iter.MoveTo(*m_height_map, x, y);
-
-            int red   = pixel_iter.Red();
-            int green = pixel_iter.Green();
-            int blue  = pixel_iter.Blue();
-
-            int world_x =  x - (hmap_width  / 2);
-            int world_z = -y + (hmap_height / 2);
-
-            // For the dirt top, take half of our height map color.
-            // Subtract one so that we don't have a two-block falloff at the edges.
-            int dirt_height = (red + green + blue) / 3;
-            dirt_height = (dirt_height / 2) - 1;
-
-            if (dirt_height >= 0) {
-                std::vector<BlockType> blocks = calcColumn(world_x, world_z, dirt_height);
-                for (const BlockType & block : blocks) {
-                    stats.add(block);
-                }
-            }
-        }
-    }
-
-    return std::move(stats);
+    WorldGenerator generator(m_build_settings, m_dirt_heights);
+    return generator.performDryRun(&m_dry_run_cache);
 }
 
 
+// Change the settings. The dry run cache sorts out what's still good on its own.
+void WorldData::setBuildSettings(const BuildSettings &settings)
+{
+    assert(settings.getHeightMapFilename() == m_build_settings.getHeightMapFilename());
+    m_build_settings = settings;
+}
 
-// Save our world to the database.
-bool WorldData::saveToDatabase(const std::string &fname) {
 
-    std::int64_t start_msec = wxGetLocalTimeMillis().GetValue();
+// Save our world to the database. The generator does the real work, in the
+// background, while a dialog shows how it's going, and this wraps it up with some
+// message boxes. A save that gets cancelled, or dies, can be picked up later.
+bool WorldData::saveToDatabase(wxWindow *parent, const std::string &fname) {
 
-    wxBeginBusyCursor();
-    BuildStats stats;
-    bool success = actualSaveToDatabase(fname, &stats);
-    wxEndBusyCursor();
+    BuildDialog dlg(parent, m_build_settings, m_dirt_heights, fname);
+    dlg.ShowModal();
 
-    std::int64_t end_msec = wxGetLocalTimeMillis().GetValue();
-    double elapsed = (end_msec - start_msec) / 1000.0;
+    const BuildProgress &progress = dlg.getProgress();
 
     std::string msg;
-    if (success) {
-        m_build_stats = stats;
-        std::string stats_str = stats.toString();
-        wxMessageBox(stats_str, "Saved", wxICON_INFORMATION);
+    if (dlg.wasSuccessful()) {
+        m_build_stats = dlg.getBuildStats();
+        msg = fmt::format("{0}\n\nSaved in {1:.1f} secs.", m_build_stats.toString(), progress.elapsed_secs);
+        if (progress.regions_resumed > 0) {
+            msg += fmt::format("\nPicked up {0} of {1} regions from an earlier save.",
+                progress.regions_resumed, progress.regions_total);
+        }
+        wxMessageBox(msg, "Saved", wxICON_INFORMATION);
         return true;
     }
-    else {
-        wxMessageBox("SQL Error! Check your logs.", "Error", wxICON_ERROR);
-        return false;
-    }
-}
-
-
-// This does the real work.
-// We call this from a wrapper function so the wrapper
-// can change the cursor and time how long it took.
-bool WorldData::actualSaveToDatabase(const std::string &fname, BuildStats *pOut_stats)
-{
-    // First, make sure we can sample the heightmap.
-    wxNativePixelData pixels(*m_height_map);
-    if (!pixels) {
-        return false;
-    }
-
-    // I'm not sure if this is expensive, so I'm only creating the one here.
-    wxNativePixelData::Iterator pixel_iter;
-
-    // Create our database.
-    bool success;
-
-    sqlite3 *db = SQL_open(fname);
-    if (db == nullptr) {
-        return false;
-    }
-
-    if (!initTables(db)) {
-        sqlite3_close(db);
-        return false;
-    }
-
-    // Create our "insert blocks" statement.
-    sqlite3_stmt *insert_stmt = SQL_prepare(db,
-        "INSERT INTO blocks (x, y, z, block_type) "
-        "VALUES (?1, ?2, ?3, ?4)");
-    if (insert_stmt == nullptr) {
+    else if (dlg.wasCancelled()) {
+        msg = fmt::format(
+            "Stopped after {0} of {1} regions.\n"
+            "Save to the same file with the same settings to pick up where it stopped.",
+            progress.regions_done, progress.regions_total);
+        wxMessageBox(msg, "Cancelled", wxICON_INFORMATION);
         return false;
     }
-
-    // Begin a transaction.
-    if (!SQL_exec(db, "BEGIN TRANSACTION")) {
-        return false;
-    }
-
-    int blocks_written = 0;
-
-    // Got this far? Congrats, we'll actually be writing data.
-    BuildStats stats;
-
-    // Calc each column and write it to the database. Note that this means
-    // looping through every pixel on the heightmap, so it's lots of work.
-    int hmap_width  = m_height_map->GetWidth();
-    int hmap_height = m_height_map->GetHeight();
-    for     (int x = 0; x < hmap_width;  x++) {
-        for (int y = 0; y < hmap_height; y++) {
-
-            pixel_iter.MoveTo(*m_height_map, x, y);
-
-            int red   = pixel_iter.Red();
-            int green = pixel_iter.Green();
-            int blue  = pixel_iter.Blue();
-
-            int world_x =  x - (hmap_width  / 2);
-            int world_z = -y + (hmap_height / 2);
-
-            // For the dirt top, take half of our height map color.
-            // Subtract one so that we don't have a two-block falloff at the edges.
-            int dirt_height = (red + green + blue) / 3;
-            dirt_height = (dirt_height / 2) - 1;
-
-            if (dirt_height >= 0) {
-                std::vector<BlockType> blocks = calcColumn(world_x, world_z, dirt_height);
-                int count = writeBlocksForColumn(world_x, world_z, blocks, db, insert_stmt, &stats);
-                blocks_written += count;
-            }
-
-            // Whenever we write, say, 1000 blocks, start a new transaction.
-            if (blocks_written >= 1000) {
-                if (!SQL_exec(db, "COMMIT TRANSACTION; BEGIN TRANSACTION;")) {
-                    return false;
-                }
-
-                blocks_written = 0;
-            }
-        }
-    }
-
-    // All done. Wrap up any remaining transaction.
-    success = SQL_exec(db, "COMMIT TRANSACTION");
-    if (!success) {
+    else {
+        msg = fmt::format("SQL Error! Check your logs.\n{}", dlg.getLastError());
+        wxMessageBox(msg, "Error", wxICON_ERROR);
         return false;
     }
-
-    sqlite3_finalize(insert_stmt);
-    sqlite3_close(db);
-
-    *pOut_stats = stats;
-    return true;
 }
 
 
-// Do the initial setup for the database.
-// Clear out any old tables, and build new ones.
-bool WorldData::initTables(sqlite3 *db)
+// Read the heightmap a band at a time, straight into the pixels the canvas draws and
+// the dirt heights the generator works from, so the image itself is never in memory.
+// The pixels are just the top 8 bits of every level. The editor draws and previews the
+// whole thing, so it all stays in memory, but saves from the command line don't need to.
+// If it won't load, it's all empty.
+bool WorldData::readHeightmap(const std::string &fname, std::string *pOut_error)
 {
-    bool success;
-
-    success = SQL_exec(db, "DROP TABLE IF EXISTS blocks");
-    if (!success) {
-        return false;
-    }
-
-    success = SQL_exec(db,
-        "CREATE TABLE blocks ("
-        "x INTEGER, "
-        "y INTEGER, "
-        "z INTEGER, "
-        "block_type VARCHAR(10) NOT NULL, "
-        "PRIMARY KEY (x, y, z))");
-    if (!success) {
-        return false;
-    }
-
-    success = SQL_exec(db, "CREATE INDEX idx_blocks_x ON blocks (x ASC)");
-    if (!success) {
-        return false;
-    }
-
-    success = SQL_exec(db, "CREATE INDEX idx_blocks_y ON blocks (y ASC)");
-    if (!success) {
+    HeightmapReader reader;
+    if (!reader.open(fname)) {
+        *pOut_error = reader.getLastError();
         return false;
     }
 
-    success = SQL_exec(db, "CREATE INDEX idx_blocks_z ON blocks (z ASC)");
-    if (!success) {
-        return false;
-    }
-
-    return true;
-}
-
-
-// Given our landscape top, calc where the stone top.
-int WorldData::calcStoneHeightForColumn(int world_x, int world_z, int dirt_height) const
-{
-    double percent      = m_build_settings.getStonePercent();
-    double subtracted   = m_build_settings.getStoneSubtracted();
-    double displacement = m_build_settings.getStoneDisplacement();
-    double noise_scale  = m_build_settings.getStoneNoiseScale();
-
-    // First, scale the stone, then lower it.
-    int result = (dirt_height * (percent / 100.0)) - subtracted;
-
-    // Scale our noise outward.
-    double noise_x   = world_x / noise_scale;
-    double noise_z   = world_z / noise_scale;
-    double noise_val = simplex_noise_2(noise_x, noise_z) - 0.5;
-
-    // Displace the result by our noise value.
-    result += (noise_val * displacement);
-
-    // Return -1 to mean there's no stone at all.
-    if (result < -1) {
-        result = -1;
-    }
-
-    assert(result <= 255);
-    return result;
-}
-
-
-// Calculate the world blocks for a particular column.
-// Profile this later, since it might be a bottleneck.
-std::vector<BlockType> WorldData::calcColumn(int world_x, int world_z, int dirt_height) const
-{
-    double noise_scale  = m_build_settings.getStoneNoiseScale();
-    double coal_density = m_build_settings.getCoalDensity() / 100.0f;
-
-    // Given our dirt height, calc how tall the stone could be.
-    int stone_height = calcStoneHeightForColumn(world_x, world_z, dirt_height);
-
-    // In rare cases, the stone could stick up *out* of the dirt.
-    int ceiling = (dirt_height > stone_height) ? dirt_height : stone_height;
-
-    // Build a vector for the Y-values, and fill it all with dirt.
-    std::vector<BlockType> blocks;
-    for (int y = 0; y <= ceiling; y++) {
-        blocks.emplace_back(BlockType::DIRT);
-    }
-
-    // Then, replace all the stone blocks for that height.
-    for (int y = 0; y <= stone_height; y++) {
-        blocks[y] = BlockType::STONE;
-    }
+    int hmap_width  = reader.getWidth();
+    int hmap_height = reader.getHeight();
+    int bit_depth   = reader.getBitDepth();
 
-    // Throughout the stone, figure out where the coal would go.
-    for (int y = 0; y <= stone_height; y++) {
+    m_pixels.width  = hmap_width;
+    m_pixels.height = hmap_height;
+    m_pixels.gray.resize(hmap_width * hmap_height);
 
-        double noise_x = world_x / noise_scale;
-        double noise_z = world_z / noise_scale;
-        double noise_y = y / noise_scale;
-        double noise_val = simplex_noise_3(noise_x, noise_y, noise_z);
+    m_dirt_heights.width  = hmap_width;
+    m_dirt_heights.height = hmap_height;
+    m_dirt_heights.first_row = 0;
+    m_dirt_heights.row_count = hmap_height;
+    m_dirt_heights.heights.resize(hmap_width * hmap_height);
 
-        if (noise_val < coal_density) {
-            blocks[y] = BlockType::COAL;
+    HeightmapBand band;
+    while (!reader.isDone()) {
+        if (!reader.readBand(HeightmapReader::BAND_ROWS, &band)) {
+            *pOut_error = reader.getLastError();
+            m_pixels = HeightmapPixels();
+            m_dirt_heights = DirtHeightMap();
+            return false;
         }
-    }
-
-    return std::move(blocks);
-}
 
+        int first = hmap_width * band.first_row;
+        int count = hmap_width * band.row_count;
 
-
-// Write all the world blocks for a particular column.
-// For SQLite string binding. Just hard-code the string lengthts.
-// For each spot on our heightmap, write the value of 'dirt_top' where the dirt world
-// actually start. Writing a value of 'dirt' for each individual block would take forever.
-// Return the number of rows written to the database, or -1 if something went wrong.
-int WorldData::writeBlocksForColumn(
-    int world_x, int world_z, const std::vector<BlockType> &blocks,
-    sqlite3 *db, sqlite3_stmt *insert_stmt, BuildStats *pOut_stats)
-{
-    int blocks_written = 0;
-
-    int ret_code;
-
-    // Calc the real tops of the dirt and stone.
-    int dirt_top  = -1;
-    int stone_top = -1;
-    for (unsigned int i = 0; i < blocks.size(); i++) {
-        if (blocks[i] == BlockType::DIRT) {
-            dirt_top = i;
+        for (int i = 0; i < count; i++) {
+            int level = band.levels[i];
+            m_pixels.gray[first + i] = static_cast<unsigned char>(level >> 8);
+            m_dirt_heights.heights[first + i] = DirtHeightMap::encode(LevelToDirtHeight(level, bit_depth));
         }
-        else if (blocks[i] == BlockType::STONE) {
-            stone_top = i;
-        }
-    }
-
-    // Write the dirt top.
-    sqlite3_reset(insert_stmt);
-    sqlite3_bind_int(insert_stmt, 1, world_x);
-    sqlite3_bind_int(insert_stmt, 2, dirt_top);
-    sqlite3_bind_int(insert_stmt, 3, world_z);
-    sqlite3_bind_text(insert_stmt, 4, "dirt_top", 8, SQLITE_STATIC);
-
-    ret_code = sqlite3_step(insert_stmt);
-    if (ret_code != SQLITE_DONE) {
-        std::string msg = fmt::format(
-            "Insert failed, code = {0}, error = {1}",
-            SQL_code_to_str(ret_code),
-            sqlite3_errmsg(db));
-        wxMessageBox(msg, "Error", wxICON_ERROR);
-        return -1;
     }
 
-    blocks_written++;
-
-    // Write the stone top (if there is one).
-    if (stone_top >= 0) {
-        sqlite3_reset(insert_stmt);
-        sqlite3_bind_int(insert_stmt, 1, world_x);
-        sqlite3_bind_int(insert_stmt, 2, stone_top);
-        sqlite3_bind_int(insert_stmt, 3, world_z);
-        sqlite3_bind_text(insert_stmt, 4, "stone_top", 9, SQLITE_STATIC);
-
-        ret_code = sqlite3_step(insert_stmt);
-        if (ret_code != SQLITE_DONE) {
-            std::string msg = fmt::format(
-                "Insert failed, code = {0}, error = {1}",
-                SQL_code_to_str(ret_code),
-                sqlite3_errmsg(db));
-            wxMessageBox(msg, "Error", wxICON_ERROR);
-            return -1;
-        }
-
-        blocks_written++;
-    }
-
-    // Then, write each individual coal block. There shouldn't be too many of these.
-    for (int y = 0; y < stone_top; y++) {
-        if (blocks[y] == BlockType::COAL) {
-            sqlite3_reset(insert_stmt);
-            sqlite3_bind_int(insert_stmt, 1, world_x);
-            sqlite3_bind_int(insert_stmt, 2, y);
-            sqlite3_bind_int(insert_stmt, 3, world_z);
-            sqlite3_bind_text(insert_stmt, 4, "coal", 4, SQLITE_STATIC);
-
-            ret_code = sqlite3_step(insert_stmt);
-            if (ret_code != SQLITE_DONE) {
-                std::string msg = fmt::format(
-                    "Insert failed, code = {0}, error = {1}",
-                    SQL_code_to_str(ret_code),
-                    sqlite3_errmsg(db));
-                wxMessageBox(msg, "Error", wxICON_ERROR);
-                return -1;
-            }
-
-            blocks_written++;
-        }
-    }
-
-    // All done. Update our stats.
-    for (unsigned int y = 0; y < blocks.size(); y++) {
-        pOut_stats->add(blocks[y]);
-    }
-
-    return blocks_written;
+    return true;
 }
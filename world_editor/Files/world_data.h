@@ -4,15 +4,14 @@
 #include "build_settings.h"
 #include "build_stats.h"
 #include "common_util.h"
+#include "heightmap_tiles.h"
+#include "world_generator.h"
 
 
 // Game data, represented in a way that's "wxWidgets" friendly.
 // It would be nice to unify any code here with the game's
 // more OpenGL-oriented code, but we won't worry about that for now.
-
-struct sqlite3;
-struct sqlite3_stmt;
-
+// The actual world building lives in "WorldGenerator", so it can run without a GUI.
 
 class WorldData
 {
@@ -21,9 +20,19 @@ public:
     ~WorldData();
 
     BuildStats performDryRun() const;
-    bool saveToDatabase(const std::string &db_fname);
+    bool saveToDatabase(wxWindow *parent, const std::string &db_fname);
+
+    // Everything but the heightmap can change. That takes a new WorldData.
+    void setBuildSettings(const BuildSettings &settings);
+    const BuildSettings &getBuildSettings() const { return m_build_settings; }
 
-    wxBitmap *getHeightmap() { return m_height_map; }
+    const HeightmapPixels &getHeightmapPixels() const { return m_pixels; }
+    const DirtHeightMap &getDirtHeights() const { return m_dirt_heights; }
+    HeightmapTiles &getHeightmapTiles() { return m_tiles; }
+
+    // For doing dry runs in the background. Whoever does that has to be
+    // the only one using the cache, until they're done.
+    DryRunCache *getDryRunCache() const { return &m_dry_run_cache; }
 
 private:
     // Disallow the default ctor, copying, and moving.
@@ -34,17 +43,18 @@ private:
     void operator=(WorldData &&that) = delete;
 
     // Private methods.
-    bool actualSaveToDatabase(const std::string &fname, BuildStats *pOut_stats);
-    bool initTables(sqlite3 *db);
-    std::vector<BlockType> calcColumn(int world_x, int world_z, int dirt_height) const;
-    int  writeBlocksForColumn(int world_x, int world_z, const std::vector<BlockType> &blocks,
-                              sqlite3 *db, sqlite3_stmt *insert_stmt, BuildStats *pOut_stats);
-    int  calcStoneHeightForColumn(int world_x, int world_z, int dirt_height) const;
-
-    // Private data.
+    bool readHeightmap(const std::string &fname, std::string *pOut_error);
+
+    // Private data. The generator only ever sees the dirt heights, and the canvas
+    // only ever sees the tiles, so nobody needs the image, and it never gets loaded.
     BuildSettings m_build_settings;
     BuildStats    m_build_stats;
 
     std::string m_database_fname;
-    wxBitmap *m_height_map;
+    HeightmapPixels m_pixels;
+    HeightmapTiles  m_tiles;
+    DirtHeightMap   m_dirt_heights;
+
+    // What the last dry run worked out. Only a cache, so it doesn't count against const.
+    mutable DryRunCache m_dry_run_cache;
 };
@@ -16,6 +16,7 @@ enum {
     ID_MENU_SAVE,
     ID_MENU_SAVE_AS,
     ID_MENU_CHANGE_IMAGE,
+    ID_MENU_BUILD_SETTINGS,
     ID_CANVAS,
 };
 
@@ -94,6 +95,7 @@ void MyMainFrame::myCreateMenuBar()
 
     wxMenu *menu_edit = new wxMenu;
     menu_edit->Append(ID_MENU_CHANGE_IMAGE, "Change Image...", "Change the base image");
+    menu_edit->Append(ID_MENU_BUILD_SETTINGS, "Build Settings...", "Tune the build settings, previewing the picked spot");
 
     wxMenu *menu_help = new wxMenu;
     menu_help->Append(wxID_ABOUT);
@@ -112,6 +114,7 @@ void MyMainFrame::myCreateMenuBar()
     Bind(wxEVT_MENU, &MyMainFrame::onMenuExit,   this, wxID_EXIT);
 
     Bind(wxEVT_MENU, &MyMainFrame::onMenuChangeImage, this, ID_MENU_CHANGE_IMAGE);
+    Bind(wxEVT_MENU, &MyMainFrame::onMenuBuildSettings, this, ID_MENU_BUILD_SETTINGS);
 
     Bind(wxEVT_MENU, &MyMainFrame::onMenuAbout, this, wxID_ABOUT);
 }
@@ -120,11 +123,15 @@ void MyMainFrame::myCreateMenuBar()
 // Close out any old game file, and load an image for a new one.
 void MyMainFrame::onMenuNew(wxCommandEvent &evt)
 {
-    SettingsDialog dlg(this);
+    SettingsDialog dlg(this, BuildSettings(), 0, 0);
     int result = dlg.ShowModal();
     if (result == wxID_OK) {
+        // If the dialog already loaded the heightmap for its stats, use that.
         const BuildSettings &settings = dlg.getBuildSettings();
-        m_world_data = std::make_unique<WorldData>(settings);
+        m_world_data = dlg.takePreviewData();
+        if (m_world_data == nullptr) {
+            m_world_data = std::make_unique<WorldData>(settings);
+        }
         m_canvas->repaintCanvas();
 
         if (dlg.getShowStats()) {
@@ -187,7 +194,7 @@ void MyMainFrame::onMenuSave(wxCommandEvent &evt)
     }
 
     std::string fname(dlg_result.c_str());
-    m_world_data->saveToDatabase(fname);
+    m_world_data->saveToDatabase(this, fname);
 }
 
 
@@ -203,6 +210,34 @@ void MyMainFrame::onMenuChangeImage(wxCommandEvent &evt)
 }
 
 
+// Change the current world's settings. The terrain preview starts out
+// around whatever spot was last clicked on the canvas.
+void MyMainFrame::onMenuBuildSettings(wxCommandEvent &evt)
+{
+    if (m_world_data == nullptr) {
+        wxMessageBox("Make a new world first!", "No data", wxICON_EXCLAMATION);
+        return;
+    }
+
+    int picked_x, picked_z;
+    m_canvas->getPickedSpot(&picked_x, &picked_z);
+
+    SettingsDialog dlg(this, m_world_data->getBuildSettings(), picked_x, picked_z);
+    int result = dlg.ShowModal();
+    if (result == wxID_OK) {
+        // Same heightmap means the dialog's copy is ready to go, dry runs and all.
+        std::unique_ptr<WorldData> preview_data = dlg.takePreviewData();
+        if (preview_data != nullptr) {
+            m_world_data = std::move(preview_data);
+        }
+        else {
+            m_world_data = std::make_unique<WorldData>(dlg.getBuildSettings());
+        }
+        m_canvas->repaintCanvas();
+    }
+}
+
+
 void MyMainFrame::onMenuExit(wxCommandEvent &evt)
 {
     Close(true);
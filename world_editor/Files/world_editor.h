@@ -41,6 +41,7 @@ private:
     void onMenuSaveAs(wxCommandEvent &evt);
     void onMenuExit(wxCommandEvent &evt);
     void onMenuChangeImage(wxCommandEvent &evt);
+    void onMenuBuildSettings(wxCommandEvent &evt);
     void onMenuAbout(wxCommandEvent &evt);
 
     // Private data.
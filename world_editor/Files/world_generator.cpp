@@ -0,0 +1,1049 @@
+#include "stdafx.h"
+#include "world_generator.h"
+
+#include "bounded_queue.h"
+#include "common_util.h"
+#include "format.h"
+#include "sqlite3.h"
+
+#include <chrono>
+
+
+const double WorldGenerator::COAL_WINDOW = 0.02;
+
+// The build key passes this by reference, so it needs a definition of its own.
+const int WorldGenerator::REGION_CHUNKS;
+
+
+// Count the bits that are set. No popcount in C++14, so do it the old-fashioned way.
+static int CountBits(std::uint64_t bits)
+{
+    bits = bits - ((bits >> 1) & 0x5555555555555555ull);
+    bits = (bits & 0x3333333333333333ull) + ((bits >> 2) & 0x3333333333333333ull);
+    bits = (bits + (bits >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+    return static_cast<int>((bits * 0x0101010101010101ull) >> 56);
+}
+
+
+// Count the bits that are set in a column, from the bottom up to "top".
+static int CountColumnBits(const ColumnBits &column_bits, int top)
+{
+    int result = 0;
+    for (int word = 0; (word * 64) <= top; word++) {
+        std::uint64_t bits = column_bits[word];
+
+        int bits_wanted = top + 1 - (word * 64);
+        if (bits_wanted < 64) {
+            bits &= (1ull << bits_wanted) - 1;
+        }
+
+        result += CountBits(bits);
+    }
+
+    return result;
+}
+
+
+// How many workers to fire off. One per core.
+static int GetWorkerCount()
+{
+    int worker_count = static_cast<int>(std::thread::hardware_concurrency());
+    if (worker_count < 1) {
+        worker_count = 1;
+    }
+
+    return worker_count;
+}
+
+
+// The column recipe for some build settings. There's no seed in the editor,
+// so the noise stays right where it is.
+static ColumnRecipe MakeColumnRecipe(const BuildSettings &settings)
+{
+    ColumnRecipe recipe;
+    recipe.stone_percent      = settings.getStonePercent();
+    recipe.stone_subtracted   = settings.getStoneSubtracted();
+    recipe.stone_displacement = settings.getStoneDisplacement();
+    recipe.stone_noise_scale  = settings.getStoneNoiseScale();
+    recipe.coal_density       = settings.getCoalDensity();
+    return recipe;
+}
+
+
+// Constructor, for the whole heightmap at once. It has to outlive the generator.
+WorldGenerator::WorldGenerator(const BuildSettings &settings, const DirtHeightMap &height_map) :
+    m_build_settings(settings),
+    m_recipe(MakeColumnRecipe(settings)),
+    m_height_map(&height_map),
+    m_height_bands(nullptr),
+    m_hmap_width(height_map.width),
+    m_hmap_height(height_map.height),
+    m_chunks_written(0),
+    m_bytes_written(0),
+    m_last_error(""),
+    m_resume(true),
+    m_cancelled(false)
+{
+    assert((height_map.first_row == 0) && (height_map.row_count == height_map.height));
+}
+
+
+// Constructor, for a heightmap that gets read in bands as the save goes. They
+// have to be open already, and outlive the generator. This can only save.
+WorldGenerator::WorldGenerator(const BuildSettings &settings, DirtHeightBands *pHeight_bands) :
+    m_build_settings(settings),
+    m_recipe(MakeColumnRecipe(settings)),
+    m_height_map(nullptr),
+    m_height_bands(pHeight_bands),
+    m_hmap_width(pHeight_bands->getWidth()),
+    m_hmap_height(pHeight_bands->getHeight()),
+    m_chunks_written(0),
+    m_bytes_written(0),
+    m_last_error(""),
+    m_resume(true),
+    m_cancelled(false)
+{
+}
+
+
+// Peform a dry run, to see what our build stats would be,
+// before performing all the I/O needed to write out the database.
+// With nothing to remember it in, the cache only lasts for this one run.
+BuildStats WorldGenerator::performDryRun() const
+{
+    DryRunCache cache;
+    return performDryRun(&cache);
+}
+
+
+// Peform a dry run, reusing whatever the last one figured out that's still good.
+// Same as saving, every core works on tiles, and each one keeps its own stats
+// until the end, so there's nothing to lock. If we're cancelled, every core stops
+// after the tile it's on, and the stats are only partway there. The cache is still
+// good, since each tile is either up to date or left for next time.
+BuildStats WorldGenerator::performDryRun(DryRunCache *pInOut_cache) const
+{
+    assert(m_height_map != nullptr);
+
+    int tile_count = getTileCount();
+
+    // A new noise scale means new noise everywhere.
+    double noise_scale = m_build_settings.getStoneNoiseScale();
+    if ((pInOut_cache->noise_scale != noise_scale) ||
+        (static_cast<int>(pInOut_cache->tiles.size()) != tile_count)) {
+        pInOut_cache->tiles.clear();
+        pInOut_cache->tiles.resize(tile_count);
+        pInOut_cache->noise_scale = noise_scale;
+    }
+
+    // If the coal density left the window, move the window.
+    double coal_density = m_build_settings.getCoalDensity() / 100.0f;
+    if ((coal_density < pInOut_cache->coal_low) || (coal_density >= pInOut_cache->coal_high)) {
+        pInOut_cache->coal_low  = coal_density - COAL_WINDOW;
+        pInOut_cache->coal_high = coal_density + COAL_WINDOW;
+
+        for (DryRunTile &tile : pInOut_cache->tiles) {
+            tile.has_coal = false;
+        }
+    }
+
+    int worker_count = GetWorkerCount();
+    std::vector<BuildStats> worker_stats(worker_count);
+    std::atomic<int> next_tile(0);
+
+    const DryRunCache &cache = *pInOut_cache;
+    std::vector<DryRunTile> &tiles = pInOut_cache->tiles;
+
+    std::vector<std::future<void>> workers;
+    for (int i = 0; i < worker_count; i++) {
+        BuildStats *stats = &worker_stats[i];
+        workers.emplace_back(std::async(std::launch::async, [this, &cache, &tiles, &next_tile, tile_count, stats]() {
+            for (int tile = next_tile++; tile < tile_count; tile = next_tile++) {
+                if (m_cancelled) {
+                    break;
+                }
+                calcDryRunTile(tile, cache, &tiles[tile], stats);
+            }
+        }));
+    }
+
+    BuildStats result;
+    for (int i = 0; i < worker_count; i++) {
+        workers[i].wait();
+        result.add(worker_stats[i]);
+    }
+
+    return std::move(result);
+}
+
+
+// Save our world to the database.
+// The world gets cut up into regions of whole chunks, and every core works on
+// regions, turning each chunk into one blob for the chunks table. The noise is the
+// expensive part, and no column depends on any other. Finished regions go through
+// a bounded queue to this thread, which is the only one that ever touches the database.
+//
+// Every region gets committed along with its checkpoint row, so if the save stops for
+// any reason, the file has whole regions, and knows which ones. Saving the same world
+// to the same file again skips those, and carries on with the rest.
+bool WorldGenerator::saveToDatabase(const std::string &fname, BuildStats *pOut_stats)
+{
+    m_chunks_written = 0;
+    m_bytes_written = 0;
+    m_last_error = "";
+
+    auto start_time = std::chrono::steady_clock::now();
+
+    // Open our database.
+    bool success;
+
+    sqlite3 *db = SQL_open(fname);
+    if (db == nullptr) {
+        m_last_error = fmt::format("Could not open '{}'.", fname);
+        return false;
+    }
+
+    // Everything up to the first region is one transaction, so if we stop before
+    // then, it all gets rolled back, and whatever was in the file is still there.
+    if (!SQL_exec(db, "BEGIN TRANSACTION")) {
+        m_last_error = "Could not begin a transaction.";
+        return false;
+    }
+
+    // If the file has an earlier save of this exact world, pick up where it stopped.
+    // Otherwise, start from scratch.
+    int region_count = getRegionCount();
+    std::string build_key = calcBuildKey();
+
+    std::vector<char> done(region_count, 0);
+    BuildStats stats;
+    bool found = false;
+
+    if (m_resume && !readCheckpoints(db, build_key, &done, &stats, &found)) {
+        m_last_error = "Could not read the checkpoints.";
+        return false;
+    }
+
+    if (!found && !initTables(db, build_key)) {
+        m_last_error = "Could not create the tables.";
+        return false;
+    }
+
+    // Count whatever's already done as done.
+    BuildProgress progress;
+    progress.regions_total = region_count;
+    progress.columns_total = getColumnCount();
+
+    for (int region = 0; region < region_count; region++) {
+        if (done[region]) {
+            progress.regions_resumed++;
+            progress.columns_resumed += getRegionColumns(region);
+        }
+    }
+
+    progress.regions_done = progress.regions_resumed;
+    progress.columns_done = progress.columns_resumed;
+
+    // The regions get worked on a row at a time, from the top of the heightmap down,
+    // the same way it's read. If the heights come in bands, each row is one band, and
+    // it's used once for every region in it that isn't already done.
+    int first_x, first_z, chunks_across, chunks_down;
+    getChunkBounds(&first_x, &first_z, &chunks_across, &chunks_down);
+
+    int regions_across = (chunks_across + REGION_CHUNKS - 1) / REGION_CHUNKS;
+    int regions_down   = (region_count > 0) ? (region_count / regions_across) : 0;
+
+    auto order_to_region = [regions_across, regions_down](int order) {
+        return ((regions_down - 1 - (order / regions_across)) * regions_across) + (order % regions_across);
+    };
+
+    if (m_height_bands != nullptr) {
+        std::vector<std::pair<int, int>> band_rows(regions_down);
+        std::vector<int> band_uses(regions_down, 0);
+
+        for (int order = 0; order < region_count; order++) {
+            int region = order_to_region(order);
+            int band = order / regions_across;
+            getRegionRows(region, &band_rows[band].first, &band_rows[band].second);
+            if (!done[region]) {
+                band_uses[band]++;
+            }
+        }
+
+        if (!m_height_bands->setBands(band_rows, band_uses)) {
+            m_last_error = m_height_bands->getLastError();
+            sqlite3_close(db);
+            return false;
+        }
+    }
+
+    // Create our "insert chunks" and "insert checkpoint" statements.
+    sqlite3_stmt *insert_stmt = SQL_prepare(db,
+        "INSERT INTO chunks (x, z, data) "
+        "VALUES (?1, ?2, ?3)");
+    if (insert_stmt == nullptr) {
+        m_last_error = "Could not prepare the insert statement.";
+        return false;
+    }
+
+    sqlite3_stmt *checkpoint_stmt = SQL_prepare(db,
+        "INSERT INTO build_regions (region, air, dirt, stone, coal) "
+        "VALUES (?1, ?2, ?3, ?4, ?5)");
+    if (checkpoint_stmt == nullptr) {
+        m_last_error = "Could not prepare the checkpoint statement.";
+        sqlite3_finalize(insert_stmt);
+        sqlite3_close(db);
+        return false;
+    }
+
+    if (m_progress_func) {
+        m_progress_func(progress);
+    }
+
+    // Got this far? Congrats, we'll actually be writing data.
+    int regions_left = region_count - progress.regions_resumed;
+
+    BoundedQueue<std::unique_ptr<RegionBuffer>> queue(MAX_QUEUED_REGIONS);
+    std::atomic<int> next_region(0);
+
+    // Fire off a worker for each core. Each one grabs the next region nobody's taken yet,
+    // and that isn't already done. If the writer gives up, the queue gets closed, and the
+    // workers quit too. If we're cancelled, or the heights can't be read, the workers quit
+    // after the region they're on, and the last one out closes the queue, so the writer
+    // doesn't wait on them forever.
+    int worker_count = GetWorkerCount();
+    std::atomic<int> workers_left(worker_count);
+
+    std::vector<std::future<void>> workers;
+    for (int i = 0; i < worker_count; i++) {
+        workers.emplace_back(std::async(std::launch::async,
+                                        [this, &queue, &next_region, &done, &workers_left, &order_to_region,
+                                         region_count, regions_across]() {
+            for (int order = next_region++; order < region_count; order = next_region++) {
+                int region = order_to_region(order);
+                if (m_cancelled) {
+                    break;
+                }
+                if (done[region]) {
+                    continue;
+                }
+
+                auto buffer = std::make_unique<RegionBuffer>();
+                if (m_height_bands != nullptr) {
+                    int band = order / regions_across;
+                    std::shared_ptr<const DirtHeightMap> heights = m_height_bands->acquire(band);
+                    if (heights == nullptr) {
+                        break;
+                    }
+                    calcRegion(region, *heights, buffer.get());
+                    m_height_bands->release(band);
+                } else {
+                    calcRegion(region, *m_height_map, buffer.get());
+                }
+
+                if (!queue.push(std::move(buffer))) {
+                    break;
+                }
+            }
+
+            if (--workers_left == 0) {
+                queue.close();
+            }
+        }));
+    }
+
+    // Write the regions as they show up, in whatever order they finish.
+    // Each one is its own transaction, checkpoint and all.
+    success = true;
+
+    int written = 0;
+    for (; written < regions_left; written++) {
+        std::unique_ptr<RegionBuffer> buffer;
+        if (m_cancelled || !queue.pop(&buffer)) {
+            success = false;
+            break;
+        }
+
+        if (!writeRegion(*buffer, db, insert_stmt, checkpoint_stmt) ||
+            !SQL_exec(db, "COMMIT TRANSACTION; BEGIN TRANSACTION;")) {
+            success = false;
+            break;
+        }
+
+        stats.add(buffer->stats);
+
+        progress.regions_done++;
+        progress.columns_done += buffer->columns;
+        progress.elapsed_secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+        if (m_progress_func) {
+            m_progress_func(progress);
+        }
+    }
+
+    queue.close();
+    for (auto &worker : workers) {
+        worker.wait();
+    }
+
+    // All done. Wrap up any remaining transaction. If we were cancelled after a region
+    // got written, there's nothing in it, but it's still worth closing out properly.
+    // Before that, it's the new tables, and the old ones dropped, so roll it all back.
+    if (success || (m_cancelled && (written > 0))) {
+        success = SQL_exec(db, "COMMIT TRANSACTION") && success;
+    }
+    else {
+        SQL_exec(db, "ROLLBACK TRANSACTION");
+    }
+
+    sqlite3_finalize(insert_stmt);
+    sqlite3_finalize(checkpoint_stmt);
+    sqlite3_close(db);
+
+    if (m_cancelled) {
+        m_last_error = "The save was cancelled.";
+        return false;
+    }
+
+    if (!success) {
+        if (m_last_error.empty() && (m_height_bands != nullptr)) {
+            m_last_error = m_height_bands->getLastError();
+        }
+        if (m_last_error.empty()) {
+            m_last_error = "Writing the blocks failed.";
+        }
+        return false;
+    }
+
+    *pOut_stats = stats;
+    return true;
+}
+
+
+// How many tiles the heightmap gets cut up into.
+int WorldGenerator::getTileCount() const
+{
+    int tiles_across = (m_hmap_width  + TILE_SIZE - 1) / TILE_SIZE;
+    int tiles_down   = (m_hmap_height + TILE_SIZE - 1) / TILE_SIZE;
+    return tiles_across * tiles_down;
+}
+
+
+// Which heightmap pixels a tile covers. Tiles are numbered across, then down.
+// The last ones are past the end, same as iterators.
+void WorldGenerator::getTileBounds(
+    int tile_index, int *pOut_first_x, int *pOut_first_y, int *pOut_last_x, int *pOut_last_y) const
+{
+    int hmap_width  = m_hmap_width;
+    int hmap_height = m_hmap_height;
+
+    int tiles_across = (hmap_width + TILE_SIZE - 1) / TILE_SIZE;
+    int first_x = (tile_index % tiles_across) * TILE_SIZE;
+    int first_y = (tile_index / tiles_across) * TILE_SIZE;
+    int last_x  = first_x + TILE_SIZE;
+    int last_y  = first_y + TILE_SIZE;
+    if (last_x > hmap_width) {
+        last_x = hmap_width;
+    }
+    if (last_y > hmap_height) {
+        last_y = hmap_height;
+    }
+
+    *pOut_first_x = first_x;
+    *pOut_first_y = first_y;
+    *pOut_last_x  = last_x;
+    *pOut_last_y  = last_y;
+}
+
+
+// Which chunks the heightmap touches, in world coords. The first chunk's origin,
+// and how many chunks there are each way. The edge chunks hang off the heightmap.
+void WorldGenerator::getChunkBounds(
+    int *pOut_first_x, int *pOut_first_z, int *pOut_chunks_across, int *pOut_chunks_down) const
+{
+    int hmap_width  = m_hmap_width;
+    int hmap_height = m_hmap_height;
+
+    // Pixel (0, 0) is the far corner, since Z goes up the image.
+    int min_world_x = -(hmap_width / 2);
+    int max_world_x = min_world_x + hmap_width - 1;
+    int max_world_z = hmap_height / 2;
+    int min_world_z = max_world_z - hmap_height + 1;
+
+    // Round down, so chunks line up across zero, same as the game's.
+    int first_x = RoundDownInt(min_world_x, CHUNK_BLOB_WIDTH);
+    int first_z = RoundDownInt(min_world_z, CHUNK_BLOB_WIDTH);
+    int last_x  = RoundDownInt(max_world_x, CHUNK_BLOB_WIDTH);
+    int last_z  = RoundDownInt(max_world_z, CHUNK_BLOB_WIDTH);
+
+    *pOut_first_x       = first_x;
+    *pOut_first_z       = first_z;
+    *pOut_chunks_across = ((last_x - first_x) / CHUNK_BLOB_WIDTH) + 1;
+    *pOut_chunks_down   = ((last_z - first_z) / CHUNK_BLOB_WIDTH) + 1;
+}
+
+
+// How many regions the chunks get cut up into.
+int WorldGenerator::getRegionCount() const
+{
+    if ((m_hmap_width <= 0) || (m_hmap_height <= 0)) {
+        return 0;
+    }
+
+    int first_x, first_z, chunks_across, chunks_down;
+    getChunkBounds(&first_x, &first_z, &chunks_across, &chunks_down);
+
+    int regions_across = (chunks_across + REGION_CHUNKS - 1) / REGION_CHUNKS;
+    int regions_down   = (chunks_down   + REGION_CHUNKS - 1) / REGION_CHUNKS;
+    return regions_across * regions_down;
+}
+
+
+// Which chunks a region covers, counting chunks from the first one.
+// Regions are numbered across, then down. The last ones are past the end.
+void WorldGenerator::getRegionBounds(int region_index, int *pOut_first_chunk_x, int *pOut_first_chunk_z,
+                                     int *pOut_last_chunk_x, int *pOut_last_chunk_z) const
+{
+    int first_x, first_z, chunks_across, chunks_down;
+    getChunkBounds(&first_x, &first_z, &chunks_across, &chunks_down);
+
+    int regions_across = (chunks_across + REGION_CHUNKS - 1) / REGION_CHUNKS;
+    int first_chunk_x = (region_index % regions_across) * REGION_CHUNKS;
+    int first_chunk_z = (region_index / regions_across) * REGION_CHUNKS;
+    int last_chunk_x  = first_chunk_x + REGION_CHUNKS;
+    int last_chunk_z  = first_chunk_z + REGION_CHUNKS;
+    if (last_chunk_x > chunks_across) {
+        last_chunk_x = chunks_across;
+    }
+    if (last_chunk_z > chunks_down) {
+        last_chunk_z = chunks_down;
+    }
+
+    *pOut_first_chunk_x = first_chunk_x;
+    *pOut_first_chunk_z = first_chunk_z;
+    *pOut_last_chunk_x  = last_chunk_x;
+    *pOut_last_chunk_z  = last_chunk_z;
+}
+
+
+// How many heightmap columns a region's chunks cover. The edge ones hang off the heightmap,
+// so only count what's on it, which is from "getChunkBounds", with the ends past the end.
+int WorldGenerator::getRegionColumns(int region_index) const
+{
+    int first_x, first_z, chunks_across, chunks_down;
+    getChunkBounds(&first_x, &first_z, &chunks_across, &chunks_down);
+
+    int first_chunk_x, first_chunk_z, last_chunk_x, last_chunk_z;
+    getRegionBounds(region_index, &first_chunk_x, &first_chunk_z, &last_chunk_x, &last_chunk_z);
+
+    int hmap_first_x = -(m_hmap_width / 2);
+    int hmap_last_x  = hmap_first_x + m_hmap_width;
+    int hmap_last_z  = (m_hmap_height / 2) + 1;
+    int hmap_first_z = hmap_last_z - m_hmap_height;
+
+    int min_x = std::max(first_x + (first_chunk_x * CHUNK_BLOB_WIDTH), hmap_first_x);
+    int max_x = std::min(first_x + (last_chunk_x  * CHUNK_BLOB_WIDTH), hmap_last_x);
+    int min_z = std::max(first_z + (first_chunk_z * CHUNK_BLOB_WIDTH), hmap_first_z);
+    int max_z = std::min(first_z + (last_chunk_z  * CHUNK_BLOB_WIDTH), hmap_last_z);
+
+    if ((max_x <= min_x) || (max_z <= min_z)) {
+        return 0;
+    }
+
+    return (max_x - min_x) * (max_z - min_z);
+}
+
+
+// Which heightmap rows a region's chunks cover, with the last one past the end.
+// Z goes up the image, so the regions furthest along Z are the top rows.
+void WorldGenerator::getRegionRows(int region_index, int *pOut_first_row, int *pOut_last_row) const
+{
+    int first_x, first_z, chunks_across, chunks_down;
+    getChunkBounds(&first_x, &first_z, &chunks_across, &chunks_down);
+
+    int first_chunk_x, first_chunk_z, last_chunk_x, last_chunk_z;
+    getRegionBounds(region_index, &first_chunk_x, &first_chunk_z, &last_chunk_x, &last_chunk_z);
+
+    int min_z = first_z + (first_chunk_z * CHUNK_BLOB_WIDTH);
+    int max_z = first_z + (last_chunk_z  * CHUNK_BLOB_WIDTH);
+
+    // The other way around from "calcChunk", for the first and last Z.
+    int first_row = std::max(-(max_z - 1) + (m_hmap_height / 2), 0);
+    int last_row  = std::min(-min_z + (m_hmap_height / 2) + 1, m_hmap_height);
+
+    *pOut_first_row = first_row;
+    *pOut_last_row  = std::max(last_row, first_row);
+}
+
+
+// Calc the blobs for every chunk in one region. Regions are numbered across, then down.
+// The heights only need the region's rows, from "getRegionRows".
+// This runs on a worker thread, so it only reads.
+void WorldGenerator::calcRegion(int region_index, const DirtHeightMap &heights, RegionBuffer *pOut) const
+{
+    int first_x, first_z, chunks_across, chunks_down;
+    getChunkBounds(&first_x, &first_z, &chunks_across, &chunks_down);
+
+    int first_chunk_x, first_chunk_z, last_chunk_x, last_chunk_z;
+    getRegionBounds(region_index, &first_chunk_x, &first_chunk_z, &last_chunk_x, &last_chunk_z);
+
+    pOut->region_index = region_index;
+    pOut->columns = getRegionColumns(region_index);
+
+    for     (int chunk_x = first_chunk_x; chunk_x < last_chunk_x; chunk_x++) {
+        for (int chunk_z = first_chunk_z; chunk_z < last_chunk_z; chunk_z++) {
+            ChunkBuffer chunk;
+            int origin_x = first_x + (chunk_x * CHUNK_BLOB_WIDTH);
+            int origin_z = first_z + (chunk_z * CHUNK_BLOB_WIDTH);
+
+            if (calcChunk(origin_x, origin_z, heights, &chunk, &pOut->stats)) {
+                pOut->chunks.emplace_back(std::move(chunk));
+            }
+        }
+    }
+}
+
+
+// Calc the blob for one chunk, from the whole heightmap.
+bool WorldGenerator::calcChunk(int origin_x, int origin_z, ChunkBuffer *pOut_chunk, BuildStats *pOut_stats) const
+{
+    assert(m_height_map != nullptr);
+    return calcChunk(origin_x, origin_z, *m_height_map, pOut_chunk, pOut_stats);
+}
+
+
+// Calc the blob for one chunk, column by column, in blob order.
+// Anything off the heightmap, or below the bottom of the world, is just air.
+// The coal isn't quite what it was before the batched noise. See "CalcCoalNoise".
+// Return false if the whole chunk is air, since there's no point writing it.
+bool WorldGenerator::calcChunk(int origin_x, int origin_z, const DirtHeightMap &heights,
+                               ChunkBuffer *pOut_chunk, BuildStats *pOut_stats) const
+{
+    int hmap_width  = m_hmap_width;
+    int hmap_height = m_hmap_height;
+
+    ChunkBlobWriter writer;
+    GeneratedColumn column;
+    bool has_blocks = false;
+
+    for     (int local_x = 0; local_x < CHUNK_BLOB_WIDTH; local_x++) {
+        for (int local_z = 0; local_z < CHUNK_BLOB_WIDTH; local_z++) {
+            int world_x = origin_x + local_x;
+            int world_z = origin_z + local_z;
+
+            // Back to the heightmap pixel, the other way around from "calcDryRunTile".
+            int x =  world_x + (hmap_width  / 2);
+            int y = -world_z + (hmap_height / 2);
+
+            int dirt_height = heights.getDirtHeight(x, y);
+            if (dirt_height < 0) {
+                writer.addEmptyColumn();
+                continue;
+            }
+
+            CalcColumn(m_recipe, world_x, world_z, dirt_height, &column);
+            addColumnToBlob(column, &writer, pOut_stats);
+            has_blocks = true;
+        }
+    }
+
+    assert(writer.isComplete());
+
+    pOut_chunk->x    = origin_x;
+    pOut_chunk->z    = origin_z;
+    pOut_chunk->data = writer.getData();
+    return has_blocks;
+}
+
+
+// Count up the blocks for one tile of the heightmap, the same as "CalcColumn" would
+// come up with, but redoing only what the cache doesn't already have. The counts are
+// all simple, except for the coal, and that's the sure coal plus the close calls.
+// This runs on a worker thread, and nobody else touches this tile while it does.
+void WorldGenerator::calcDryRunTile(
+    int tile_index, const DryRunCache &cache, DryRunTile *pInOut_tile, BuildStats *pOut_stats) const
+{
+    double coal_density = m_build_settings.getCoalDensity() / 100.0f;
+
+    int hmap_width  = m_hmap_width;
+    int hmap_height = m_hmap_height;
+
+    int first_x, first_y, last_x, last_y;
+    getTileBounds(tile_index, &first_x, &first_y, &last_x, &last_y);
+
+    int column_count = (last_x - first_x) * (last_y - first_y);
+
+    // The stone noise, if the noise scale changed.
+    if (!pInOut_tile->has_stone_noise) {
+        pInOut_tile->stone_noise.resize(column_count);
+
+        int column = 0;
+        for     (int x = first_x; x < last_x; x++) {
+            for (int y = first_y; y < last_y; y++) {
+                int world_x =  x - (hmap_width  / 2);
+                int world_z = -y + (hmap_height / 2);
+                pInOut_tile->stone_noise[column] = CalcStoneNoise(m_recipe, world_x, world_z);
+                column++;
+            }
+        }
+
+        pInOut_tile->has_stone_noise = true;
+    }
+
+    // The stone heights are cheap, so always redo those. If any column's stone
+    // went higher than we have coal noise for, redo the coal noise too.
+    std::vector<int> stone_heights(column_count);
+    bool coal_is_stale = !pInOut_tile->has_coal;
+
+    int column = 0;
+    for     (int x = first_x; x < last_x; x++) {
+        for (int y = first_y; y < last_y; y++) {
+            int dirt_height = m_height_map->getDirtHeight(x, y);
+            if (dirt_height >= 0) {
+                int stone_height = CalcStoneHeightFromNoise(m_recipe, dirt_height, pInOut_tile->stone_noise[column]);
+                stone_heights[column] = stone_height;
+
+                if (!coal_is_stale && (stone_height > pInOut_tile->noise_tops[column])) {
+                    coal_is_stale = true;
+                }
+            }
+
+            column++;
+        }
+    }
+
+    // Redo the coal noise, but only for the columns that need it. The rest just get
+    // copied over. The first time through, only go up as far as the stone, since
+    // that's all a build would ever do. After that, the stone must be going up,
+    // so go all the way up to the ceiling, and it won't have to happen again.
+    if (coal_is_stale) {
+        bool had_coal = pInOut_tile->has_coal;
+
+        std::vector<int> old_noise_tops;
+        std::vector<ColumnBits> old_coal_bits;
+        std::vector<int> old_candidate_starts;
+        std::vector<CoalCandidate> old_candidates;
+        if (had_coal) {
+            old_noise_tops.swap(pInOut_tile->noise_tops);
+            old_coal_bits.swap(pInOut_tile->coal_bits);
+            old_candidate_starts.swap(pInOut_tile->candidate_starts);
+            old_candidates.swap(pInOut_tile->candidates);
+        }
+
+        ColumnBits no_bits;
+        no_bits.fill(0);
+
+        pInOut_tile->noise_tops.assign(column_count, -1);
+        pInOut_tile->coal_bits.assign(column_count, no_bits);
+        pInOut_tile->candidate_starts.resize(column_count + 1);
+        pInOut_tile->candidates.clear();
+
+        float noise_vals[CHUNK_BLOB_HEIGHT];
+
+        column = 0;
+        for     (int x = first_x; x < last_x; x++) {
+            for (int y = first_y; y < last_y; y++) {
+                pInOut_tile->candidate_starts[column] = pInOut_tile->candidates.size();
+
+                int dirt_height = m_height_map->getDirtHeight(x, y);
+                int stone_height = stone_heights[column];
+
+                if (dirt_height < 0) {
+                    // Nothing here at all.
+                }
+                else if (had_coal && (stone_height <= old_noise_tops[column])) {
+                    pInOut_tile->noise_tops[column] = old_noise_tops[column];
+                    pInOut_tile->coal_bits[column]  = old_coal_bits[column];
+
+                    auto first = old_candidates.begin() + old_candidate_starts[column];
+                    auto last  = old_candidates.begin() + old_candidate_starts[column + 1];
+                    pInOut_tile->candidates.insert(pInOut_tile->candidates.end(), first, last);
+                }
+                else {
+                    int world_x =  x - (hmap_width  / 2);
+                    int world_z = -y + (hmap_height / 2);
+
+                    int ceiling = (dirt_height > stone_height) ? dirt_height : stone_height;
+                    int noise_top = had_coal ? ceiling : stone_height;
+                    CalcCoalNoise(m_recipe, world_x, world_z, noise_top, noise_vals);
+
+                    ColumnBits &column_bits = pInOut_tile->coal_bits[column];
+                    for (int noise_y = 0; noise_y <= noise_top; noise_y++) {
+                        float noise_val = noise_vals[noise_y];
+                        if (noise_val < cache.coal_low) {
+                            column_bits[noise_y / 64] |= 1ull << (noise_y % 64);
+                        }
+                        else if (noise_val < cache.coal_high) {
+                            pInOut_tile->candidates.push_back({ noise_y, noise_val });
+                        }
+                    }
+
+                    pInOut_tile->noise_tops[column] = noise_top;
+                }
+
+                column++;
+            }
+        }
+
+        pInOut_tile->candidate_starts[column_count] = pInOut_tile->candidates.size();
+        pInOut_tile->has_coal = true;
+    }
+
+    // Now, just count. Everything up to the ceiling is dirt, except the stone,
+    // and some of the stone is coal.
+    int dirt_count  = 0;
+    int stone_count = 0;
+    int coal_count  = 0;
+
+    column = 0;
+    for     (int x = first_x; x < last_x; x++) {
+        for (int y = first_y; y < last_y; y++) {
+            int dirt_height = m_height_map->getDirtHeight(x, y);
+            if (dirt_height >= 0) {
+                int stone_height = stone_heights[column];
+                int ceiling = (dirt_height > stone_height) ? dirt_height : stone_height;
+
+                int column_coal = 0;
+                if (stone_height >= 0) {
+                    column_coal = CountColumnBits(pInOut_tile->coal_bits[column], stone_height);
+                }
+
+                int first = pInOut_tile->candidate_starts[column];
+                int last  = pInOut_tile->candidate_starts[column + 1];
+                for (int i = first; i < last; i++) {
+                    const CoalCandidate &candidate = pInOut_tile->candidates[i];
+                    if ((candidate.y <= stone_height) && (candidate.noise < coal_density)) {
+                        column_coal++;
+                    }
+                }
+
+                dirt_count  += ceiling - stone_height;
+                stone_count += (stone_height + 1) - column_coal;
+                coal_count  += column_coal;
+            }
+
+            column++;
+        }
+    }
+
+    pOut_stats->add(BlockType::DIRT,  dirt_count);
+    pOut_stats->add(BlockType::STONE, stone_count);
+    pOut_stats->add(BlockType::COAL,  coal_count);
+}
+
+
+// Do the initial setup for the database.
+// Clear out any old tables, and build new ones, with the key for this save.
+bool WorldGenerator::initTables(sqlite3 *db, const std::string &build_key)
+{
+    bool success;
+
+    // The old row-per-block table goes too, or the game would think it's an old world.
+    success = SQL_exec(db, "DROP TABLE IF EXISTS blocks");
+    if (!success) {
+        return false;
+    }
+
+    success = SQL_exec(db, "DROP TABLE IF EXISTS chunks");
+    if (!success) {
+        return false;
+    }
+
+    success = SQL_exec(db, "DROP TABLE IF EXISTS build_info");
+    if (!success) {
+        return false;
+    }
+
+    success = SQL_exec(db, "DROP TABLE IF EXISTS build_regions");
+    if (!success) {
+        return false;
+    }
+
+    // The primary key is all the game ever looks chunks up by, so no other indexes.
+    success = SQL_exec(db,
+        "CREATE TABLE chunks ("
+        "x INTEGER, "
+        "z INTEGER, "
+        "data BLOB NOT NULL, "
+        "PRIMARY KEY (x, z))");
+    if (!success) {
+        return false;
+    }
+
+    // What this save is of, and which regions are done, with their stats. The game never
+    // looks at these. They're only here so an interrupted save can pick up where it stopped.
+    success = SQL_exec(db, "CREATE TABLE build_info (key TEXT NOT NULL)");
+    if (!success) {
+        return false;
+    }
+
+    success = SQL_exec(db, fmt::format("INSERT INTO build_info (key) VALUES ('{}')", build_key));
+    if (!success) {
+        return false;
+    }
+
+    success = SQL_exec(db,
+        "CREATE TABLE build_regions ("
+        "region INTEGER PRIMARY KEY, "
+        "air INTEGER, "
+        "dirt INTEGER, "
+        "stone INTEGER, "
+        "coal INTEGER)");
+    if (!success) {
+        return false;
+    }
+
+    return true;
+}
+
+
+// See if the file has an earlier save of the same world, and if it does, which regions
+// it got done, and their stats. Not finding one isn't an error. Return false if
+// something went wrong, in which case the database is closed.
+bool WorldGenerator::readCheckpoints(
+    sqlite3 *db, const std::string &build_key, std::vector<char> *pOut_done, BuildStats *pOut_stats, bool *pOut_found)
+{
+    *pOut_found = false;
+
+    // No checkpoint table means no earlier save, or one from before there were checkpoints.
+    sqlite3_stmt *stmt = SQL_prepare(db,
+        "SELECT 1 FROM sqlite_master WHERE type == 'table' AND name == 'build_info'");
+    if (stmt == nullptr) {
+        return false;
+    }
+
+    bool has_table = (sqlite3_step(stmt) == SQLITE_ROW);
+    sqlite3_finalize(stmt);
+
+    if (!has_table) {
+        return true;
+    }
+
+    // Anything different about the world means none of it's any good.
+    stmt = SQL_prepare(db, "SELECT key FROM build_info");
+    if (stmt == nullptr) {
+        return false;
+    }
+
+    bool same_world = false;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        const char *key = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0));
+        same_world = (key != nullptr) && (build_key == key);
+    }
+    sqlite3_finalize(stmt);
+
+    if (!same_world) {
+        return true;
+    }
+
+    // Same world. Get the regions, and add up their stats.
+    stmt = SQL_prepare(db, "SELECT region, air, dirt, stone, coal FROM build_regions");
+    if (stmt == nullptr) {
+        return false;
+    }
+
+    int ret_code;
+    while ((ret_code = sqlite3_step(stmt)) == SQLITE_ROW) {
+        int region = sqlite3_column_int(stmt, 0);
+        if ((region < 0) || (region >= static_cast<int>(pOut_done->size()))) {
+            continue;
+        }
+
+        (*pOut_done)[region] = 1;
+        pOut_stats->add(BlockType::AIR,   sqlite3_column_int64(stmt, 1));
+        pOut_stats->add(BlockType::DIRT,  sqlite3_column_int64(stmt, 2));
+        pOut_stats->add(BlockType::STONE, sqlite3_column_int64(stmt, 3));
+        pOut_stats->add(BlockType::COAL,  sqlite3_column_int64(stmt, 4));
+    }
+
+    sqlite3_finalize(stmt);
+
+    if (ret_code != SQLITE_DONE) {
+        PrintDebug(fmt::format("Reading the checkpoints failed, code = {}", SQL_code_to_str(ret_code)));
+        sqlite3_close(db);
+        return false;
+    }
+
+    *pOut_found = true;
+    return true;
+}
+
+
+// Everything a save depends on, as a string. An earlier save only gets picked up if this
+// matches exactly. The generator only ever sees the dirt heights, so they go in as a hash.
+std::string WorldGenerator::calcBuildKey() const
+{
+    // Bands hash the whole heightmap when they're opened.
+    std::uint64_t hash = (m_height_map != nullptr) ?
+        HashDirtHeights(*m_height_map, DIRT_HASH_START) : m_height_bands->getHash();
+
+    return fmt::format(
+        "blob_version={0} region_chunks={1} width={2} height={3} heights={4:016x} "
+        "stone_percent={5:.17g} stone_subtracted={6:.17g} stone_displacement={7:.17g} "
+        "stone_noise_scale={8:.17g} coal_density={9:.17g}",
+        CHUNK_BLOB_VERSION, REGION_CHUNKS, m_hmap_width, m_hmap_height, hash,
+        m_build_settings.getStonePercent(),
+        m_build_settings.getStoneSubtracted(),
+        m_build_settings.getStoneDisplacement(),
+        m_build_settings.getStoneNoiseScale(),
+        m_build_settings.getCoalDensity());
+}
+
+
+// Add a column's rows to the blob, and its blocks to the stats.
+void WorldGenerator::addColumnToBlob(
+    const GeneratedColumn &column, ChunkBlobWriter *pOut_writer, BuildStats *pOut_stats) const
+{
+    pOut_writer->addColumnTops(column.dirt_top, column.stone_top, column.coal_ys.data(), column.coal_count);
+
+    for (int y = 0; y < column.block_count; y++) {
+        pOut_stats->add(column.blocks[y]);
+    }
+}
+
+
+// Write all the chunks for a region, a row apiece, then its checkpoint row.
+// The blobs outlive the statement, so SQLite doesn't need its own copy.
+// Return false if something went wrong.
+bool WorldGenerator::writeRegion(
+    const RegionBuffer &region, sqlite3 *db, sqlite3_stmt *insert_stmt, sqlite3_stmt *checkpoint_stmt)
+{
+    for (const ChunkBuffer &chunk : region.chunks) {
+        int size = static_cast<int>(chunk.data.size());
+
+        sqlite3_reset(insert_stmt);
+        sqlite3_bind_int(insert_stmt, 1, chunk.x);
+        sqlite3_bind_int(insert_stmt, 2, chunk.z);
+        sqlite3_bind_blob(insert_stmt, 3, chunk.data.data(), size, SQLITE_STATIC);
+
+        int ret_code = sqlite3_step(insert_stmt);
+        if (ret_code != SQLITE_DONE) {
+            m_last_error = fmt::format(
+                "Insert failed, code = {0}, error = {1}",
+                SQL_code_to_str(ret_code),
+                sqlite3_errmsg(db));
+            return false;
+        }
+
+        m_chunks_written++;
+        m_bytes_written += size;
+    }
+
+    sqlite3_reset(checkpoint_stmt);
+    sqlite3_bind_int(checkpoint_stmt, 1, region.region_index);
+    sqlite3_bind_int64(checkpoint_stmt, 2, region.stats.getCount(BlockType::AIR));
+    sqlite3_bind_int64(checkpoint_stmt, 3, region.stats.getCount(BlockType::DIRT));
+    sqlite3_bind_int64(checkpoint_stmt, 4, region.stats.getCount(BlockType::STONE));
+    sqlite3_bind_int64(checkpoint_stmt, 5, region.stats.getCount(BlockType::COAL));
+
+    int ret_code = sqlite3_step(checkpoint_stmt);
+    if (ret_code != SQLITE_DONE) {
+        m_last_error = fmt::format(
+            "Checkpoint failed, code = {0}, error = {1}",
+            SQL_code_to_str(ret_code),
+            sqlite3_errmsg(db));
+        return false;
+    }
+
+    return true;
+}
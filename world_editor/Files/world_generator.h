@@ -0,0 +1,186 @@
+#pragma once
+
+#include "stdafx.h"
+#include "build_progress.h"
+#include "build_settings.h"
+#include "build_stats.h"
+#include "chunk_blob.h"
+#include "column_recipe.h"
+#include "common_util.h"
+#include "dirt_heights.h"
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+
+// Everything it takes to turn a heightmap into a world file, with no GUI at all.
+// The editor wraps this up with its bitmaps and message boxes, and the headless
+// command-line generator wraps it up with a PNG loader and some printing.
+
+
+// One row for the chunks table. The origin is in world coords, same as the game's.
+struct ChunkBuffer
+{
+    int x;
+    int z;
+    std::vector<unsigned char> data;
+};
+
+
+// Everything one region of chunks turns into, ready to be written, and which
+// region it was, and how many heightmap columns it covers, for the progress.
+// Chunks with nothing in them at all don't get a row.
+struct RegionBuffer
+{
+    RegionBuffer() : region_index(0), columns(0) {}
+
+    int region_index;
+    int columns;
+    std::vector<ChunkBuffer> chunks;
+    BuildStats stats;
+};
+
+
+// Gets told how a save is going, after every region, on whichever thread is saving.
+typedef std::function<void(const BuildProgress &progress)> BuildProgressFunc;
+
+
+// A spot in a column where the coal noise is close to the coal density,
+// so whether it's coal or not depends on exactly where the density is.
+struct CoalCandidate
+{
+    int y;
+    float noise;
+};
+
+
+// One bit per block in a column, for the spots that are coal for
+// any coal density in the window, as long as they're under the stone.
+typedef std::array<std::uint64_t, 4> ColumnBits;
+
+
+// What a dry run remembers about one tile, so the next one can skip whatever
+// the settings change didn't touch. The stone noise only depends on the noise
+// scale. The coal noise does too, but there's far too much of it to keep,
+// so we keep which spots are sure to be coal, and the ones that are close.
+// Columns go down each X in turn, the way "calcDryRunTile" walks them.
+struct DryRunTile
+{
+    DryRunTile() : has_stone_noise(false), has_coal(false) {}
+
+    bool has_stone_noise;
+    std::vector<double> stone_noise;
+
+    // How high each column's coal noise goes, the sure coal, and the close calls
+    // for each column, which start at "candidate_starts[column]".
+    bool has_coal;
+    std::vector<int> noise_tops;
+    std::vector<ColumnBits> coal_bits;
+    std::vector<int> candidate_starts;
+    std::vector<CoalCandidate> candidates;
+};
+
+
+// Everything a dry run keeps between runs, for one heightmap. Changing the coal
+// density only recounts, unless it leaves the window. Changing the stone percent,
+// subtraction or displacement only redoes the stone heights. Changing the noise
+// scale, or the heightmap, means starting all over.
+struct DryRunCache
+{
+    DryRunCache() : noise_scale(-1.0), coal_low(0.0), coal_high(0.0) {}
+
+    double noise_scale;
+    double coal_low;
+    double coal_high;
+    std::vector<DryRunTile> tiles;
+};
+
+
+class WorldGenerator
+{
+public:
+    WorldGenerator(const BuildSettings &settings, const DirtHeightMap &height_map);
+    WorldGenerator(const BuildSettings &settings, DirtHeightBands *pHeight_bands);
+    ~WorldGenerator() {}
+
+    BuildStats performDryRun() const;
+    BuildStats performDryRun(DryRunCache *pInOut_cache) const;
+    bool saveToDatabase(const std::string &fname, BuildStats *pOut_stats);
+
+    // One chunk's blob, all on its own, for anyone who wants to look before saving.
+    // Dry runs and this need the whole heightmap. Saving can make do with bands of it.
+    bool calcChunk(int origin_x, int origin_z, ChunkBuffer *pOut_chunk, BuildStats *pOut_stats) const;
+
+    // Saving. Any thread can cancel, and the save stops after the region it's on.
+    // Dry runs can be cancelled too, and stop after the tiles they're on.
+    void setProgressFunc(BuildProgressFunc func) { m_progress_func = func; }
+    void setResume(bool resume) { m_resume = resume; }
+    void cancel() { m_cancelled = true; }
+
+    // Getters. The chunk and byte counts and the error are from the last save.
+    int getColumnCount() const { return m_hmap_width * m_hmap_height; }
+    int getChunksWritten() const { return m_chunks_written; }
+    long long getBytesWritten() const { return m_bytes_written; }
+    bool wasCancelled() const { return m_cancelled; }
+    const std::string &getLastError() const { return m_last_error; }
+
+private:
+    // Disallow the default ctor, copying, and moving.
+    WorldGenerator() = delete;
+    WorldGenerator(const WorldGenerator &that) = delete;
+    void operator=(const WorldGenerator &that) = delete;
+    WorldGenerator(WorldGenerator &&that) = delete;
+    void operator=(WorldGenerator &&that) = delete;
+
+    // Private methods.
+    bool initTables(sqlite3 *db, const std::string &build_key);
+    bool readCheckpoints(
+        sqlite3 *db, const std::string &build_key, std::vector<char> *pOut_done, BuildStats *pOut_stats, bool *pOut_found);
+    std::string calcBuildKey() const;
+    void calcRegion(int region_index, const DirtHeightMap &heights, RegionBuffer *pOut) const;
+    bool calcChunk(int origin_x, int origin_z, const DirtHeightMap &heights,
+                   ChunkBuffer *pOut_chunk, BuildStats *pOut_stats) const;
+    void calcDryRunTile(
+        int tile_index, const DryRunCache &cache, DryRunTile *pInOut_tile, BuildStats *pOut_stats) const;
+    void addColumnToBlob(const GeneratedColumn &column, ChunkBlobWriter *pOut_writer, BuildStats *pOut_stats) const;
+    bool writeRegion(const RegionBuffer &region, sqlite3 *db, sqlite3_stmt *insert_stmt, sqlite3_stmt *checkpoint_stmt);
+    void getTileBounds(int tile_index, int *pOut_first_x, int *pOut_first_y, int *pOut_last_x, int *pOut_last_y) const;
+    int  getTileCount() const;
+    void getChunkBounds(int *pOut_first_x, int *pOut_first_z, int *pOut_chunks_across, int *pOut_chunks_down) const;
+    int  getRegionCount() const;
+    void getRegionBounds(int region_index, int *pOut_first_chunk_x, int *pOut_first_chunk_z,
+                         int *pOut_last_chunk_x, int *pOut_last_chunk_z) const;
+    int  getRegionColumns(int region_index) const;
+    void getRegionRows(int region_index, int *pOut_first_row, int *pOut_last_row) const;
+
+    // Private data. Dry runs count the heightmap in square tiles, one per task.
+    // Saving works in square regions of whole chunks instead, so every chunk's
+    // blob gets made in one go, and only so many finished regions can be
+    // waiting on the database at once. Every region is committed along with a
+    // checkpoint row saying it's done, so a save can pick up where one stopped.
+    static const int TILE_SIZE = 64;
+    static const int REGION_CHUNKS = 4;
+    static const int MAX_QUEUED_REGIONS = 16;
+
+    // How far the coal density can move, in noise units, before the dry run
+    // has to redo the coal noise. That's two percent of coal density either way.
+    static const double COAL_WINDOW;
+
+    // The heights are either the whole heightmap, or bands of it read as the save
+    // goes, whichever ctor it was. The other one's null. The recipe is the
+    // settings, the way the game's generator takes them too.
+    BuildSettings m_build_settings;
+    ColumnRecipe m_recipe;
+    const DirtHeightMap *m_height_map;
+    DirtHeightBands *m_height_bands;
+    int m_hmap_width;
+    int m_hmap_height;
+
+    int m_chunks_written;
+    long long m_bytes_written;
+    std::string m_last_error;
+
+    BuildProgressFunc m_progress_func;
+    bool m_resume;
+    std::atomic<bool> m_cancelled;
+};
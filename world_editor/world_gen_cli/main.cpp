@@ -0,0 +1,261 @@
+#include "stdafx.h"
+
+#include "build_settings.h"
+#include "build_stats.h"
+#include "dirt_heights.h"
+#include "format.h"
+#include "world_generator.h"
+
+#include <chrono>
+#include <csignal>
+
+
+// The world generator, minus the editor. Give it a heightmap, the same
+// build settings the editor's settings dialog has, and where to write the world.
+// Good for scripted builds, and for timing the generator on its own.
+
+
+// The generator that's saving, if any, so Ctrl-C can stop it cleanly.
+// Cancelling just sets a flag, which is all a signal handler should do.
+static WorldGenerator *s_saving_generator = nullptr;
+
+static void OnInterrupt(int /* sig */)
+{
+    if (s_saving_generator != nullptr) {
+        s_saving_generator->cancel();
+    }
+}
+
+
+// Print how to use this thing.
+static void PrintUsage()
+{
+    BuildSettings defaults;
+
+    printf(
+        "Usage: world_gen <heightmap> <world.db> [options]\n"
+        "\n"
+        "The heightmap can be a PNG, 8 or 16 bits, or a square 16-bit raw file (.r16 or .raw).\n"
+        "Name any one tile of a grid of either, like \"map_x0_y0.png\", to use the whole grid.\n"
+        "\n"
+        "Options:\n"
+        "  --stone-percent <val>       How much of the dirt height is stone (%.1f)\n"
+        "  --stone-subtracted <val>    How far to lower the stone (%.1f)\n"
+        "  --stone-displacement <val>  How far the noise moves the stone (%.1f)\n"
+        "  --stone-noise-scale <val>   How stretched out the noise is (%.1f)\n"
+        "  --coal-density <val>        Percent chance of coal, roughly (%.1f)\n"
+        "  --dry-run                   Just count the blocks, don't write anything\n"
+        "  --fresh                     Start over, even if <world.db> has an unfinished save\n"
+        "  --stop-after <regions>      Stop after writing this many regions, same as Ctrl-C\n"
+        "\n"
+        "Saves can be stopped with Ctrl-C. Saving the same world to the same file again\n"
+        "picks up where it stopped.\n",
+        defaults.getStonePercent(),
+        defaults.getStoneSubtracted(),
+        defaults.getStoneDisplacement(),
+        defaults.getStoneNoiseScale(),
+        defaults.getCoalDensity());
+}
+
+
+// Parse the options after the two file names. Return false for anything we don't know.
+static bool ParseOptions(
+    int argc, char *argv[], BuildSettings *pOut_settings, bool *pOut_dry_run, bool *pOut_fresh, int *pOut_stop_after)
+{
+    for (int i = 3; i < argc; i++) {
+        std::string arg = argv[i];
+
+        if (arg == "--dry-run") {
+            *pOut_dry_run = true;
+            continue;
+        }
+
+        if (arg == "--fresh") {
+            *pOut_fresh = true;
+            continue;
+        }
+
+        if (i + 1 >= argc) {
+            fprintf(stderr, "Missing a value for '%s'.\n", arg.c_str());
+            return false;
+        }
+
+        if (arg == "--stop-after") {
+            *pOut_stop_after = atoi(argv[++i]);
+            continue;
+        }
+
+        double val = atof(argv[++i]);
+
+        if (arg == "--stone-percent") {
+            pOut_settings->setStonePercent(val);
+        }
+        else if (arg == "--stone-subtracted") {
+            pOut_settings->setStoneSubtracted(val);
+        }
+        else if (arg == "--stone-displacement") {
+            pOut_settings->setStoneDisplacement(val);
+        }
+        else if (arg == "--stone-noise-scale") {
+            pOut_settings->setStoneNoiseScale(val);
+        }
+        else if (arg == "--coal-density") {
+            pOut_settings->setCoalDensity(val);
+        }
+        else {
+            fprintf(stderr, "Unknown option '%s'.\n", arg.c_str());
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3) {
+        PrintUsage();
+        return 1;
+    }
+
+    std::string hmap_fname = argv[1];
+    std::string db_fname   = argv[2];
+
+    BuildSettings settings;
+    bool dry_run = false;
+    bool fresh = false;
+    int stop_after = -1;
+
+    if (!settings.setHeightMapFilename(hmap_fname) ||
+        !ParseOptions(argc, argv, &settings, &dry_run, &fresh, &stop_after)) {
+        return 1;
+    }
+
+    // Time the load separately, so it doesn't muddy the generator's numbers. A dry run
+    // wants the whole heightmap's dirt heights. A save only reads it through once here,
+    // for the hash, and then reads it again a band at a time as it goes, so however big
+    // the heightmap is, only a few bands of it are ever in memory.
+    auto load_start = std::chrono::steady_clock::now();
+
+    DirtHeightMap height_map;
+    DirtHeightBands height_bands;
+    std::unique_ptr<WorldGenerator> generator_ptr;
+    int hmap_width, hmap_height;
+
+    if (dry_run) {
+        std::string error;
+        if (!ReadDirtHeightMap(hmap_fname, &height_map, &error)) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+        generator_ptr = std::make_unique<WorldGenerator>(settings, height_map);
+        hmap_width  = height_map.width;
+        hmap_height = height_map.height;
+    }
+    else {
+        if (!height_bands.open(hmap_fname)) {
+            fprintf(stderr, "%s\n", height_bands.getLastError().c_str());
+            return 1;
+        }
+        generator_ptr = std::make_unique<WorldGenerator>(settings, &height_bands);
+        hmap_width  = height_bands.getWidth();
+        hmap_height = height_bands.getHeight();
+    }
+
+    auto load_end = std::chrono::steady_clock::now();
+    double load_secs = std::chrono::duration<double>(load_end - load_start).count();
+
+    WorldGenerator &generator = *generator_ptr;
+    generator.setResume(!fresh);
+
+    // Show how the save's going, now and then. The generator calls this after every
+    // region, which is far too often to print. It's also called once before the first
+    // region, so stopping after zero regions stops before anything gets written.
+    BuildProgress last_progress;
+    auto last_print = std::chrono::steady_clock::now();
+
+    generator.setProgressFunc([&generator, &last_progress, &last_print, stop_after](const BuildProgress &progress) {
+        if ((stop_after >= 0) && (progress.regions_done - progress.regions_resumed >= stop_after)) {
+            generator.cancel();
+        }
+
+        if ((progress.regions_done == progress.regions_resumed) && (progress.regions_resumed > 0)) {
+            fprintf(stderr, "Picking up %d of %d regions from an earlier save.\n",
+                progress.regions_resumed, progress.regions_total);
+        }
+
+        last_progress = progress;
+
+        auto now = std::chrono::steady_clock::now();
+        if (std::chrono::duration<double>(now - last_print).count() < 1.0) {
+            return;
+        }
+        last_print = now;
+
+        double secs_left = progress.getSecsLeft();
+        fprintf(stderr, "%5.1f%%, %d of %d regions, %.0f columns/sec, %s\n",
+            progress.getFraction() * 100.0, progress.regions_done, progress.regions_total,
+            progress.getColumnsPerSec(),
+            (secs_left >= 0.0) ? fmt::format("about {} secs left", static_cast<int>(secs_left + 0.5)).c_str() : "");
+    });
+
+    // Then the actual build.
+    auto build_start = std::chrono::steady_clock::now();
+
+    BuildStats stats;
+    bool success = true;
+    if (dry_run) {
+        stats = generator.performDryRun();
+    }
+    else {
+        s_saving_generator = &generator;
+        std::signal(SIGINT, OnInterrupt);
+
+        success = generator.saveToDatabase(db_fname, &stats);
+
+        std::signal(SIGINT, SIG_DFL);
+        s_saving_generator = nullptr;
+    }
+
+    auto build_end = std::chrono::steady_clock::now();
+    double build_secs = std::chrono::duration<double>(build_end - build_start).count();
+
+    if (generator.wasCancelled()) {
+        fprintf(stderr, "Stopped after %d of %d regions. Run it again to pick up where it stopped.\n",
+            last_progress.regions_done, last_progress.regions_total);
+        return 1;
+    }
+
+    if (!success) {
+        fprintf(stderr, "Build failed: %s\n", generator.getLastError().c_str());
+        return 1;
+    }
+
+    // Report how it went. Only count what this run did, not what it picked up.
+    long long columns = generator.getColumnCount() - last_progress.columns_resumed;
+    int chunks  = generator.getChunksWritten();
+    long long bytes = generator.getBytesWritten();
+    double safe_secs = (build_secs > 0.0) ? build_secs : 0.000001;
+
+    std::string report = fmt::format(
+        "{0}\n"
+        "\n"
+        "Heightmap: {1} x {2}, loaded in {3:.3f} secs\n"
+        "{4}: {5:.3f} secs\n"
+        "Columns:   {6} ({7:.0f}/sec)\n",
+        stats.toString(),
+        hmap_width, hmap_height, load_secs,
+        dry_run ? "Dry run" : "Build  ", build_secs,
+        columns, columns / safe_secs);
+
+    if (!dry_run) {
+        report += fmt::format(
+            "Chunks:    {0} ({1:.0f}/sec), {2} bytes of blobs\n"
+            "Written to '{3}'\n",
+            chunks, chunks / safe_secs, bytes, db_fname);
+    }
+
+    printf("%s", report.c_str());
+    return 0;
+}